@@ -6,47 +6,109 @@
 #include <windows.h>
 #include <comutil.h>
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
 #include <sstream>
 #include <cstdint>
 using namespace std;
 
 #include "disassembler.h"
+#include "scanner.h"
+#include "extractor.h"
+#include "pointers.h"
+#include "transfer.h"
+#include "cursor.h"
+#include "stats.h"
+#include "trace.h"
+#include "walker.h"
+#include "frames.h"
+#include "entropy.h"
+#include "readers.h"
+#include "heaps.h"
 
 // define this to avoid using seh to trap an illegal memory access
 //#define UNSAFE_MEMACCESS
 
-/** globals */
+/** compiled signature sets shared by every instance */
 namespace utils {
-	/* integer dumpers */
-	static struct {
-		const char* type;
-		Dumper::dumptype dumper;
-	} dumptypes[] = {
-		{ "uint8_t", &Dumper::dump<uint8_t> },
-		{ "uint16_t", &Dumper::dump<uint16_t> },
-		{ "uint32_t", &Dumper::dump<uint32_t> },
-		{ "uint64_t", &Dumper::dump<uint64_t> },
-		{ "float", &Dumper::dump<float> },
-		{ "double", &Dumper::dump<double> },
-
-		{ "ubyte1", &Dumper::dump<uint8_t> },
-		{ "uint2", &Dumper::dump<uint16_t> },
-		{ "uint4", &Dumper::dump<uint32_t> },
-		{ "uint8", &Dumper::dump<uint64_t> },
-		{ "binary32", &Dumper::dump<float> },
-		{ "binary64", &Dumper::dump<double> },
-		{ NULL, NULL }
-	};
+	static SignatureCache SignatureSets;
+}
+
+/** per-method statistics shared by every instance */
+namespace utils {
+	static Statistics Stats;
+}
+
+/** how long the address space caches are trusted before they're read again */
+namespace utils {
+	const std::chrono::milliseconds layout_lifetime(1000);
+}
+
+/** the access trace shared by every instance */
+namespace utils {
+	static trace::Recorder Trace;
+
+	// the raw bits of a loaded value, zero-extended, so that a replay can compare it against memory
+	template<typename T> inline std::uint64_t
+	TraceBits(T value)
+	{
+		std::uint64_t res = 0;
+		memcpy(&res, &value, sizeof(value));
+		return res;
+	}
+}
+
+/** background jobs */
+namespace jobs {
+	static Job::function
+	executables(const std::vector<Region>& regions, const std::string& argument, size_t threads)
+	{
+		return [regions](Job& job) { scan::executables(job, regions); };
+	}
+
+	static Job::function
+	bytes(const std::vector<Region>& regions, const std::string& argument, size_t threads)
+	{
+		auto pattern = scan::parse(argument);
+		return [regions, pattern, threads](Job& job) { scan::bytes(job, regions, pattern, threads); };
+	}
+
+	static Job::function
+	signatures(const std::vector<Region>& regions, const std::string& argument, size_t threads)
+	{
+		auto set = utils::SignatureSets.get(argument);
+		return [regions, set, threads](Job& job) { scan::signatures(job, regions, set, threads); };
+	}
+
+	static Job::function
+	strings(const std::vector<Region>& regions, const std::string& argument, size_t threads)
+	{
+		size_t minimum = argument.empty() ? 4 : std::stoul(argument, nullptr, 0);
+		return [regions, minimum, threads](Job& job) { strings::extract(job, regions, minimum, threads); };
+	}
+
+	static Job::function
+	crc32(const std::vector<Region>& regions, const std::string& argument, size_t threads)
+	{
+		size_t blocksize = argument.empty() ? 0x1000 : std::stoul(argument, nullptr, 0);
+		return [regions, blocksize](Job& job) { scan::crc32(job, regions, blocksize); };
+	}
+}
 
-	/* disassembler syntax */
+namespace utils {
+	/* job types */
 	static struct {
-		const char* identifier;
-		enum cs_opt_value option;
-	} SyntaxList[] = {
-		{"default", CS_OPT_SYNTAX_DEFAULT},
-		{"intel", CS_OPT_SYNTAX_INTEL},
-		{"att", CS_OPT_SYNTAX_ATT},
-		{NULL, (cs_opt_value)0}
+		const char* operation;
+		Job::function(*builder)(const std::vector<Region>&, const std::string&, size_t);
+	} jobtypes[] = {
+		{ "executables", &jobs::executables },
+		{ "bytes", &jobs::bytes },
+		{ "crc32", &jobs::crc32 },
+		{ "signatures", &jobs::signatures },
+		{ "strings", &jobs::strings },
+		{ NULL, NULL }
 	};
 }
 
@@ -76,6 +138,52 @@ namespace utils {
 		throw std::invalid_argument(std::to_string(option));
 	}
 
+	std::string
+	BSTRToString(BSTR bstr)
+	{
+		auto tempstr = _com_util::ConvertBSTRToString(bstr);
+		if (tempstr == NULL)
+			throw std::invalid_argument("bstr");
+
+		std::string res(tempstr);
+		delete[] tempstr;
+		return res;
+	}
+
+	// hand off the contents of a wide buffer, which is the only copy that's made of them
+	BSTR
+	BufferToBSTR(WideBuffer& buffer)
+	{
+		static_assert(sizeof(OLECHAR) == sizeof(char16_t), "OLECHAR is expected to be UTF-16");
+		return ::SysAllocStringLen(reinterpret_cast<const OLECHAR*>(buffer.data()), static_cast<UINT>(buffer.size()));
+	}
+
+	// everything that we format ourselves is ASCII, so it's widened directly into the result
+	BSTR
+	StringToBSTR(const std::string& string)
+	{
+		auto res = ::SysAllocStringLen(NULL, static_cast<UINT>(string.size()));
+		if (res == NULL)
+			return NULL;
+
+		auto p = reinterpret_cast<const unsigned char*>(string.data());
+		for (size_t i = 0; i < string.size(); i++)
+			res[i] = p[i];
+		return res;
+	}
+
+	Job::function
+	CstringToJob(const std::string& operation, const std::vector<Region>& regions, const std::string& argument, size_t threads)
+	{
+		auto p = &jobtypes[0];
+		while (p->operation) {
+			if (operation.compare(p->operation) == 0)
+				return p->builder(regions, argument, threads);
+			p++;
+		}
+		throw std::invalid_argument(operation);
+	}
+
 	Dumper::dumptype
 	CstringToDumptype(std::string type)
 	{
@@ -87,6 +195,29 @@ namespace utils {
 		}
 		throw std::invalid_argument(type);
 	}
+
+	size_t
+	CstringToDumpsize(std::string type)
+	{
+		auto p = &dumptypes[0];
+		while (p->type) {
+			if (type.compare(p->type) == 0)
+				return p->size;
+			p++;
+		}
+		throw std::invalid_argument(type);
+	}
+
+	// the number of bytes transferred, followed by what they used to be if it was asked for
+	std::string
+	TransferToString(size_t count, const std::vector<uint8_t>* previous)
+	{
+		std::ostringstream os;
+		os << std::hex << count;
+		if (previous)
+			os << " " << transfer::format(*previous);
+		return os.str();
+	}
 }
 
 /** NDK signatures */
@@ -122,68 +253,6 @@ namespace ndk {
 
 /** general utilities */
 namespace utils {
-	// byte
-	static uint8_t
-	ubyte1(intptr_t ea)
-	{
-		return *(uint8_t*)(ea);
-	}
-	static int8_t
-	sbyte1(intptr_t ea)
-	{
-		return *(int8_t*)(ea);
-	}
-
-	// word
-	static uint16_t
-	uint2(intptr_t ea)
-	{
-		return *(uint16_t*)(ea);
-	}
-	static int16_t
-	sint2(intptr_t ea)
-	{
-		return *(int16_t*)(ea);
-	}
-
-	// dword
-	static uint32_t
-	uint4(intptr_t ea)
-	{
-		return *(uint32_t*)(ea);
-	}
-	static int32_t
-	sint4(intptr_t ea)
-	{
-		return *(int32_t*)(ea);
-	}
-
-	// qword
-	static uint64_t
-	uint8(intptr_t ea)
-	{
-		return *(uint64_t*)(ea);
-	}
-
-	static int64_t
-	sint8(intptr_t ea)
-	{
-		return *(int64_t*)(ea);
-	}
-
-	// floating-point
-	static float
-	binary32(intptr_t ea)
-	{
-		return *(float*)(ea);
-	}
-
-	static double
-	binary64(intptr_t ea)
-	{
-		return *(double*)(ea);
-	}
-
 	// platform specific calls
 	static intptr_t
 	getProcessEnvironmentBlock()
@@ -213,39 +282,6 @@ namespace utils {
 		return (intptr_t)info.PebBaseAddress;
 	}
 
-	static intptr_t
-	getThreadEnvironmentBlock(DWORD dwTid)
-	{
-		static ndk::PNtQueryInformationThread NtQueryInformationThread = NULL;
-
-		NTSTATUS notok; ULONG dwLength;
-		HANDLE hThread;
-		ndk::THREAD_BASIC_INFORMATION info;
-
-		if (NtQueryInformationThread == NULL) {
-			HMODULE hNtDll = LoadLibrary(L"ntdll.dll");
-			if (hNtDll == NULL)
-				return (intptr_t)0;
-
-			NtQueryInformationThread = reinterpret_cast<decltype(NtQueryInformationThread)>(GetProcAddress(hNtDll, "NtQueryInformationThread"));
-			if (NtQueryInformationThread == NULL)
-				return (intptr_t)0;
-		}
-
-		memset(&info, 0, sizeof(info));
-
-		if (dwTid == 0)
-			dwTid = ::GetCurrentThreadId();
-
-		hThread = ::OpenThread(THREAD_QUERY_INFORMATION, FALSE, dwTid);
-		notok = NtQueryInformationThread(hThread, (::THREADINFOCLASS)ndk::ThreadBasicInformation, &info, sizeof(info), &dwLength);
-		CloseHandle(hThread);
-
-		if (notok || dwLength < offsetof(ndk::THREAD_BASIC_INFORMATION, TebBaseAddress) + sizeof(info.TebBaseAddress))
-			return (intptr_t)0;
-		return (intptr_t)info.TebBaseAddress;
-	}
-
 	static DWORD
 	getLastError()
 	{
@@ -323,6 +359,148 @@ namespace utils {
 	}
 }
 
+/** CLeaker engine state */
+CLeaker::Engine&
+CLeaker::engine()
+{
+	auto& res = m_engines.get();
+
+	// reconfigure this thread's disassembler if the settings have changed since it was last used
+	auto generation = m_generation.load();
+	if (res.generation != generation) {
+		res.disasm.bits(m_bits.load());
+		res.disasm.syntax(static_cast<cs_opt_value>(m_syntax.load()));
+		res.disasm.annotate(m_annotate ? &m_symbols : nullptr);
+		res.generation = generation;
+	}
+
+	res.os.reset();
+	return res;
+}
+
+RegionMap&
+CLeaker::regions()
+{
+	if (m_regions.stale(utils::layout_lifetime))
+		m_regions.refresh();
+	return m_regions;
+}
+
+std::vector<Region>
+CLeaker::readable(ULONGLONG ea, ULONGLONG n)
+{
+	const auto start = static_cast<uintptr_t>(ea);
+	const auto stop = (n > UINTPTR_MAX - ea) ? UINTPTR_MAX : static_cast<uintptr_t>(ea + n);
+
+	// scans are long enough that it's worth re-reading the layout before starting one
+	m_regions.refresh();
+	return m_regions.select(start, stop, [](const Region& r) { return r.readable(); });
+}
+
+ModuleTable&
+CLeaker::modules()
+{
+	if (m_modules.stale(utils::layout_lifetime))
+		m_modules.refresh();
+	return m_modules;
+}
+
+// a module that isn't found might have been loaded since the table was read, so it's read again before giving up
+bool
+CLeaker::owner(uintptr_t ea, Module& result)
+{
+	if (modules().find(ea, result))
+		return true;
+	m_modules.refresh();
+	return m_modules.find(ea, result);
+}
+
+// the exports are only parsed again for the modules that changed since the last time
+SymbolTable&
+CLeaker::symbols()
+{
+	auto& table = modules();
+	auto generation = table.generation();
+	if (m_symbols.source() != generation)
+		m_symbols.refresh(table.snapshot(), generation);
+	return m_symbols;
+}
+
+FunctionTable&
+CLeaker::functions()
+{
+	auto& table = modules();
+	auto generation = table.generation();
+	if (m_functions.source() != generation)
+		m_functions.refresh(table.snapshot(), generation);
+	return m_functions;
+}
+
+// only the code that's inside of a module is a target for a return address or a function pointer
+pointers::Targets
+CLeaker::code()
+{
+	std::vector<pointers::Interval> res;
+
+	// code that was mapped since the layout was last read would otherwise be missing from the targets
+	m_regions.refresh();
+	auto& table = modules();
+	for (auto& region : m_regions.select(0, UINTPTR_MAX, [](const Region& r) { return r.executable(); })) {
+		Module module;
+		if (table.find(region.base, module))
+			res.push_back({ region.base, region.end() });
+	}
+	return pointers::Targets(res);
+}
+
+// decode a batch of counted strings, and give the layout one more chance if any of them weren't mapped
+HRESULT
+CLeaker::strings(BSTR kind, const std::vector<std::uint64_t>& addresses, ULONG cap, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("strings");
+	Probe probe(utils::Stats, counters);
+
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	counted::kind_t type;
+	try {
+		if (!counted::kind(utils::BSTRToString(kind), type))
+			throw std::invalid_argument("kind");
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::engine);
+	auto limit = cap ? static_cast<size_t>(cap) : 0xffff;
+	auto results = counted::decode(type, addresses, width, limit, &regions());
+	if (std::any_of(results.begin(), results.end(), [](const counted::Result& r) { return r.status == counted::Result::unmapped; })) {
+		m_regions.refresh();
+		for (auto& item : results)
+			if (item.status == counted::Result::unmapped)
+				item = counted::decode(type, item.address, width, limit, &m_regions);
+	}
+
+	auto& os = engine().os;
+	for (auto& item : results) {
+		if (item.status == counted::Result::fault)
+			probe.fault();
+		auto count = item.text.size() * ((type == counted::unicode) ? sizeof(char16_t) : sizeof(char));
+		probe.bytes(count);
+		if (!item.text.empty())
+			utils::Trace.record(trace::read, item.buffer, count, 0, count);
+		counted::format(item, os);
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::BufferToBSTR(os.buffer());
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
 /** CLeaker implementation */
 STDMETHODIMP CLeaker::breakpoint()
 {
@@ -333,7 +511,7 @@ STDMETHODIMP CLeaker::breakpoint()
 /* CLeaker disassembler and dumper */
 STDMETHODIMP CLeaker::get_syntax(BSTR* pVal)
 {
-	auto bstrSyntax = _com_util::ConvertStringToBSTR(utils::OptionToSyntax(disasm.m_syntax));
+	auto bstrSyntax = utils::StringToBSTR(utils::OptionToSyntax(static_cast<cs_opt_value>(m_syntax.load())));
 	if (bstrSyntax == NULL)
 		return S_FALSE;
 
@@ -350,7 +528,8 @@ STDMETHODIMP CLeaker::put_syntax(BSTR newVal)
 		return S_FALSE;
 
 	try {
-		(cs_opt_value)disasm.syntax(utils::SyntaxToOption(syntax));
+		m_syntax = utils::SyntaxToOption(syntax);
+		m_generation++;
 	}
 	catch (...) {
 		res = S_FALSE;
@@ -362,40 +541,69 @@ STDMETHODIMP CLeaker::put_syntax(BSTR newVal)
 
 STDMETHODIMP CLeaker::get_bits(ULONG* pVal)
 {
-	*pVal = disasm.m_bits;
+	*pVal = m_bits;
 	return S_OK;
 }
 
 STDMETHODIMP CLeaker::put_bits(ULONG newVal)
 {
-	try {
-		(size_t)disasm.bits(newVal);
-	}
-	catch (...) {
+	switch (newVal) {
+	case 16: case 32: case 64:
+		break;
+	default:
 		return S_FALSE;
 	}
+
+	m_bits = newVal;
+	m_generation++;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::get_threads(ULONG* pVal)
+{
+	*pVal = m_threads;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::put_threads(ULONG newVal)
+{
+	m_threads = newVal;
 	return S_OK;
 }
 
 STDMETHODIMP CLeaker::disassemble(ULONGLONG ea, ULONG n, BSTR* result)
 {
-	std::stringstream os;
+	static auto& counters = utils::Stats.method("disassemble");
+	Probe probe(utils::Stats, counters);
+
+	auto& state = engine();
+	auto& os = state.os;
 	intptr_t p = static_cast<intptr_t>(ea);
+	size_t cb = 0;
 
+	if (m_annotate)
+		symbols();
+
+	probe.enter(MethodStats::engine);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
-		if (disasm.disasm(p, n, os) != static_cast<size_t>(n))
+		if (state.disasm.disasm(p, n, os, &cb) != static_cast<size_t>(n))
 			return S_FALSE;
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::disasm, ea, 0, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
 #endif
 
-	auto bstr = _com_util::ConvertStringToBSTR(os.str().c_str());
+	probe.bytes(cb);
+	utils::Trace.record(trace::disasm, ea, cb, 0, n);
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::BufferToBSTR(os.buffer());
 	if (bstr == NULL)
 		return S_FALSE;
 
@@ -405,7 +613,10 @@ STDMETHODIMP CLeaker::disassemble(ULONGLONG ea, ULONG n, BSTR* result)
 
 STDMETHODIMP CLeaker::dump(ULONGLONG ea, ULONG n, BSTR type, BSTR* result)
 {
-	std::stringstream os;
+	static auto& counters = utils::Stats.method("dump");
+	Probe probe(utils::Stats, counters);
+
+	auto& os = engine().os;
 	intptr_t p = static_cast<intptr_t>(ea);
 
 	// figure out what type the user wants
@@ -415,24 +626,31 @@ STDMETHODIMP CLeaker::dump(ULONGLONG ea, ULONG n, BSTR type, BSTR* result)
 	std::string typestr(tempstr);
 	delete[] tempstr;
 
-	// dump it to the stringstream
+	// dump it to this thread's stream
 	Dumper::dumptype dumper = utils::CstringToDumptype(typestr);
-	Dumper d(disasm.m_bits, 16);
+	Dumper d(m_bits, 16, (dumper == &Dumper::symbols) ? &symbols() : nullptr);
 
+	probe.enter(MethodStats::engine);
+	auto size = n * utils::CstringToDumpsize(typestr);
+	probe.bytes(size);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		(d.*dumper)(p, n, os);
+		utils::Trace.record(trace::dump, ea, size, 0, n);
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::dump, ea, size, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
 #endif
 
-	// render the stringstream and then return it
-	auto bstr = _com_util::ConvertStringToBSTR(os.str().c_str());
+	// hand the widened buffer off as the result
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::BufferToBSTR(os.buffer());
 	if (bstr == NULL)
 		return S_FALSE;
 	*result = bstr;
@@ -443,15 +661,24 @@ STDMETHODIMP CLeaker::dump(ULONGLONG ea, ULONG n, BSTR type, BSTR* result)
 /* CLeaker integer extraction */
 STDMETHODIMP CLeaker::uint8_t(ULONGLONG ea, ULONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("uint8_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(1);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::ubyte1(p);
 		*result = static_cast<ULONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 1, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 1, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -461,16 +688,24 @@ STDMETHODIMP CLeaker::uint8_t(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::sint8_t(ULONGLONG ea, LONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("sint8_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
 
+	probe.enter(MethodStats::guard);
+	probe.bytes(1);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::sbyte1(p);
 		*result = static_cast<LONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 1, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 1, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -480,15 +715,24 @@ STDMETHODIMP CLeaker::sint8_t(ULONGLONG ea, LONGLONG* result)
 
 STDMETHODIMP CLeaker::uint16_t(ULONGLONG ea, ULONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("uint16_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(2);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::uint2(p);
 		*result = static_cast<ULONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 2, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 2, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -498,15 +742,24 @@ STDMETHODIMP CLeaker::uint16_t(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::sint16_t(ULONGLONG ea, LONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("sint16_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(2);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::sint2(p);
 		*result = static_cast<LONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 2, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 2, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -516,15 +769,24 @@ STDMETHODIMP CLeaker::sint16_t(ULONGLONG ea, LONGLONG* result)
 
 STDMETHODIMP CLeaker::uint32_t(ULONGLONG ea, ULONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("uint32_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(4);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::uint4(p);
 		*result = static_cast<ULONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 4, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 4, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -534,15 +796,24 @@ STDMETHODIMP CLeaker::uint32_t(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::sint32_t(ULONGLONG ea, LONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("sint32_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(4);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::sint4(p);
 		*result = static_cast<LONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 4, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 4, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -552,15 +823,24 @@ STDMETHODIMP CLeaker::sint32_t(ULONGLONG ea, LONGLONG* result)
 
 STDMETHODIMP CLeaker::uint64_t(ULONGLONG ea, ULONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("uint64_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(8);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::uint8(p);
 		*result = static_cast<ULONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 8, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 8, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -570,15 +850,24 @@ STDMETHODIMP CLeaker::uint64_t(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::sint64_t(ULONGLONG ea, LONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("sint64_t");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(8);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::sint8(p);
 		*result = static_cast<LONGLONG>(res);
+		utils::Trace.record(trace::load, ea, 8, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 8, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -588,15 +877,24 @@ STDMETHODIMP CLeaker::sint64_t(ULONGLONG ea, LONGLONG* result)
 
 STDMETHODIMP CLeaker::binary32(ULONGLONG ea, FLOAT* result)
 {
+	static auto& counters = utils::Stats.method("binary32");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(4);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::binary32(p);
 		*result = static_cast<FLOAT>(res);
+		utils::Trace.record(trace::load, ea, 4, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 4, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -606,15 +904,24 @@ STDMETHODIMP CLeaker::binary32(ULONGLONG ea, FLOAT* result)
 
 STDMETHODIMP CLeaker::binary64(ULONGLONG ea, DOUBLE* result)
 {
+	static auto& counters = utils::Stats.method("binary64");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
+
+	probe.enter(MethodStats::guard);
+	probe.bytes(8);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
 		auto res = utils::binary64(p);
 		*result = static_cast<DOUBLE>(res);
+		utils::Trace.record(trace::load, ea, 8, 0, utils::TraceBits(res));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::load, ea, 8, 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
@@ -625,25 +932,35 @@ STDMETHODIMP CLeaker::binary64(ULONGLONG ea, DOUBLE* result)
 /* CLeaker string extraction */
 STDMETHODIMP CLeaker::unicodestring(ULONGLONG ea, BSTR* result)
 {
+	static auto& counters = utils::Stats.method("unicodestring");
+	Probe probe(utils::Stats, counters);
+
 	std::wstring wstr;
 	intptr_t p = static_cast<intptr_t>(ea);
 	PUNICODE_STRING us = reinterpret_cast<PUNICODE_STRING>(p);
 
 	// convert UNICODE_STRING to an std::wstring
+	probe.enter(MethodStats::guard);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
-		wstr.assign(us->Buffer, us->Length);
+		auto buffer = us->Buffer;
+		wstr.assign(buffer, us->Length / sizeof(WCHAR));
+		utils::Trace.record(trace::read, reinterpret_cast<std::uintptr_t>(buffer), wstr.size() * sizeof(wchar_t), 0, wstr.size() * sizeof(wchar_t));
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::read, ea, sizeof(UNICODE_STRING), 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
 #endif
 
 	// convert std::wstring to a BSTR
-	auto bstr = ::SysAllocString(wstr.c_str());
+	probe.bytes(wstr.size() * sizeof(wchar_t));
+	probe.enter(MethodStats::conversion);
+	auto bstr = ::SysAllocStringLen(wstr.data(), static_cast<UINT>(wstr.size()));
 	if (bstr == NULL)
 		return S_FALSE;
 
@@ -653,27 +970,39 @@ STDMETHODIMP CLeaker::unicodestring(ULONGLONG ea, BSTR* result)
 
 STDMETHODIMP CLeaker::ansistring(ULONGLONG ea, BSTR* result)
 {
+	static auto& counters = utils::Stats.method("ansistring");
+	Probe probe(utils::Stats, counters);
+
 	std::string str;
 	intptr_t p = static_cast<intptr_t>(ea);
 	PANSI_STRING as = reinterpret_cast<PANSI_STRING>(p);
 
 	// convert ANSI_STRING to an std::string
+	probe.enter(MethodStats::guard);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
-		str.assign(as->Buffer, as->Length);
+		auto buffer = as->Buffer;
+		str.assign(buffer, as->Length);
+		utils::Trace.record(trace::read, reinterpret_cast<std::uintptr_t>(buffer), str.size(), 0, str.size());
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::read, ea, sizeof(ANSI_STRING), 0, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
 #endif
 
-	// convert std::string to a BSTR
-	auto bstr = _com_util::ConvertStringToBSTR(str.c_str());
+	// convert std::string straight into a BSTR using the current code page
+	probe.bytes(str.size());
+	probe.enter(MethodStats::conversion);
+	auto count = ::MultiByteToWideChar(CP_ACP, 0, str.data(), static_cast<int>(str.size()), NULL, 0);
+	auto bstr = ::SysAllocStringLen(NULL, static_cast<UINT>(count));
 	if (bstr == NULL)
 		return S_FALSE;
+	::MultiByteToWideChar(CP_ACP, 0, str.data(), static_cast<int>(str.size()), bstr, count);
 
 	*result = bstr;
 	return S_OK;
@@ -689,9 +1018,17 @@ STDMETHODIMP CLeaker::Peb(ULONGLONG* PebBaseAddress)
 
 STDMETHODIMP CLeaker::Teb(ULONG dwThreadId, ULONGLONG* TebBaseAddress)
 {
-	dwThreadId = ::GetCurrentThreadId();
-	auto res = utils::getThreadEnvironmentBlock(dwThreadId);
-	*TebBaseAddress = static_cast<ULONGLONG>(res);
+	ThreadInfo info;
+
+	// the environment block of a thread is only looked up the first time it's asked for
+	if (dwThreadId == 0)
+		dwThreadId = ::GetCurrentThreadId();
+	if (!m_threadinfo.find(dwThreadId, info)) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	*TebBaseAddress = static_cast<ULONGLONG>(info.teb);
 	return S_OK;
 }
 
@@ -722,11 +1059,15 @@ STDMETHODIMP CLeaker::geterrormessage(ULONG dwErrorCode, BSTR* bstrErrorMessage)
 /* CLeaker VirtualQuery wrappers */
 STDMETHODIMP CLeaker::mem_baseaddress(ULONGLONG ea, ULONGLONG* result)
 {
-	const auto bits = disasm.m_bits;
+	static auto& counters = utils::Stats.method("mem_baseaddress");
+	Probe probe(utils::Stats, counters);
+
+	const auto bits = m_bits.load();
 	DWORD res;
 	MEMORY_BASIC_INFORMATION32 mbi32;
 	MEMORY_BASIC_INFORMATION64 mbi64;
 	
+	probe.enter(MethodStats::engine);
 	if (bits == 64)
 		res = utils::queryAddress(static_cast<intptr_t>(ea), &mbi64);
 	else if (bits == 32)
@@ -746,11 +1087,15 @@ STDMETHODIMP CLeaker::mem_baseaddress(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::mem_size(ULONGLONG ea, ULONGLONG* result)
 {
-	const auto bits = disasm.m_bits;
+	static auto& counters = utils::Stats.method("mem_size");
+	Probe probe(utils::Stats, counters);
+
+	const auto bits = m_bits.load();
 	DWORD res;
 	MEMORY_BASIC_INFORMATION32 mbi32;
 	MEMORY_BASIC_INFORMATION64 mbi64;
 
+	probe.enter(MethodStats::engine);
 	if (bits == 64)
 		res = utils::queryAddress(static_cast<intptr_t>(ea), &mbi64);
 	else if (bits == 32)
@@ -770,11 +1115,15 @@ STDMETHODIMP CLeaker::mem_size(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::mem_state(ULONGLONG ea, ULONGLONG* result)
 {
-	const auto bits = disasm.m_bits;
+	static auto& counters = utils::Stats.method("mem_state");
+	Probe probe(utils::Stats, counters);
+
+	const auto bits = m_bits.load();
 	DWORD res;
 	MEMORY_BASIC_INFORMATION32 mbi32;
 	MEMORY_BASIC_INFORMATION64 mbi64;
 
+	probe.enter(MethodStats::engine);
 	if (bits == 64)
 		res = utils::queryAddress(static_cast<intptr_t>(ea), &mbi64);
 	else if (bits == 32)
@@ -794,11 +1143,15 @@ STDMETHODIMP CLeaker::mem_state(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::mem_protect(ULONGLONG ea, ULONGLONG* result)
 {
-	const auto bits = disasm.m_bits;
+	static auto& counters = utils::Stats.method("mem_protect");
+	Probe probe(utils::Stats, counters);
+
+	const auto bits = m_bits.load();
 	DWORD res;
 	MEMORY_BASIC_INFORMATION32 mbi32;
 	MEMORY_BASIC_INFORMATION64 mbi64;
 
+	probe.enter(MethodStats::engine);
 	if (bits == 64)
 		res = utils::queryAddress(static_cast<intptr_t>(ea), &mbi64);
 	else if (bits == 32)
@@ -817,11 +1170,15 @@ STDMETHODIMP CLeaker::mem_protect(ULONGLONG ea, ULONGLONG* result)
 
 STDMETHODIMP CLeaker::mem_type(ULONGLONG ea, ULONGLONG* result)
 {
-	const auto bits = disasm.m_bits;
+	static auto& counters = utils::Stats.method("mem_type");
+	Probe probe(utils::Stats, counters);
+
+	const auto bits = m_bits.load();
 	DWORD res;
 	MEMORY_BASIC_INFORMATION32 mbi32;
 	MEMORY_BASIC_INFORMATION64 mbi64;
 
+	probe.enter(MethodStats::engine);
 	if (bits == 64)
 		res = utils::queryAddress(static_cast<intptr_t>(ea), &mbi64);
 	else if (bits == 32)
@@ -838,13 +1195,11 @@ STDMETHODIMP CLeaker::mem_type(ULONGLONG ea, ULONGLONG* result)
 	return S_OK;
 }
 
-/*
-	TODO:
-		Enumerate thread IDs. Figure out how to return an array or an object from ActiveX.
-*/
-
 STDMETHODIMP CLeaker::store(ULONGLONG ea, ULONG n, ULONGLONG value, ULONGLONG* result)
 {
+	static auto& counters = utils::Stats.method("store");
+	Probe probe(utils::Stats, counters);
+
 	intptr_t p = static_cast<intptr_t>(ea);
 
 	union {
@@ -856,6 +1211,8 @@ STDMETHODIMP CLeaker::store(ULONGLONG ea, ULONG n, ULONGLONG value, ULONGLONG* r
 		std::uint32_t* p4; std::uint64_t* p8;
 	};
 
+	probe.enter(MethodStats::guard);
+	probe.bytes(n);
 #if !defined(UNSAFE_MEMACCESS)
 	try {
 #endif
@@ -895,9 +1252,1115 @@ STDMETHODIMP CLeaker::store(ULONGLONG ea, ULONG n, ULONGLONG value, ULONGLONG* r
 #if !defined(UNSAFE_MEMACCESS)
 	}
 	catch (...) {
+		probe.fault();
+		utils::Trace.record(trace::store, ea, n, value, 0, true);
 		utils::setLastError(STATUS_ACCESS_VIOLATION);
 		return S_FALSE;
 	}
 #endif
+
+	utils::Trace.record(trace::store, ea, n, value, *result);
+	return S_OK;
+}
+
+/* CLeaker address space caches */
+STDMETHODIMP CLeaker::refresh(ULONG* result)
+{
+	size_t count;
+
+	try {
+		count = m_regions.refresh();
+		m_modules.refresh();
+	}
+	catch (...) {
+		return S_FALSE;
+	}
+
+	*result = static_cast<ULONG>(count);
+	return S_OK;
+}
+
+/* CLeaker background jobs */
+STDMETHODIMP CLeaker::job_start(BSTR operation, ULONGLONG ea, ULONGLONG n, BSTR argument, ULONG* handle)
+{
+	try {
+		auto regions = readable(ea, n);
+		auto f = utils::CstringToJob(utils::BSTRToString(operation), regions, utils::BSTRToString(argument), m_threads);
+		*handle = static_cast<ULONG>(m_jobs.submit(f));
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::job_poll(ULONG handle, BSTR* result)
+{
+	std::string chunk;
+
+	auto job = m_jobs.find(handle);
+	if (!job) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+
+	// an exhausted stream is reported with S_FALSE
+	auto more = job->next(chunk);
+
+	auto bstr = utils::StringToBSTR(chunk);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return more ? S_OK : S_FALSE;
+}
+
+STDMETHODIMP CLeaker::job_progress(ULONG handle, DOUBLE* result)
+{
+	auto job = m_jobs.find(handle);
+	if (!job) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+
+	*result = job->fraction();
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::job_wait(ULONG handle, ULONG timeout, ULONG* state)
+{
+	auto job = m_jobs.find(handle);
+	if (!job) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+
+	*state = static_cast<ULONG>(job->wait((timeout == INFINITE) ? static_cast<unsigned long>(-1) : timeout));
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::job_cancel(ULONG handle)
+{
+	auto job = m_jobs.find(handle);
+	if (!job) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+
+	job->cancel();
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::job_close(ULONG handle)
+{
+	if (!m_jobs.close(handle)) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+	return S_OK;
+}
+
+/* CLeaker scanning */
+STDMETHODIMP CLeaker::scan_bytes(ULONGLONG ea, ULONGLONG n, BSTR pattern, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("scan_bytes");
+	Probe probe(utils::Stats, counters);
+
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto regions = readable(ea, n);
+		auto hits = scan::bytes(regions, scan::parse(utils::BSTRToString(pattern)), m_threads);
+		for (auto hit : hits) {
+			res.append(scan::format(hit));
+			res.push_back('\n');
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::scan_signatures(ULONGLONG ea, ULONGLONG n, BSTR signatures, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("scan_signatures");
+	Probe probe(utils::Stats, counters);
+
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto set = utils::SignatureSets.get(utils::BSTRToString(signatures));
+		auto hits = scan::signatures(readable(ea, n), *set, m_threads);
+		for (auto& hit : hits) {
+			res.append(scan::format(hit));
+			res.push_back('\n');
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::scan_strings(ULONGLONG ea, ULONGLONG n, ULONG minimum, ULONG limit, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("scan_strings");
+	Probe probe(utils::Stats, counters);
+
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto found = strings::extract(readable(ea, n), minimum ? minimum : 1, limit ? limit : 0x100000, m_threads);
+		for (auto& item : found) {
+			res.append(strings::format(item));
+			res.push_back('\n');
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::scan_pointers(ULONGLONG ea, ULONGLONG n, BSTR intervals, ULONG limit, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("scan_pointers");
+	Probe probe(utils::Stats, counters);
+
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto targets = pointers::Targets::parse(utils::BSTRToString(intervals));
+		auto found = pointers::search(readable(ea, n), width, targets, limit ? limit : 0x100000, m_threads);
+		for (auto& item : found) {
+			res.append(pointers::format(item, width));
+			res.push_back('\n');
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker snapshots */
+STDMETHODIMP CLeaker::snapshot_capture(ULONGLONG ea, ULONGLONG n, ULONG* handle)
+{
+	static auto& counters = utils::Stats.method("snapshot_capture");
+	Probe probe(utils::Stats, counters);
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto snapshot = std::make_shared<Snapshot>(readable(ea, n), m_threads);
+		*handle = static_cast<ULONG>(m_snapshots.add(snapshot));
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::snapshot_diff(ULONG handle, VARIANT_BOOL update, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("snapshot_diff");
+	Probe probe(utils::Stats, counters);
+
+	std::string res;
+
+	auto snapshot = m_snapshots.find(handle);
+	if (!snapshot) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::engine);
+	// every page that's readable right now, since the snapshot only looks at the ones it captured
+	try {
+		auto changes = snapshot->diff(readable(0, ~0ull), m_threads, update != VARIANT_FALSE);
+		for (auto& change : changes) {
+			res.append(Snapshot::format(change));
+			res.push_back('\n');
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::snapshot_close(ULONG handle)
+{
+	if (!m_snapshots.close(handle)) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+	return S_OK;
+}
+
+/* CLeaker bulk writing */
+STDMETHODIMP CLeaker::write(ULONGLONG ea, BSTR data, VARIANT_BOOL previous, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("write");
+	Probe probe(utils::Stats, counters);
+
+	std::vector<std::uint8_t> original;
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto bytes = scan::parse(utils::BSTRToString(data));
+		auto count = transfer::write(static_cast<uintptr_t>(ea), bytes.data(), bytes.size(), previous ? &original : nullptr);
+		if (count < bytes.size()) {
+			probe.fault();
+			utils::setLastError(STATUS_ACCESS_VIOLATION);
+		}
+		probe.bytes(count);
+		utils::Trace.record(trace::write, ea, bytes.size(), 0, count, count < bytes.size());
+		res = utils::TransferToString(count, previous ? &original : nullptr);
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::fill(ULONGLONG ea, ULONGLONG n, BSTR pattern, VARIANT_BOOL previous, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("fill");
+	Probe probe(utils::Stats, counters);
+
+	std::vector<std::uint8_t> original;
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto count = transfer::fill(static_cast<uintptr_t>(ea), static_cast<size_t>(n), scan::parse(utils::BSTRToString(pattern)), previous ? &original : nullptr);
+		if (count < n) {
+			probe.fault();
+			utils::setLastError(STATUS_ACCESS_VIOLATION);
+		}
+		probe.bytes(count);
+		utils::Trace.record(trace::fill, ea, n, 0, count, count < n);
+		res = utils::TransferToString(count, previous ? &original : nullptr);
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::copy(ULONGLONG dst, ULONGLONG src, ULONGLONG n, VARIANT_BOOL previous, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("copy");
+	Probe probe(utils::Stats, counters);
+
+	std::vector<std::uint8_t> original;
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto count = transfer::copy(static_cast<uintptr_t>(dst), static_cast<uintptr_t>(src), static_cast<size_t>(n), previous ? &original : nullptr);
+		if (count < n) {
+			probe.fault();
+			utils::setLastError(STATUS_ACCESS_VIOLATION);
+		}
+		probe.bytes(count);
+		utils::Trace.record(trace::copy, dst, n, src, count, count < n);
+		res = utils::TransferToString(count, previous ? &original : nullptr);
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+// the same "count bytes" format as the writers, so that a block can be read in a single call
+STDMETHODIMP CLeaker::read(ULONGLONG ea, ULONG n, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("read");
+	Probe probe(utils::Stats, counters);
+
+	std::vector<std::uint8_t> bytes;
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto count = transfer::read(static_cast<uintptr_t>(ea), n, bytes);
+		if (count < n) {
+			probe.fault();
+			utils::setLastError(STATUS_ACCESS_VIOLATION);
+		}
+		probe.bytes(count);
+		utils::Trace.record(trace::read, ea, n, 0, count, count < n);
+		res = utils::TransferToString(count, &bytes);
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker streaming output */
+STDMETHODIMP CLeaker::open_dump(ULONGLONG ea, ULONGLONG n, BSTR type, ULONG* handle)
+{
+	try {
+		auto typestr = utils::BSTRToString(type);
+		auto dumper = utils::CstringToDumptype(typestr);
+		auto cursor = Cursor::dump(Dumper(m_bits, 16, (dumper == &Dumper::symbols) ? &symbols() : nullptr), dumper, utils::CstringToDumpsize(typestr), static_cast<intptr_t>(ea), static_cast<size_t>(n));
+		*handle = static_cast<ULONG>(m_cursors.add(cursor));
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::open_disasm(ULONGLONG ea, ULONGLONG n, ULONG* handle)
+{
+	try {
+		// the cursor gets its own disassembler since it can be consumed from any thread
+		auto disassembler = std::make_shared<Disassembler>();
+		disassembler->bits(m_bits.load());
+		disassembler->syntax(static_cast<cs_opt_value>(m_syntax.load()));
+		disassembler->annotate(m_annotate ? &symbols() : nullptr);
+
+		auto cursor = Cursor::disasm(disassembler, static_cast<intptr_t>(ea), static_cast<size_t>(n));
+		*handle = static_cast<ULONG>(m_cursors.add(cursor));
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::next(ULONG handle, ULONG maxChars, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("next");
+	Probe probe(utils::Stats, counters);
+
+	std::string chunk;
+
+	auto cursor = m_cursors.find(handle);
+	if (!cursor) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::engine);
+	// an exhausted cursor is reported with S_FALSE, and one that stopped early also sets the last error
+	auto more = cursor->next(maxChars ? maxChars : 0x10000, chunk);
+	if (!more && cursor->failed()) {
+		probe.fault();
+		utils::setLastError(STATUS_ACCESS_VIOLATION);
+	}
+	probe.bytes(chunk.size());
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(chunk);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return more ? S_OK : S_FALSE;
+}
+
+STDMETHODIMP CLeaker::close(ULONG handle)
+{
+	if (!m_cursors.close(handle)) {
+		utils::setLastError(STATUS_INVALID_HANDLE);
+		return S_FALSE;
+	}
+	return S_OK;
+}
+
+/* CLeaker instrumentation */
+STDMETHODIMP CLeaker::get_instrumented(VARIANT_BOOL* pVal)
+{
+	*pVal = utils::Stats.enabled() ? VARIANT_TRUE : VARIANT_FALSE;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::put_instrumented(VARIANT_BOOL newVal)
+{
+	utils::Stats.enable(newVal != VARIANT_FALSE);
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::stats(BSTR* result)
+{
+	auto bstr = utils::StringToBSTR(utils::Stats.format());
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::stats_reset()
+{
+	utils::Stats.reset();
+	return S_OK;
+}
+
+/* CLeaker access tracing */
+STDMETHODIMP CLeaker::trace_start()
+{
+	utils::Trace.start();
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::trace_stop()
+{
+	utils::Trace.stop();
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::trace_flush(BSTR path, ULONG* result)
+{
+	// each flush is appended as its own section so that a file can be flushed into repeatedly
+	std::ofstream file(path, std::ios::binary | std::ios::app);
+	if (!file) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	trace::header(file);
+	auto count = utils::Trace.flush(file);
+	if (!file) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	*result = static_cast<ULONG>(count);
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::trace_dropped(ULONGLONG* result)
+{
+	*result = static_cast<ULONGLONG>(utils::Trace.dropped());
+	return S_OK;
+}
+
+/* CLeaker pointer chains */
+STDMETHODIMP CLeaker::evaluate(ULONGLONG base, BSTR expression, ULONGLONG* result)
+{
+	static auto& counters = utils::Stats.method("evaluate");
+	Probe probe(utils::Stats, counters);
+
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	trace::ProcessBackend process;
+	trace::RecordingBackend backend(process, utils::Trace);
+	std::uint64_t res, fault;
+
+	probe.enter(MethodStats::engine);
+	try {
+		walk::Path path(utils::BSTRToString(expression));
+		if (!path.evaluate(backend, base, width, res, fault)) {
+			probe.fault();
+			utils::setLastError(STATUS_ACCESS_VIOLATION);
+			return S_FALSE;
+		}
+		probe.bytes(path.hops() * width);
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	*result = static_cast<ULONGLONG>(res);
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::walk_list(ULONGLONG head, ULONG offset, ULONG limit, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("walk_list");
+	Probe probe(utils::Stats, counters);
+
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	trace::ProcessBackend process;
+	trace::RecordingBackend backend(process, utils::Trace);
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto list = walk::list(backend, head, offset, width, limit ? limit : 0x100000);
+		if (list.status == walk::List::fault)
+			probe.fault();
+		probe.bytes(list.nodes.size() * width);
+		res = walk::format(list);
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker batched strings */
+STDMETHODIMP CLeaker::read_strings(BSTR kind, BSTR addresses, ULONG cap, BSTR* result)
+{
+	std::vector<std::uint64_t> items;
+	try {
+		items = counted::parse(utils::BSTRToString(addresses));
+	}
+	catch (...) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+	return strings(kind, items, cap, result);
+}
+
+STDMETHODIMP CLeaker::read_string_array(BSTR kind, ULONGLONG ea, ULONG count, ULONG stride, ULONG cap, BSTR* result)
+{
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	return strings(kind, counted::stride(ea, count, stride ? stride : counted::size(width)), cap, result);
+}
+
+/* CLeaker thread enumeration */
+STDMETHODIMP CLeaker::thread_list(BSTR* result)
+{
+	static auto& counters = utils::Stats.method("thread_list");
+	Probe probe(utils::Stats, counters);
+
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		m_threadinfo.refresh();
+		for (auto& info : m_threadinfo.snapshot()) {
+			res.append(ThreadTable::format(info));
+			res.push_back('\n');
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker symbols */
+STDMETHODIMP CLeaker::get_annotate(VARIANT_BOOL* pVal)
+{
+	*pVal = m_annotate ? VARIANT_TRUE : VARIANT_FALSE;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::put_annotate(VARIANT_BOOL newVal)
+{
+	m_annotate = (newVal != VARIANT_FALSE);
+	m_generation++;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::symbolize(ULONGLONG ea, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("symbolize");
+	Probe probe(utils::Stats, counters);
+
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		if (ea > UINTPTR_MAX || !symbols().resolve(static_cast<uintptr_t>(ea), res)) {
+			utils::setLastError(STATUS_INVALID_PARAMETER);
+			return S_FALSE;
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker functions */
+STDMETHODIMP CLeaker::function_at(ULONGLONG ea, BSTR* result)
+{
+	FunctionTable::Range range;
+
+	try {
+		if (ea > UINTPTR_MAX || !functions().find(static_cast<uintptr_t>(ea), range)) {
+			utils::setLastError(STATUS_INVALID_PARAMETER);
+			return S_FALSE;
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	auto bstr = utils::StringToBSTR(FunctionTable::format(range));
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+STDMETHODIMP CLeaker::disassemble_function(ULONGLONG ea, BSTR* result)
+{
+	FunctionTable::Range range;
+
+	// a chained entry is only a piece of its function, so the whole thing is listed from its primary entry
+	try {
+		if (ea > UINTPTR_MAX || !functions().function(static_cast<uintptr_t>(ea), range)) {
+			utils::setLastError(STATUS_INVALID_PARAMETER);
+			return S_FALSE;
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	if (m_annotate)
+		symbols();
+
+	auto& state = engine();
+	auto begin = static_cast<intptr_t>(range.begin);
+	auto size = static_cast<size_t>(range.end - range.begin);
+
+#if !defined(UNSAFE_MEMACCESS)
+	try {
+#endif
+		auto n = state.disasm.count(begin, size);
+		if (n == 0 || state.disasm.disasm(begin, n, state.os) != n)
+			return S_FALSE;
+		utils::Trace.record(trace::disasm, range.begin, size, 0, n);
+#if !defined(UNSAFE_MEMACCESS)
+	}
+	catch (...) {
+		utils::Trace.record(trace::disasm, range.begin, 0, 0, 0, true);
+		utils::setLastError(STATUS_ACCESS_VIOLATION);
+		return S_FALSE;
+	}
+#endif
+
+	auto bstr = utils::BufferToBSTR(state.os.buffer());
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker stacks */
+STDMETHODIMP CLeaker::stack_scan(ULONGLONG low, ULONGLONG high, ULONG limit, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("stack_scan");
+	Probe probe(utils::Stats, counters);
+
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	std::string res;
+
+	if (high <= low) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto stack = readable(low, high - low);
+
+		auto& state = engine();
+		frames::verifier verify = [&state](std::uint64_t value, frames::Site& site) {
+			return frames::verify(state.disasm, value, site);
+		};
+
+		size_t verified;
+		auto found = frames::scan(stack, width, code(), verify, &functions(), limit, &verified);
+		for (auto& item : stack)
+			probe.bytes(item.size);
+
+		auto& names = symbols();
+		for (auto& item : found) {
+			res.append(frames::format(item, width, &names));
+			res.push_back('\n');
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker tables */
+STDMETHODIMP CLeaker::scan_vtables(ULONGLONG ea, ULONG minimum, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("scan_vtables");
+	Probe probe(utils::Stats, counters);
+
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	const size_t count = minimum ? minimum : 3;
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		m_regions.refresh();
+		auto loaded = modules().snapshot();
+		m_vtables.retain(loaded);
+
+		// the modules that were already swept are taken from the cache, and the rest are swept together
+		std::vector<std::pair<Module, std::vector<vtables::Table>>> found;
+		std::vector<Module> pending;
+		std::vector<Region> regions;
+		for (auto& module : loaded) {
+			if (ea && !module.contains(static_cast<uintptr_t>(ea)))
+				continue;
+
+			std::vector<vtables::Table> tables;
+			if (m_vtables.find(module, width, count, tables)) {
+				found.emplace_back(module, std::move(tables));
+				continue;
+			}
+
+			auto selected = m_regions.select(module.base, module.end(), &vtables::readonly);
+			for (auto& region : selected)
+				probe.bytes(region.size);
+			regions.insert(regions.end(), selected.begin(), selected.end());
+			pending.push_back(module);
+		}
+
+		if (!pending.empty()) {
+			auto tables = vtables::search(regions, width, code(), count, m_threads);
+			for (auto& module : pending) {
+				auto first = std::lower_bound(tables.begin(), tables.end(), vtables::Table{ module.base, 0 });
+				auto last = std::lower_bound(first, tables.end(), vtables::Table{ module.end(), 0 });
+				std::vector<vtables::Table> items(first, last);
+				m_vtables.assign(module, width, count, items);
+				found.emplace_back(module, std::move(items));
+			}
+		}
+
+		std::sort(found.begin(), found.end(), [](const std::pair<Module, std::vector<vtables::Table>>& a, const std::pair<Module, std::vector<vtables::Table>>& b) {
+			return a.first.base < b.first.base;
+		});
+		for (auto& item : found) {
+			auto name = SymbolTable::name(item.first.path);
+			for (auto& table : item.second) {
+				res.append(vtables::format(table, name));
+				res.push_back('\n');
+			}
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker classification */
+STDMETHODIMP CLeaker::scan_entropy(ULONGLONG ea, ULONGLONG n, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("scan_entropy");
+	Probe probe(utils::Stats, counters);
+
+	const size_t width = (m_bits == 64) ? sizeof(std::uint64_t) : sizeof(std::uint32_t);
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto regions = readable(ea, n);
+		for (auto& region : regions)
+			probe.bytes(region.size);
+
+		// a value looks like a pointer if it lands anywhere that's mapped
+		std::vector<pointers::Interval> mapped;
+		for (auto& region : m_regions.select(0, UINTPTR_MAX, [](const Region& r) { return r.readable(); }))
+			mapped.push_back({ region.base, region.end() });
+
+		res = entropy::format(entropy::measure(regions, width, pointers::Targets(mapped), m_threads));
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker integrity */
+STDMETHODIMP CLeaker::module_integrity(ULONGLONG ea, ULONG scope, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("module_integrity");
+	Probe probe(utils::Stats, counters);
+
+	const size_t gap = 8;
+	if (scope > integrity::readonly) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+	const auto kind = static_cast<integrity::scope_t>(scope);
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto loaded = modules().snapshot();
+		m_integrity.retain(loaded);
+
+		size_t checked = 0;
+		for (auto& module : loaded) {
+			if (ea && !module.contains(static_cast<uintptr_t>(ea)))
+				continue;
+
+			// the file is only read and relocated the first time, and a module without a usable file is skipped
+			std::shared_ptr<const integrity::Image> image;
+			if (!m_integrity.find(module, kind, image)) {
+				try {
+					image = std::make_shared<const integrity::Image>(integrity::expected(pe::file(module.path), module.base, kind));
+				}
+				catch (const std::runtime_error&) {
+					continue;
+				}
+				catch (const std::logic_error&) {
+					continue;
+				}
+				m_integrity.assign(module, kind, image);
+			}
+			probe.bytes(image->contents.size());
+			checked++;
+
+			size_t unreadable;
+			auto name = SymbolTable::name(module.path);
+			for (auto& patch : integrity::compare(*image, gap, &unreadable)) {
+				res.append(integrity::format(patch, name));
+				res.push_back('\n');
+			}
+		}
+
+		if (ea && !checked) {
+			utils::setLastError(STATUS_INVALID_HANDLE);
+			return S_FALSE;
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker heaps */
+STDMETHODIMP CLeaker::heap_walk(ULONGLONG heap, ULONG limit, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("heap_walk");
+	Probe probe(utils::Stats, counters);
+
+	// the heaps belong to this process, so their layout follows what we were compiled for rather than m_bits
+	trace::ProcessBackend process;
+	trace::RecordingBackend backend(process, utils::Trace);
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		std::vector<std::uint64_t> addresses;
+		if (heap)
+			addresses.push_back(heap);
+		else
+			addresses = heaps::process(backend, static_cast<std::uint64_t>(utils::getProcessEnvironmentBlock()), sizeof(uintptr_t));
+
+		for (auto address : addresses) {
+			auto walked = heaps::walk(backend, address, sizeof(uintptr_t), limit);
+			for (auto& entry : walked.entries)
+				probe.bytes(static_cast<size_t>(entry.size));
+			res.append(heaps::format(walked));
+		}
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
+	return S_OK;
+}
+
+/* CLeaker instruction index */
+STDMETHODIMP CLeaker::query_instructions(ULONGLONG ea, BSTR query, ULONG limit, BSTR* result)
+{
+	static auto& counters = utils::Stats.method("query_instructions");
+	Probe probe(utils::Stats, counters);
+
+	const auto mode = (m_bits == 16) ? CS_MODE_16 : (m_bits == 32) ? CS_MODE_32 : CS_MODE_64;
+	std::string res;
+
+	probe.enter(MethodStats::engine);
+	try {
+		auto parsed = instructions::parse(utils::BSTRToString(query));
+
+		auto loaded = modules().snapshot();
+		m_instructions.retain(loaded);
+
+		Module module;
+		if (!owner(static_cast<uintptr_t>(ea), module)) {
+			utils::setLastError(STATUS_INVALID_HANDLE);
+			return S_FALSE;
+		}
+
+		// the module is only decoded the first time that it's queried
+		std::shared_ptr<const instructions::Index> index;
+		if (!m_instructions.find(module, mode, index)) {
+			m_regions.refresh();
+			auto regions = m_regions.select(module.base, module.end(), [](const Region& r) { return r.executable(); });
+			for (auto& region : regions)
+				probe.bytes(region.size);
+			index = std::make_shared<const instructions::Index>(instructions::build(module.base, regions, mode));
+			m_instructions.assign(module, mode, index);
+		}
+		res = instructions::format(*index, index->find(parsed, limit));
+	}
+	catch (const std::invalid_argument&) {
+		utils::setLastError(STATUS_INVALID_PARAMETER);
+		return S_FALSE;
+	}
+	catch (...) {
+		utils::setLastError(STATUS_NO_MEMORY);
+		return S_FALSE;
+	}
+
+	probe.enter(MethodStats::conversion);
+	auto bstr = utils::StringToBSTR(res);
+	if (bstr == NULL)
+		return S_FALSE;
+
+	*result = bstr;
 	return S_OK;
 }
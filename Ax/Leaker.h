@@ -4,7 +4,22 @@
 #include <atlctl.h>
 #include "Ax_i.h"
 
+#include <atomic>
+
 #include "disassembler.h"
+#include "regions.h"
+#include "threading.h"
+#include "jobs.h"
+#include "snapshot.h"
+#include "cursor.h"
+#include "sink.h"
+#include "counted.h"
+#include "threadinfo.h"
+#include "symbols.h"
+#include "functions.h"
+#include "vtables.h"
+#include "integrity.h"
+#include "instructions.h"
 
 #if defined(_WIN32_WCE) && !defined(_CE_DCOM) && !defined(_CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA)
 #error "Single-threaded COM objects are not properly supported on Windows CE platform, such as the Windows Mobile platforms that do not include full DCOM support. Define _CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA to force ATL to support creating single-thread COM object's and allow use of it's single-threaded COM object implementations. The threading model in your rgs file was set to 'Free' as that is the only threading model supported in non DCOM Windows CE platforms."
@@ -14,7 +29,7 @@ using namespace ATL;
 
 // CLeaker
 class ATL_NO_VTABLE CLeaker :
-	public CComObjectRootEx<CComSingleThreadModel>,
+	public CComObjectRootEx<CComMultiThreadModel>,
 	public IDispatchImpl<ILeaker, &IID_ILeaker, &LIBID_AxLib, /*wMajor =*/ 1, /*wMinor =*/ 0>,
 	public IOleControlImpl<CLeaker>,
 	public IOleObjectImpl<CLeaker>,
@@ -26,10 +41,61 @@ class ATL_NO_VTABLE CLeaker :
 	public CComControl<CLeaker>
 {
 private:
-	Disassembler disasm;
+	/* engine state that is owned by a single thread */
+	struct Engine {
+		Disassembler disasm;
+		WideStream os;
+		unsigned long generation;
+
+		Engine() : disasm(), generation(0) {}
+	};
+
+	/* settings that are shared by every thread's engine */
+	std::atomic<ULONG> m_bits;
+	std::atomic<int> m_syntax;
+	std::atomic<unsigned long> m_generation;
+	std::atomic<bool> m_annotate;
+
+	/* number of workers that a scan is sharded across (0 for one per processor) */
+	std::atomic<ULONG> m_threads;
+
+	PerThread<Engine> m_engines;
+
+	/* caches that are shared between threads */
+	RegionMap m_regions;
+	ModuleTable m_modules;
+	ThreadTable m_threadinfo;
+	SymbolTable m_symbols;
+	FunctionTable m_functions;
+	vtables::Cache m_vtables;
+	integrity::Cache m_integrity;
+	instructions::Cache m_instructions;
+
+	/* memory captures that are compared later */
+	SnapshotTable m_snapshots;
+
+	/* output that's being streamed to a client */
+	CursorTable m_cursors;
+
+	CComPtr<IUnknown> m_pUnkMarshaler;
+
+	/* background jobs (destroyed first so that nothing is left running) */
+	Scheduler m_jobs;
+
+	Engine& engine();
+	RegionMap& regions();
+	std::vector<Region> readable(ULONGLONG ea, ULONGLONG n);
+	ModuleTable& modules();
+	bool owner(uintptr_t ea, Module& result);
+	SymbolTable& symbols();
+	FunctionTable& functions();
+	pointers::Targets code();
+	HRESULT strings(BSTR kind, const std::vector<std::uint64_t>& addresses, ULONG cap, BSTR* result);
 
 public:
-	CLeaker() : disasm()
+	CLeaker() :
+		m_bits(sizeof(void*) * 8), m_syntax(CS_OPT_SYNTAX_DEFAULT), m_generation(1), m_annotate(false), m_threads(0),
+		m_engines([]() { return new Engine(); })
 	{}
 
 DECLARE_OLEMISC_STATUS(OLEMISC_RECOMPOSEONRESIZE |
@@ -44,6 +110,8 @@ DECLARE_REGISTRY_RESOURCEID(IDR_LEAKER)
 
 DECLARE_NOT_AGGREGATABLE(CLeaker)
 
+DECLARE_GET_CONTROLLING_UNKNOWN()
+
 BEGIN_COM_MAP(CLeaker)
 	COM_INTERFACE_ENTRY(ILeaker)
 	COM_INTERFACE_ENTRY(IDispatch)
@@ -57,6 +125,7 @@ BEGIN_COM_MAP(CLeaker)
 	COM_INTERFACE_ENTRY(IOleControl)
 	COM_INTERFACE_ENTRY(IOleObject)
 	COM_INTERFACE_ENTRY_IID(IID_IObjectSafety, IObjectSafety)
+	COM_INTERFACE_ENTRY_AGGREGATE(IID_IMarshal, m_pUnkMarshaler.p)
 END_COM_MAP()
 
 BEGIN_PROP_MAP(CLeaker)
@@ -82,11 +151,13 @@ public:
 
 	HRESULT FinalConstruct()
 	{
-		return S_OK;
+		return CoCreateFreeThreadedMarshaler(GetControllingUnknown(), &m_pUnkMarshaler.p);
 	}
 
 	void FinalRelease()
-	{}
+	{
+		m_pUnkMarshaler.Release();
+	}
 
 	STDMETHOD(breakpoint)();
 
@@ -94,6 +165,8 @@ public:
 	STDMETHOD(put_syntax)(BSTR newVal);
 	STDMETHOD(get_bits)(ULONG* pVal);
 	STDMETHOD(put_bits)(ULONG newVal);
+	STDMETHOD(get_threads)(ULONG* pVal);
+	STDMETHOD(put_threads)(ULONG newVal);
 	STDMETHOD(disassemble)(ULONGLONG ea, ULONG n, BSTR* result);
 	STDMETHOD(dump)(ULONGLONG ea, ULONG n, BSTR type, BSTR* result);
 
@@ -122,6 +195,71 @@ public:
 	STDMETHOD(mem_type)(ULONGLONG ea, ULONGLONG* result);
 
 	STDMETHOD(store)(ULONGLONG ea, ULONG n, ULONGLONG value, ULONGLONG* result);
+
+	STDMETHOD(refresh)(ULONG* result);
+
+	STDMETHOD(job_start)(BSTR operation, ULONGLONG ea, ULONGLONG n, BSTR argument, ULONG* handle);
+	STDMETHOD(job_poll)(ULONG handle, BSTR* result);
+	STDMETHOD(job_progress)(ULONG handle, DOUBLE* result);
+	STDMETHOD(job_wait)(ULONG handle, ULONG timeout, ULONG* state);
+	STDMETHOD(job_cancel)(ULONG handle);
+	STDMETHOD(job_close)(ULONG handle);
+
+	STDMETHOD(scan_bytes)(ULONGLONG ea, ULONGLONG n, BSTR pattern, BSTR* result);
+	STDMETHOD(scan_signatures)(ULONGLONG ea, ULONGLONG n, BSTR signatures, BSTR* result);
+	STDMETHOD(scan_strings)(ULONGLONG ea, ULONGLONG n, ULONG minimum, ULONG limit, BSTR* result);
+	STDMETHOD(scan_pointers)(ULONGLONG ea, ULONGLONG n, BSTR intervals, ULONG limit, BSTR* result);
+
+	STDMETHOD(snapshot_capture)(ULONGLONG ea, ULONGLONG n, ULONG* handle);
+	STDMETHOD(snapshot_diff)(ULONG handle, VARIANT_BOOL update, BSTR* result);
+	STDMETHOD(snapshot_close)(ULONG handle);
+
+	STDMETHOD(write)(ULONGLONG ea, BSTR data, VARIANT_BOOL previous, BSTR* result);
+	STDMETHOD(fill)(ULONGLONG ea, ULONGLONG n, BSTR pattern, VARIANT_BOOL previous, BSTR* result);
+	STDMETHOD(copy)(ULONGLONG dst, ULONGLONG src, ULONGLONG n, VARIANT_BOOL previous, BSTR* result);
+	STDMETHOD(read)(ULONGLONG ea, ULONG n, BSTR* result);
+
+	STDMETHOD(open_dump)(ULONGLONG ea, ULONGLONG n, BSTR type, ULONG* handle);
+	STDMETHOD(open_disasm)(ULONGLONG ea, ULONGLONG n, ULONG* handle);
+	STDMETHOD(next)(ULONG handle, ULONG maxChars, BSTR* result);
+	STDMETHOD(close)(ULONG handle);
+
+	STDMETHOD(get_instrumented)(VARIANT_BOOL* pVal);
+	STDMETHOD(put_instrumented)(VARIANT_BOOL newVal);
+	STDMETHOD(stats)(BSTR* result);
+	STDMETHOD(stats_reset)();
+
+	STDMETHOD(trace_start)();
+	STDMETHOD(trace_stop)();
+	STDMETHOD(trace_flush)(BSTR path, ULONG* result);
+	STDMETHOD(trace_dropped)(ULONGLONG* result);
+
+	STDMETHOD(evaluate)(ULONGLONG base, BSTR expression, ULONGLONG* result);
+	STDMETHOD(walk_list)(ULONGLONG head, ULONG offset, ULONG limit, BSTR* result);
+
+	STDMETHOD(read_strings)(BSTR kind, BSTR addresses, ULONG cap, BSTR* result);
+	STDMETHOD(read_string_array)(BSTR kind, ULONGLONG ea, ULONG count, ULONG stride, ULONG cap, BSTR* result);
+
+	STDMETHOD(thread_list)(BSTR* result);
+
+	STDMETHOD(get_annotate)(VARIANT_BOOL* pVal);
+	STDMETHOD(put_annotate)(VARIANT_BOOL newVal);
+	STDMETHOD(symbolize)(ULONGLONG ea, BSTR* result);
+
+	STDMETHOD(function_at)(ULONGLONG ea, BSTR* result);
+	STDMETHOD(disassemble_function)(ULONGLONG ea, BSTR* result);
+
+	STDMETHOD(stack_scan)(ULONGLONG low, ULONGLONG high, ULONG limit, BSTR* result);
+
+	STDMETHOD(scan_vtables)(ULONGLONG ea, ULONG minimum, BSTR* result);
+
+	STDMETHOD(scan_entropy)(ULONGLONG ea, ULONGLONG n, BSTR* result);
+
+	STDMETHOD(module_integrity)(ULONGLONG ea, ULONG scope, BSTR* result);
+
+	STDMETHOD(heap_walk)(ULONGLONG heap, ULONG limit, BSTR* result);
+
+	STDMETHOD(query_instructions)(ULONGLONG ea, BSTR query, ULONG limit, BSTR* result);
 	};
 
 OBJECT_ENTRY_AUTO(__uuidof(Leaker), CLeaker)
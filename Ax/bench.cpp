@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "bench.h"
+
+namespace {
+	typedef std::chrono::steady_clock clock_type;
+
+	// each sample is long enough that the resolution of the clock doesn't matter
+	const double minimum_sample = 200000.0;		// nanoseconds
+	const size_t minimum_samples = 5, maximum_samples = 51;
+
+	double
+	elapsed(clock_type::time_point start)
+	{
+		return std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+	}
+}
+
+/** Suite */
+namespace bench {
+	void
+	Suite::add(const std::string& name, size_t bytes, std::function<void()> body)
+	{
+		Case item = { name, bytes, body };
+		m_cases.push_back(item);
+	}
+
+	/*
+		A case is warmed up and calibrated by doubling the iterations until
+		a sample is long enough. Then samples are taken until the budget is
+		spent, and the median is used since it isn't thrown off by the odd
+		sample that was interrupted.
+	*/
+	std::vector<Result>
+	Suite::run(const std::string& filter, size_t milliseconds) const
+	{
+		std::vector<Result> res;
+		const double budget = milliseconds * 1e6;
+
+		for (auto& item : m_cases) {
+			if (!filter.empty() && item.name.find(filter) == std::string::npos)
+				continue;
+
+			size_t iterations = 1;
+			double sample;
+			for (;;) {
+				auto start = clock_type::now();
+				for (size_t i = 0; i < iterations; i++)
+					item.body();
+				sample = elapsed(start);
+				if (sample >= minimum_sample || iterations >= (static_cast<size_t>(1) << 30))
+					break;
+				iterations *= 2;
+			}
+
+			std::vector<double> samples;
+			auto started = clock_type::now();
+			while (samples.size() < minimum_samples || (samples.size() < maximum_samples && elapsed(started) < budget)) {
+				auto start = clock_type::now();
+				for (size_t i = 0; i < iterations; i++)
+					item.body();
+				samples.push_back(elapsed(start) / iterations);
+			}
+
+			std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+			Result result = { item.name, samples[samples.size() / 2], 0.0 };
+			result.rate = (result.nanoseconds > 0.0) ? item.bytes * 1e9 / result.nanoseconds : 0.0;
+			res.push_back(result);
+		}
+		return res;
+	}
+}
+
+/** utilities */
+namespace bench {
+	const char*
+	name(status_t status)
+	{
+		switch (status) {
+		case improved: return "improved";
+		case regressed: return "regressed";
+		case added: return "added";
+		default: return "unchanged";
+		}
+	}
+
+	/*
+		Each page of the corpus is either zeroes, pointer-sized values near
+		each other, printable text, small integers, or noise.
+	*/
+	std::vector<uint8_t>
+	corpus(size_t size, uint32_t seed)
+	{
+		static const char text[] = "The quick brown fox jumps over the lazy dog. 0123456789\r\n";
+		const size_t page = 0x1000;
+
+		std::vector<uint8_t> res(size, 0);
+		std::mt19937_64 random(seed);
+
+		for (size_t offset = 0; offset < size; offset += page) {
+			auto p = res.data() + offset;
+			auto length = (std::min)(page, size - offset);
+
+			switch (random() % 5) {
+			case 0:
+				break;
+			case 1:
+				for (size_t i = 0; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+					uint64_t value = 0x00007ff800000000ull + (random() & 0xffffff8ull);
+					memcpy(p + i, &value, sizeof(value));
+				}
+				break;
+			case 2:
+				for (size_t i = 0; i < length; i++)
+					p[i] = static_cast<uint8_t>(text[(i + offset) % (sizeof(text) - 1)]);
+				break;
+			case 3:
+				for (size_t i = 0; i + sizeof(uint32_t) <= length; i += sizeof(uint32_t)) {
+					uint32_t value = static_cast<uint32_t>(random() % 0x100);
+					memcpy(p + i, &value, sizeof(value));
+				}
+				break;
+			default:
+				for (size_t i = 0; i < length; i++)
+					p[i] = static_cast<uint8_t>(random());
+			}
+		}
+		return res;
+	}
+
+	/*
+		Each instruction is picked from a table of common encodings, where the
+		last `random` bytes of an encoding are its displacement or immediate
+		and are filled in at random. Whatever's left at the end is padded with
+		int3 the way a linker pads a function.
+	*/
+	std::vector<uint8_t>
+	code(size_t size, uint32_t seed)
+	{
+		static const struct {
+			uint8_t bytes[8];
+			size_t length, random;
+		} encodings[] = {
+			{ { 0x55 }, 1, 0 },										// push rbp
+			{ { 0x48, 0x89, 0xe5 }, 3, 0 },							// mov rbp, rsp
+			{ { 0x48, 0x83, 0xec }, 4, 1 },							// sub rsp, imm8
+			{ { 0x48, 0x8b, 0x45 }, 4, 1 },							// mov rax, [rbp+disp8]
+			{ { 0x48, 0x89, 0x44, 0x24 }, 5, 1 },					// mov [rsp+disp8], rax
+			{ { 0x48, 0x8b, 0x40, 0x08 }, 4, 0 },					// mov rax, [rax+8]
+			{ { 0x48, 0x8b, 0x05 }, 7, 4 },							// mov rax, [rip+disp32]
+			{ { 0x48, 0x8d, 0x0d }, 7, 4 },							// lea rcx, [rip+disp32]
+			{ { 0xe8 }, 5, 4 },										// call rel32
+			{ { 0xff, 0x15 }, 6, 4 },								// call [rip+disp32]
+			{ { 0xff, 0xd0 }, 2, 0 },								// call rax
+			{ { 0x85, 0xc0 }, 2, 0 },								// test eax, eax
+			{ { 0x74 }, 2, 1 },										// je rel8
+			{ { 0x0f, 0x85 }, 6, 4 },								// jne rel32
+			{ { 0xb8 }, 5, 4 },										// mov eax, imm32
+			{ { 0x3d, 0x5a, 0x4d, 0x00, 0x00 }, 5, 0 },				// cmp eax, 0x4d5a
+			{ { 0x31, 0xc0 }, 2, 0 },								// xor eax, eax
+			{ { 0xc3 }, 1, 0 },										// ret
+		};
+		const size_t count = sizeof(encodings) / sizeof(*encodings);
+
+		std::vector<uint8_t> res;
+		std::mt19937_64 random(seed);
+		res.reserve(size);
+
+		for (;;) {
+			auto& encoding = encodings[random() % count];
+			if (res.size() + encoding.length > size)
+				break;
+			res.insert(res.end(), encoding.bytes, encoding.bytes + encoding.length - encoding.random);
+			for (size_t i = 0; i < encoding.random; i++)
+				res.push_back(static_cast<uint8_t>(random()));
+		}
+		res.resize(size, 0xcc);
+		return res;
+	}
+
+	std::string
+	format(const std::vector<Result>& results)
+	{
+		std::ostringstream os;
+		for (auto& item : results)
+			os << item.name << " " << std::fixed << std::setprecision(1) << item.nanoseconds << " " << std::setprecision(0) << item.rate << "\n";
+		return os.str();
+	}
+
+	// anything after the first three fields is ignored, so a comparison can also be used as a baseline
+	std::vector<Result>
+	parse(const std::string& text)
+	{
+		std::vector<Result> res;
+		std::istringstream is(text);
+		std::string line;
+
+		while (std::getline(is, line)) {
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+
+			std::istringstream fields(line);
+			Result item;
+			if (!(fields >> item.name >> item.nanoseconds >> item.rate) || item.nanoseconds < 0.0)
+				throw std::invalid_argument(line);
+			res.push_back(item);
+		}
+		std::sort(res.begin(), res.end());
+		return res;
+	}
+
+	std::vector<Comparison>
+	compare(const std::vector<Result>& baseline, const std::vector<Result>& results, double tolerance)
+	{
+		std::vector<Comparison> res;
+
+		auto sorted = baseline;
+		std::sort(sorted.begin(), sorted.end());
+
+		for (auto& item : results) {
+			Comparison comparison = { item, added, 0.0 };
+
+			auto it = std::lower_bound(sorted.begin(), sorted.end(), item);
+			if (it != sorted.end() && it->name == item.name && it->nanoseconds > 0.0) {
+				comparison.change = (item.nanoseconds - it->nanoseconds) / it->nanoseconds;
+				comparison.status = (comparison.change > tolerance) ? regressed : (comparison.change < -tolerance) ? improved : unchanged;
+			}
+			res.push_back(comparison);
+		}
+		return res;
+	}
+
+	std::string
+	format(const std::vector<Comparison>& comparisons)
+	{
+		std::ostringstream os;
+		for (auto& item : comparisons) {
+			os << item.result.name << " " << std::fixed << std::setprecision(1) << item.result.nanoseconds << " " << std::setprecision(0) << item.result.rate;
+			os << " " << name(item.status) << " " << std::showpos << std::setprecision(1) << item.change * 100 << std::noshowpos << "\n";
+		}
+		return os.str();
+	}
+}
+
+/** benchmark programs */
+namespace bench {
+	Options
+	options(int argc, char** argv)
+	{
+		Options res = { "", "", "", 500, 0.1, false };
+
+		for (int i = 1; i < argc; i++) {
+			std::string option(argv[i]);
+			if (option == "--quick") {
+				res.quick = true;
+				continue;
+			}
+			if (i + 1 >= argc)
+				throw std::invalid_argument(option);
+
+			std::string value(argv[++i]);
+			if (option == "--filter")
+				res.filter = value;
+			else if (option == "--baseline")
+				res.baseline = value;
+			else if (option == "--output")
+				res.output = value;
+			else if (option == "--budget")
+				res.milliseconds = std::stoul(value);
+			else if (option == "--tolerance")
+				res.tolerance = std::stod(value);
+			else
+				throw std::invalid_argument(option);
+		}
+
+		if (res.quick)
+			res.milliseconds = 1;
+		return res;
+	}
+
+	/*
+		A quick run isn't compared against the baseline since its corpora
+		are too small for the timings to mean anything. A benchmark that
+		hasn't had its baseline recorded yet just has its results printed.
+	*/
+	int
+	execute(const Suite& suite, const Options& options)
+	{
+		auto results = suite.run(options.filter, options.milliseconds);
+		if (results.empty()) {
+			std::cerr << "no case matched \"" << options.filter << "\"" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		if (!options.output.empty()) {
+			std::ofstream file(options.output);
+			file << format(results);
+			if (!file) {
+				std::cerr << "unable to write " << options.output << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (options.baseline.empty() || options.quick) {
+			std::cout << format(results);
+			return EXIT_SUCCESS;
+		}
+
+		std::ifstream file(options.baseline);
+		if (!file) {
+			std::cerr << "no baseline exists at " << options.baseline << ", so nothing was compared" << std::endl;
+			std::cout << format(results);
+			return EXIT_SUCCESS;
+		}
+		std::ostringstream text;
+		text << file.rdbuf();
+
+		auto comparisons = compare(parse(text.str()), results, options.tolerance);
+		std::cout << format(comparisons);
+		for (auto& item : comparisons)
+			if (item.status == regressed)
+				return EXIT_FAILURE;
+		return EXIT_SUCCESS;
+	}
+}
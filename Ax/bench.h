@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** timing the native engines, and comparing the timings against an earlier run */
+namespace bench {
+	/* type-definitions */
+	struct Case {
+		std::string name;
+		size_t bytes;					// how much memory a single iteration covers
+		std::function<void()> body;		// a single iteration
+	};
+
+	struct Result {
+		std::string name;
+		double nanoseconds;				// the median time of an iteration
+		double rate;					// bytes per second
+
+		bool operator<(const Result& other) const { return name < other.name; }
+	};
+
+	enum status_t { unchanged, improved, regressed, added };
+
+	struct Comparison {
+		Result result;
+		status_t status;
+		double change;					// the relative change in time from the baseline
+	};
+
+	/* a set of cases that are timed one after another */
+	class Suite {
+	private:
+		std::vector<Case> m_cases;
+
+	public:
+		void add(const std::string& name, size_t bytes, std::function<void()> body);
+		size_t size() const { return m_cases.size(); }
+
+		// Time each case whose name contains `filter`, spending roughly `milliseconds` on each of them.
+		std::vector<Result> run(const std::string& filter, size_t milliseconds) const;
+	};
+
+	/* the command line of a benchmark program */
+	struct Options {
+		std::string filter;			// only the cases whose names contain this
+		std::string baseline;		// a file with the results of an earlier run to compare against
+		std::string output;			// a file to write the results to, which can be used as a baseline
+		size_t milliseconds;		// spent on each case
+		double tolerance;
+		bool quick;					// small corpora and a short budget, just to check that every case runs
+	};
+
+	/* utilities */
+	const char* name(status_t status);
+
+	/*
+		Parse the options of a benchmark program, which throws
+		std::invalid_argument for anything that it doesn't understand.
+
+			--filter text --budget milliseconds --baseline path
+			--tolerance fraction --output path --quick
+	*/
+	Options options(int argc, char** argv);
+
+	// Run the suite and print its results, returning a non-zero exit code if any of them regressed from the baseline.
+	// A baseline that doesn't exist is reported, and the results are printed without being compared.
+	int execute(const Suite& suite, const Options& options);
+
+	// The corpus for the data engines, which is a mix of the kinds of pages that show up in a process.
+	std::vector<uint8_t> corpus(size_t size, uint32_t seed);
+
+	// The corpus for the engines that decode instructions, which is the x64 code that a compiler emits most often.
+	std::vector<uint8_t> code(size_t size, uint32_t seed);
+
+	/*
+		A result is written as its name, the nanoseconds for an iteration, and
+		the bytes per second. The output of a run can be parsed back as the
+		baseline of a later one.
+
+			dump/uint32_t 5123.4 799523651
+	*/
+	std::string format(const std::vector<Result>& results);
+	std::vector<Result> parse(const std::string& text);		// throws std::invalid_argument
+
+	// A case is regressed or improved when its time changed by more than `tolerance` (a fraction) from the baseline.
+	std::vector<Comparison> compare(const std::vector<Result>& baseline, const std::vector<Result>& results, double tolerance);
+
+	// A comparison is its result followed by its status and the change in percent.
+	std::string format(const std::vector<Comparison>& comparisons);
+}
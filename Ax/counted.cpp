@@ -0,0 +1,162 @@
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "counted.h"
+#include "scanner.h"
+
+/** utilities */
+bool
+counted::kind(const std::string& name, kind_t& result)
+{
+	if (name == "ansi" || name == "ANSI_STRING")
+		result = ansi;
+	else if (name == "unicode" || name == "UNICODE_STRING")
+		result = unicode;
+	else
+		return false;
+	return true;
+}
+
+size_t
+counted::size(size_t width)
+{
+	return width + width;
+}
+
+std::vector<uint64_t>
+counted::parse(const std::string& addresses)
+{
+	std::vector<uint64_t> res;
+
+	// addresses are hex, and can be separated by whitespace or commas
+	std::istringstream is(addresses);
+	std::string token;
+	while (is >> token) {
+		size_t start = 0;
+		for (size_t i = 0; i <= token.size(); i++) {
+			if (i < token.size() && token[i] != ',')
+				continue;
+			if (i > start) {
+				size_t count;
+				auto item = token.substr(start, i - start);
+				auto value = std::stoull(item, &count, 16);
+				if (count != item.size())
+					throw std::invalid_argument(item);
+				res.push_back(value);
+			}
+			start = i + 1;
+		}
+	}
+	return res;
+}
+
+std::vector<uint64_t>
+counted::stride(uint64_t ea, size_t count, size_t stride)
+{
+	std::vector<uint64_t> res;
+	res.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		res.push_back(ea + i * stride);
+	return res;
+}
+
+/** decoding */
+counted::Result
+counted::decode(kind_t kind, uint64_t address, size_t width, size_t cap, const RegionMap* map)
+{
+	Result res = { Result::ok, kind, address, 0, {} };
+
+	try {
+		// read the header and validate it before touching the buffer
+		std::uint16_t length, maximum;
+		auto p = reinterpret_cast<const std::uint8_t*>(static_cast<uintptr_t>(address));
+		memcpy(&length, p + 0, sizeof(length));
+		memcpy(&maximum, p + 2, sizeof(maximum));
+		memcpy(&res.buffer, p + width, width);
+
+		if (length > maximum || (kind == unicode && length % 2)) {
+			res.status = Result::invalid;
+			return res;
+		}
+
+		size_t count = length;
+		if (count > cap) {
+			count = cap - ((kind == unicode) ? cap % 2 : 0);
+			res.status = Result::truncated;
+		}
+		if (count == 0)
+			return res;
+
+		auto buffer = static_cast<uintptr_t>(res.buffer);
+		if (map && map->readable(buffer, count) < count) {
+			res.status = Result::unmapped;
+			return res;
+		}
+
+		// each ansi byte is widened to a code unit without interpreting it
+		auto q = reinterpret_cast<const std::uint8_t*>(buffer);
+		if (kind == unicode) {
+			res.text.resize(count / sizeof(char16_t));
+			memcpy(&res.text[0], q, count);
+		}
+		else
+			res.text.assign(q, q + count);
+	}
+	catch (...) {
+		res.status = Result::fault;
+		res.text.clear();
+	}
+	return res;
+}
+
+std::vector<counted::Result>
+counted::decode(kind_t kind, const std::vector<uint64_t>& addresses, size_t width, size_t cap, const RegionMap* map)
+{
+	std::vector<Result> res;
+	res.reserve(addresses.size());
+	for (auto address : addresses)
+		res.push_back(decode(kind, address, width, cap, map));
+	return res;
+}
+
+/*
+	Printable ASCII is written as-is, and everything else is escaped. Code
+	units of a unicode string are escaped as \uXXXX, and bytes of an ansi
+	string as \xXX so that the client can decide how to decode them.
+
+		0000000000402000 ok C:\\Windows\\SYSTEM32\\ntdll.dll
+		0000000000402010 truncated caf\u00e9
+		0000000000402020 fault
+*/
+void
+counted::format(const Result& result, std::ostream& os)
+{
+	static const char* names[] = { "ok", "truncated", "invalid", "unmapped", "fault" };
+	static const char digits[] = "0123456789abcdef";
+
+	os << scan::format(static_cast<uintptr_t>(result.address)) << " " << names[result.status];
+	if (result.status != Result::ok && result.status != Result::truncated) {
+		os << "\n";
+		return;
+	}
+
+	std::string line(" ");
+	line.reserve(1 + result.text.size());
+	for (auto ch : result.text) {
+		if (ch == '\\')
+			line.append("\\\\");
+		else if (ch >= 0x20 && ch < 0x7f)
+			line.push_back(static_cast<char>(ch));
+		else if (result.kind == ansi) {
+			char escape[] = { '\\', 'x', digits[(ch >> 4) & 0xf], digits[ch & 0xf] };
+			line.append(escape, sizeof(escape));
+		}
+		else {
+			char escape[] = { '\\', 'u', digits[(ch >> 12) & 0xf], digits[(ch >> 8) & 0xf], digits[(ch >> 4) & 0xf], digits[ch & 0xf] };
+			line.append(escape, sizeof(escape));
+		}
+	}
+	line.push_back('\n');
+	os << line;
+}
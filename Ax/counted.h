@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "regions.h"
+
+/** decoding the counted strings (UNICODE_STRING and ANSI_STRING) that are used throughout the NDK */
+namespace counted {
+	/* type-definitions */
+	enum kind_t { ansi, unicode };
+
+	/*
+		Both structures share the same layout, where Length and MaximumLength
+		are in bytes and Buffer is aligned to the width of a pointer.
+
+			USHORT Length; USHORT MaximumLength; PVOID Buffer;
+	*/
+	struct Result {
+		enum status_t {
+			ok,
+			truncated,	// Length was larger than the cap, so only that much was read
+			invalid,	// Length is larger than MaximumLength, or is odd for a unicode string
+			unmapped,	// the buffer isn't entirely inside a readable region
+			fault,		// reading the structure or its buffer raised an exception
+		} status;
+		kind_t kind;
+		uint64_t address;
+		uint64_t buffer;
+		std::u16string text;	// each code unit, or each byte of an ansi string
+	};
+
+	/* utilities */
+	bool kind(const std::string& name, kind_t& result);
+	size_t size(size_t width);
+	std::vector<uint64_t> parse(const std::string& addresses);		// throws std::invalid_argument
+	std::vector<uint64_t> stride(uint64_t ea, size_t count, size_t stride);
+
+	// Decode the structure at each address. If `map` is given then the
+	// buffer has to be readable according to it before it's touched.
+	Result decode(kind_t kind, uint64_t address, size_t width, size_t cap, const RegionMap* map);
+	std::vector<Result> decode(kind_t kind, const std::vector<uint64_t>& addresses, size_t width, size_t cap, const RegionMap* map);
+
+	// A result is its address, status, and then its text escaped so that it fits on one line.
+	void format(const Result& result, std::ostream& os);
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "cursor.h"
+
+/** Cursor */
+bool
+Cursor::next(size_t maximum, std::string& chunk)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::ostringstream os;
+
+	// only produce enough to satisfy the request so that the cursor never buffers more than a chunk
+	while (!m_exhausted && m_pending.size() < maximum) {
+		os.str(std::string());
+		os.clear();
+
+		// a piece that faults is discarded, but everything before it is still handed out
+		try {
+			m_exhausted = !m_produce(os);
+			m_pending.append(os.str());
+		}
+		catch (...) {
+			m_exhausted = m_failed = true;
+		}
+	}
+
+	auto size = (std::min)(maximum, m_pending.size());
+	chunk.assign(m_pending, 0, size);
+	m_pending.erase(0, size);
+	return !(m_exhausted && m_pending.empty() && chunk.empty());
+}
+
+bool
+Cursor::failed()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_failed;
+}
+
+/*
+	A dump is produced one row at a time since each row is formatted
+	independently of the others.
+*/
+std::shared_ptr<Cursor>
+Cursor::dump(const Dumper& dumper, Dumper::dumptype type, size_t size, intptr_t ea, size_t count)
+{
+	const size_t row = (std::max)(dumper.width() / size, static_cast<size_t>(1));
+	auto d = std::make_shared<Dumper>(dumper);
+	size_t done = 0;
+
+	return std::make_shared<Cursor>([d, type, size, row, ea, count, done](std::ostream& os) mutable {
+		if (done >= count)
+			return false;
+
+		auto leftover = (std::min)(row, count - done);
+		((*d).*type)(ea + done * size, leftover, os);
+		done += leftover;
+		return done < count;
+	});
+}
+
+/*
+	Instructions are decoded in batches. Each batch after the first is
+	preceded by a newline so the result is joined exactly the way that
+	Disassembler::disasm joins its lines.
+*/
+std::shared_ptr<Cursor>
+Cursor::disasm(std::shared_ptr<Disassembler> disassembler, intptr_t ea, size_t count)
+{
+	const size_t batch = 0x100;
+	size_t done = 0;
+	bool truncated = false;
+
+	// a batch that comes up short is still emitted, and then the next piece reports the failure
+	return std::make_shared<Cursor>([disassembler, batch, ea, count, done, truncated](std::ostream& os) mutable {
+		if (truncated)
+			throw std::runtime_error("disasm");
+		if (done >= count)
+			return false;
+
+		auto requested = (std::min)(batch, count - done);
+		size_t cb;
+
+		std::ostringstream lines;
+		auto decoded = disassembler->disasm(ea, requested, lines, &cb);
+		if (decoded == 0)
+			throw std::runtime_error("disasm");
+
+		if (done)
+			os << std::endl;
+		os << lines.str();
+
+		ea += cb;
+		done += decoded;
+		truncated = decoded < requested;
+		return truncated || done < count;
+	});
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "disassembler.h"
+#include "threading.h"
+
+/** text that is produced a piece at a time and handed out in bounded chunks */
+class Cursor {
+public:
+	/* type-definitions */
+	typedef std::function<bool(std::ostream&)> producer;	// writes the next piece, returns false when there's nothing left
+
+private:
+	/* private members */
+	std::mutex m_lock;
+	producer m_produce;
+	std::string m_pending;
+	bool m_exhausted, m_failed;
+
+public:
+	/* scoping methods */
+	Cursor(producer produce) : m_produce(produce), m_exhausted(false), m_failed(false) {}
+	~Cursor() {}
+
+	Cursor(const Cursor&) = delete;
+	Cursor& operator=(const Cursor&) = delete;
+
+	/* methods */
+
+	// Return up to `maximum` characters, producing only as much as is needed to fill them. This returns
+	// false once everything has been handed out. A producer that faults ends the stream and sets failed().
+	bool next(size_t maximum, std::string& chunk);
+	bool failed();
+
+	/* cursors that emit the same text as Dumper::dump and Disassembler::disasm */
+	static std::shared_ptr<Cursor> dump(const Dumper& dumper, Dumper::dumptype type, size_t size, intptr_t ea, size_t count);
+	static std::shared_ptr<Cursor> disasm(std::shared_ptr<Disassembler> disassembler, intptr_t ea, size_t count);
+};
+
+/** the cursors that have been opened by a client */
+typedef HandleTable<Cursor> CursorTable;
@@ -1,13 +1,46 @@
-#include "stdafx.h"
-
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <limits>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
 #include <ctype.h>
 
 #include "disassembler.h"
+#include "symbols.h"
 
 /** globals */
+namespace utils {
+	/* integer dumpers */
+	const DumpType dumptypes[] = {
+		{ "uint8_t", &Dumper::dump<uint8_t>, sizeof(uint8_t) },
+		{ "uint16_t", &Dumper::dump<uint16_t>, sizeof(uint16_t) },
+		{ "uint32_t", &Dumper::dump<uint32_t>, sizeof(uint32_t) },
+		{ "uint64_t", &Dumper::dump<uint64_t>, sizeof(uint64_t) },
+		{ "float", &Dumper::dump<float>, sizeof(float) },
+		{ "double", &Dumper::dump<double>, sizeof(double) },
+
+		{ "ubyte1", &Dumper::dump<uint8_t>, sizeof(uint8_t) },
+		{ "uint2", &Dumper::dump<uint16_t>, sizeof(uint16_t) },
+		{ "uint4", &Dumper::dump<uint32_t>, sizeof(uint32_t) },
+		{ "uint8", &Dumper::dump<uint64_t>, sizeof(uint64_t) },
+		{ "binary32", &Dumper::dump<float>, sizeof(float) },
+		{ "binary64", &Dumper::dump<double>, sizeof(double) },
+
+		{ "symbols", &Dumper::symbols, sizeof(uintptr_t) },
+		{ NULL, NULL, 0 }
+	};
+
+	/* disassembler syntax */
+	const Syntax SyntaxList[] = {
+		{"default", CS_OPT_SYNTAX_DEFAULT},
+		{"intel", CS_OPT_SYNTAX_INTEL},
+		{"att", CS_OPT_SYNTAX_ATT},
+		{NULL, (cs_opt_value)0}
+	};
+}
+
 void
 Disassembler::option(enum cs_opt_type type, size_t value)
 {
@@ -45,6 +78,8 @@ Disassembler::mode(enum cs_mode mode)
 	auto err = cs_option(m_handle, CS_OPT_MODE, mode);
 	if (err != CS_ERR_OK)
 		throw std::invalid_argument(cs_strerror(err));
+
+	m_bits = (mode == CS_MODE_16) ? 16 : (mode == CS_MODE_32) ? 32 : (mode == CS_MODE_64) ? 64 : m_bits;
 }
 
 size_t
@@ -69,11 +104,64 @@ Disassembler::size(intptr_t ea, size_t count)
 		res += ins->size;
 		count--;
 	}
+	cs_free(ins, 1);
 	return res;
 }
 
 size_t
-Disassembler::disasm(intptr_t ea, size_t count, std::ostream& os)
+Disassembler::count(intptr_t ea, size_t size)
+{
+	size_t res = 0;
+	const uint8_t* p = reinterpret_cast<uint8_t*>(ea);
+	uint64_t offset = static_cast<uint64_t>(ea);
+
+	cs_insn* ins = cs_malloc(m_handle);
+
+	while (size > 0) {
+		try {
+			if (!cs_disasm_iter(m_handle, &p, &size, &offset, ins))
+				break;
+		}
+		catch (...)
+		{
+			break;
+		}
+		res++;
+	}
+	cs_free(ins, 1);
+	return res;
+}
+
+bool
+Disassembler::call(intptr_t ea, size_t size, uint64_t& target, bool& immediate)
+{
+	const uint8_t* p = reinterpret_cast<uint8_t*>(ea);
+	uint64_t offset = static_cast<uint64_t>(ea);
+	size_t available = size;
+	bool res = false;
+
+	cs_insn* ins = cs_malloc(m_handle);
+
+	try {
+		if (cs_disasm_iter(m_handle, &p, &available, &offset, ins) && ins->size == size && strncmp(ins->mnemonic, "call", 4) == 0) {
+			// both syntaxes write the destination of a direct call as a bare hex number
+			const char* operand = ins->op_str;
+			immediate = strncmp(operand, "0x", 2) == 0;
+			target = immediate ? strtoull(operand + 2, nullptr, 16) : 0;
+			res = true;
+		}
+	}
+	catch (...)
+	{
+		res = false;
+	}
+
+	cs_free(ins, 1);
+	return res;
+}
+
+size_t
+Disassembler::disasm(intptr_t ea, size_t count, std::ostream& os, size_t* consumed)
 {
 	size_t res, cb;
 	cs_insn* insns;
@@ -82,9 +170,14 @@ Disassembler::disasm(intptr_t ea, size_t count, std::ostream& os)
 	count = res = cs_disasm(m_handle, reinterpret_cast<uint8_t*>(ea), cb, ea, 0, &insns);
 
 	auto p = insns;
+	if (consumed)
+		*consumed = count ? static_cast<size_t>(insns[count - 1].address + insns[count - 1].size - ea) : 0;
+
 	while (res > 0) {
 		os << std::hex << std::setfill('0') << std::setw(m_bits / 4) << p->address;
 		os << " : " << p->mnemonic << " " << p->op_str;
+		if (m_symbols)
+			annotation(p, os);
 		p++; res--;
 		if (res)
 			os << std::endl;
@@ -95,6 +188,76 @@ Disassembler::disasm(intptr_t ea, size_t count, std::ostream& os)
 	return count;
 }
 
+/*
+	Every hex number in the operands that lands inside of a module is given
+	its symbol. A displacement from rip is relative to the next instruction,
+	and a branch through memory also gets the symbol of the pointer that's
+	stored there.
+
+		00401000 : call qword ptr [rip + 0x1ffa]  ; app+0x3000 -> kernel32!CreateFileW
+*/
+void
+Disassembler::annotation(const cs_insn* insn, std::ostream& os)
+{
+	const std::string operands(insn->op_str);
+	const bool branch = insn->mnemonic[0] == 'j' || strncmp(insn->mnemonic, "call", 4) == 0;
+	std::vector<std::string> notes;
+
+	size_t open = std::string::npos;
+	for (size_t i = 0; i < operands.size(); i++) {
+		if (operands[i] == '[')
+			open = i;
+		else if (operands[i] == ']')
+			open = std::string::npos;
+		if (operands.compare(i, 2, "0x") != 0 || (i && isalnum(static_cast<unsigned char>(operands[i - 1]))))
+			continue;
+
+		char* stop;
+		uint64_t value = strtoull(operands.c_str() + i + 2, &stop, 16);
+		auto next = static_cast<size_t>(stop - operands.c_str());
+
+		// figure out whether this is the displacement of a memory operand (intel or at&t)
+		bool memory = false, rip = false, absolute = false;
+		if (open != std::string::npos) {
+			auto inside = operands.substr(open + 1, i - open - 1);
+			memory = true;
+			rip = inside.find("rip") != std::string::npos;
+			absolute = inside.find_first_not_of(' ') == std::string::npos;
+			if (rip && inside.find('-') != std::string::npos)
+				value = 0 - value;
+		}
+		else if (next < operands.size() && operands[next] == '(') {
+			memory = true;
+			rip = operands.compare(next, 6, "(%rip)") == 0;
+			absolute = false;
+		}
+		if (rip)
+			value += insn->address + insn->size;
+		i = next - 1;
+
+		std::string note, target;
+		if (m_bits < 64)
+			value &= 0xffffffffull;
+		m_symbols->resolve(static_cast<uintptr_t>(value), note);
+
+		if (branch && memory && (rip || absolute)) {
+			try {
+				uint64_t pointer = 0;
+				memcpy(&pointer, reinterpret_cast<const void*>(static_cast<uintptr_t>(value)), m_bits / 8);
+				if (m_symbols->resolve(static_cast<uintptr_t>(pointer), target))
+					note += (note.empty() ? "-> " : " -> ") + target;
+			}
+			catch (...) {
+			}
+		}
+		if (!note.empty())
+			notes.push_back(note);
+	}
+
+	for (size_t i = 0; i < notes.size(); i++)
+		os << (i ? ", " : "  ; ") << notes[i];
+}
+
 size_t
 Disassembler::bits(size_t num)
 {
@@ -115,6 +278,24 @@ Dumper::address(intptr_t ea, std::ostream& os)
 	os << std::hex << std::setfill('0') << std::setw(m_bits / 4) << ea;
 }
 
+void
+Dumper::symbols(intptr_t ea, size_t count, std::ostream& os)
+{
+	const uintptr_t* p = reinterpret_cast<const uintptr_t*>(ea);
+	std::string symbol;
+
+	for (size_t i = 0; i < count; i++, p++) {
+		auto value = *p;
+		address(reinterpret_cast<intptr_t>(p), os);
+		os << divider;
+		os << std::hex << std::setfill('0') << std::setw(sizeof(value) * 2) << value;
+		if (m_symbols && m_symbols->resolve(value, symbol))
+			os << " " << symbol;
+		os << std::endl;
+	}
+	os.flush();
+}
+
 void
 Dumper::printable(intptr_t ea, size_t count, std::ostream& os)
 {
@@ -2,15 +2,21 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <stdexcept>
 
 #include <capstone.h>
 
+class SymbolTable;
+
 /** class definitions */
 class Disassembler {
 protected:
 	/* protected properties */
 	csh m_handle;
+	const SymbolTable* m_symbols;
+
+	void annotation(const cs_insn* insn, std::ostream& os);
 
 public:
 	/* public properties */
@@ -19,7 +25,7 @@ public:
 
 public:
 	/* scoping methods */
-	Disassembler()
+	Disassembler() : m_symbols(nullptr)
 	{
 		cs_err err;
 		#if defined(_M_AMD64) || defined(_M_X64)
@@ -37,7 +43,7 @@ public:
 		option(CS_OPT_SKIPDATA, CS_OPT_ON);
 	}
 
-	Disassembler(enum cs_mode mode) {
+	Disassembler(enum cs_mode mode) : m_symbols(nullptr) {
 		auto err = cs_open(CS_ARCH_X86, mode, &m_handle);
 		if (err != CS_ERR_OK)
 			throw std::invalid_argument(cs_strerror(err));
@@ -66,8 +72,15 @@ public:
 
 	size_t bits(size_t num);
 
+	// When given a symbol table, each address that an instruction refers to is followed by its symbol.
+	void annotate(const SymbolTable* symbols) { m_symbols = symbols; }
+
 	size_t size(intptr_t ea, size_t count);
-	size_t disasm(intptr_t ea, size_t count, std::ostream& os);
+	size_t count(intptr_t ea, size_t size);		// the number of instructions that fit entirely within `size` bytes
+
+	// Whether exactly `size` bytes at `ea` decode as a call, along with its destination if that's an immediate.
+	bool call(intptr_t ea, size_t size, uint64_t& target, bool& immediate);
+	size_t disasm(intptr_t ea, size_t count, std::ostream& os, size_t* consumed = nullptr);
 };
 
 class Dumper {
@@ -79,6 +92,7 @@ private:
 	/* private members */
 	size_t m_bits;
 	size_t m_width;
+	const SymbolTable* m_symbols;
 
 	const char unprintable = '.';
 	const std::string divider = " | ";
@@ -129,9 +143,14 @@ protected:
 
 public:
 	/* public interface */
-	Dumper(size_t bits, size_t width) : m_bits(bits), m_width(width) {}
+	Dumper(size_t bits, size_t width, const SymbolTable* symbols = nullptr) : m_bits(bits), m_width(width), m_symbols(symbols) {}
 	~Dumper() {}
 
+	size_t width() const { return m_width; }
+
+	// Each pointer is on its own line, followed by the symbol that it points to.
+	void symbols(intptr_t ea, size_t count, std::ostream& os);
+
 	template <typename T>
 	void dump(intptr_t ea, size_t count, std::ostream& os) {
 		T* p = reinterpret_cast<T*>(ea);
@@ -157,3 +176,19 @@ public:
 		os.flush();
 	}
 };
+
+/** the dumpers and the syntaxes that are selected by name, where each list ends with an entry without one */
+namespace utils {
+	struct DumpType {
+		const char* type;
+		Dumper::dumptype dumper;
+		size_t size;
+	};
+	extern const DumpType dumptypes[];
+
+	struct Syntax {
+		const char* identifier;
+		enum cs_opt_value option;
+	};
+	extern const Syntax SyntaxList[];
+}
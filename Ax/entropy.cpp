@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "entropy.h"
+#include "parallel.h"
+#include "scanner.h"
+
+namespace {
+	/* the thresholds for each kind, in the same units as a Page */
+	const uint8_t threshold_compressed = 240;	// 7.5 bits
+	const uint8_t threshold_pointers = 128;
+	const uint8_t threshold_text = 230;
+
+	// c * log2(c) for every count that a page can have, so that the entropy is a sum of lookups
+	const std::vector<float>&
+	logarithms()
+	{
+		static const std::vector<float> table = []() {
+			std::vector<float> res(entropy::pagesize + 1, 0.0f);
+			for (size_t c = 1; c < res.size(); c++)
+				res[c] = static_cast<float>(c * std::log2(static_cast<double>(c)));
+			return res;
+		}();
+		return table;
+	}
+
+	inline uint8_t
+	ratio(size_t count, size_t total)
+	{
+		return total ? static_cast<uint8_t>((count * 255 + total / 2) / total) : 0;
+	}
+}
+
+/** utilities */
+namespace entropy {
+	const char*
+	name(kind_t kind)
+	{
+		switch (kind) {
+		case zero: return "zero";
+		case uniform: return "uniform";
+		case text: return "text";
+		case pointer: return "pointer";
+		case compressed: return "compressed";
+		default: return "mixed";
+		}
+	}
+
+	/*
+		The histogram is split into four that are interleaved by byte, so that
+		consecutive increments of the same bin don't have to wait on each
+		other. A page fits in a 16-bit count.
+	*/
+	Page
+	measure(uintptr_t ea, size_t size, size_t width, const pointers::Targets& targets)
+	{
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(ea);
+		uint16_t partial[4][256];
+		uint32_t counts[256];
+		size_t i = 0;
+
+		size = (std::min)(size, pagesize);
+		memset(partial, 0, sizeof(partial));
+
+		// zero pages and padding are common enough that they're worth checking for before building a histogram
+		if (size >= sizeof(uint64_t)) {
+			const uint64_t repeated = p[0] * 0x0101010101010101ull;
+			for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+				uint64_t v;
+				memcpy(&v, p + i, sizeof(v));
+				if (v != repeated)
+					break;
+			}
+			partial[0][p[0]] = static_cast<uint16_t>(i);
+		}
+
+		for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+			uint64_t v;
+			memcpy(&v, p + i, sizeof(v));
+			partial[0][v & 0xff]++;
+			partial[1][(v >> 8) & 0xff]++;
+			partial[2][(v >> 16) & 0xff]++;
+			partial[3][(v >> 24) & 0xff]++;
+			partial[0][(v >> 32) & 0xff]++;
+			partial[1][(v >> 40) & 0xff]++;
+			partial[2][(v >> 48) & 0xff]++;
+			partial[3][v >> 56]++;
+		}
+		for (; i < size; i++)
+			partial[0][p[i]]++;
+
+		auto& table = logarithms();
+		size_t printable = 0, dominant = 0;
+		double sum = 0.0;
+		for (size_t b = 0; b < 256; b++) {
+			counts[b] = partial[0][b] + partial[1][b] + partial[2][b] + partial[3][b];
+			sum += table[counts[b]];
+			dominant = (std::max)(dominant, static_cast<size_t>(counts[b]));
+			if ((b >= 0x20 && b < 0x7f) || b == '\t' || b == '\n' || b == '\r')
+				printable += counts[b];
+		}
+
+		// the entropy is log2(n) - sum(c log2 c) / n
+		double bits = size ? std::log2(static_cast<double>(size)) - sum / size : 0.0;
+
+		size_t hits = 0;
+		auto count = [&hits](const pointers::Found&) { hits++; return true; };
+		if (width == sizeof(uint64_t))
+			pointers::search8(ea, size, targets, count);
+		else
+			pointers::search4(ea, size, targets, count);
+
+		Page res;
+		res.base = ea;
+		res.entropy = static_cast<uint8_t>((std::min)(255.0, std::floor(bits * 32 + 0.5)));
+		res.zeros = ratio(counts[0], size);
+		res.printable = ratio(printable, size);
+		res.pointers = ratio(hits, size / width);
+
+		if (counts[0] == size)
+			res.kind = zero;
+		else if (dominant == size)
+			res.kind = uniform;
+		else if (res.entropy >= threshold_compressed)
+			res.kind = compressed;
+		else if (res.pointers >= threshold_pointers)
+			res.kind = pointer;
+		else if (res.printable >= threshold_text)
+			res.kind = text;
+		else
+			res.kind = mixed;
+		return res;
+	}
+
+	std::vector<Page>
+	measure(const std::vector<Region>& regions, size_t width, const pointers::Targets& targets, size_t threads)
+	{
+		auto items = parallel::shard(scan::coalesce(regions), 0x100000, 0);
+
+		// a page that faults is left out rather than losing the rest of its shard
+		return parallel::collect<Page>(items, threads, [width, &targets](const parallel::Item& item, std::vector<Page>& hits) {
+			hits.reserve(item.size / pagesize + 1);
+			for (uintptr_t ea = item.base; ea < item.base + item.size; ea += pagesize) {
+				try {
+					hits.push_back(measure(ea, (std::min)(pagesize, static_cast<size_t>(item.base + item.size - ea)), width, targets));
+				}
+				catch (...) {
+				}
+			}
+		});
+	}
+
+	std::string
+	format(const std::vector<Page>& pages)
+	{
+		static const char digits[] = "0123456789abcdef";
+		std::string res, run;
+		size_t count = 0;
+		uintptr_t start = 0;
+
+		auto flush = [&]() {
+			if (!count)
+				return;
+			std::ostringstream os;
+			os << scan::format(start) << " " << std::dec << count << " ";
+			res.append(os.str());
+			res.append(run);
+			res.push_back('\n');
+			run.clear();
+			count = 0;
+		};
+
+		for (auto& page : pages) {
+			if (count && page.base != start + count * pagesize)
+				flush();
+			if (!count)
+				start = page.base;
+
+			for (uint8_t b : { page.entropy, page.zeros, page.printable, page.pointers, static_cast<uint8_t>(page.kind) }) {
+				run.push_back(digits[b >> 4]);
+				run.push_back(digits[b & 0xf]);
+			}
+			count++;
+		}
+		flush();
+		return res;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "pointers.h"
+#include "regions.h"
+
+/** classifying each page of memory by its byte distribution, so that the uninteresting ones can be skipped */
+namespace entropy {
+	/* type-definitions */
+	const size_t pagesize = 0x1000;
+
+	enum kind_t : uint8_t {
+		mixed,
+		zero,			// every byte is zero
+		uniform,		// every byte is the same non-zero value, such as padding
+		text,			// almost entirely printable
+		pointer,		// mostly aligned values that point into mapped memory
+		compressed,		// close to the maximum entropy, so compressed or encrypted
+	};
+
+	/*
+		Each measurement is scaled to a byte. The entropy is in units of 1/32
+		of a bit, and each of the ratios is out of 255.
+	*/
+	struct Page {
+		uintptr_t base;
+		uint8_t entropy;
+		uint8_t zeros;
+		uint8_t printable;
+		uint8_t pointers;
+		kind_t kind;
+	};
+
+	/* utilities */
+	const char* name(kind_t kind);
+
+	// Measure a single page (or less) where `targets` are the values that look like pointers.
+	Page measure(uintptr_t ea, size_t size, size_t width, const pointers::Targets& targets);
+
+	// Measure every page of the regions using `threads` workers.
+	std::vector<Page> measure(const std::vector<Region>& regions, size_t width, const pointers::Targets& targets, size_t threads);
+
+	/*
+		Each run of consecutive pages is written as a line with the address of
+		the first page, the number of pages, and then five bytes in hex for
+		each page: entropy, zeros, printable, pointers, and kind.
+
+			00007ff812340000 2 f4005f000500ff000001
+	*/
+	std::string format(const std::vector<Page>& pages);
+}
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRINGS_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "extractor.h"
+#include "scanner.h"
+
+/** character classification */
+namespace {
+	const size_t npos = static_cast<size_t>(-1);
+
+	/*
+		Each item may read ahead to the end of its span so that a run which
+		crosses into the items after it is measured in full by the one that
+		it starts in. A kernel only reads past its own end while it's in the
+		middle of a run, and the items after it only skip over the part of
+		the run that's within themselves, so a run is never read twice.
+	*/
+	const size_t readahead = npos;
+
+	inline bool
+	printable(uint8_t b)
+	{
+		return (b >= 0x20 && b < 0x7f) || b == '\t';
+	}
+
+	// bit n is set if p[n] is printable
+	inline unsigned
+	printable16(const uint8_t* p)
+	{
+#if defined(STRINGS_SSE2)
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+		// bias the range [0x20, 0x7e] down to the bottom of the signed range so that a single compare does the job
+		auto biased = _mm_xor_si128(_mm_sub_epi8(v, _mm_set1_epi8(0x20)), _mm_set1_epi8(static_cast<char>(0x80)));
+		auto res = _mm_cmplt_epi8(biased, _mm_set1_epi8(static_cast<char>(0x5f ^ 0x80)));
+		res = _mm_or_si128(res, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+		return static_cast<unsigned>(_mm_movemask_epi8(res));
+#else
+		unsigned res = 0;
+		for (int i = 0; i < 16; i++)
+			res |= printable(p[i]) ? (1u << i) : 0;
+		return res;
+#endif
+	}
+
+	// bit n is set if p[n] is zero
+	inline unsigned
+	zero16(const uint8_t* p)
+	{
+#if defined(STRINGS_SSE2)
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())));
+#else
+		unsigned res = 0;
+		for (int i = 0; i < 16; i++)
+			res |= (p[i] == 0) ? (1u << i) : 0;
+		return res;
+#endif
+	}
+
+	inline bool
+	printablew(const uint8_t* p)
+	{
+		return printable(p[0]) && p[1] == 0;
+	}
+
+	// the index of the lowest bit that's set, which has to be at least one of them
+	inline unsigned
+	trailing(unsigned mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long res;
+		_BitScanForward(&res, mask);
+		return static_cast<unsigned>(res);
+#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+	}
+}
+
+/** utilities */
+namespace strings {
+	const char*
+	name(encoding_t encoding)
+	{
+		return (encoding == utf16) ? "utf16" : "ascii";
+	}
+
+	std::string
+	format(const Found& found)
+	{
+		std::ostringstream os;
+		os << scan::format(found.address) << " " << name(found.encoding) << " " << found.text;
+		return os.str();
+	}
+}
+
+/** kernels */
+namespace strings {
+	size_t
+	extract8(uintptr_t ea, size_t size, size_t overlap, bool continued, size_t minimum, visitor visit)
+	{
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(ea);
+		const size_t window = size + overlap;
+		size_t i = 0, start = npos, res = 0;
+
+		auto close = [&](size_t stop) {
+			auto length = stop - start;
+			auto found = start;
+			start = npos;
+			if (length < minimum)
+				return true;
+
+			Found item = { ea + found, ascii, length, std::string(reinterpret_cast<const char*>(p + found), (std::min)(length, maximum)) };
+			res++;
+			return visit(item);
+		};
+
+		// skip over the run that the previous item is responsible for, but only as far as our own end
+		if (continued && printable(p[-1])) {
+			while (i + 16 <= size && printable16(p + i) == 0xffff)
+				i += 16;
+			while (i < size && printable(p[i]))
+				i++;
+		}
+
+		while (i < window) {
+			if (start == npos && i >= size)
+				break;
+
+			/*
+				Classify 16 characters at a time, and then jump from one edge
+				of a run to the next with the bits of the mask. Each window is
+				only loaded once, however many runs start or stop within it.
+			*/
+			if (i + 16 <= window) {
+				const unsigned mask = printable16(p + i);
+				for (unsigned offset = 0; offset < 16; ) {
+					unsigned edges = ((start == npos) ? mask : ~mask & 0xffff) >> offset;
+					if (!edges)
+						break;
+					offset += trailing(edges);
+
+					// a run that starts past our end belongs to the item after us
+					if (start != npos) {
+						if (!close(i + offset))
+							return res;
+					} else if (i + offset >= size)
+						return res;
+					else
+						start = i + offset;
+				}
+				i += 16;
+				continue;
+			}
+
+			if (printable(p[i])) {
+				if (start == npos)
+					start = i;
+			} else if (start != npos && !close(i))
+				return res;
+			i++;
+		}
+
+		if (start != npos)
+			close(i);
+		return res;
+	}
+
+	size_t
+	extract16(uintptr_t ea, size_t size, size_t overlap, bool continued, size_t minimum, visitor visit)
+	{
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(ea);
+		const size_t window = (size + overlap) / 2, limit = (size + 1) / 2;
+		size_t i = 0, start = npos, res = 0;
+
+		auto close = [&](size_t stop) {
+			auto length = stop - start;
+			auto found = start;
+			start = npos;
+			if (length < minimum)
+				return true;
+
+			std::string text;
+			for (size_t n = 0; n < (std::min)(length, maximum); n++)
+				text.push_back(static_cast<char>(p[2 * (found + n)]));
+
+			Found item = { ea + 2 * found, utf16, length, text };
+			res++;
+			return visit(item);
+		};
+
+		// skip over the run that the previous item is responsible for, but only as far as our own end
+		if (continued && printablew(p - 2)) {
+			while (2 * i + 16 <= size && (printable16(p + 2 * i) & (zero16(p + 2 * i) >> 1) & 0x5555) == 0x5555)
+				i += 8;
+			while (i < limit && printablew(p + 2 * i))
+				i++;
+		}
+
+		while (i < window) {
+			if (start == npos && i >= limit)
+				break;
+
+			// classify 8 characters at a time, where each character is the even bit of its pair in the mask
+			if (i + 8 <= window) {
+				const unsigned mask = printable16(p + 2 * i) & (zero16(p + 2 * i) >> 1) & 0x5555;
+				for (unsigned offset = 0; offset < 16; ) {
+					unsigned edges = ((start == npos) ? mask : ~mask & 0x5555) >> offset;
+					if (!edges)
+						break;
+					offset += trailing(edges);
+
+					auto at = i + offset / 2;
+					if (start != npos) {
+						if (!close(at))
+							return res;
+					} else if (at >= limit)
+						return res;
+					else
+						start = at;
+				}
+				i += 8;
+				continue;
+			}
+
+			if (printablew(p + 2 * i)) {
+				if (start == npos)
+					start = i;
+			} else if (start != npos && !close(i))
+				return res;
+			i++;
+		}
+
+		if (start != npos)
+			close(i);
+		return res;
+	}
+
+	// both encodings of a single item in address order, with each stopping after `limit` strings or once `stop` is set
+	static void
+	extract(const parallel::Item& item, size_t minimum, size_t limit, const std::function<bool()>& stop, std::vector<Found>& hits)
+	{
+		size_t count8 = 0, count16 = 0;
+		extract8(item.base, item.size, item.overlap, item.continued, minimum, [&](Found& found) {
+			hits.push_back(std::move(found));
+			return ++count8 < limit && !stop();
+		});
+		extract16(item.base, item.size, item.overlap, item.continued, minimum, [&](Found& found) {
+			hits.push_back(std::move(found));
+			return ++count16 < limit && !stop();
+		});
+
+		std::sort(hits.begin(), hits.end());
+		if (hits.size() > limit)
+			hits.resize(limit);
+	}
+
+	std::vector<Found>
+	extract(const std::vector<Region>& regions, size_t minimum, size_t limit, size_t threads)
+	{
+		std::vector<Found> res;
+		std::atomic<bool> full(limit == 0);
+		std::function<bool()> stop = [&full]() { return full.load(); };
+
+		auto items = parallel::shard(scan::coalesce(regions), 0x100000, readahead);
+
+		parallel::run<Found>(items, threads,
+			[minimum, limit, &stop](const parallel::Item& item, std::vector<Found>& hits) {
+				extract(item, minimum, limit, stop, hits);
+			},
+			[&res, &full, limit](std::vector<Found>& hits) {
+				for (auto& found : hits) {
+					if (res.size() >= limit)
+						break;
+					res.push_back(std::move(found));
+				}
+				if (res.size() >= limit)
+					full = true;
+			},
+			stop
+		);
+		return res;
+	}
+
+	void
+	extract(Job& job, const std::vector<Region>& regions, size_t minimum, size_t threads)
+	{
+		auto spans = scan::coalesce(regions);
+		auto items = parallel::shard(spans, 0x100000, readahead);
+		std::function<bool()> stop = [&job]() { return job.interrupted(); };
+		job.progress(0, scan::total(spans));
+
+		parallel::run<Found>(items, threads,
+			[&job, minimum, &stop](const parallel::Item& item, std::vector<Found>& hits) {
+				extract(item, minimum, npos, stop, hits);
+				job.advance(item.size);
+			},
+			[&job](std::vector<Found>& hits) {
+				for (auto& found : hits)
+					job.emit(format(found));
+			},
+			stop
+		);
+	}
+}
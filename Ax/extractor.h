@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "regions.h"
+#include "jobs.h"
+#include "parallel.h"
+
+/** printable string extraction */
+namespace strings {
+	/* type-definitions */
+	enum encoding_t { ascii, utf16 };
+
+	struct Found {
+		uintptr_t address;
+		encoding_t encoding;
+		size_t length;		// in characters, the text may be truncated
+		std::string text;
+
+		bool operator<(const Found& other) const {
+			return address < other.address || (address == other.address && encoding < other.encoding);
+		}
+	};
+	typedef std::function<bool(Found&)> visitor;	// returns false to stop
+
+	/* the longest text that will be returned for a single string */
+	const size_t maximum = 0x1000;
+
+	/* utilities */
+	const char* name(encoding_t encoding);
+	std::string format(const Found& found);
+
+	/*
+		Kernels that report every run of at least `minimum` printable characters
+		that starts within [ea, ea+size). A run may continue past the end into
+		the `overlap`, and its length is only exact if it ends before the
+		overlap does. If `continued` is set, a run that was already in progress
+		at `ea` belongs to whoever scanned the memory before it and is skipped.
+	*/
+	size_t extract8(uintptr_t ea, size_t size, size_t overlap, bool continued, size_t minimum, visitor visit);
+	size_t extract16(uintptr_t ea, size_t size, size_t overlap, bool continued, size_t minimum, visitor visit);
+
+	/* extract both encodings from every region using `threads` workers, stopping after `limit` strings */
+	std::vector<Found> extract(const std::vector<Region>& regions, size_t minimum, size_t limit, size_t threads);
+
+	/* a job that emits the strings of each shard as soon as it and the ones before it have been scanned */
+	void extract(Job& job, const std::vector<Region>& regions, size_t minimum, size_t threads);
+}
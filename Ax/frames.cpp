@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+#include "frames.h"
+#include "scanner.h"
+
+namespace {
+	/*
+		The lengths that a call can have, with the direct call (e8 rel32)
+		first since it's the most common. The rest cover the indirect forms
+		(ff /2) through a register, a displacement, a sib, or rip, each with
+		or without a prefix.
+	*/
+	const size_t lengths[] = { 5, 6, 2, 3, 7, 4, 8, 9 };
+
+	/* the score that each piece of evidence adds to a candidate */
+	enum : unsigned {
+		score_indirect = 1,
+		score_direct = 2,
+		score_function = 1,		// the return address is inside of a function that's in the exception directory
+		score_entry = 1,		// a direct call lands at the beginning of one of those functions
+	};
+}
+
+/** utilities */
+namespace frames {
+	const char*
+	name(kind_t kind)
+	{
+		switch (kind) {
+		case direct: return "direct";
+		case indirect: return "indirect";
+		default: return "none";
+		}
+	}
+
+	bool
+	verify(Disassembler& disassembler, uint64_t address, Site& result)
+	{
+		for (auto length : lengths) {
+			if (address < length)
+				continue;
+
+			uint64_t target;
+			bool immediate;
+			if (!disassembler.call(static_cast<intptr_t>(address - length), length, target, immediate))
+				continue;
+
+			result.kind = immediate ? direct : indirect;
+			result.target = immediate ? target : 0;
+			return true;
+		}
+		return false;
+	}
+}
+
+/** scanning */
+namespace frames {
+	static unsigned
+	score(const Candidate& candidate, const FunctionTable* functions)
+	{
+		unsigned res = (candidate.site.kind == direct) ? score_direct : score_indirect;
+		if (functions == nullptr)
+			return res;
+
+		FunctionTable::Range range;
+		if (functions->find(static_cast<uintptr_t>(candidate.value), range))
+			res += score_function;
+		if (candidate.site.kind == direct && functions->find(static_cast<uintptr_t>(candidate.site.target), range) && range.begin == candidate.site.target)
+			res += score_entry;
+		return res;
+	}
+
+	std::vector<Candidate>
+	scan(const std::vector<Region>& regions, size_t width, const pointers::Targets& code, const verifier& verify, const FunctionTable* functions, size_t limit, size_t* verified)
+	{
+		std::vector<pointers::Found> found;
+		std::vector<Candidate> res;
+
+		// the values that land in code are collected first by the same kernels that scan for pointers
+		auto collect = [&found](const pointers::Found& item) {
+			found.push_back(item);
+			return true;
+		};
+		for (auto& region : regions) {
+			if (width == sizeof(uint64_t))
+				pointers::search8(region.base, region.size, code, collect);
+			else
+				pointers::search4(region.base, region.size, code, collect);
+		}
+
+		// a return address shows up in more than one frame for recursion or a loop, so each is decoded once
+		std::unordered_map<uint64_t, std::pair<bool, Site>> cache;
+		for (auto& item : found) {
+			auto it = cache.find(item.value);
+			if (it == cache.end()) {
+				Site site = { none, 0 };
+				bool ok;
+				try {
+					ok = verify(item.value, site);
+				}
+				catch (...) {
+					ok = false;
+				}
+				it = cache.emplace(item.value, std::make_pair(ok, site)).first;
+			}
+			if (!it->second.first)
+				continue;
+
+			Candidate candidate = { item.location, item.value, it->second.second, 0 };
+			candidate.score = score(candidate, functions);
+			res.push_back(candidate);
+		}
+
+		if (verified)
+			*verified = cache.size();
+
+		std::stable_sort(res.begin(), res.end(), [](const Candidate& a, const Candidate& b) {
+			return (a.score != b.score) ? a.score > b.score : a.slot < b.slot;
+		});
+		if (limit && res.size() > limit)
+			res.resize(limit);
+		return res;
+	}
+
+	/*
+		The target is 0 for anything that isn't a direct call, and the symbol
+		is only included when the value is inside of a module.
+
+			000000000014f8a8 00007ff812341234 3 direct 00007ff812345000 ntdll!RtlUserThreadStart+0x21
+	*/
+	std::string
+	format(const Candidate& candidate, size_t width, const SymbolTable* symbols)
+	{
+		std::ostringstream os;
+		std::string symbol;
+
+		os << scan::format(candidate.slot) << " ";
+		os << std::hex << std::setfill('0') << std::setw(width * 2) << candidate.value << " ";
+		os << std::dec << candidate.score << " " << name(candidate.site.kind) << " ";
+		os << std::hex << std::setfill('0') << std::setw(width * 2) << candidate.site.target;
+		if (symbols && symbols->resolve(static_cast<uintptr_t>(candidate.value), symbol))
+			os << " " << symbol;
+		return os.str();
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "disassembler.h"
+#include "functions.h"
+#include "pointers.h"
+#include "regions.h"
+#include "symbols.h"
+
+/** finding the return addresses that are stored on a stack */
+namespace frames {
+	/* type-definitions */
+	enum kind_t { none, direct, indirect };
+
+	// the call instruction that precedes a return address
+	struct Site {
+		kind_t kind;
+		uint64_t target;	// the destination of a direct call
+	};
+	typedef std::function<bool(uint64_t, Site&)> verifier;
+
+	struct Candidate {
+		uintptr_t slot;		// where on the stack the value was found
+		uint64_t value;
+		Site site;
+		unsigned score;
+	};
+
+	/* utilities */
+	const char* name(kind_t kind);
+
+	// Find the call that ends at `address` by decoding each length that a call can have.
+	bool verify(Disassembler& disassembler, uint64_t address, Site& result);
+
+	/*
+		Check every aligned value of `width` bytes in the regions for one
+		that lands in `code`, and keep the ones that are preceded by a call.
+		Each distinct value is only verified once. The result is ranked by
+		score and then by slot, and `verified` is how many values needed
+		to be decoded.
+	*/
+	std::vector<Candidate> scan(const std::vector<Region>& regions, size_t width, const pointers::Targets& code, const verifier& verify, const FunctionTable* functions, size_t limit, size_t* verified);
+
+	// A candidate is its slot, value, score, and kind, followed by the target of a direct call and the symbol of the value.
+	std::string format(const Candidate& candidate, size_t width, const SymbolTable* symbols);
+}
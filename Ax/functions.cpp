@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <sstream>
+
+#include "functions.h"
+#include "scanner.h"
+
+namespace {
+	/*
+		An UNWIND_INFO starts with its version and flags, the size of the
+		prolog, and the number of unwind codes. Chained info is a
+		RUNTIME_FUNCTION that follows the codes, which are padded to an even
+		count. An unwind rva with its lowest bit set points directly at
+		another RUNTIME_FUNCTION instead.
+	*/
+	const uint8_t unw_flag_chaininfo = 0x4;
+	const size_t unwind_codes = 4, unwind_code = 2;
+	const size_t runtime_function = 3 * sizeof(uint32_t);
+
+	// chains are short, so anything longer than this is treated as corrupt
+	const size_t maximum_chain = 32;
+
+	uint32_t
+	primary(const pe::View& image, uint32_t begin, uint32_t unwind)
+	{
+		for (size_t i = 0; i < maximum_chain; i++) {
+			uint32_t entry;
+			if (unwind & 1)
+				entry = unwind & ~1u;
+			else {
+				auto header = image.read<uint8_t>(unwind);
+				if (!((header >> 3) & unw_flag_chaininfo))
+					return begin;
+				auto count = image.read<uint8_t>(unwind + 2);
+				entry = unwind + static_cast<uint32_t>(unwind_codes + ((count + 1u) & ~1u) * unwind_code);
+			}
+			begin = image.read<uint32_t>(entry);
+			unwind = image.read<uint32_t>(entry + 2 * sizeof(uint32_t));
+		}
+		return begin;
+	}
+}
+
+/** pdata */
+std::vector<pdata::Function>
+pdata::parse(const pe::View& image)
+{
+	std::vector<Function> res;
+
+	uint32_t rva, size;
+	if (!image.wide() || !image.directory(pe::directory_exception, rva, size))
+		return res;
+
+	auto count = size / runtime_function;
+	image.offset(rva, count * runtime_function);
+	res.reserve(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		auto entry = rva + i * static_cast<uint32_t>(runtime_function);
+		Function item = { image.read<uint32_t>(entry), image.read<uint32_t>(entry + 4), image.read<uint32_t>(entry + 8), 0 };
+		if (item.begin >= item.end)
+			continue;
+
+		// unwind info that can't be read only loses the chain, not the entry
+		try {
+			item.primary = primary(image, item.begin, item.unwind);
+		}
+		catch (const std::out_of_range&) {
+			item.primary = item.begin;
+		}
+		res.push_back(item);
+	}
+
+	// the table is supposed to be sorted already, but that's not something to depend on
+	if (!std::is_sorted(res.begin(), res.end()))
+		std::sort(res.begin(), res.end());
+	return res;
+}
+
+/** FunctionTable */
+size_t
+FunctionTable::refresh(const std::vector<Module>& modules, unsigned long generation)
+{
+	std::vector<Image> known;
+	{
+		ReadLock lock(m_lock);
+		known = m_images;
+	}
+
+	// an image that's at the same place with the same size doesn't need to be parsed again
+	std::vector<Image> images;
+	for (auto& module : modules) {
+		Image image = { module.base, module.size, {} };
+		auto it = std::lower_bound(known.begin(), known.end(), module.base, [](const Image& image, uintptr_t ea) { return image.base < ea; });
+		if (it != known.end() && it->base == image.base && it->size == image.size)
+			image.functions.swap(it->functions);
+		else {
+			try {
+				image.functions = pdata::parse(pe::View(reinterpret_cast<const void*>(module.base), module.size, true));
+			}
+			catch (...) {
+				image.functions.clear();
+			}
+		}
+		if (!image.functions.empty())
+			images.push_back(std::move(image));
+	}
+
+	auto res = assign(std::move(images));
+
+	WriteLock lock(m_lock);
+	m_source = generation;
+	return res;
+}
+
+size_t
+FunctionTable::assign(std::vector<Image> images)
+{
+	std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) { return a.base < b.base; });
+	for (auto& image : images)
+		if (!std::is_sorted(image.functions.begin(), image.functions.end()))
+			std::sort(image.functions.begin(), image.functions.end());
+
+	WriteLock lock(m_lock);
+	m_images.swap(images);
+	return m_images.size();
+}
+
+unsigned long
+FunctionTable::source() const
+{
+	ReadLock lock(m_lock);
+	return m_source;
+}
+
+bool
+FunctionTable::find(uintptr_t ea, Range& result) const
+{
+	ReadLock lock(m_lock);
+
+	auto image = std::upper_bound(m_images.begin(), m_images.end(), ea, [](uintptr_t ea, const Image& image) { return ea < image.base; });
+	if (image == m_images.begin() || !(--image)->contains(ea))
+		return false;
+
+	// the entries don't overlap, so only the last one that begins at or before the address can contain it
+	auto rva = static_cast<uint32_t>(ea - image->base);
+	auto item = std::upper_bound(image->functions.begin(), image->functions.end(), rva, [](uint32_t rva, const pdata::Function& item) { return rva < item.begin; });
+	if (item == image->functions.begin() || !(--item)->contains(rva))
+		return false;
+
+	result.begin = image->base + item->begin;
+	result.end = image->base + item->end;
+	result.unwind = image->base + item->unwind;
+	result.primary = image->base + item->primary;
+	return true;
+}
+
+bool
+FunctionTable::function(uintptr_t ea, Range& result) const
+{
+	if (!find(ea, result))
+		return false;
+	return result.primary == result.begin || find(result.primary, result);
+}
+
+/*
+	A range is written as the bounds of its entry, its unwind info, and the
+	beginning of the function that it's a part of. Each of them is in hex.
+
+		00007ff812341000 00007ff812341080 00007ff812345678 00007ff812341000
+*/
+std::string
+FunctionTable::format(const Range& range)
+{
+	std::ostringstream os;
+	os << scan::format(range.begin) << " " << scan::format(range.end) << " " << scan::format(range.unwind) << " " << scan::format(range.primary);
+	return os.str();
+}
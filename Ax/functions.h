@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "pe.h"
+#include "regions.h"
+#include "threading.h"
+
+/** the exception directory (.pdata) of an x64 image, which describes the bounds of every function that isn't a leaf */
+namespace pdata {
+	/* type-definitions */
+	struct Function {
+		uint32_t begin;		// RUNTIME_FUNCTION
+		uint32_t end;
+		uint32_t unwind;
+		uint32_t primary;	// the begin of the function that this is chained to, or its own begin
+
+		bool contains(uint32_t rva) const { return begin <= rva && rva < end; }
+		bool operator<(const Function& other) const { return begin < other.begin; }
+	};
+
+	// Read the table sorted by address. A PE32 image doesn't have one, so its table is empty.
+	std::vector<Function> parse(const pe::View& image);		// throws std::out_of_range
+}
+
+/** index of the functions in every loaded module */
+class FunctionTable {
+public:
+	/* type-definitions */
+	struct Image {
+		uintptr_t base;
+		size_t size;
+		std::vector<pdata::Function> functions;		// sorted by begin
+
+		bool contains(uintptr_t ea) const { return base <= ea && ea - base < size; }
+	};
+
+	// a function with each of its addresses relocated to where its module is loaded
+	struct Range {
+		uintptr_t begin, end;
+		uintptr_t unwind;
+		uintptr_t primary;
+	};
+
+private:
+	/* private members */
+	mutable ReadWriteLock m_lock;
+	std::vector<Image> m_images;	// sorted by base address
+	unsigned long m_source;
+
+public:
+	/* scoping methods */
+	FunctionTable() : m_source(0) {}
+	~FunctionTable() {}
+
+	/* methods */
+	size_t refresh(const std::vector<Module>& modules, unsigned long generation);
+	size_t assign(std::vector<Image> images);
+	unsigned long source() const;
+
+	bool find(uintptr_t ea, Range& result) const;
+
+	// The entry that a chained entry belongs to, which is the whole function.
+	bool function(uintptr_t ea, Range& result) const;
+
+	static std::string format(const Range& range);
+};
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include "heaps.h"
+#include "scanner.h"
+
+namespace {
+	const uint32_t signature_nt = 0xffeeffee;		// SegmentSignature of a _HEAP_SEGMENT
+	const uint32_t signature_segment = 0xddeeddee;	// Signature of a _SEGMENT_HEAP
+	const size_t maximum_segments = 0x1000;
+
+	/*
+		The fields that are needed from the environment block, _HEAP,
+		_HEAP_SEGMENT, and _HEAP_ENTRY. These have stayed put since Windows 7,
+		unlike the heap's own list of segments, which is why the segments are
+		found through the ring of their SegmentListEntry instead.
+	*/
+	struct Layout {
+		size_t peb_count, peb_heaps;
+		size_t signature, segments, first, lastvalid, ucrs;
+		size_t mask, encoding;
+		size_t entry, granularity;
+		size_t size, flags, checksum, unused;
+	};
+
+	const Layout layout64 = {
+		0xe8, 0xf0,
+		0x10, 0x18, 0x40, 0x48, 0x60,
+		0x7c, 0x80,
+		0x10, 0x10,
+		0x08, 0x0a, 0x0b, 0x0f,
+	};
+
+	const Layout layout32 = {
+		0x88, 0x90,
+		0x08, 0x10, 0x24, 0x28, 0x38,
+		0x4c, 0x50,
+		0x08, 0x08,
+		0x00, 0x02, 0x03, 0x07,
+	};
+
+	/*
+		Memory is copied from the backend several pages at a time, and then
+		each field is read out of those copies. A page that couldn't be read
+		is remembered as empty so that it isn't asked for again.
+	*/
+	class Pages {
+	private:
+		static const uint64_t pagesize = 0x1000, granularity = 0x10000;
+		static const size_t run = 16, capacity = 0x400;
+
+		trace::Backend& m_backend;
+		std::map<uint64_t, std::vector<uint8_t>> m_pages;
+
+		const std::vector<uint8_t>&
+		page(uint64_t base)
+		{
+			auto it = m_pages.find(base);
+			if (it != m_pages.end())
+				return it->second;
+			if (m_pages.size() >= capacity)
+				m_pages.clear();
+
+			// read ahead up to the next page that we already have, but never past the allocation
+			// granularity so that it can't wander into an unrelated allocation (such as a guard page)
+			std::vector<uint8_t> buffer(run * pagesize);
+			const uint64_t stop = base - base % granularity + granularity;
+			size_t count = 1;
+			while (count < run && base + count * pagesize < stop && m_pages.find(base + count * pagesize) == m_pages.end())
+				count++;
+			auto n = m_backend.read(base, buffer.data(), count * pagesize);
+
+			for (size_t i = 0; i < count; i++) {
+				auto& result = m_pages[base + i * pagesize];
+				auto offset = i * pagesize;
+				if (offset < n)
+					result.assign(buffer.begin() + offset, buffer.begin() + offset + (std::min)(static_cast<size_t>(pagesize), n - offset));
+				if (offset + pagesize > n)
+					break;
+			}
+			return m_pages[base];
+		}
+
+	public:
+		Pages(trace::Backend& backend) : m_backend(backend) {}
+
+		bool
+		read(uint64_t address, void* buffer, size_t size)
+		{
+			auto out = static_cast<uint8_t*>(buffer);
+			for (size_t res = 0; res < size; ) {
+				auto ea = address + res;
+				auto& bytes = page(ea - ea % pagesize);
+				auto offset = static_cast<size_t>(ea % pagesize);
+				if (offset >= bytes.size())
+					return false;
+				auto count = (std::min)(size - res, bytes.size() - offset);
+				memcpy(out + res, bytes.data() + offset, count);
+				res += count;
+			}
+			return true;
+		}
+
+		template<typename T> bool
+		value(uint64_t address, T& result)
+		{
+			return read(address, &result, sizeof(result));
+		}
+
+		bool
+		pointer(uint64_t address, size_t width, uint64_t& result)
+		{
+			if (width == sizeof(uint64_t))
+				return value(address, result);
+
+			uint32_t res;
+			if (!value(address, res))
+				return false;
+			result = res;
+			return true;
+		}
+	};
+
+	struct Range {
+		uint64_t start, stop;
+	};
+
+	/* the uncommitted ranges of a segment, from the descriptors linked through their SegmentEntry */
+	std::vector<Range>
+	uncommitted(Pages& pages, uint64_t segment, const Layout& layout, size_t width)
+	{
+		std::vector<Range> res;
+		const uint64_t head = segment + layout.ucrs;
+
+		uint64_t node;
+		if (!pages.pointer(head, width, node))
+			return res;
+		for (size_t i = 0; node != head && i < maximum_segments; i++) {
+			uint64_t address, size;
+			if (!pages.pointer(node + 2 * width, width, address) || !pages.pointer(node + 3 * width, width, size))
+				break;
+			res.push_back({ address, address + size });
+			if (!pages.pointer(node, width, node))
+				break;
+		}
+		std::sort(res.begin(), res.end(), [](const Range& a, const Range& b) { return a.start < b.start; });
+		return res;
+	}
+
+	/* walk the entries of a segment, and return false if one of them didn't decode */
+	bool
+	entries(Pages& pages, uint64_t segment, const Layout& layout, size_t width, const std::vector<uint8_t>& encoding, size_t limit, std::vector<heaps::Entry>& result)
+	{
+		uint64_t ea, stop;
+		if (!pages.pointer(segment + layout.first, width, ea) || !pages.pointer(segment + layout.lastvalid, width, stop))
+			return false;
+
+		auto ranges = uncommitted(pages, segment, layout, width);
+		auto range = ranges.begin();
+		std::vector<uint8_t> header(layout.entry);
+
+		while (ea < stop && (!limit || result.size() < limit)) {
+			while (range != ranges.end() && range->stop <= ea)
+				++range;
+			if (range != ranges.end() && range->start <= ea) {
+				ea = range->stop;
+				continue;
+			}
+
+			if (!pages.read(ea, header.data(), header.size()))
+				return false;
+			for (size_t i = 0; i < header.size(); i++)
+				header[i] ^= encoding[i];
+
+			// the checksum is the xor of the size and flags
+			auto p = header.data() + layout.size;
+			if ((p[0] ^ p[1] ^ p[2]) != header[layout.checksum])
+				return false;
+
+			uint16_t size;
+			memcpy(&size, header.data() + layout.size, sizeof(size));
+			if (!size)
+				return false;
+
+			heaps::Entry entry = { ea, static_cast<uint64_t>(size) * layout.granularity, header[layout.flags], header[layout.unused] };
+			result.push_back(entry);
+			ea += entry.size;
+		}
+		return true;
+	}
+}
+
+/** utilities */
+namespace heaps {
+	const char*
+	name(kind_t kind)
+	{
+		switch (kind) {
+		case nt: return "nt";
+		case segment: return "segment";
+		default: return "invalid";
+		}
+	}
+
+	std::vector<uint64_t>
+	process(trace::Backend& backend, uint64_t peb, size_t width)
+	{
+		auto& layout = (width == sizeof(uint64_t)) ? layout64 : layout32;
+		Pages pages(backend);
+		std::vector<uint64_t> res;
+
+		uint32_t count;
+		uint64_t list;
+		if (!pages.value(peb + layout.peb_count, count) || !pages.pointer(peb + layout.peb_heaps, width, list))
+			return res;
+
+		for (uint32_t i = 0; i < count && i < maximum_segments; i++) {
+			uint64_t heap;
+			if (!pages.pointer(list + i * width, width, heap))
+				break;
+			res.push_back(heap);
+		}
+		return res;
+	}
+
+	/*
+		A heap is also its own first segment, and every segment is linked
+		into a ring through its SegmentListEntry that includes the list head
+		in the heap. The list head is the one member that doesn't have the
+		segment signature, so it's skipped.
+	*/
+	Heap
+	walk(trace::Backend& backend, uint64_t address, size_t width, size_t limit)
+	{
+		auto& layout = (width == sizeof(uint64_t)) ? layout64 : layout32;
+		Pages pages(backend);
+		Heap res = { address, invalid, 0, false, {} };
+
+		uint32_t signature;
+		if (!pages.value(address + layout.signature, signature))
+			return res;
+		if (signature == signature_segment)
+			res.kind = segment;
+		if (signature != signature_nt)
+			return res;
+		res.kind = nt;
+
+		// the headers are only encoded when the mask is set
+		uint32_t mask;
+		std::vector<uint8_t> encoding(layout.entry, 0);
+		if (!pages.value(address + layout.mask, mask) || (mask && !pages.read(address + layout.encoding, encoding.data(), encoding.size()))) {
+			res.corrupt = true;
+			return res;
+		}
+
+		const uint64_t head = address + layout.segments;
+		uint64_t node = head;
+		do {
+			auto segment = node - layout.segments;
+			if (pages.value(segment + layout.signature, signature) && signature == signature_nt) {
+				res.segments++;
+				if (!entries(pages, segment, layout, width, encoding, limit, res.entries))
+					res.corrupt = true;
+			}
+			if (!pages.pointer(node, width, node)) {
+				res.corrupt = true;
+				break;
+			}
+		} while (node != head && res.segments < maximum_segments && (!limit || res.entries.size() < limit));
+		return res;
+	}
+
+	std::string
+	format(const Heap& heap)
+	{
+		std::ostringstream os;
+		os << "heap " << scan::format(static_cast<uintptr_t>(heap.address)) << " " << name(heap.kind) << " " << std::dec << heap.segments << " " << heap.entries.size();
+		if (heap.corrupt)
+			os << " corrupt";
+		os << "\n";
+
+		static const char digits[] = "0123456789abcdef";
+		for (auto& entry : heap.entries) {
+			os << scan::format(static_cast<uintptr_t>(entry.address)) << " " << std::hex << entry.size << " ";
+			os << digits[entry.flags >> 4] << digits[entry.flags & 0xf] << "\n";
+		}
+		return os.str();
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+/** walking the segments and entries of an NT heap */
+namespace heaps {
+	/* type-definitions */
+	enum kind_t : uint8_t {
+		invalid,
+		nt,			// the original heap, with a list of segments that are carved into entries
+		segment,	// the segment heap, which isn't walked
+	};
+
+	// the flags of a decoded _HEAP_ENTRY
+	enum flags_t : uint8_t {
+		busy = 0x01,
+		extra = 0x02,
+		fill = 0x04,
+		virtualalloc = 0x08,
+		last = 0x10,
+	};
+
+	struct Entry {
+		uint64_t address;		// of the header
+		uint64_t size;			// including the header
+		uint8_t flags;
+		uint8_t unused;			// UnusedBytes
+	};
+
+	struct Heap {
+		uint64_t address;
+		kind_t kind;
+		size_t segments;
+		bool corrupt;			// the walk stopped at a header that didn't decode
+		std::vector<Entry> entries;
+	};
+
+	/* utilities */
+	const char* name(kind_t kind);
+
+	// The heaps in the ProcessHeaps list of the environment block at `peb`.
+	std::vector<uint64_t> process(trace::Backend& backend, uint64_t peb, size_t width);
+
+	/*
+		Walk every segment of the heap at `address` and decode each of its
+		entries with the heap's encoding. Uncommitted ranges are skipped, and
+		at most `limit` entries are returned if it's not 0. `width` is the
+		size of a pointer in the process that owns the heap.
+	*/
+	Heap walk(trace::Backend& backend, uint64_t address, size_t width, size_t limit);
+
+	/*
+		A heap is a line with its address, kind, number of segments, and
+		number of entries, followed by "corrupt" if the walk was cut short.
+		Each entry follows as a line with its address, size, and flags.
+
+			heap 000001d2a3b40000 nt 1 3
+			000001d2a3b40740 30 01
+			000001d2a3b40770 120 01
+			000001d2a3b40890 f770 00
+	*/
+	std::string format(const Heap& heap);
+}
@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#include "instructions.h"
+#include "scanner.h"
+
+namespace {
+	const size_t block = 0x1000;		// the rows that are tested together, so that their selection stays in the cache
+
+	/* a capstone handle that's closed when it goes out of scope */
+	class Handle {
+	public:
+		csh handle;
+
+		Handle(cs_mode mode)
+		{
+			auto err = cs_open(CS_ARCH_X86, mode, &handle);
+			if (err != CS_ERR_OK)
+				throw std::invalid_argument(cs_strerror(err));
+		}
+		~Handle() { cs_close(&handle); }
+	};
+
+	/* the ids of every mnemonic and register by name, which are the same in every mode */
+	struct Names {
+		std::map<std::string, uint16_t> mnemonics;
+		std::map<std::string, uint8_t> registers;
+
+		Names()
+		{
+			Handle h(CS_MODE_64);
+			for (unsigned id = 1; id < X86_INS_ENDING; id++) {
+				auto name = cs_insn_name(h.handle, id);
+				if (name)
+					mnemonics.emplace(name, static_cast<uint16_t>(id));
+			}
+			for (unsigned id = 1; id < X86_REG_ENDING && id <= UINT8_MAX; id++) {
+				auto name = cs_reg_name(h.handle, id);
+				if (name)
+					registers.emplace(name, static_cast<uint8_t>(id));
+			}
+		}
+	};
+
+	const Names&
+	names()
+	{
+		static const Names res;
+		return res;
+	}
+
+	/* the row for an instruction that was decoded with its details */
+	instructions::Row
+	decode(csh handle, const cs_insn* insn)
+	{
+		instructions::Row res = { static_cast<uintptr_t>(insn->address), static_cast<uint8_t>(insn->size), static_cast<uint16_t>(insn->id), 0, 0, 0, 0, 0 };
+		auto& x86 = insn->detail->x86;
+
+		for (uint8_t i = 0; i < x86.op_count; i++) {
+			auto& op = x86.operands[i];
+			auto kind = (op.type == X86_OP_REG) ? instructions::reg : (op.type == X86_OP_IMM) ? instructions::imm : (op.type == X86_OP_MEM) ? instructions::mem : instructions::none;
+			if (i < instructions::operands)
+				res.kinds |= kind << (2 * i);
+
+			if (kind == instructions::mem && !(res.flags & instructions::memory)) {
+				res.flags |= instructions::memory;
+				res.base = static_cast<uint8_t>(op.mem.base);
+				res.displacement = op.mem.disp;
+			}
+			else if (kind == instructions::imm && !(res.flags & instructions::immediate)) {
+				res.flags |= instructions::immediate;
+				res.value = op.imm;
+			}
+		}
+
+		if (cs_insn_group(handle, insn, CS_GRP_JUMP))
+			res.flags |= instructions::jump;
+		if (cs_insn_group(handle, insn, CS_GRP_CALL))
+			res.flags |= instructions::call;
+		if (cs_insn_group(handle, insn, CS_GRP_RET))
+			res.flags |= instructions::ret;
+		if (cs_insn_group(handle, insn, CS_GRP_INT))
+			res.flags |= instructions::interrupt;
+
+		// a branch is relative or indirect depending on how its destination is given
+		if ((res.flags & (instructions::jump | instructions::call)) && x86.op_count)
+			res.flags |= (x86.operands[0].type == X86_OP_IMM) ? instructions::relative : instructions::indirect;
+		return res;
+	}
+
+	/* clear each row of the block whose value in the column fails the test */
+	template<typename T, typename F> void
+	narrow(uint8_t* selected, const T* column, size_t count, F test)
+	{
+		for (size_t i = 0; i < count; i++)
+			selected[i] &= static_cast<uint8_t>(test(column[i]));
+	}
+
+	int64_t
+	number(const std::string& text)
+	{
+		auto negative = !text.empty() && text[0] == '-';
+		auto digits = text.substr(negative ? 1 : 0);
+		auto hex = digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X');
+		if (hex)
+			digits = digits.substr(2);
+		if (digits.empty() || digits.find_first_not_of(hex ? "0123456789abcdefABCDEF" : "0123456789") != std::string::npos)
+			throw std::invalid_argument(text);
+
+		auto res = static_cast<int64_t>(std::stoull(digits, nullptr, hex ? 16 : 10));
+		return negative ? -res : res;
+	}
+}
+
+/** Index */
+namespace instructions {
+	void
+	Index::append(const Row& row)
+	{
+		m_offsets.push_back(static_cast<uint32_t>(row.address - m_base));
+		m_lengths.push_back(row.length);
+		m_mnemonics.push_back(row.mnemonic);
+		m_kinds.push_back(row.kinds);
+		m_flags.push_back(row.flags);
+		m_bases.push_back(row.base);
+		m_displacements.push_back(row.displacement);
+		m_values.push_back(row.value);
+	}
+
+	void
+	Index::shrink()
+	{
+		m_offsets.shrink_to_fit();
+		m_lengths.shrink_to_fit();
+		m_mnemonics.shrink_to_fit();
+		m_kinds.shrink_to_fit();
+		m_flags.shrink_to_fit();
+		m_bases.shrink_to_fit();
+		m_displacements.shrink_to_fit();
+		m_values.shrink_to_fit();
+	}
+
+	size_t
+	Index::footprint() const
+	{
+		return sizeof(*this)
+			+ m_offsets.capacity() * sizeof(uint32_t)
+			+ (m_lengths.capacity() + m_kinds.capacity() + m_flags.capacity() + m_bases.capacity()) * sizeof(uint8_t)
+			+ m_mnemonics.capacity() * sizeof(uint16_t)
+			+ (m_displacements.capacity() + m_values.capacity()) * sizeof(int64_t);
+	}
+
+	Row
+	Index::row(size_t index) const
+	{
+		Row res = { m_base + m_offsets[index], m_lengths[index], m_mnemonics[index], m_kinds[index], m_flags[index], m_bases[index], m_displacements[index], m_values[index] };
+		return res;
+	}
+
+	/*
+		Each block starts with every row selected, and then each of the
+		query's tests clears the rows that fail it one column at a time.
+		The tests don't branch on the rows, so every one of them is a loop
+		that can be vectorized.
+	*/
+	std::vector<size_t>
+	Index::find(const Query& query, size_t limit) const
+	{
+		std::vector<size_t> res;
+		uint8_t selected[block];
+
+		for (size_t start = 0; start < size(); start += block) {
+			auto count = (std::min)(block, size() - start);
+			memset(selected, 1, count);
+
+			if (query.mnemonic) {
+				auto mnemonic = query.mnemonic;
+				narrow(selected, m_mnemonics.data() + start, count, [mnemonic](uint16_t v) { return v == mnemonic; });
+			}
+			if (query.mask) {
+				auto kinds = query.kinds, mask = query.mask;
+				narrow(selected, m_kinds.data() + start, count, [kinds, mask](uint8_t v) { return (v & mask) == kinds; });
+			}
+			if (query.flags) {
+				auto flags = query.flags;
+				narrow(selected, m_flags.data() + start, count, [flags](uint8_t v) { return (v & flags) == flags; });
+			}
+			if (query.base) {
+				auto base = query.base;
+				narrow(selected, m_bases.data() + start, count, [base](uint8_t v) { return v == base; });
+			}
+			if (query.displaced) {
+				auto displacement = query.displacement;
+				narrow(selected, m_displacements.data() + start, count, [displacement](int64_t v) { return v == displacement; });
+			}
+			if (query.valued) {
+				auto value = query.value;
+				narrow(selected, m_values.data() + start, count, [value](int64_t v) { return v == value; });
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				if (!selected[i])
+					continue;
+				res.push_back(start + i);
+				if (limit && res.size() >= limit)
+					return res;
+			}
+		}
+		return res;
+	}
+}
+
+/** utilities */
+namespace instructions {
+	/*
+		Each region is decoded straight out of memory, and a region that
+		faults partway through keeps whatever was decoded before the fault.
+	*/
+	Index
+	build(uintptr_t base, const std::vector<Region>& regions, cs_mode mode)
+	{
+		Index res(base);
+		Handle h(mode);
+
+		auto err = cs_option(h.handle, CS_OPT_DETAIL, CS_OPT_ON);
+		if (err != CS_ERR_OK)
+			throw std::invalid_argument(cs_strerror(err));
+
+		std::unique_ptr<cs_insn, void(*)(cs_insn*)> insn(cs_malloc(h.handle), [](cs_insn* p) { cs_free(p, 1); });
+		for (auto& region : regions) {
+			const uint8_t* p = reinterpret_cast<const uint8_t*>(region.base);
+			size_t size = region.size;
+			uint64_t address = region.base;
+
+			while (size > 0) {
+				bool decoded;
+				try {
+					decoded = cs_disasm_iter(h.handle, &p, &size, &address, insn.get());
+				}
+				catch (...) {
+					break;
+				}
+
+				// resynchronize on the next byte after one that doesn't decode
+				if (!decoded) {
+					p++, size--, address++;
+					continue;
+				}
+				res.append(decode(h.handle, insn.get()));
+			}
+		}
+		res.shrink();
+		return res;
+	}
+
+	Query
+	parse(const std::string& text)
+	{
+		static const std::map<std::string, uint8_t> flags = {
+			{ "jump", jump }, { "call", call }, { "ret", ret }, { "interrupt", interrupt },
+			{ "relative", relative }, { "indirect", indirect }, { "memory", memory }, { "immediate", immediate },
+		};
+		static const std::map<std::string, operand_t> kinds = {
+			{ "none", none }, { "reg", reg }, { "imm", imm }, { "mem", mem },
+		};
+		auto& table = names();
+
+		Query res = { 0, 0, 0, 0, 0, false, false, 0, 0 };
+		std::istringstream is(text);
+		std::string term;
+
+		while (is >> term) {
+			std::transform(term.begin(), term.end(), term.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+			auto separator = term.find('=');
+
+			if (separator == std::string::npos) {
+				auto flag = flags.find(term);
+				auto mnemonic = table.mnemonics.find(term);
+				if (flag != flags.end())
+					res.flags |= flag->second;
+				else if (mnemonic != table.mnemonics.end())
+					res.mnemonic = mnemonic->second;
+				else
+					throw std::invalid_argument(term);
+				continue;
+			}
+
+			auto key = term.substr(0, separator), value = term.substr(separator + 1);
+			if (key == "ops") {
+				// the operands that are listed are compared along with the ones after them, which have to be absent
+				std::istringstream items(value);
+				std::string item;
+				res.kinds = res.mask = 0;
+				for (size_t i = 0; i < operands; i++) {
+					if (!std::getline(items, item, ','))
+						item = "none";
+					if (item == "*")
+						continue;
+					auto kind = kinds.find(item);
+					if (kind == kinds.end())
+						throw std::invalid_argument(item);
+					res.kinds |= kind->second << (2 * i);
+					res.mask |= 3 << (2 * i);
+				}
+				if (std::getline(items, item, ','))
+					throw std::invalid_argument(value);
+			}
+			else if (key == "disp") {
+				res.displaced = true;
+				res.displacement = number(value);
+				res.flags |= memory;
+			}
+			else if (key == "imm") {
+				res.valued = true;
+				res.value = number(value);
+				res.flags |= immediate;
+			}
+			else if (key == "base") {
+				auto base = table.registers.find(value);
+				if (base == table.registers.end())
+					throw std::invalid_argument(value);
+				res.base = base->second;
+				res.flags |= memory;
+			}
+			else
+				throw std::invalid_argument(key);
+		}
+		return res;
+	}
+
+	std::string
+	format(const Index& index, const std::vector<size_t>& matches)
+	{
+		std::ostringstream os;
+		os << "index " << scan::format(index.base()) << " " << std::dec << index.size() << " " << index.footprint() << "\n";
+		for (auto item : matches) {
+			auto row = index.row(item);
+			os << scan::format(row.address) << " " << std::dec << static_cast<unsigned>(row.length) << "\n";
+		}
+		return os.str();
+	}
+}
+
+/** Cache */
+namespace instructions {
+	bool
+	Cache::find(const Module& module, cs_mode mode, std::shared_ptr<const Index>& result) const
+	{
+		ReadLock lock(m_lock);
+		auto it = m_entries.find(module.base);
+		if (it == m_entries.end())
+			return false;
+
+		auto& entry = it->second;
+		if (entry.module.size != module.size || entry.module.path != module.path || entry.mode != mode)
+			return false;
+		result = entry.index;
+		return true;
+	}
+
+	void
+	Cache::assign(const Module& module, cs_mode mode, std::shared_ptr<const Index> index)
+	{
+		Entry entry = { module, mode, std::move(index) };
+
+		WriteLock lock(m_lock);
+		m_entries[module.base] = std::move(entry);
+	}
+
+	size_t
+	Cache::retain(const std::vector<Module>& modules)
+	{
+		WriteLock lock(m_lock);
+		for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+			auto& entry = it->second;
+			auto found = std::find_if(modules.begin(), modules.end(), [&entry](const Module& module) {
+				return module.base == entry.module.base && module.size == entry.module.size && module.path == entry.module.path;
+			});
+			it = (found == modules.end()) ? m_entries.erase(it) : std::next(it);
+		}
+		return m_entries.size();
+	}
+
+	size_t
+	Cache::size() const
+	{
+		ReadLock lock(m_lock);
+		return m_entries.size();
+	}
+}
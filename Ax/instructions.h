@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <capstone.h>
+
+#include "regions.h"
+#include "threading.h"
+
+/** an index of the decoded instructions of a module that can be queried without disassembling it again */
+namespace instructions {
+	/* type-definitions */
+	const size_t operands = 4;		// the operands whose kinds are kept
+
+	// the kind of each operand, packed two bits apiece with the first operand in the lowest bits
+	enum operand_t : uint8_t {
+		none,
+		reg,
+		imm,
+		mem,
+	};
+
+	enum flags_t : uint8_t {
+		jump = 0x01,
+		call = 0x02,
+		ret = 0x04,
+		interrupt = 0x08,
+		relative = 0x10,	// a jump or call whose destination is an immediate
+		indirect = 0x20,	// a jump or call through a register or memory
+		memory = 0x40,		// has a memory operand, which the base and displacement are taken from
+		immediate = 0x80,	// has an immediate operand
+	};
+
+	// a decoded instruction, which is only used on the way in and out of the index
+	struct Row {
+		uintptr_t address;
+		uint8_t length;
+		uint16_t mnemonic;		// capstone's instruction id
+		uint8_t kinds;
+		uint8_t flags;
+		uint8_t base;			// register of the first memory operand
+		int64_t displacement;	// of the first memory operand
+		int64_t value;			// of the first immediate operand
+	};
+
+	/*
+		Every field that's tested is optional. The mnemonic and the base are
+		unused when 0 (which is capstone's invalid id), and the operand kinds
+		are only compared for the operands that are set in `mask`.
+	*/
+	struct Query {
+		uint16_t mnemonic;
+		uint8_t kinds, mask;
+		uint8_t flags;			// every one of these has to be set
+		uint8_t base;
+		bool displaced, valued;
+		int64_t displacement, value;
+	};
+
+	/*
+		The instructions are stored as columns rather than as rows so that a
+		query only reads the fields that it tests, and so that each test is a
+		loop over a contiguous array that the compiler can vectorize.
+	*/
+	class Index {
+	private:
+		uintptr_t m_base;
+		std::vector<uint32_t> m_offsets;		// from the base, in ascending order
+		std::vector<uint8_t> m_lengths;
+		std::vector<uint16_t> m_mnemonics;
+		std::vector<uint8_t> m_kinds, m_flags, m_bases;
+		std::vector<int64_t> m_displacements, m_values;
+
+	public:
+		Index(uintptr_t base) : m_base(base) {}
+
+		void append(const Row& row);
+		void shrink();
+
+		uintptr_t base() const { return m_base; }
+		size_t size() const { return m_offsets.size(); }
+		size_t footprint() const;		// in bytes
+		Row row(size_t index) const;
+
+		// The indices of the rows that match, stopping after `limit` of them if it's not 0.
+		std::vector<size_t> find(const Query& query, size_t limit) const;
+	};
+
+	/* utilities */
+
+	// Decode every region of the module at `base` with `mode`, skipping over any bytes that don't decode.
+	Index build(uintptr_t base, const std::vector<Region>& regions, cs_mode mode);
+
+	/*
+		A query is a list of terms separated by spaces, where each is either
+		a mnemonic, a flag, or a field with its value. The operands are
+		listed in order with "*" for any kind, and the ones that aren't
+		listed have to be absent. Numbers are in hex when they start with
+		"0x", and throw std::invalid_argument when they (or anything else)
+		can't be parsed. A flag is matched before a mnemonic of the same
+		name, so "call" is every kind of call.
+
+			mov ops=reg,mem disp=0x1c8
+			imm=0x4d5a
+			call indirect
+			base=rbp ops=mem,*
+	*/
+	Query parse(const std::string& text);
+
+	/*
+		The index is a line with its base, its number of instructions, and
+		how many bytes it occupies. Each match follows as a line with its
+		address and length.
+
+			index 00007ff8a1b40000 41235 1113345
+			00007ff8a1b41034 7
+			00007ff8a1b41290 7
+	*/
+	std::string format(const Index& index, const std::vector<size_t>& matches);
+
+	/* the index of each module, which is reused until the module is unloaded */
+	class Cache {
+	private:
+		struct Entry {
+			Module module;
+			cs_mode mode;
+			std::shared_ptr<const Index> index;
+		};
+
+		mutable ReadWriteLock m_lock;
+		std::map<uintptr_t, Entry> m_entries;
+
+	public:
+		bool find(const Module& module, cs_mode mode, std::shared_ptr<const Index>& result) const;
+		void assign(const Module& module, cs_mode mode, std::shared_ptr<const Index> index);
+
+		// Drop every entry whose module isn't loaded anymore.
+		size_t retain(const std::vector<Module>& modules);
+		size_t size() const;
+	};
+}
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+#include "integrity.h"
+#include "pe.h"
+#include "scanner.h"
+#include "snapshot.h"
+
+namespace {
+	/* call `fn(rva, size, offset)` for each piece of the image's spans that fits within a single page */
+	template<typename F> void
+	pages(const integrity::Image& image, F fn)
+	{
+		for (auto& span : image.spans) {
+			const uint32_t stop = span.rva + span.size;
+			for (uint32_t rva = span.rva; rva < stop; ) {
+				uint32_t next = (std::min)(stop, static_cast<uint32_t>((rva & ~(integrity::pagesize - 1)) + integrity::pagesize));
+				fn(rva, next - rva, span.offset + (rva - span.rva));
+				rva = next;
+			}
+		}
+	}
+
+	/* [start, stop) without whatever overlaps [hole, hole+size) */
+	void
+	exclude(std::vector<integrity::Image::Span>& spans, uint32_t start, uint32_t stop, uint32_t hole, uint32_t size)
+	{
+		const uint32_t end = hole + size;
+		if (!size || end <= start || hole >= stop) {
+			spans.push_back({ start, stop - start, 0 });
+			return;
+		}
+		if (start < hole)
+			spans.push_back({ start, hole - start, 0 });
+		if (end < stop)
+			spans.push_back({ end, stop - end, 0 });
+	}
+}
+
+/** utilities */
+namespace integrity {
+	/*
+		The file is laid out and relocated the way the loader would have done
+		it, and then only the sections within the scope are kept. The import
+		address table is always left out since the loader writes to it.
+	*/
+	Image
+	expected(const std::vector<uint8_t>& file, uintptr_t base, scope_t scope)
+	{
+		Image res;
+		res.base = base;
+
+		auto mapped = pe::map(pe::View(file.data(), file.size(), false));
+		pe::relocate(mapped, base);
+		pe::View view(mapped.data(), mapped.size(), true);
+
+		uint32_t iat, size;
+		if (!view.directory(pe::directory_iat, iat, size))
+			iat = size = 0;
+
+		for (auto& section : view.sections()) {
+			if (section.discardable())
+				continue;
+			if (!section.executable() && (scope != readonly || section.writable()))
+				continue;
+
+			uint32_t extent = section.size ? section.size : section.rawsize;
+			if (section.address >= mapped.size())
+				continue;
+			extent = (std::min)(extent, static_cast<uint32_t>(mapped.size() - section.address));
+			exclude(res.spans, section.address, section.address + extent, iat, size);
+		}
+		std::sort(res.spans.begin(), res.spans.end(), [](const Image::Span& a, const Image::Span& b) { return a.rva < b.rva; });
+
+		for (auto& span : res.spans) {
+			span.offset = res.contents.size();
+			res.contents.insert(res.contents.end(), mapped.begin() + span.rva, mapped.begin() + span.rva + span.size);
+		}
+
+		pages(res, [&res](uint32_t, uint32_t size, size_t offset) {
+			res.hashes.push_back(Snapshot::hash(res.contents.data() + offset, size));
+		});
+		return res;
+	}
+
+	/*
+		Each page is copied out before it's hashed so that a fault only loses
+		that page, and so the bytes that are compared are the ones that were
+		hashed. Bytes between two runs that are being joined are the same in
+		both, so they're taken from the expected image.
+	*/
+	std::vector<Patch>
+	compare(const Image& image, size_t gap, size_t* unreadable)
+	{
+		std::vector<Patch> res;
+		uint8_t actual[pagesize];
+		size_t index = 0, faults = 0;
+		size_t end = 0;		// the offset into the contents that the last patch stops at
+
+		auto append = [](Patch& patch, const uint8_t* expected, const uint8_t* actual, size_t size) {
+			auto count = (std::min)(size, captured - (std::min)(captured, patch.expected.size()));
+			patch.expected.insert(patch.expected.end(), expected, expected + count);
+			patch.actual.insert(patch.actual.end(), actual, actual + count);
+			patch.size += size;
+		};
+
+		pages(image, [&](uint32_t rva, uint32_t size, size_t offset) {
+			auto hash = image.hashes[index++];
+			try {
+				memcpy(actual, reinterpret_cast<const void*>(image.base + rva), size);
+			}
+			catch (...) {
+				faults++;
+				return;
+			}
+			if (Snapshot::hash(actual, size) == hash)
+				return;
+
+			auto expected = image.contents.data() + offset;
+			for (auto& range : Snapshot::compare(expected, actual, size)) {
+				auto start = offset + range.offset;
+				auto address = image.base + rva + range.offset;
+
+				// runs are only joined within a span, where the contents and the addresses are both contiguous
+				if (!res.empty() && start >= end && start - end <= gap && address - res.back().address - res.back().size == start - end) {
+					auto gapped = image.contents.data() + end;
+					append(res.back(), gapped, gapped, start - end);
+				}
+				else {
+					Patch patch = { address, 0, {}, {} };
+					res.push_back(patch);
+				}
+				append(res.back(), expected + range.offset, actual + range.offset, range.size);
+				end = start + range.size;
+			}
+		});
+
+		if (unreadable)
+			*unreadable = faults;
+		return res;
+	}
+
+	std::string
+	format(const Patch& patch, const std::string& module)
+	{
+		std::string res;
+		std::ostringstream os;
+		os << scan::format(patch.address) << " " << std::dec << patch.size << " " << module << " ";
+		res = os.str();
+
+		static const char digits[] = "0123456789abcdef";
+		for (auto bytes : { &patch.expected, &patch.actual }) {
+			if (bytes == &patch.actual)
+				res.push_back(' ');
+			for (auto b : *bytes) {
+				res.push_back(digits[b >> 4]);
+				res.push_back(digits[b & 0xf]);
+			}
+		}
+		return res;
+	}
+}
+
+/** Cache */
+namespace integrity {
+	bool
+	Cache::find(const Module& module, scope_t scope, std::shared_ptr<const Image>& result) const
+	{
+		ReadLock lock(m_lock);
+		auto it = m_entries.find(module.base);
+		if (it == m_entries.end())
+			return false;
+
+		auto& entry = it->second;
+		if (entry.module.size != module.size || entry.module.path != module.path || entry.scope != scope)
+			return false;
+		result = entry.image;
+		return true;
+	}
+
+	void
+	Cache::assign(const Module& module, scope_t scope, std::shared_ptr<const Image> image)
+	{
+		Entry entry = { module, scope, std::move(image) };
+
+		WriteLock lock(m_lock);
+		m_entries[module.base] = std::move(entry);
+	}
+
+	size_t
+	Cache::retain(const std::vector<Module>& modules)
+	{
+		WriteLock lock(m_lock);
+		for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+			auto& entry = it->second;
+			auto found = std::find_if(modules.begin(), modules.end(), [&entry](const Module& module) {
+				return module.base == entry.module.base && module.size == entry.module.size && module.path == entry.module.path;
+			});
+			it = (found == modules.end()) ? m_entries.erase(it) : std::next(it);
+		}
+		return m_entries.size();
+	}
+
+	size_t
+	Cache::size() const
+	{
+		ReadLock lock(m_lock);
+		return m_entries.size();
+	}
+}
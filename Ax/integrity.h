@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "regions.h"
+#include "threading.h"
+
+/** comparing a loaded module against the file that it was loaded from */
+namespace integrity {
+	/* type-definitions */
+	const size_t pagesize = 0x1000;
+	const size_t captured = 64;		// the most bytes of a patch that are kept
+
+	enum scope_t {
+		code,			// the executable sections
+		readonly,		// along with every section that isn't writable, except for the import address table
+	};
+
+	/*
+		What a module should look like once it's been loaded, limited to the
+		sections within the scope. Each page of those sections is hashed so
+		that only the pages whose hashes differ have to be compared.
+	*/
+	struct Image {
+		struct Span {
+			uint32_t rva;
+			uint32_t size;
+			size_t offset;		// into the contents
+		};
+
+		uintptr_t base;
+		std::vector<Span> spans;		// sorted by rva
+		std::vector<uint8_t> contents;
+		std::vector<uint64_t> hashes;	// for each page of the contents
+	};
+
+	struct Patch {
+		uintptr_t address;
+		size_t size;
+		std::vector<uint8_t> expected, actual;		// the first `captured` bytes
+	};
+
+	/* utilities */
+
+	// Build the expected image for the file being loaded at `base`. Throws if the file isn't a PE.
+	Image expected(const std::vector<uint8_t>& file, uintptr_t base, scope_t scope);
+
+	/*
+		Compare the expected image against what's in memory at its base. Each
+		run of changed bytes is a patch, and runs that are closer than `gap`
+		bytes are joined. The pages that can't be read are counted in
+		`unreadable` rather than reported.
+	*/
+	std::vector<Patch> compare(const Image& image, size_t gap, size_t* unreadable);
+
+	// A patch is its address, its size, the module, and then the expected and actual bytes in hex.
+	std::string format(const Patch& patch, const std::string& module);
+
+	/* the expected images of each module, which are reused until the module is unloaded */
+	class Cache {
+	private:
+		struct Entry {
+			Module module;
+			scope_t scope;
+			std::shared_ptr<const Image> image;
+		};
+
+		mutable ReadWriteLock m_lock;
+		std::map<uintptr_t, Entry> m_entries;
+
+	public:
+		bool find(const Module& module, scope_t scope, std::shared_ptr<const Image>& result) const;
+		void assign(const Module& module, scope_t scope, std::shared_ptr<const Image> image);
+
+		// Drop every entry whose module isn't loaded anymore.
+		size_t retain(const std::vector<Module>& modules);
+		size_t size() const;
+	};
+}
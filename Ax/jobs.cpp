@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#include "jobs.h"
+
+/** ThreadPool */
+ThreadPool::ThreadPool(size_t count) : m_stopping(false)
+{
+	if (count == 0)
+		count = std::max(1u, std::thread::hardware_concurrency());
+
+	for (size_t i = 0; i < count; i++)
+		m_workers.emplace_back(&ThreadPool::worker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stopping = true;
+		m_tasks.clear();
+	}
+	m_ready.notify_all();
+
+	for (auto& t : m_workers)
+		t.join();
+}
+
+void
+ThreadPool::submit(task t)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_tasks.push_back(std::move(t));
+	}
+	m_ready.notify_one();
+}
+
+void
+ThreadPool::worker()
+{
+	for (;;) {
+		task t;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_ready.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			if (m_stopping)
+				return;
+
+			t = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		t();
+	}
+}
+
+/** Job */
+void
+Job::run(function f)
+{
+	if (interrupted()) {
+		finish(cancelled);
+		return;
+	}
+
+	m_state = running;
+	try {
+		f(*this);
+	}
+	catch (const std::exception& e) {
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_error = e.what();
+		}
+		finish(failed);
+		return;
+	}
+	catch (...) {
+		finish(failed);
+		return;
+	}
+	finish(interrupted() ? cancelled : finished);
+}
+
+void
+Job::finish(state_t state)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (!m_pending.empty()) {
+			m_chunks.push_back(std::move(m_pending));
+			m_pending.clear();
+		}
+		m_state = state;
+	}
+	m_done.notify_all();
+}
+
+void
+Job::emit(const std::string& record)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_pending.append(record);
+	m_pending.push_back('\n');
+
+	if (m_pending.size() >= m_chunksize) {
+		m_chunks.push_back(std::move(m_pending));
+		m_pending.clear();
+	}
+}
+
+void
+Job::progress(uint64_t done, uint64_t total)
+{
+	m_total = total;
+	m_progress = done;
+}
+
+void
+Job::advance(uint64_t count)
+{
+	m_progress += count;
+}
+
+bool
+Job::next(std::string& chunk)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	// hand out a full chunk if we have one, otherwise whatever partial results have been collected
+	if (!m_chunks.empty()) {
+		chunk = std::move(m_chunks.front());
+		m_chunks.pop_front();
+		return true;
+	}
+
+	chunk.swap(m_pending);
+	m_pending.clear();
+
+	// the stream is only exhausted once the job has completed and nothing is left
+	auto state = m_state.load();
+	return !chunk.empty() || state == pending || state == running;
+}
+
+Job::state_t
+Job::wait(unsigned long milliseconds)
+{
+	std::unique_lock<std::mutex> lock(m_lock);
+	auto complete = [this]() { auto state = m_state.load(); return state != pending && state != running; };
+
+	if (milliseconds == static_cast<unsigned long>(-1))
+		m_done.wait(lock, complete);
+	else
+		m_done.wait_for(lock, std::chrono::milliseconds(milliseconds), complete);
+	return static_cast<state_t>(m_state.load());
+}
+
+double
+Job::fraction() const
+{
+	auto total = m_total.load();
+	if (state() == finished)
+		return 1.0;
+	return total ? static_cast<double>(m_progress.load()) / total : 0.0;
+}
+
+std::string
+Job::error() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_error;
+}
+
+/** Scheduler */
+Scheduler::~Scheduler()
+{
+	cancel();
+}
+
+unsigned long
+Scheduler::submit(Job::function f)
+{
+	auto job = std::make_shared<Job>(m_chunksize);
+	unsigned long res;
+	ThreadPool* pool;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		res = m_next++;
+		m_jobs[res] = job;
+
+		if (!m_pool)
+			m_pool.reset(new ThreadPool(m_workers));
+		pool = m_pool.get();
+	}
+
+	pool->submit([job, f]() { job->run(f); });
+	return res;
+}
+
+std::shared_ptr<Job>
+Scheduler::find(unsigned long handle)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	auto it = m_jobs.find(handle);
+	return (it == m_jobs.end()) ? std::shared_ptr<Job>() : it->second;
+}
+
+bool
+Scheduler::close(unsigned long handle)
+{
+	std::shared_ptr<Job> job;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto it = m_jobs.find(handle);
+		if (it == m_jobs.end())
+			return false;
+		job = it->second;
+		m_jobs.erase(it);
+	}
+
+	// the worker keeps its own reference, so just ask it to stop
+	job->cancel();
+	return true;
+}
+
+void
+Scheduler::cancel()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (auto& item : m_jobs)
+		item.second->cancel();
+}
+
+size_t
+Scheduler::workers() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_pool ? m_pool->size() : 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** a pool of native worker threads */
+class ThreadPool {
+public:
+	/* type-definitions */
+	typedef std::function<void()> task;
+
+private:
+	/* private members */
+	std::mutex m_lock;
+	std::condition_variable m_ready;
+	std::deque<task> m_tasks;
+	std::vector<std::thread> m_workers;
+	bool m_stopping;
+
+	void worker();
+
+public:
+	/* scoping methods */
+	ThreadPool(size_t count = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/* methods */
+	void submit(task t);
+	size_t size() const { return m_workers.size(); }
+};
+
+/** a background operation whose results are streamed in chunks */
+class Job {
+public:
+	/* type-definitions */
+	enum state_t { pending, running, finished, cancelled, failed };
+	typedef std::function<void(Job&)> function;
+
+private:
+	/* private members */
+	mutable std::mutex m_lock;
+	std::condition_variable m_done;
+
+	std::atomic<int> m_state;
+	std::atomic<bool> m_cancel;
+	std::atomic<uint64_t> m_progress, m_total;
+
+	size_t m_chunksize;
+	std::string m_pending;		// records that haven't filled up a chunk yet
+	std::deque<std::string> m_chunks;
+	std::string m_error;
+
+	void finish(state_t state);
+
+public:
+	/* scoping methods */
+	Job(size_t chunksize) : m_state(pending), m_cancel(false), m_progress(0), m_total(0), m_chunksize(chunksize) {}
+	~Job() {}
+
+	/* methods used by the worker */
+	void run(function f);
+	void emit(const std::string& record);
+	void progress(uint64_t done, uint64_t total);
+	void advance(uint64_t count);
+	bool interrupted() const { return m_cancel.load(); }
+
+	/* methods used by the client */
+	void cancel() { m_cancel = true; }
+	bool next(std::string& chunk);
+	state_t wait(unsigned long milliseconds);
+	state_t state() const { return static_cast<state_t>(m_state.load()); }
+	double fraction() const;
+	std::string error() const;
+};
+
+/** tracks the jobs that have been submitted by a client, and only starts its workers once the first one is */
+class Scheduler {
+private:
+	/* private members */
+	mutable std::mutex m_lock;
+	std::map<unsigned long, std::shared_ptr<Job>> m_jobs;
+	unsigned long m_next;
+	size_t m_chunksize, m_workers;
+
+	std::unique_ptr<ThreadPool> m_pool;	// declared last so that it's joined before the job table is destroyed
+
+public:
+	/* scoping methods */
+	Scheduler(size_t workers = 0, size_t chunksize = 0x10000) : m_next(1), m_chunksize(chunksize), m_workers(workers) {}
+	~Scheduler();
+
+	/* methods */
+	unsigned long submit(Job::function f);
+	std::shared_ptr<Job> find(unsigned long handle);
+	bool close(unsigned long handle);
+	void cancel();
+	size_t workers() const;		// the number of threads that have been started
+};
@@ -0,0 +1,34 @@
+#include <algorithm>
+
+#include "parallel.h"
+
+/** utilities */
+namespace parallel {
+	std::vector<Item>
+	shard(const std::vector<Region>& spans, size_t blocksize, size_t overlap)
+	{
+		std::vector<Item> res;
+
+		for (auto& r : spans) {
+			for (size_t offset = 0; offset < r.size; offset += blocksize) {
+				Item item;
+				item.base = r.base + offset;
+				item.size = std::min(blocksize, r.size - offset);
+
+				// the overlap can't extend beyond the end of the span that we came from
+				item.overlap = std::min(overlap, r.size - offset - item.size);
+				item.continued = offset > 0;
+				res.push_back(item);
+			}
+		}
+		return res;
+	}
+
+	size_t
+	workers(size_t requested)
+	{
+		if (requested)
+			return requested;
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "regions.h"
+
+/** region-sharded scanning across a set of work-stealing threads */
+namespace parallel {
+	/*
+		A piece of a span. The overlap is how far a kernel may read past the end
+		to finish a match, and continued is set if the memory right before the
+		item belongs to the same span.
+	*/
+	struct Item {
+		uintptr_t base;
+		size_t size;
+		size_t overlap;
+		bool continued;
+	};
+
+	/* utilities */
+	std::vector<Item> shard(const std::vector<Region>& spans, size_t blocksize, size_t overlap);
+	size_t workers(size_t requested);
+
+	/* the queue of items that belong to a single worker. its owner takes from the front and thieves take from the back. */
+	class Queue {
+	private:
+		std::mutex m_lock;
+		std::deque<size_t> m_items;
+
+	public:
+		void push(size_t index) {
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_items.push_back(index);
+		}
+
+		bool pop(size_t& index) {
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (m_items.empty())
+				return false;
+			index = m_items.front();
+			m_items.pop_front();
+			return true;
+		}
+
+		bool steal(size_t& index) {
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (m_items.empty())
+				return false;
+			index = m_items.back();
+			m_items.pop_back();
+			return true;
+		}
+	};
+
+	/*
+		Run `kernel(item, hits)` for every item using `threads` workers. The hits
+		for each item are handed to `sink(hits)` in item order (and thus in address
+		order), serialized, as soon as every item before it has completed. A kernel
+		that faults contributes no hits for its item.
+	*/
+	template <typename T>
+	void run(const std::vector<Item>& items, size_t threads, std::function<void(const Item&, std::vector<T>&)> kernel, std::function<void(std::vector<T>&)> sink, std::function<bool()> interrupted = nullptr)
+	{
+		const size_t count = items.size();
+		threads = (std::min)(workers(threads), (std::max)(count, static_cast<size_t>(1)));
+
+		// hand each worker a contiguous run of items so that they start out touching different memory
+		std::vector<Queue> queues(threads);
+		for (size_t i = 0; i < count; i++)
+			queues[i * threads / count].push(i);
+
+		std::mutex lock;
+		std::vector<std::vector<T>> results(count);
+		std::vector<bool> complete(count, false);
+		size_t cursor = 0;
+
+		auto worker = [&](size_t self) {
+			size_t index;
+			for (;;) {
+				if (interrupted && interrupted())
+					return;
+
+				// take our own work first, and then try stealing from everyone else
+				bool found = queues[self].pop(index);
+				for (size_t i = 1; !found && i < threads; i++)
+					found = queues[(self + i) % threads].steal(index);
+				if (!found)
+					return;
+
+				std::vector<T> hits;
+				try {
+					kernel(items[index], hits);
+				}
+				catch (...) {
+					hits.clear();
+				}
+
+				// flush every item that's now part of the completed prefix
+				std::lock_guard<std::mutex> guard(lock);
+				results[index].swap(hits);
+				complete[index] = true;
+				for (; cursor < count && complete[cursor]; cursor++) {
+					sink(results[cursor]);
+					std::vector<T>().swap(results[cursor]);
+				}
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (size_t i = 1; i < threads; i++)
+			pool.emplace_back(worker, i);
+		worker(0);
+
+		for (auto& t : pool)
+			t.join();
+	}
+
+	/* run the scan and collect every hit into a single sorted vector */
+	template <typename T>
+	std::vector<T> collect(const std::vector<Item>& items, size_t threads, std::function<void(const Item&, std::vector<T>&)> kernel)
+	{
+		std::vector<T> res;
+		run<T>(items, threads, kernel, [&res](std::vector<T>& hits) { res.insert(res.end(), hits.begin(), hits.end()); });
+		return res;
+	}
+}
@@ -0,0 +1,274 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "pe.h"
+
+namespace {
+	/* the offsets of the fields in the headers that are needed */
+	const size_t dos_lfanew = 0x3c;
+	const size_t nt_sections = 0x06, nt_optionalsize = 0x14, nt_optional = 0x18;
+	const size_t optional_base32 = 0x1c, optional_base64 = 0x18, optional_image = 0x38, optional_headers = 0x3c;
+	const size_t optional_count32 = 0x5c, optional_count64 = 0x6c;
+	const size_t optional_directory32 = 0x60, optional_directory64 = 0x70;
+	const size_t section_size = 0x28;
+	const size_t section_virtualsize = 0x08, section_virtualaddress = 0x0c, section_rawsize = 0x10, section_rawpointer = 0x14, section_characteristics = 0x24;
+	const uint16_t magic32 = 0x10b, magic64 = 0x20b;
+
+	template<typename T> inline T
+	header(const uint8_t* data, size_t size, size_t offset)
+	{
+		T res;
+		if (offset > size || size - offset < sizeof(T))
+			throw std::invalid_argument("header");
+		memcpy(&res, data + offset, sizeof(res));
+		return res;
+	}
+}
+
+/** View */
+pe::View::View(const void* data, size_t size, bool mapped) :
+	m_data(static_cast<const uint8_t*>(data)), m_size(size), m_mapped(mapped)
+{
+	if (header<uint16_t>(m_data, m_size, 0) != 0x5a4d)
+		throw std::invalid_argument("dos");
+
+	auto nt = header<uint32_t>(m_data, m_size, dos_lfanew);
+	if (header<uint32_t>(m_data, m_size, nt) != 0x4550)
+		throw std::invalid_argument("nt");
+
+	m_count = header<uint16_t>(m_data, m_size, nt + nt_sections);
+	m_optional = nt + nt_optional;
+	m_sections = m_optional + header<uint16_t>(m_data, m_size, nt + nt_optionalsize);
+
+	m_magic = header<uint16_t>(m_data, m_size, m_optional);
+	if (m_magic != magic32 && m_magic != magic64)
+		throw std::invalid_argument("optional");
+	m_headers = header<uint32_t>(m_data, m_size, m_optional + optional_headers);
+}
+
+bool
+pe::View::wide() const
+{
+	return m_magic == magic64;
+}
+
+uint64_t
+pe::View::base() const
+{
+	if (wide())
+		return header<uint64_t>(m_data, m_size, m_optional + optional_base64);
+	return header<uint32_t>(m_data, m_size, m_optional + optional_base32);
+}
+
+uint32_t
+pe::View::image() const
+{
+	return header<uint32_t>(m_data, m_size, m_optional + optional_image);
+}
+
+std::vector<pe::Section>
+pe::View::sections() const
+{
+	std::vector<Section> res;
+	for (size_t i = 0; i < m_count; i++) {
+		auto section = m_sections + i * section_size;
+		header<uint8_t>(m_data, m_size, section + section_size - 1);
+
+		Section item;
+		auto name = reinterpret_cast<const char*>(m_data + section);
+		item.name.assign(name, strnlen(name, 8));
+		item.address = header<uint32_t>(m_data, m_size, section + section_virtualaddress);
+		item.size = header<uint32_t>(m_data, m_size, section + section_virtualsize);
+		item.rawoffset = header<uint32_t>(m_data, m_size, section + section_rawpointer);
+		item.rawsize = header<uint32_t>(m_data, m_size, section + section_rawsize);
+		item.characteristics = header<uint32_t>(m_data, m_size, section + section_characteristics);
+		res.push_back(item);
+	}
+	return res;
+}
+
+size_t
+pe::View::offset(uint32_t rva, size_t length) const
+{
+	size_t res = rva;
+
+	// the headers are at the same offset in both layouts, but everything else lives in a section
+	if (!m_mapped && rva >= m_headers) {
+		size_t i;
+		for (i = 0; i < m_count; i++) {
+			auto section = m_sections + i * section_size;
+			auto va = header<uint32_t>(m_data, m_size, section + section_virtualaddress);
+			auto raw = header<uint32_t>(m_data, m_size, section + section_rawsize);
+			auto extent = (std::max)(header<uint32_t>(m_data, m_size, section + section_virtualsize), raw);
+			if (rva < va || rva - va >= extent)
+				continue;
+
+			// whatever's past the end of the raw data is zero-filled when it's mapped, so it isn't readable here
+			if (rva - va >= raw || raw - (rva - va) < length)
+				throw std::out_of_range("section");
+			res = header<uint32_t>(m_data, m_size, section + section_rawpointer) + (rva - va);
+			break;
+		}
+		if (i == m_count)
+			throw std::out_of_range("rva");
+	}
+
+	if (res > m_size || m_size - res < length)
+		throw std::out_of_range("rva");
+	return res;
+}
+
+bool
+pe::View::directory(directory_t index, uint32_t& rva, uint32_t& size) const
+{
+	auto count = header<uint32_t>(m_data, m_size, m_optional + (wide() ? optional_count64 : optional_count32));
+	if (index >= count)
+		return false;
+
+	auto entry = m_optional + (wide() ? optional_directory64 : optional_directory32) + index * 2 * sizeof(uint32_t);
+	rva = header<uint32_t>(m_data, m_size, entry);
+	size = header<uint32_t>(m_data, m_size, entry + sizeof(uint32_t));
+	return rva != 0 && size != 0;
+}
+
+std::string
+pe::View::string(uint32_t rva, size_t limit) const
+{
+	auto start = offset(rva, 1);
+	auto p = reinterpret_cast<const char*>(m_data + start);
+	return std::string(p, strnlen(p, (std::min)(limit, m_size - start)));
+}
+
+/* reading an image from its file */
+std::vector<uint8_t>
+pe::file(const std::string& path)
+{
+#if defined(_WIN32)
+	// module paths are utf-8, but a narrow path would be opened with the ansi code page
+	std::wstring wide(path.size() + 1, L'\0');
+	auto cch = ::MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], static_cast<int>(wide.size()));
+	wide.resize(cch > 0 ? cch - 1 : 0);
+	std::ifstream is(wide.c_str(), std::ios::binary);
+#else
+	std::ifstream is(path, std::ios::binary);
+#endif
+	if (!is)
+		throw std::runtime_error(path);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+/* mapping an image */
+std::vector<uint8_t>
+pe::map(const View& view)
+{
+	if (view.mapped())
+		throw std::invalid_argument("mapped");
+
+	std::vector<uint8_t> res(view.image(), 0);
+	auto headers = (std::min)({ static_cast<size_t>(view.headers()), view.size(), res.size() });
+	std::copy(view.data(), view.data() + headers, res.begin());
+
+	// a section's raw data is cut at its virtual size, except for linkers that leave that empty
+	for (auto& section : view.sections()) {
+		size_t count = section.size ? (std::min)(section.size, section.rawsize) : section.rawsize;
+		if (section.rawoffset > view.size() || section.address > res.size())
+			throw std::out_of_range(section.name);
+		count = (std::min)({ count, view.size() - section.rawoffset, res.size() - section.address });
+		std::copy(view.data() + section.rawoffset, view.data() + section.rawoffset + count, res.begin() + section.address);
+	}
+	return res;
+}
+
+/*
+	The relocations are a list of blocks, one per page, where each entry is
+	a 4-bit type followed by the 12-bit offset into the page. HIGHADJ takes
+	up the entry after it for the low half of the value being adjusted.
+*/
+size_t
+pe::relocate(std::vector<uint8_t>& image, uint64_t base)
+{
+	enum : uint16_t { absolute = 0, high = 1, low = 2, highlow = 3, highadj = 4, dir64 = 10 };
+	View view(image.data(), image.size(), true);
+	size_t res = 0;
+
+	uint32_t rva, size;
+	const uint64_t delta = base - view.base();
+	if (!delta || !view.directory(directory_basereloc, rva, size))
+		return 0;
+
+	auto patch = [&image](uint32_t rva, size_t length) -> uint8_t* {
+		if (rva > image.size() || image.size() - rva < length)
+			throw std::out_of_range("relocation");
+		return image.data() + rva;
+	};
+
+	for (uint32_t offset = 0; offset + 2 * sizeof(uint32_t) <= size; ) {
+		auto page = view.read<uint32_t>(rva + offset);
+		auto length = view.read<uint32_t>(rva + offset + sizeof(uint32_t));
+		if (length < 2 * sizeof(uint32_t) || length > size - offset)
+			throw std::out_of_range("block");
+
+		for (uint32_t entry = 2 * sizeof(uint32_t); entry + sizeof(uint16_t) <= length; entry += sizeof(uint16_t)) {
+			auto item = view.read<uint16_t>(rva + offset + entry);
+			auto target = page + (item & 0xfff);
+
+			switch (item >> 12) {
+			case absolute:
+				continue;
+			case high: {
+				uint16_t value;
+				memcpy(&value, patch(target, sizeof(value)), sizeof(value));
+				value = static_cast<uint16_t>(value + (delta >> 16));
+				memcpy(patch(target, sizeof(value)), &value, sizeof(value));
+				break;
+			}
+			case low: {
+				uint16_t value;
+				memcpy(&value, patch(target, sizeof(value)), sizeof(value));
+				value = static_cast<uint16_t>(value + delta);
+				memcpy(patch(target, sizeof(value)), &value, sizeof(value));
+				break;
+			}
+			case highadj: {
+				uint16_t value;
+				entry += sizeof(uint16_t);
+				if (entry + sizeof(uint16_t) > length)
+					throw std::out_of_range("highadj");
+				auto adjust = static_cast<int16_t>(view.read<uint16_t>(rva + offset + entry));
+				memcpy(&value, patch(target, sizeof(value)), sizeof(value));
+				uint32_t full = (static_cast<uint32_t>(value) << 16) + adjust + static_cast<uint32_t>(delta) + 0x8000;
+				value = static_cast<uint16_t>(full >> 16);
+				memcpy(patch(target, sizeof(value)), &value, sizeof(value));
+				break;
+			}
+			case highlow: {
+				uint32_t value;
+				memcpy(&value, patch(target, sizeof(value)), sizeof(value));
+				value += static_cast<uint32_t>(delta);
+				memcpy(patch(target, sizeof(value)), &value, sizeof(value));
+				break;
+			}
+			case dir64: {
+				uint64_t value;
+				memcpy(&value, patch(target, sizeof(value)), sizeof(value));
+				value += delta;
+				memcpy(patch(target, sizeof(value)), &value, sizeof(value));
+				break;
+			}
+			default:
+				// the other types are for architectures that we don't read
+				continue;
+			}
+			res++;
+		}
+		offset += length;
+	}
+	return res;
+}
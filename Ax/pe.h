@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** reading the headers and data directories of a PE image */
+namespace pe {
+	/* type-definitions */
+	enum directory_t : uint32_t {
+		directory_export = 0,
+		directory_exception = 3,
+		directory_basereloc = 5,
+		directory_iat = 12,
+	};
+
+	enum section_t : uint32_t {
+		section_execute = 0x20000000,
+		section_read = 0x40000000,
+		section_write = 0x80000000,
+		section_discardable = 0x02000000,
+	};
+
+	struct Section {
+		std::string name;
+		uint32_t address;		// rva
+		uint32_t size;			// VirtualSize
+		uint32_t rawoffset, rawsize;
+		uint32_t characteristics;
+
+		bool executable() const { return (characteristics & section_execute) != 0; }
+		bool writable() const { return (characteristics & section_write) != 0; }
+		bool discardable() const { return (characteristics & section_discardable) != 0; }
+	};
+
+	/*
+		An image is either mapped, where an rva is the offset from its base, or
+		laid out the way it is in its file, where an rva has to be translated
+		through the section headers. Anything that's out of bounds throws
+		std::out_of_range, and anything that isn't a PE throws
+		std::invalid_argument.
+	*/
+	class View {
+	private:
+		/* private members */
+		const uint8_t* m_data;
+		size_t m_size;
+		bool m_mapped;
+
+		uint16_t m_magic;
+		uint32_t m_headers;		// SizeOfHeaders
+		size_t m_optional;		// offset of the optional header
+		size_t m_sections;		// offset of the first section header
+		uint16_t m_count;
+
+	public:
+		/* scoping methods */
+		View(const void* data, size_t size, bool mapped);
+
+		/* methods */
+		const uint8_t* data() const { return m_data; }
+		size_t size() const { return m_size; }
+		bool mapped() const { return m_mapped; }
+		bool wide() const;		// a PE32+ image
+
+		uint64_t base() const;		// ImageBase, which is what the image was linked for
+		uint32_t image() const;		// SizeOfImage
+		uint32_t headers() const { return m_headers; }
+		std::vector<Section> sections() const;
+
+		size_t offset(uint32_t rva, size_t length) const;
+		bool directory(directory_t index, uint32_t& rva, uint32_t& size) const;
+
+		template<typename T> T
+		read(uint32_t rva) const
+		{
+			T res;
+			memcpy(&res, m_data + offset(rva, sizeof(T)), sizeof(res));
+			return res;
+		}
+
+		// A string is cut at `limit` characters or the end of what's readable.
+		std::string string(uint32_t rva, size_t limit) const;
+	};
+
+	/* reading an image from its file */
+	std::vector<uint8_t> file(const std::string& path);		// throws std::runtime_error
+
+	// Lay out an image from its file the way that the loader maps it, with everything that isn't in the file zeroed.
+	std::vector<uint8_t> map(const View& view);
+
+	// Apply the base relocations of a mapped image for it being loaded at `base`, and return the number of fixups.
+	size_t relocate(std::vector<uint8_t>& image, uint64_t base);
+}
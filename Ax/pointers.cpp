@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POINTERS_SSE2
+#endif
+
+#if defined(__SSE4_2__) || defined(__AVX__)
+#include <nmmintrin.h>
+#define POINTERS_SSE42
+#endif
+
+#include "pointers.h"
+#include "scanner.h"
+
+/** Targets */
+namespace pointers {
+	Targets::Targets(std::vector<Interval> intervals) : m_lowest(0), m_highest(0)
+	{
+		std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) { return a.start < b.start; });
+
+		// merge anything that overlaps or touches so that a lookup only has to check one interval
+		for (auto& item : intervals) {
+			if (item.start >= item.stop)
+				continue;
+			if (!m_intervals.empty() && item.start <= m_intervals.back().stop) {
+				m_intervals.back().stop = (std::max)(m_intervals.back().stop, item.stop);
+				continue;
+			}
+			m_intervals.push_back(item);
+		}
+
+		if (!m_intervals.empty()) {
+			m_lowest = m_intervals.front().start;
+			m_highest = m_intervals.back().stop;
+		}
+	}
+
+	/*
+		Each line of the text is an interval written as the hex start and
+		stop of the range separated by whitespace. The stop is exclusive.
+	*/
+	Targets
+	Targets::parse(const std::string& text)
+	{
+		std::vector<Interval> res;
+		std::istringstream is(text);
+		std::string line;
+
+		while (std::getline(is, line)) {
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+
+			std::istringstream fields(line);
+			Interval item;
+			if (!(fields >> std::hex >> item.start >> item.stop) || item.start >= item.stop)
+				throw std::invalid_argument(line);
+			res.push_back(item);
+		}
+		return Targets(res);
+	}
+
+	bool
+	Targets::contains(uint64_t value) const
+	{
+		auto it = std::upper_bound(m_intervals.begin(), m_intervals.end(), value, [](uint64_t value, const Interval& item) { return value < item.start; });
+		if (it == m_intervals.begin())
+			return false;
+		--it;
+		return value < it->stop;
+	}
+}
+
+/** utilities */
+namespace pointers {
+	std::string
+	format(const Found& found, size_t width)
+	{
+		std::ostringstream os;
+		os << scan::format(found.location) << " " << std::hex << std::setfill('0') << std::setw(width * 2) << found.value;
+		return os.str();
+	}
+}
+
+/** kernels */
+namespace pointers {
+	size_t
+	search4(uintptr_t ea, size_t size, const Targets& targets, visitor visit)
+	{
+		const uint32_t* p = reinterpret_cast<const uint32_t*>(ea);
+		const size_t count = size / sizeof(uint32_t);
+		size_t i = 0, res = 0;
+
+		if (targets.empty() || targets.lowest() > 0xffffffffull)
+			return 0;
+
+		// everything is checked against the bounds of the whole set first, which is a single unsigned compare
+		const uint32_t lowest = static_cast<uint32_t>(targets.lowest());
+		const uint64_t span = (std::min)(targets.highest(), static_cast<uint64_t>(0x100000000ull)) - lowest;
+
+		auto check = [&](size_t index) {
+			auto value = p[index];
+			if (static_cast<uint32_t>(value - lowest) >= span || !targets.contains(value))
+				return true;
+			Found found = { reinterpret_cast<uintptr_t>(p + index), value };
+			res++;
+			return visit(found);
+		};
+
+#if defined(POINTERS_SSE2)
+		if (span < 0x100000000ull) {
+			const auto bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+			const auto base = _mm_set1_epi32(static_cast<int>(lowest));
+			const auto limit = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(span) ^ 0x80000000u));
+
+			for (; i + 4 <= count; i += 4) {
+				auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+				auto candidates = _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(v, base), bias), limit);
+				auto mask = _mm_movemask_ps(_mm_castsi128_ps(candidates));
+				for (; mask; mask &= mask - 1) {
+					int n = 0;
+					while (!(mask & (1 << n)))
+						n++;
+					if (!check(i + n))
+						return res;
+				}
+			}
+		}
+#endif
+
+		for (; i < count; i++)
+			if (!check(i))
+				return res;
+		return res;
+	}
+
+	size_t
+	search8(uintptr_t ea, size_t size, const Targets& targets, visitor visit)
+	{
+		const uint64_t* p = reinterpret_cast<const uint64_t*>(ea);
+		const size_t count = size / sizeof(uint64_t);
+		size_t i = 0, res = 0;
+
+		if (targets.empty())
+			return 0;
+
+		const uint64_t lowest = targets.lowest();
+		const uint64_t span = targets.highest() - lowest;
+
+		auto check = [&](size_t index) {
+			auto value = p[index];
+			if (value - lowest >= span || !targets.contains(value))
+				return true;
+			Found found = { reinterpret_cast<uintptr_t>(p + index), value };
+			res++;
+			return visit(found);
+		};
+
+#if defined(POINTERS_SSE42)
+		const auto bias = _mm_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+		const auto base = _mm_set1_epi64x(static_cast<long long>(lowest));
+		const auto limit = _mm_set1_epi64x(static_cast<long long>(span ^ 0x8000000000000000ull));
+
+		for (; i + 2 <= count; i += 2) {
+			auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			auto candidates = _mm_cmpgt_epi64(limit, _mm_xor_si128(_mm_sub_epi64(v, base), bias));
+			auto mask = _mm_movemask_pd(_mm_castsi128_pd(candidates));
+			if ((mask & 1) && !check(i))
+				return res;
+			if ((mask & 2) && !check(i + 1))
+				return res;
+		}
+#elif defined(POINTERS_SSE2)
+		/*
+			SSE2 has no 64-bit compare, so the unsigned one is put together
+			from the 32-bit halves: a value is below the span when its high
+			half is below the span's, or equal with the low half below.
+		*/
+		const auto bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+		const auto base = _mm_set1_epi64x(static_cast<long long>(lowest));
+		const auto limit = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(span)), bias);
+
+		auto below = [&](const uint64_t* q) {
+			auto v = _mm_xor_si128(_mm_sub_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(q)), base), bias);
+			auto less = _mm_cmpgt_epi32(limit, v);
+			auto equal = _mm_cmpeq_epi32(limit, v);
+			auto low = _mm_shuffle_epi32(less, _MM_SHUFFLE(2, 2, 0, 0));
+			return _mm_movemask_pd(_mm_castsi128_pd(_mm_or_si128(less, _mm_and_si128(equal, low))));
+		};
+
+		for (; i + 4 <= count; i += 4) {
+			auto mask = below(p + i) | (below(p + i + 2) << 2);
+			for (; mask; mask &= mask - 1) {
+				int n = 0;
+				while (!(mask & (1 << n)))
+					n++;
+				if (!check(i + n))
+					return res;
+			}
+		}
+#else
+		// without a 64-bit compare, test four values at a time so that the common case is a single branch
+		for (; i + 4 <= count; i += 4) {
+			bool any = (p[i] - lowest < span) | (p[i + 1] - lowest < span) | (p[i + 2] - lowest < span) | (p[i + 3] - lowest < span);
+			if (!any)
+				continue;
+			for (size_t n = 0; n < 4; n++)
+				if (!check(i + n))
+					return res;
+		}
+#endif
+
+		for (; i < count; i++)
+			if (!check(i))
+				return res;
+		return res;
+	}
+
+	std::vector<Found>
+	search(const std::vector<Region>& regions, size_t width, const Targets& targets, size_t limit, size_t threads)
+	{
+		std::vector<Found> res;
+		std::atomic<bool> full(limit == 0);
+
+		if (width != sizeof(uint32_t) && width != sizeof(uint64_t))
+			throw std::invalid_argument("width");
+
+		auto kernel = (width == sizeof(uint64_t)) ? &search8 : &search4;
+		auto items = parallel::shard(scan::coalesce(regions), 0x100000, 0);
+
+		parallel::run<Found>(items, threads,
+			[kernel, &targets, limit](const parallel::Item& item, std::vector<Found>& hits) {
+				kernel(item.base, item.size, targets, [&hits, limit](const Found& found) {
+					hits.push_back(found);
+					return hits.size() < limit;
+				});
+			},
+			[&res, &full, limit](std::vector<Found>& hits) {
+				for (auto& found : hits) {
+					if (res.size() >= limit)
+						break;
+					res.push_back(found);
+				}
+				if (res.size() >= limit)
+					full = true;
+			},
+			[&full]() { return full.load(); }
+		);
+		return res;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "regions.h"
+#include "parallel.h"
+
+/** searching memory for values that point into a set of ranges */
+namespace pointers {
+	/* type-definitions */
+	struct Interval {
+		uint64_t start, stop;	// [start, stop)
+	};
+
+	struct Found {
+		uintptr_t location;
+		uint64_t value;
+
+		bool operator<(const Found& other) const { return location < other.location; }
+	};
+	typedef std::function<bool(const Found&)> visitor;	// returns false to stop
+
+	/* a sorted set of non-overlapping intervals */
+	class Targets {
+	private:
+		std::vector<Interval> m_intervals;
+		uint64_t m_lowest, m_highest;
+
+	public:
+		Targets(std::vector<Interval> intervals);
+
+		static Targets parse(const std::string& text);
+
+		bool contains(uint64_t value) const;
+		bool empty() const { return m_intervals.empty(); }
+		uint64_t lowest() const { return m_lowest; }
+		uint64_t highest() const { return m_highest; }
+	};
+
+	/* utilities */
+	std::string format(const Found& found, size_t width);
+
+	/* kernels that check every aligned value of `width` bytes within [ea, ea+size) */
+	size_t search4(uintptr_t ea, size_t size, const Targets& targets, visitor visit);
+	size_t search8(uintptr_t ea, size_t size, const Targets& targets, visitor visit);
+
+	/* search every region using `threads` workers, stopping after `limit` results */
+	std::vector<Found> search(const std::vector<Region>& regions, size_t width, const Targets& targets, size_t limit, size_t threads);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+/** reading a single value from an address, which faults if it isn't readable */
+namespace utils {
+	// byte
+	inline uint8_t
+	ubyte1(intptr_t ea)
+	{
+		return *(uint8_t*)(ea);
+	}
+	inline int8_t
+	sbyte1(intptr_t ea)
+	{
+		return *(int8_t*)(ea);
+	}
+
+	// word
+	inline uint16_t
+	uint2(intptr_t ea)
+	{
+		return *(uint16_t*)(ea);
+	}
+	inline int16_t
+	sint2(intptr_t ea)
+	{
+		return *(int16_t*)(ea);
+	}
+
+	// dword
+	inline uint32_t
+	uint4(intptr_t ea)
+	{
+		return *(uint32_t*)(ea);
+	}
+	inline int32_t
+	sint4(intptr_t ea)
+	{
+		return *(int32_t*)(ea);
+	}
+
+	// qword
+	inline uint64_t
+	uint8(intptr_t ea)
+	{
+		return *(uint64_t*)(ea);
+	}
+
+	inline int64_t
+	sint8(intptr_t ea)
+	{
+		return *(int64_t*)(ea);
+	}
+
+	// floating-point
+	inline float
+	binary32(intptr_t ea)
+	{
+		return *(float*)(ea);
+	}
+
+	inline double
+	binary64(intptr_t ea)
+	{
+		return *(double*)(ea);
+	}
+}
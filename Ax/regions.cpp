@@ -0,0 +1,372 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <tlhelp32.h>
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+#include <algorithm>
+#include <map>
+
+#include "regions.h"
+
+/** region attributes */
+bool
+Region::readable() const
+{
+	const uint32_t mask = memory::protect_readonly | memory::protect_readwrite | memory::protect_writecopy | memory::protect_execute_read | memory::protect_execute_readwrite | memory::protect_execute_writecopy;
+	return committed() && !(protect & memory::protect_guard) && (protect & mask);
+}
+
+bool
+Region::writable() const
+{
+	const uint32_t mask = memory::protect_readwrite | memory::protect_writecopy | memory::protect_execute_readwrite | memory::protect_execute_writecopy;
+	return committed() && !(protect & memory::protect_guard) && (protect & mask);
+}
+
+bool
+Region::executable() const
+{
+	const uint32_t mask = memory::protect_execute | memory::protect_execute_read | memory::protect_execute_readwrite | memory::protect_execute_writecopy;
+	return committed() && !(protect & memory::protect_guard) && (protect & mask);
+}
+
+/** platform-specific enumeration */
+#if defined(_WIN32)
+namespace regions {
+	std::vector<Region>
+	enumerate()
+	{
+		std::vector<Region> res;
+		MEMORY_BASIC_INFORMATION mbi;
+		uintptr_t ea = 0;
+
+		while (::VirtualQuery(reinterpret_cast<LPCVOID>(ea), &mbi, sizeof(mbi)) == sizeof(mbi)) {
+			if (mbi.State != MEM_FREE) {
+				Region region;
+				region.base = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+				region.allocation = reinterpret_cast<uintptr_t>(mbi.AllocationBase);
+				region.size = mbi.RegionSize;
+				region.state = mbi.State;
+				region.protect = mbi.Protect;
+				region.type = mbi.Type;
+				res.push_back(region);
+			}
+
+			// stop if we've wrapped around the top of the address space
+			auto next = reinterpret_cast<uintptr_t>(mbi.BaseAddress) + mbi.RegionSize;
+			if (next <= ea)
+				break;
+			ea = next;
+		}
+		return res;
+	}
+
+	std::vector<Module>
+	modules()
+	{
+		std::vector<Module> res;
+		MODULEENTRY32W me;
+
+		HANDLE hSnapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32, 0);
+		if (hSnapshot == INVALID_HANDLE_VALUE)
+			return res;
+
+		me.dwSize = sizeof(me);
+		for (auto ok = ::Module32FirstW(hSnapshot, &me); ok; ok = ::Module32NextW(hSnapshot, &me)) {
+			Module module;
+			module.base = reinterpret_cast<uintptr_t>(me.modBaseAddr);
+			module.size = me.modBaseSize;
+
+			char path[MAX_PATH * 3];
+			auto cb = ::WideCharToMultiByte(CP_UTF8, 0, me.szExePath, -1, path, sizeof(path), NULL, NULL);
+			module.path.assign(path, cb > 0 ? cb - 1 : 0);
+			res.push_back(module);
+		}
+
+		::CloseHandle(hSnapshot);
+		return res;
+	}
+}
+#else
+namespace regions {
+	// A single line from /proc/self/maps
+	struct mapping {
+		uintptr_t start, stop;
+		std::string perms, path;
+	};
+
+	static std::vector<mapping>
+	mappings()
+	{
+		std::vector<mapping> res;
+		std::ifstream maps("/proc/self/maps");
+		std::string line;
+
+		while (std::getline(maps, line)) {
+			std::istringstream is(line);
+			mapping m;
+			std::string offset, device, inode;
+			char dash;
+
+			is >> std::hex >> m.start >> dash >> m.stop >> m.perms >> offset >> device >> inode;
+			if (!is)
+				continue;
+			std::getline(is >> std::ws, m.path);
+			res.push_back(m);
+		}
+		return res;
+	}
+
+	static uint32_t
+	protection(const std::string& perms)
+	{
+		const bool r = perms.size() > 0 && perms[0] == 'r';
+		const bool w = perms.size() > 1 && perms[1] == 'w';
+		const bool x = perms.size() > 2 && perms[2] == 'x';
+
+		if (x)
+			return w ? memory::protect_execute_readwrite : r ? memory::protect_execute_read : memory::protect_execute;
+		if (r)
+			return w ? memory::protect_readwrite : memory::protect_readonly;
+		return memory::protect_noaccess;
+	}
+
+	std::vector<Region>
+	enumerate()
+	{
+		std::vector<Region> res;
+		std::map<std::string, uintptr_t> allocations;
+
+		for (auto& m : mappings()) {
+			Region region;
+			region.base = m.start;
+			region.size = m.stop - m.start;
+			region.state = memory::state_commit;
+			region.protect = protection(m.perms);
+
+			// the kernel's vvar pages fault on access even though they're mapped readable
+			if (m.path.compare(0, 5, "[vvar") == 0)
+				region.protect = memory::protect_noaccess;
+
+			// file-backed mappings are treated as images allocated at their first mapping
+			if (!m.path.empty() && m.path[0] == '/') {
+				auto it = allocations.insert(std::make_pair(m.path, m.start)).first;
+				region.allocation = it->second;
+				region.type = memory::type_image;
+			} else {
+				region.allocation = m.start;
+				region.type = memory::type_private;
+			}
+			res.push_back(region);
+		}
+		return res;
+	}
+
+	std::vector<Module>
+	modules()
+	{
+		std::vector<Module> res;
+		std::map<std::string, size_t> index;
+
+		for (auto& m : mappings()) {
+			if (m.path.empty() || m.path[0] != '/')
+				continue;
+
+			auto it = index.find(m.path);
+			if (it == index.end()) {
+				Module module;
+				module.base = m.start;
+				module.size = m.stop - m.start;
+				module.path = m.path;
+				index[m.path] = res.size();
+				res.push_back(module);
+				continue;
+			}
+
+			auto& module = res[it->second];
+			auto stop = std::max(module.end(), m.stop);
+			module.base = std::min(module.base, m.start);
+			module.size = stop - module.base;
+		}
+		return res;
+	}
+}
+#endif
+
+/** RegionMap */
+size_t
+RegionMap::refresh()
+{
+	return assign(regions::enumerate());
+}
+
+size_t
+RegionMap::assign(std::vector<Region> regions)
+{
+	std::sort(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.base < b.base; });
+	auto same = [](const Region& a, const Region& b) {
+		return a.base == b.base && a.allocation == b.allocation && a.size == b.size && a.state == b.state && a.protect == b.protect && a.type == b.type;
+	};
+
+	WriteLock lock(m_lock);
+	if (!m_generation || !std::equal(regions.begin(), regions.end(), m_regions.begin(), m_regions.end(), same))
+		m_generation++;
+	m_regions.swap(regions);
+	m_refreshed = std::chrono::steady_clock::now();
+	return m_regions.size();
+}
+
+bool
+RegionMap::find(uintptr_t ea, Region& result) const
+{
+	ReadLock lock(m_lock);
+	auto it = std::upper_bound(m_regions.begin(), m_regions.end(), ea, [](uintptr_t ea, const Region& r) { return ea < r.base; });
+	if (it == m_regions.begin())
+		return false;
+
+	--it;
+	if (!it->contains(ea))
+		return false;
+
+	result = *it;
+	return true;
+}
+
+size_t
+RegionMap::readable(uintptr_t ea, size_t count) const
+{
+	size_t res = 0;
+
+	ReadLock lock(m_lock);
+	auto it = std::upper_bound(m_regions.begin(), m_regions.end(), ea, [](uintptr_t ea, const Region& r) { return ea < r.base; });
+	if (it == m_regions.begin())
+		return 0;
+
+	// walk forward through adjacent readable regions until we've satisfied the count
+	for (--it; res < count && it != m_regions.end(); ++it) {
+		if (!it->contains(ea + res) || !it->readable())
+			break;
+		res += std::min(count - res, static_cast<size_t>(it->end() - (ea + res)));
+	}
+	return res;
+}
+
+std::vector<Region>
+RegionMap::snapshot() const
+{
+	ReadLock lock(m_lock);
+	return m_regions;
+}
+
+std::vector<Region>
+RegionMap::select(uintptr_t start, uintptr_t stop, bool(*predicate)(const Region&)) const
+{
+	std::vector<Region> res;
+
+	ReadLock lock(m_lock);
+	for (auto& r : m_regions) {
+		if (r.end() <= start || r.base >= stop)
+			continue;
+		if (predicate && !predicate(r))
+			continue;
+
+		// clamp the region to the requested boundaries
+		Region item = r;
+		item.base = std::max(r.base, start);
+		item.size = std::min(r.end(), stop) - item.base;
+		res.push_back(item);
+	}
+	return res;
+}
+
+bool
+RegionMap::stale(std::chrono::milliseconds lifetime) const
+{
+	ReadLock lock(m_lock);
+	return !m_generation || std::chrono::steady_clock::now() - m_refreshed >= lifetime;
+}
+
+unsigned long
+RegionMap::generation() const
+{
+	ReadLock lock(m_lock);
+	return m_generation;
+}
+
+size_t
+RegionMap::size() const
+{
+	ReadLock lock(m_lock);
+	return m_regions.size();
+}
+
+/** ModuleTable */
+size_t
+ModuleTable::refresh()
+{
+	return assign(regions::modules());
+}
+
+size_t
+ModuleTable::assign(std::vector<Module> modules)
+{
+	std::sort(modules.begin(), modules.end(), [](const Module& a, const Module& b) { return a.base < b.base; });
+	auto same = [](const Module& a, const Module& b) {
+		return a.base == b.base && a.size == b.size && a.path == b.path;
+	};
+
+	WriteLock lock(m_lock);
+	if (!m_generation || !std::equal(modules.begin(), modules.end(), m_modules.begin(), m_modules.end(), same))
+		m_generation++;
+	m_modules.swap(modules);
+	m_refreshed = std::chrono::steady_clock::now();
+	return m_modules.size();
+}
+
+bool
+ModuleTable::find(uintptr_t ea, Module& result) const
+{
+	ReadLock lock(m_lock);
+	auto it = std::upper_bound(m_modules.begin(), m_modules.end(), ea, [](uintptr_t ea, const Module& m) { return ea < m.base; });
+	if (it == m_modules.begin())
+		return false;
+
+	--it;
+	if (!it->contains(ea))
+		return false;
+
+	result = *it;
+	return true;
+}
+
+std::vector<Module>
+ModuleTable::snapshot() const
+{
+	ReadLock lock(m_lock);
+	return m_modules;
+}
+
+bool
+ModuleTable::stale(std::chrono::milliseconds lifetime) const
+{
+	ReadLock lock(m_lock);
+	return !m_generation || std::chrono::steady_clock::now() - m_refreshed >= lifetime;
+}
+
+unsigned long
+ModuleTable::generation() const
+{
+	ReadLock lock(m_lock);
+	return m_generation;
+}
+
+size_t
+ModuleTable::size() const
+{
+	ReadLock lock(m_lock);
+	return m_modules.size();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "threading.h"
+
+/** memory attributes (these share their values with the MEM_* and PAGE_* constants from winnt.h) */
+namespace memory {
+	enum : uint32_t {
+		state_commit = 0x1000,
+		state_reserve = 0x2000,
+		state_free = 0x10000,
+	};
+
+	enum : uint32_t {
+		type_private = 0x20000,
+		type_mapped = 0x40000,
+		type_image = 0x1000000,
+	};
+
+	enum : uint32_t {
+		protect_noaccess = 0x01,
+		protect_readonly = 0x02,
+		protect_readwrite = 0x04,
+		protect_writecopy = 0x08,
+		protect_execute = 0x10,
+		protect_execute_read = 0x20,
+		protect_execute_readwrite = 0x40,
+		protect_execute_writecopy = 0x80,
+		protect_guard = 0x100,
+	};
+}
+
+/** a single contiguous range of pages sharing the same attributes */
+struct Region {
+	uintptr_t base;
+	uintptr_t allocation;
+	size_t size;
+	uint32_t state;
+	uint32_t protect;
+	uint32_t type;
+
+	uintptr_t end() const { return base + size; }
+	bool contains(uintptr_t ea) const { return base <= ea && ea - base < size; }
+
+	bool committed() const { return state == memory::state_commit; }
+	bool readable() const;
+	bool writable() const;
+	bool executable() const;
+};
+
+/** a module that has been mapped into the address space */
+struct Module {
+	uintptr_t base;
+	size_t size;
+	std::string path;
+
+	uintptr_t end() const { return base + size; }
+	bool contains(uintptr_t ea) const { return base <= ea && ea - base < size; }
+};
+
+/** platform-specific enumeration */
+namespace regions {
+	std::vector<Region> enumerate();
+	std::vector<Module> modules();
+}
+
+/*
+	The caches of the address space only advance their generation when a
+	refresh finds something different, so that whatever was derived from
+	them doesn't have to be rebuilt just because they were read again.
+*/
+
+/** cache of the address space layout. readers share the lock and writers only refresh it. */
+class RegionMap {
+private:
+	/* private members */
+	mutable ReadWriteLock m_lock;
+	std::vector<Region> m_regions;	// sorted by base address
+	unsigned long m_generation;
+	std::chrono::steady_clock::time_point m_refreshed;
+
+public:
+	/* scoping methods */
+	RegionMap() : m_generation(0) {}
+	~RegionMap() {}
+
+	/* methods */
+	size_t refresh();
+	size_t assign(std::vector<Region> regions);
+
+	bool find(uintptr_t ea, Region& result) const;
+	size_t readable(uintptr_t ea, size_t count) const;
+	std::vector<Region> snapshot() const;
+	std::vector<Region> select(uintptr_t start, uintptr_t stop, bool(*predicate)(const Region&)) const;
+
+	// Whether the layout has never been read, or was last read longer than `lifetime` ago.
+	bool stale(std::chrono::milliseconds lifetime) const;
+	unsigned long generation() const;
+	size_t size() const;
+};
+
+/** cache of the modules that have been loaded into the address space */
+class ModuleTable {
+private:
+	/* private members */
+	mutable ReadWriteLock m_lock;
+	std::vector<Module> m_modules;	// sorted by base address
+	unsigned long m_generation;
+	std::chrono::steady_clock::time_point m_refreshed;
+
+public:
+	/* scoping methods */
+	ModuleTable() : m_generation(0) {}
+	~ModuleTable() {}
+
+	/* methods */
+	size_t refresh();
+	size_t assign(std::vector<Module> modules);
+
+	bool find(uintptr_t ea, Module& result) const;
+	std::vector<Module> snapshot() const;
+
+	// Whether the modules have never been read, or were last read longer than `lifetime` ago.
+	bool stale(std::chrono::milliseconds lifetime) const;
+	unsigned long generation() const;
+	size_t size() const;
+};
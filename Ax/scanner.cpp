@@ -0,0 +1,254 @@
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "scanner.h"
+
+/** globals */
+namespace scan {
+	// how many bytes to process before checking whether the job was cancelled
+	static const size_t stride = 0x100000;
+}
+
+/** utilities */
+namespace scan {
+	std::vector<Region>
+	coalesce(const std::vector<Region>& regions)
+	{
+		std::vector<Region> res;
+
+		// merge adjacent readable regions so that a match can straddle a region boundary
+		for (auto& r : regions) {
+			if (!r.readable())
+				continue;
+			if (!res.empty() && res.back().end() == r.base) {
+				res.back().size += r.size;
+				continue;
+			}
+			res.push_back(r);
+		}
+		return res;
+	}
+
+	std::vector<uint8_t>
+	parse(const std::string& hex)
+	{
+		std::vector<uint8_t> res;
+		std::string digits;
+
+		for (auto ch : hex) {
+			if (isspace(static_cast<unsigned char>(ch)))
+				continue;
+			if (!isxdigit(static_cast<unsigned char>(ch)))
+				throw std::invalid_argument(hex);
+			digits.push_back(ch);
+		}
+
+		if (digits.empty() || digits.size() % 2)
+			throw std::invalid_argument(hex);
+
+		for (size_t i = 0; i < digits.size(); i += 2)
+			res.push_back(static_cast<uint8_t>(std::stoul(digits.substr(i, 2), nullptr, 16)));
+		return res;
+	}
+
+	std::string
+	format(uintptr_t ea)
+	{
+		std::ostringstream os;
+		os << std::hex << std::setfill('0') << std::setw(sizeof(uintptr_t) * 2) << ea;
+		return os.str();
+	}
+
+	std::string
+	format(const SignatureSet::Hit& hit)
+	{
+		std::ostringstream os;
+		os << format(hit.address) << " " << std::dec << hit.id;
+		return os.str();
+	}
+
+	uint64_t
+	total(const std::vector<Region>& regions)
+	{
+		uint64_t res = 0;
+		for (auto& r : regions)
+			res += r.size;
+		return res;
+	}
+}
+
+/** kernels */
+namespace scan {
+	size_t
+	bytes(uintptr_t ea, size_t size, const std::vector<uint8_t>& pattern, visitor visit)
+	{
+		const uint8_t* start = reinterpret_cast<const uint8_t*>(ea);
+		const uint8_t* p = start;
+		size_t res = 0;
+
+		if (pattern.empty() || pattern.size() > size)
+			return 0;
+
+		// find the first byte of the pattern, and then compare the rest
+		const uint8_t* stop = start + size - pattern.size() + 1;
+		while (p < stop) {
+			p = static_cast<const uint8_t*>(memchr(p, pattern[0], stop - p));
+			if (p == nullptr)
+				break;
+			if (memcmp(p, pattern.data(), pattern.size()) == 0) {
+				visit(reinterpret_cast<uintptr_t>(p));
+				res++;
+			}
+			p++;
+		}
+		return res;
+	}
+
+	uint32_t
+	crc32(uint32_t crc, const void* data, size_t size)
+	{
+		static const std::array<uint32_t, 0x100> table = []() {
+			std::array<uint32_t, 0x100> res;
+			for (uint32_t i = 0; i < 0x100; i++) {
+				uint32_t c = i;
+				for (int j = 0; j < 8; j++)
+					c = (c >> 1) ^ (0xedb88320 & (0 - (c & 1)));
+				res[i] = c;
+			}
+			return res;
+		}();
+
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+}
+
+/** synchronous scans */
+namespace scan {
+	std::vector<uintptr_t>
+	bytes(const std::vector<Region>& regions, const std::vector<uint8_t>& pattern, size_t threads)
+	{
+		if (pattern.empty())
+			return std::vector<uintptr_t>();
+
+		auto items = parallel::shard(coalesce(regions), stride, pattern.size() - 1);
+		return parallel::collect<uintptr_t>(items, threads, [&pattern](const parallel::Item& item, std::vector<uintptr_t>& hits) {
+			bytes(item.base, item.size + item.overlap, pattern, [&hits](uintptr_t ea) { hits.push_back(ea); });
+		});
+	}
+
+	std::vector<SignatureSet::Hit>
+	signatures(const std::vector<Region>& regions, const SignatureSet& set, size_t threads)
+	{
+		auto items = parallel::shard(coalesce(regions), stride, set.longest() - 1);
+		return parallel::collect<SignatureSet::Hit>(items, threads, [&set](const parallel::Item& item, std::vector<SignatureSet::Hit>& hits) {
+			set.scan(item.base, item.size, item.overlap, [&hits](const SignatureSet::Hit& hit) { hits.push_back(hit); });
+			std::sort(hits.begin(), hits.end());
+		});
+	}
+}
+
+/** jobs */
+namespace scan {
+	void
+	executables(Job& job, const std::vector<Region>& regions)
+	{
+		job.progress(0, regions.size());
+
+		for (auto& r : regions) {
+			if (job.interrupted())
+				return;
+			job.advance(1);
+
+			if (!r.readable() || r.size < sizeof(uint16_t))
+				continue;
+
+			// a region can disappear while we're scanning it, so treat a fault as a miss
+			try {
+				if (*reinterpret_cast<const uint16_t*>(r.base) == 0x5a4d)
+					job.emit(format(r.base));
+			}
+			catch (...) {
+				continue;
+			}
+		}
+	}
+
+	void
+	bytes(Job& job, const std::vector<Region>& regions, const std::vector<uint8_t>& pattern, size_t threads)
+	{
+		auto spans = coalesce(regions);
+		auto items = parallel::shard(spans, stride, pattern.size() - 1);
+		job.progress(0, total(spans));
+
+		parallel::run<uintptr_t>(items, threads,
+			[&job, &pattern](const parallel::Item& item, std::vector<uintptr_t>& hits) {
+				bytes(item.base, item.size + item.overlap, pattern, [&hits](uintptr_t ea) { hits.push_back(ea); });
+				job.advance(item.size);
+			},
+			[&job](std::vector<uintptr_t>& hits) {
+				for (auto ea : hits)
+					job.emit(format(ea));
+			},
+			[&job]() { return job.interrupted(); }
+		);
+	}
+
+	void
+	crc32(Job& job, const std::vector<Region>& regions, size_t blocksize)
+	{
+		auto spans = coalesce(regions);
+		job.progress(0, total(spans));
+
+		if (blocksize == 0)
+			throw std::invalid_argument("blocksize");
+
+		for (auto& r : spans) {
+			for (size_t offset = 0; offset < r.size; offset += blocksize) {
+				if (job.interrupted())
+					return;
+
+				auto count = std::min(blocksize, r.size - offset);
+				try {
+					auto crc = scan::crc32(0, reinterpret_cast<const void*>(r.base + offset), count);
+
+					std::ostringstream os;
+					os << format(r.base + offset) << " " << std::hex << std::setfill('0') << std::setw(8) << crc;
+					job.emit(os.str());
+				}
+				catch (...) {
+				}
+				job.advance(count);
+			}
+		}
+	}
+
+	void
+	signatures(Job& job, const std::vector<Region>& regions, std::shared_ptr<const SignatureSet> set, size_t threads)
+	{
+		auto spans = coalesce(regions);
+		auto items = parallel::shard(spans, stride, set->longest() - 1);
+		job.progress(0, total(spans));
+
+		parallel::run<SignatureSet::Hit>(items, threads,
+			[&job, &set](const parallel::Item& item, std::vector<SignatureSet::Hit>& hits) {
+				set->scan(item.base, item.size, item.overlap, [&hits](const SignatureSet::Hit& hit) { hits.push_back(hit); });
+				std::sort(hits.begin(), hits.end());
+				job.advance(item.size);
+			},
+			[&job](std::vector<SignatureSet::Hit>& hits) {
+				for (auto& hit : hits)
+					job.emit(format(hit));
+			},
+			[&job]() { return job.interrupted(); }
+		);
+	}
+}
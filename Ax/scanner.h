@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "regions.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "signatures.h"
+
+/** memory scanning kernels */
+namespace scan {
+	/* type-definitions */
+	typedef std::function<void(uintptr_t)> visitor;
+
+	/* utilities */
+	std::vector<Region> coalesce(const std::vector<Region>& regions);
+	std::vector<uint8_t> parse(const std::string& hex);
+	std::string format(uintptr_t ea);
+	std::string format(const SignatureSet::Hit& hit);
+	uint64_t total(const std::vector<Region>& regions);
+
+	/* synchronous scans that are sharded across `threads` workers */
+	std::vector<uintptr_t> bytes(const std::vector<Region>& regions, const std::vector<uint8_t>& pattern, size_t threads);
+	std::vector<SignatureSet::Hit> signatures(const std::vector<Region>& regions, const SignatureSet& set, size_t threads);
+
+	/* kernels */
+	size_t bytes(uintptr_t ea, size_t size, const std::vector<uint8_t>& pattern, visitor visit);
+	uint32_t crc32(uint32_t crc, const void* data, size_t size);
+
+	/* jobs that operate on a list of regions */
+	void executables(Job& job, const std::vector<Region>& regions);
+	void bytes(Job& job, const std::vector<Region>& regions, const std::vector<uint8_t>& pattern, size_t threads);
+	void crc32(Job& job, const std::vector<Region>& regions, size_t blocksize);
+	void signatures(Job& job, const std::vector<Region>& regions, std::shared_ptr<const SignatureSet> set, size_t threads);
+}
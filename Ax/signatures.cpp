@@ -0,0 +1,248 @@
+#include <cctype>
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+
+#include "signatures.h"
+
+/** utilities */
+namespace {
+	int
+	nibble(char ch)
+	{
+		if (ch >= '0' && ch <= '9')
+			return ch - '0';
+		if (ch >= 'a' && ch <= 'f')
+			return ch - 'a' + 10;
+		if (ch >= 'A' && ch <= 'F')
+			return ch - 'A' + 10;
+		return -1;
+	}
+}
+
+/** Signature */
+bool
+Signature::matches(const uint8_t* p) const
+{
+	for (size_t i = 0; i < value.size(); i++)
+		if ((p[i] & mask[i]) != value[i])
+			return false;
+	return true;
+}
+
+/** SignatureSet */
+SignatureSet::SignatureSet(const std::string& source) : m_longest(0)
+{
+	std::istringstream is(source);
+	std::string line;
+
+	// every line is a signature whose id is its line number, blank lines are skipped
+	for (uint32_t id = 0; std::getline(is, line); id++) {
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		m_signatures.push_back(parse(id, line));
+		m_longest = std::max(m_longest, m_signatures.back().value.size());
+	}
+
+	if (m_signatures.empty())
+		throw std::invalid_argument("no signatures");
+	compile();
+}
+
+/*
+	A signature is a list of hex bytes where either nibble may be a "?" to
+	match anything. It may be prefixed with "^" to anchor it to a page
+	boundary, or "^N" to anchor it to an alignment of N (in hex).
+
+		^ 4d 5a 9? 00
+		^10 55 8b ec
+*/
+Signature
+SignatureSet::parse(uint32_t id, const std::string& text)
+{
+	Signature res;
+	std::string nibbles;
+	size_t i = text.find_first_not_of(" \t\r");
+
+	res.id = id;
+	res.alignment = 0;
+
+	if (i != std::string::npos && text[i] == '^') {
+		auto stop = text.find_first_of(" \t", ++i);
+		auto alignment = text.substr(i, (stop == std::string::npos) ? std::string::npos : stop - i);
+		res.alignment = alignment.empty() ? 0x1000 : std::stoul(alignment, nullptr, 16);
+		if (res.alignment == 0)
+			throw std::invalid_argument(text);
+		i = stop;
+	}
+
+	for (; i != std::string::npos && i < text.size(); i++) {
+		auto ch = text[i];
+		if (isspace(static_cast<unsigned char>(ch)))
+			continue;
+		if (ch != '?' && nibble(ch) < 0)
+			throw std::invalid_argument(text);
+		nibbles.push_back(ch);
+	}
+
+	if (nibbles.empty() || nibbles.size() % 2)
+		throw std::invalid_argument(text);
+
+	for (size_t n = 0; n < nibbles.size(); n += 2) {
+		auto hi = nibbles[n], lo = nibbles[n + 1];
+		res.value.push_back(static_cast<uint8_t>(((hi == '?') ? 0 : nibble(hi) << 4) | ((lo == '?') ? 0 : nibble(lo))));
+		res.mask.push_back(static_cast<uint8_t>(((hi == '?') ? 0 : 0xf0) | ((lo == '?') ? 0 : 0x0f)));
+	}
+
+	// find the longest run of exact bytes to use as the key
+	res.key_offset = res.key_length = 0;
+	for (size_t start = 0, n = 0; n <= res.mask.size(); n++) {
+		if (n < res.mask.size() && res.mask[n] == 0xff)
+			continue;
+		if (n - start > res.key_length) {
+			res.key_offset = start;
+			res.key_length = n - start;
+		}
+		start = n + 1;
+	}
+
+	if (res.key_length == 0)
+		throw std::invalid_argument(text);
+	return res;
+}
+
+void
+SignatureSet::compile()
+{
+	std::vector<std::array<int32_t, 0x100>> trie(1);
+	std::vector<std::vector<uint32_t>> outputs(1);
+	trie[0].fill(-1);
+
+	// build a trie out of each signature's key
+	for (uint32_t index = 0; index < m_signatures.size(); index++) {
+		auto& sig = m_signatures[index];
+		size_t state = 0;
+		for (size_t i = 0; i < sig.key_length; i++) {
+			auto ch = sig.value[sig.key_offset + i];
+			if (trie[state][ch] < 0) {
+				trie[state][ch] = static_cast<int32_t>(trie.size());
+				trie.emplace_back();
+				trie.back().fill(-1);
+				outputs.emplace_back();
+			}
+			state = trie[state][ch];
+		}
+		outputs[state].push_back(index);
+	}
+
+	// walk it breadth-first to resolve the failure links into a complete transition table
+	const size_t count = trie.size();
+	std::vector<uint32_t> fail(count, 0);
+	std::deque<uint32_t> queue;
+
+	m_delta.assign(count * 0x100, 0);
+	for (int ch = 0; ch < 0x100; ch++) {
+		auto next = trie[0][ch];
+		if (next < 0)
+			continue;
+		m_delta[ch] = next;
+		queue.push_back(next);
+	}
+
+	while (!queue.empty()) {
+		auto state = queue.front();
+		queue.pop_front();
+
+		auto& inherited = outputs[fail[state]];
+		outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+
+		for (int ch = 0; ch < 0x100; ch++) {
+			auto next = trie[state][ch];
+			auto fallback = m_delta[fail[state] * 0x100 + ch];
+			if (next < 0) {
+				m_delta[state * 0x100 + ch] = fallback;
+				continue;
+			}
+			fail[next] = fallback;
+			m_delta[state * 0x100 + ch] = next;
+			queue.push_back(next);
+		}
+	}
+
+	// flatten the outputs so that each state is a range
+	m_outputs.clear();
+	m_first.clear();
+	for (auto& items : outputs) {
+		m_first.push_back(static_cast<uint32_t>(m_outputs.size()));
+		m_outputs.insert(m_outputs.end(), items.begin(), items.end());
+	}
+	m_first.push_back(static_cast<uint32_t>(m_outputs.size()));
+}
+
+size_t
+SignatureSet::scan(uintptr_t ea, size_t size, size_t overlap, visitor visit) const
+{
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(ea);
+	const size_t window = size + overlap;
+	const uint32_t* delta = m_delta.data();
+	const uint32_t* first = m_first.data();
+	size_t res = 0;
+	uint32_t state = 0;
+
+	for (size_t i = 0; i < window; i++) {
+		state = delta[state * 0x100 + p[i]];
+		if (first[state] == first[state + 1])
+			continue;
+
+		// the key ends at i, so work backwards to where each candidate starts
+		for (auto n = first[state]; n < first[state + 1]; n++) {
+			auto& sig = m_signatures[m_outputs[n]];
+			auto end = i + 1;
+			if (end < sig.key_offset + sig.key_length)
+				continue;
+
+			auto start = end - sig.key_length - sig.key_offset;
+			if (start >= size || start + sig.value.size() > window)
+				continue;
+			if (sig.alignment && (ea + start) % sig.alignment)
+				continue;
+			if (!sig.matches(p + start))
+				continue;
+
+			Hit hit = { ea + start, sig.id };
+			visit(hit);
+			res++;
+		}
+	}
+	return res;
+}
+
+/** SignatureCache */
+std::shared_ptr<const SignatureSet>
+SignatureCache::get(const std::string& source)
+{
+	{
+		ReadLock lock(m_lock);
+		auto it = m_sets.find(source);
+		if (it != m_sets.end())
+			return it->second;
+	}
+
+	// compile it outside the lock since this can take a while
+	auto res = std::make_shared<const SignatureSet>(source);
+
+	WriteLock lock(m_lock);
+	if (m_sets.size() >= m_capacity)
+		m_sets.clear();
+	m_sets[source] = res;
+	return res;
+}
+
+void
+SignatureCache::clear()
+{
+	WriteLock lock(m_lock);
+	m_sets.clear();
+}
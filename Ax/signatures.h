@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "threading.h"
+
+/** a single byte signature with wildcard nibbles */
+struct Signature {
+	uint32_t id;
+	std::vector<uint8_t> value;
+	std::vector<uint8_t> mask;	// bits that have to match
+	size_t alignment;			// non-zero if the match has to start on this boundary
+
+	// the longest run of fully-specified bytes, which is what the automaton looks for
+	size_t key_offset, key_length;
+
+	bool matches(const uint8_t* p) const;
+};
+
+/** a set of signatures that are compiled into a single Aho-Corasick automaton */
+class SignatureSet {
+public:
+	/* type-definitions */
+	struct Hit {
+		uintptr_t address;
+		uint32_t id;
+
+		bool operator<(const Hit& other) const {
+			return address < other.address || (address == other.address && id < other.id);
+		}
+	};
+	typedef std::function<void(const Hit&)> visitor;
+
+private:
+	/* private members */
+	std::vector<Signature> m_signatures;
+	size_t m_longest;
+
+	std::vector<uint32_t> m_delta;		// state * 256 + byte -> state
+	std::vector<uint32_t> m_outputs;	// indices into m_signatures, grouped by state
+	std::vector<uint32_t> m_first;		// state -> first index into m_outputs (with a sentinel at the end)
+
+	void compile();
+
+public:
+	/* scoping methods */
+	SignatureSet(const std::string& source);
+	~SignatureSet() {}
+
+	/* methods */
+	static Signature parse(uint32_t id, const std::string& text);
+
+	size_t size() const { return m_signatures.size(); }
+	size_t states() const { return m_first.empty() ? 0 : m_first.size() - 1; }
+	size_t longest() const { return m_longest; }
+
+	// Scan [ea, ea+size+overlap) reporting every match that starts before ea+size
+	size_t scan(uintptr_t ea, size_t size, size_t overlap, visitor visit) const;
+};
+
+/** compiled signature sets keyed by their source so that repeated scans don't recompile them */
+class SignatureCache {
+private:
+	/* private members */
+	mutable ReadWriteLock m_lock;
+	std::map<std::string, std::shared_ptr<const SignatureSet>> m_sets;
+	size_t m_capacity;
+
+public:
+	/* scoping methods */
+	SignatureCache(size_t capacity = 16) : m_capacity(capacity) {}
+	~SignatureCache() {}
+
+	/* methods */
+	std::shared_ptr<const SignatureSet> get(const std::string& source);
+	void clear();
+};
@@ -0,0 +1,85 @@
+#include <cstring>
+
+#include "sink.h"
+
+/** WideBuffer */
+WideBuffer::WideBuffer()
+{
+	setp(m_narrow, m_narrow + sizeof(m_narrow));
+}
+
+void
+WideBuffer::widen()
+{
+	auto count = static_cast<size_t>(pptr() - pbase());
+	if (count == 0)
+		return;
+
+	auto p = reinterpret_cast<const unsigned char*>(pbase());
+	m_data.insert(m_data.end(), p, p + count);
+	setp(m_narrow, m_narrow + sizeof(m_narrow));
+}
+
+WideBuffer::int_type
+WideBuffer::overflow(int_type ch)
+{
+	widen();
+	if (traits_type::eq_int_type(ch, traits_type::eof()))
+		return traits_type::not_eof(ch);
+
+	*pptr() = traits_type::to_char_type(ch);
+	pbump(1);
+	return ch;
+}
+
+std::streamsize
+WideBuffer::xsputn(const char* s, std::streamsize n)
+{
+	// anything that won't fit in what's left of the narrow area goes straight to the wide buffer
+	if (n <= epptr() - pptr()) {
+		memcpy(pptr(), s, static_cast<size_t>(n));
+		pbump(static_cast<int>(n));
+		return n;
+	}
+
+	widen();
+	append(s, static_cast<size_t>(n));
+	return n;
+}
+
+int
+WideBuffer::sync()
+{
+	widen();
+	return 0;
+}
+
+void
+WideBuffer::reset()
+{
+	m_data.clear();
+	setp(m_narrow, m_narrow + sizeof(m_narrow));
+}
+
+void
+WideBuffer::append(const char* s, size_t n)
+{
+	widen();
+
+	auto p = reinterpret_cast<const unsigned char*>(s);
+	m_data.insert(m_data.end(), p, p + n);
+}
+
+const char16_t*
+WideBuffer::data()
+{
+	widen();
+	return m_data.data();
+}
+
+size_t
+WideBuffer::size()
+{
+	widen();
+	return m_data.size();
+}
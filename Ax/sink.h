@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/*
+	A stream buffer that widens everything that's written to it into UTF-16.
+	Characters are collected in a small narrow area and then widened a block
+	at a time, so formatting never has to go through an intermediate string.
+	Resetting it keeps its capacity so that it can be reused for each call.
+*/
+class WideBuffer : public std::streambuf {
+private:
+	/* private members */
+	std::vector<char16_t> m_data;
+	char m_narrow[0x400];
+
+	void widen();
+
+protected:
+	/* std::streambuf */
+	int_type overflow(int_type ch) override;
+	std::streamsize xsputn(const char* s, std::streamsize n) override;
+	int sync() override;
+
+public:
+	/* scoping methods */
+	WideBuffer();
+	~WideBuffer() {}
+
+	WideBuffer(const WideBuffer&) = delete;
+	WideBuffer& operator=(const WideBuffer&) = delete;
+
+	/* methods */
+	void reset();
+	void append(const char* s, size_t n);
+
+	const char16_t* data();
+	size_t size();
+};
+
+/** an output stream that writes into a WideBuffer */
+class WideStream : public std::ostream {
+private:
+	/* private members */
+	WideBuffer m_buffer;
+
+public:
+	/* scoping methods */
+	WideStream() : std::ostream(&m_buffer) {}
+	~WideStream() {}
+
+	/* methods */
+	WideBuffer& buffer() { return m_buffer; }
+
+	void reset() {
+		m_buffer.reset();
+		clear();
+	}
+};
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "snapshot.h"
+#include "scanner.h"
+#include "parallel.h"
+
+/** utilities */
+namespace {
+	const uint64_t prime1 = 0x9e3779b185ebca87ull;
+	const uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+	const size_t blocksize = 0x100000;
+
+	inline uint64_t
+	load(const uint8_t* p)
+	{
+		uint64_t res;
+		memcpy(&res, p, sizeof(res));
+		return res;
+	}
+
+	inline uint64_t
+	mix(uint64_t acc, uint64_t value)
+	{
+		acc += value * prime2;
+		acc = (acc << 31) | (acc >> 33);
+		return acc * prime1;
+	}
+
+	/* the address ranges that are covered by both lists */
+	std::vector<Region>
+	intersect(const std::vector<Region>& a, const std::vector<Region>& b)
+	{
+		std::vector<Region> res;
+		for (size_t i = 0, j = 0; i < a.size() && j < b.size(); ) {
+			auto start = (std::max)(a[i].base, b[j].base);
+			auto stop = (std::min)(a[i].end(), b[j].end());
+			if (start < stop) {
+				Region r = a[i];
+				r.base = start;
+				r.size = stop - start;
+				res.push_back(r);
+			}
+			if (a[i].end() < b[j].end())
+				i++;
+			else
+				j++;
+		}
+		return res;
+	}
+
+	/* merge runs of adjacent pages back into spans */
+	std::vector<Region>
+	spans(const std::vector<Snapshot::Page>& pages)
+	{
+		std::vector<Region> res;
+		for (auto& page : pages) {
+			if (!res.empty() && res.back().end() == page.address) {
+				res.back().size += Snapshot::pagesize;
+				continue;
+			}
+			Region r = {};
+			r.base = r.allocation = page.address;
+			r.size = Snapshot::pagesize;
+			r.state = memory::state_commit;
+			r.protect = memory::protect_readonly;
+			res.push_back(r);
+		}
+		return res;
+	}
+
+	std::vector<Snapshot::Page>::iterator
+	locate(std::vector<Snapshot::Page>& pages, uintptr_t ea)
+	{
+		return std::lower_bound(pages.begin(), pages.end(), ea, [](const Snapshot::Page& page, uintptr_t ea) { return page.address < ea; });
+	}
+}
+
+/** Snapshot */
+Snapshot::Snapshot(const std::vector<Region>& regions, size_t threads)
+{
+	std::vector<Page> layout;
+
+	// lay out every page up front so that each worker can copy into its own piece of the contents
+	auto spans = scan::coalesce(regions);
+	for (auto& r : spans) {
+		auto start = r.base & ~(pagesize - 1);
+		for (auto ea = start; ea < r.end(); ea += pagesize) {
+			Page page = { ea, 0, layout.size() * pagesize };
+			layout.push_back(page);
+		}
+	}
+	m_contents.resize(layout.size() * pagesize);
+
+	// every page is read by itself so that one which faults is marked as unread without losing the rest of the piece
+	const size_t unread = ~static_cast<size_t>(0);
+	auto items = parallel::shard(::spans(layout), blocksize, 0);
+	auto pages = parallel::collect<Page>(items, threads, [this, &layout, unread](const parallel::Item& item, std::vector<Page>& hits) {
+		for (auto it = locate(layout, item.base); it != layout.end() && it->address < item.base + item.size; ++it) {
+			auto p = &m_contents[it->offset];
+			Page page = *it;
+			try {
+				memcpy(p, reinterpret_cast<const void*>(it->address), pagesize);
+			}
+			catch (...) {
+				page.offset = unread;
+				hits.push_back(page);
+				continue;
+			}
+
+			page.hash = hash(p, pagesize);
+			hits.push_back(page);
+		}
+	});
+
+	for (auto& page : pages)
+		if (page.offset == unread)
+			m_missing.push_back(page.address);
+		else
+			m_pages.push_back(page);
+}
+
+/*
+	A 64-bit hash that keeps four independent lanes so that a page can be
+	hashed at close to the rate it can be read.
+*/
+uint64_t
+Snapshot::hash(const void* data, size_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint64_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+	size_t i = 0;
+
+	for (; i + 32 <= size; i += 32) {
+		lanes[0] = mix(lanes[0], load(p + i));
+		lanes[1] = mix(lanes[1], load(p + i + 8));
+		lanes[2] = mix(lanes[2], load(p + i + 16));
+		lanes[3] = mix(lanes[3], load(p + i + 24));
+	}
+
+	uint64_t res = size;
+	for (auto lane : lanes)
+		res = mix(res, lane);
+	for (; i < size; i++)
+		res = mix(res, p[i]);
+
+	res ^= res >> 33;
+	res *= prime2;
+	res ^= res >> 29;
+	return res;
+}
+
+std::vector<Snapshot::Range>
+Snapshot::compare(const uint8_t* before, const uint8_t* after, size_t size)
+{
+	std::vector<Range> res;
+	size_t i = 0;
+
+	while (i < size) {
+		// skip the identical bytes a word at a time
+		while (i + sizeof(uint64_t) <= size && load(before + i) == load(after + i))
+			i += sizeof(uint64_t);
+		while (i < size && before[i] == after[i])
+			i++;
+		if (i >= size)
+			break;
+
+		Range range = { i, 0 };
+		while (i < size && before[i] != after[i])
+			i++;
+		range.size = i - range.offset;
+		res.push_back(range);
+	}
+	return res;
+}
+
+/*
+	A change is written as the page address followed by its kind. A modified
+	page is followed by each of its changed ranges as "offset:size" in hex.
+
+		00007ff6a0001000 modified 10:8 ff0:4
+		00007ff6a0002000 missing
+*/
+std::string
+Snapshot::format(const Change& change)
+{
+	std::ostringstream os;
+
+	os << scan::format(change.page) << ((change.kind == Change::modified) ? " modified" : " missing");
+	os << std::hex;
+	for (auto& range : change.ranges)
+		os << " " << range.offset << ":" << range.size;
+	return os.str();
+}
+
+std::vector<Snapshot::Change>
+Snapshot::diff(const std::vector<Region>& current, size_t threads, bool update)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	std::vector<Change> res;
+
+	// only compare the pages that can still be read, and everything else is missing
+	auto live = intersect(spans(m_pages), scan::coalesce(current));
+
+	// the pages that couldn't be captured are missing from the start
+	for (auto ea : m_missing) {
+		Change change = { Change::missing, ea, {} };
+		res.push_back(change);
+	}
+
+	std::vector<bool> present(m_pages.size(), false);
+	auto span = live.begin();
+	for (size_t i = 0; i < m_pages.size(); i++) {
+		auto& page = m_pages[i];
+		while (span != live.end() && span->end() <= page.address)
+			++span;
+		present[i] = span != live.end() && span->contains(page.address);
+		if (present[i])
+			continue;
+		Change change = { Change::missing, page.address, {} };
+		res.push_back(change);
+	}
+
+	/*
+		An unchanged page costs a hash, and only a changed one gets copied out
+		and compared against what was captured. Every read of the page is done
+		by itself so that a page which faults is reported as missing without
+		losing the rest of the item, and the capture is only updated from the
+		copy so that a fault can't leave a page of it half-written.
+	*/
+	auto items = parallel::shard(live, blocksize, 0);
+	auto changes = parallel::collect<Change>(items, threads, [this, update](const parallel::Item& item, std::vector<Change>& hits) {
+		std::vector<uint8_t> buffer(pagesize);
+		for (auto it = locate(m_pages, item.base); it != m_pages.end() && it->address < item.base + item.size; ++it) {
+			auto p = reinterpret_cast<const uint8_t*>(it->address);
+			try {
+				if (hash(p, pagesize) == it->hash)
+					continue;
+				memcpy(buffer.data(), p, pagesize);
+			}
+			catch (...) {
+				Change change = { Change::missing, it->address, {} };
+				hits.push_back(change);
+				continue;
+			}
+
+			auto q = &m_contents[it->offset];
+			Change change = { Change::modified, it->address, compare(q, buffer.data(), pagesize) };
+			if (change.ranges.empty())
+				continue;
+			hits.push_back(change);
+
+			if (update) {
+				memcpy(q, buffer.data(), pagesize);
+				it->hash = hash(q, pagesize);
+			}
+		}
+	});
+
+	// the missing pages are dropped so that they're only reported once
+	size_t dropped = res.size() - m_missing.size();
+	for (auto& change : changes) {
+		if (change.kind != Change::missing)
+			continue;
+		present[locate(m_pages, change.page) - m_pages.begin()] = false;
+		dropped++;
+	}
+
+	if (update)
+		m_missing.clear();
+	if (update && dropped) {
+		std::vector<Page> remaining;
+		for (size_t i = 0; i < m_pages.size(); i++)
+			if (present[i])
+				remaining.push_back(m_pages[i]);
+		m_pages.swap(remaining);
+	}
+
+	res.insert(res.end(), changes.begin(), changes.end());
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+size_t
+Snapshot::read(uintptr_t address, void* buffer, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	auto out = static_cast<uint8_t*>(buffer);
+	size_t res = 0;
+	for (auto it = locate(m_pages, address - address % pagesize); res < size; ++it) {
+		auto ea = address + res;
+		if (it == m_pages.end() || it->address != ea - ea % pagesize)
+			break;
+		auto offset = ea - it->address;
+		auto count = (std::min)(size - res, pagesize - offset);
+		memcpy(out + res, &m_contents[it->offset + offset], count);
+		res += count;
+	}
+	return res;
+}
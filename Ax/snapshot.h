@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "regions.h"
+#include "threading.h"
+
+/** a page-granular capture of memory that can be compared against what's there now */
+class Snapshot {
+public:
+	/* type-definitions */
+	static const size_t pagesize = 0x1000;
+
+	struct Page {
+		uintptr_t address;
+		uint64_t hash;
+		size_t offset;		// into the captured contents
+	};
+
+	struct Range {
+		size_t offset;		// relative to the page
+		size_t size;
+	};
+
+	struct Change {
+		enum kind_t { modified, missing } kind;
+		uintptr_t page;
+		std::vector<Range> ranges;
+
+		bool operator<(const Change& other) const { return page < other.page; }
+	};
+
+private:
+	/* private members */
+	std::mutex m_lock;
+	std::vector<Page> m_pages;		// sorted by address
+	std::vector<uintptr_t> m_missing;	// pages that faulted while being captured
+	std::vector<uint8_t> m_contents;
+
+public:
+	/* scoping methods */
+	Snapshot(const std::vector<Region>& regions, size_t threads);
+	~Snapshot() {}
+
+	Snapshot(const Snapshot&) = delete;
+	Snapshot& operator=(const Snapshot&) = delete;
+
+	/* methods */
+	static uint64_t hash(const void* data, size_t size);
+	static std::vector<Range> compare(const uint8_t* before, const uint8_t* after, size_t size);
+	static std::string format(const Change& change);
+
+	// Compare every captured page against `current` (the regions that are readable now), where a page that
+	// isn't in it, that faults, or that faulted while being captured is missing. If `update` is set, then the
+	// snapshot takes on the new contents and drops the missing pages so that the next diff is relative to this one.
+	std::vector<Change> diff(const std::vector<Region>& current, size_t threads, bool update);
+
+	// Copy captured contents, stopping at the first page that wasn't captured.
+	size_t read(uintptr_t address, void* buffer, size_t size);
+
+	size_t pages() const { return m_pages.size(); }
+};
+
+/** the snapshots that have been captured by a client */
+typedef HandleTable<Snapshot> SnapshotTable;
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <sstream>
+
+#include "stats.h"
+
+/** Histogram */
+size_t
+Histogram::bucket(uint64_t value)
+{
+	size_t res = 0;
+	while (value > 1 && res < buckets - 1) {
+		value >>= 1;
+		res++;
+	}
+	return res;
+}
+
+void
+Histogram::record(uint64_t value)
+{
+	m_counts[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_sum.fetch_add(value, std::memory_order_relaxed);
+
+	auto maximum = m_max.load(std::memory_order_relaxed);
+	while (value > maximum && !m_max.compare_exchange_weak(maximum, value, std::memory_order_relaxed))
+		;
+}
+
+void
+Histogram::reset()
+{
+	for (auto& count : m_counts)
+		count.store(0, std::memory_order_relaxed);
+	m_count = m_sum = m_max = 0;
+}
+
+uint64_t
+Histogram::percentile(double fraction) const
+{
+	uint64_t total = 0;
+	for (auto& count : m_counts)
+		total += count.load(std::memory_order_relaxed);
+	if (total == 0)
+		return 0;
+
+	// find the first bucket where the running total reaches the requested rank, where the whole of it is the last sample
+	auto rank = (std::min)(static_cast<uint64_t>(fraction * total), total - 1);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < buckets; i++) {
+		seen += m_counts[i].load(std::memory_order_relaxed);
+		if (seen > rank)
+			return (i + 1 < buckets) ? (uint64_t(1) << (i + 1)) - 1 : UINT64_MAX;
+	}
+	return UINT64_MAX;
+}
+
+/** MethodStats */
+const char*
+MethodStats::name(phase_t phase)
+{
+	static const char* names[] = { "guard", "engine", "conversion", "total" };
+	return names[phase];
+}
+
+void
+MethodStats::reset()
+{
+	calls = bytes = faults = 0;
+	for (auto& histogram : latency)
+		histogram.reset();
+}
+
+/*
+	A method is written as its counters followed by each phase that has been
+	timed. A phase is its sample count, mean, median, 99th percentile, and
+	maximum in nanoseconds. The percentiles are bucket upper bounds.
+
+		calls=3 bytes=48 faults=0 total=3:812:1023:2047:1402 engine=3:530:1023:1023:911
+*/
+std::string
+MethodStats::format() const
+{
+	std::ostringstream os;
+
+	static const phase_t order[] = { total, guard, engine, conversion };
+
+	os << "calls=" << calls.load() << " bytes=" << bytes.load() << " faults=" << faults.load();
+	for (auto phase : order) {
+		auto& histogram = latency[phase];
+		if (histogram.count() == 0)
+			continue;
+		os << " " << name(phase) << "=" << histogram.count() << ":" << histogram.sum() / histogram.count();
+		os << ":" << histogram.percentile(0.5) << ":" << histogram.percentile(0.99) << ":" << histogram.maximum();
+	}
+	return os.str();
+}
+
+/** Statistics */
+MethodStats&
+Statistics::method(const std::string& name)
+{
+	{
+		ReadLock lock(m_lock);
+		auto it = m_methods.find(name);
+		if (it != m_methods.end())
+			return *it->second;
+	}
+
+	WriteLock lock(m_lock);
+	auto& res = m_methods[name];
+	if (!res)
+		res.reset(new MethodStats());
+	return *res;
+}
+
+void
+Statistics::reset()
+{
+	ReadLock lock(m_lock);
+	for (auto& item : m_methods)
+		item.second->reset();
+}
+
+std::string
+Statistics::format() const
+{
+	std::ostringstream os;
+
+	ReadLock lock(m_lock);
+	for (auto& item : m_methods) {
+		if (item.second->calls.load() == 0)
+			continue;
+		os << item.first << " " << item.second->format() << "\n";
+	}
+	return os.str();
+}
+
+/** Probe */
+void
+Probe::close(clock::time_point now)
+{
+	if (m_phase >= 0)
+		m_method->latency[m_phase].record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_mark).count());
+	m_mark = now;
+}
+
+Probe::~Probe()
+{
+	if (!m_method)
+		return;
+
+	auto now = clock::now();
+	close(now);
+	m_method->latency[MethodStats::total].record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start).count());
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "threading.h"
+
+/** a latency histogram with a bucket for each power of two nanoseconds */
+class Histogram {
+public:
+	/* type-definitions */
+	static const size_t buckets = 64;
+
+private:
+	/* private members */
+	std::array<std::atomic<uint64_t>, buckets> m_counts;
+	std::atomic<uint64_t> m_count, m_sum, m_max;
+
+public:
+	/* scoping methods */
+	Histogram() { reset(); }
+	~Histogram() {}
+
+	Histogram(const Histogram&) = delete;
+	Histogram& operator=(const Histogram&) = delete;
+
+	/* methods */
+	static size_t bucket(uint64_t value);
+
+	void record(uint64_t value);
+	void reset();
+
+	uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+	uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+	uint64_t maximum() const { return m_max.load(std::memory_order_relaxed); }
+
+	// the upper bound of the bucket that contains the given fraction of the samples
+	uint64_t percentile(double fraction) const;
+};
+
+/** everything that's counted for a single method */
+struct MethodStats {
+	/* type-definitions */
+	enum phase_t { guard, engine, conversion, total, phases };
+
+	/* members */
+	std::atomic<uint64_t> calls, bytes, faults;
+	Histogram latency[phases];
+
+	MethodStats() : calls(0), bytes(0), faults(0) {}
+
+	static const char* name(phase_t phase);
+	void reset();
+	std::string format() const;
+};
+
+/** the statistics for each method, which are only collected while enabled */
+class Statistics {
+private:
+	/* private members */
+	std::atomic<bool> m_enabled;
+	mutable ReadWriteLock m_lock;
+	std::map<std::string, std::unique_ptr<MethodStats>> m_methods;
+
+public:
+	/* scoping methods */
+	Statistics() : m_enabled(false) {}
+	~Statistics() {}
+
+	/* methods */
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+	void enable(bool value) { m_enabled = value; }
+
+	// Entries are never removed, so the reference can be cached by the caller.
+	MethodStats& method(const std::string& name);
+
+	void reset();
+	std::string format() const;
+};
+
+/*
+	Times a single call to a method. Each call to enter() closes the phase
+	that was being timed and starts the next one, and the destructor closes
+	the last one. If the statistics are disabled then this does nothing.
+*/
+class Probe {
+public:
+	/* type-definitions */
+	typedef std::chrono::steady_clock clock;
+
+private:
+	/* private members */
+	MethodStats* m_method;
+	clock::time_point m_start, m_mark;
+	int m_phase;
+
+	void close(clock::time_point now);
+
+public:
+	/* scoping methods */
+	Probe(const Statistics& statistics, MethodStats& method) : m_method(nullptr), m_phase(-1) {
+		if (!statistics.enabled())
+			return;
+		m_method = &method;
+		m_method->calls.fetch_add(1, std::memory_order_relaxed);
+		m_start = m_mark = clock::now();
+	}
+
+	~Probe();
+
+	Probe(const Probe&) = delete;
+	Probe& operator=(const Probe&) = delete;
+
+	/* methods */
+	void enter(MethodStats::phase_t phase) {
+		if (!m_method)
+			return;
+		auto now = clock::now();
+		close(now);
+		m_phase = phase;
+	}
+
+	void bytes(uint64_t count) {
+		if (m_method)
+			m_method->bytes.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	void fault() {
+		if (m_method)
+			m_method->faults.fetch_add(1, std::memory_order_relaxed);
+	}
+};
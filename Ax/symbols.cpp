@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstring>
+
+#include "symbols.h"
+
+namespace {
+	/* the offsets into the export directory */
+	enum {
+		export_base = 0x10,
+		export_functions = 0x14, export_names = 0x18,
+		export_addressoffunctions = 0x1c, export_addressofnames = 0x20, export_addressofnameordinals = 0x24,
+	};
+}
+
+/** SymbolTable */
+std::string
+SymbolTable::name(const std::string& path)
+{
+	auto start = path.find_last_of("\\/");
+	auto res = path.substr((start == std::string::npos) ? 0 : start + 1);
+
+	auto stop = res.rfind('.');
+	if (stop != std::string::npos && stop > 0)
+		res.erase(stop);
+	return res;
+}
+
+std::vector<SymbolTable::Export>
+SymbolTable::exports(const pe::View& image)
+{
+	std::vector<Export> res;
+
+	uint32_t rva, length;
+	if (!image.directory(pe::directory_export, rva, length))
+		return res;
+
+	auto ordinal = image.read<uint32_t>(rva + export_base);
+	auto functions = image.read<uint32_t>(rva + export_functions), names = image.read<uint32_t>(rva + export_names);
+	auto aof = image.read<uint32_t>(rva + export_addressoffunctions);
+	auto aon = image.read<uint32_t>(rva + export_addressofnames), aono = image.read<uint32_t>(rva + export_addressofnameordinals);
+
+	// check the tables up front so that a corrupt count can't make these allocations huge
+	image.offset(aof, static_cast<size_t>(functions) * sizeof(uint32_t));
+	if (names) {
+		image.offset(aon, static_cast<size_t>(names) * sizeof(uint32_t));
+		image.offset(aono, static_cast<size_t>(names) * sizeof(uint16_t));
+	}
+
+	// name each function by the first name that refers to it, and otherwise by its ordinal
+	std::vector<uint32_t> named(functions, 0);
+	for (uint32_t i = 0; i < names; i++) {
+		auto index = image.read<uint16_t>(aono + 2 * i);
+		if (index < functions && !named[index])
+			named[index] = image.read<uint32_t>(aon + 4 * i);
+	}
+
+	for (uint32_t i = 0; i < functions; i++) {
+		auto address = image.read<uint32_t>(aof + 4 * i);
+
+		// an address inside of the export directory is the name of the export it's forwarded to
+		if (address == 0 || (address >= rva && address - rva < length))
+			continue;
+
+		Export item = { address, named[i] ? image.string(named[i], 0x200) : "#" + std::to_string(ordinal + i) };
+		res.push_back(std::move(item));
+	}
+
+	// when more than one export shares an address then the first one is used
+	std::stable_sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end(), [](const Export& a, const Export& b) { return a.rva == b.rva; }), res.end());
+	return res;
+}
+
+std::vector<SymbolTable::Export>
+SymbolTable::exports(uintptr_t base, size_t size)
+{
+	try {
+		return exports(pe::View(reinterpret_cast<const void*>(base), size, true));
+	}
+	catch (...) {
+	}
+	return {};
+}
+
+size_t
+SymbolTable::refresh(const std::vector<Module>& modules, unsigned long generation)
+{
+	std::vector<Image> known;
+	{
+		ReadLock lock(m_lock);
+		known = m_images;
+	}
+
+	// an image that's at the same place with the same name doesn't need its exports parsed again
+	std::vector<Image> images;
+	for (auto& module : modules) {
+		Image image = { module.base, module.size, name(module.path), {} };
+		auto it = std::lower_bound(known.begin(), known.end(), module.base, [](const Image& image, uintptr_t ea) { return image.base < ea; });
+		if (it != known.end() && it->base == image.base && it->size == image.size && it->name == image.name)
+			image.exports.swap(it->exports);
+		else
+			image.exports = exports(module.base, module.size);
+		images.push_back(std::move(image));
+	}
+
+	auto res = assign(std::move(images));
+
+	WriteLock lock(m_lock);
+	m_source = generation;
+	return res;
+}
+
+size_t
+SymbolTable::assign(std::vector<Image> images)
+{
+	std::sort(images.begin(), images.end(), [](const Image& a, const Image& b) { return a.base < b.base; });
+	for (auto& image : images)
+		std::sort(image.exports.begin(), image.exports.end());
+
+	WriteLock lock(m_lock);
+	m_images.swap(images);
+	return m_images.size();
+}
+
+unsigned long
+SymbolTable::source() const
+{
+	ReadLock lock(m_lock);
+	return m_source;
+}
+
+/*
+	An address is written as the module and the export that precedes it, and
+	an address before the first export is written relative to the module.
+
+		ntdll!NtClose+0x14
+		ntdll+0x1000
+*/
+bool
+SymbolTable::resolve(uintptr_t ea, std::string& result) const
+{
+	static const char digits[] = "0123456789abcdef";
+	ReadLock lock(m_lock);
+
+	// find the last image that starts at or before the address
+	auto image = std::upper_bound(m_images.begin(), m_images.end(), ea, [](uintptr_t ea, const Image& image) { return ea < image.base; });
+	if (image == m_images.begin() || !(--image)->contains(ea))
+		return false;
+
+	auto rva = static_cast<uint32_t>(ea - image->base);
+	auto item = std::upper_bound(image->exports.begin(), image->exports.end(), rva, [](uint32_t rva, const Export& item) { return rva < item.rva; });
+
+	result = image->name;
+	if (item != image->exports.begin()) {
+		--item;
+		result += '!';
+		result += item->name;
+		rva -= item->rva;
+	}
+
+	// this is formatted by hand since it's done for every line of an annotated listing
+	if (rva) {
+		char buffer[2 + 2 * sizeof(rva)], *p = buffer + sizeof(buffer);
+		for (; rva; rva >>= 4)
+			*--p = digits[rva & 0xf];
+		result += "+0x";
+		result.append(p, buffer + sizeof(buffer));
+	}
+	return true;
+}
+
+bool
+SymbolTable::resolve(uintptr_t ea, std::ostream& os) const
+{
+	std::string result;
+	if (!resolve(ea, result))
+		return false;
+	os << result;
+	return true;
+}
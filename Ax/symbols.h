@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "pe.h"
+#include "regions.h"
+#include "threading.h"
+
+/** resolving an address to the module and export that contains it (module!export+offset) */
+class SymbolTable {
+public:
+	/* type-definitions */
+	struct Export {
+		uint32_t rva;
+		std::string name;
+
+		bool operator<(const Export& other) const { return rva < other.rva; }
+	};
+
+	struct Image {
+		uintptr_t base;
+		size_t size;
+		std::string name;				// the file name of the module without its extension
+		std::vector<Export> exports;	// sorted by rva
+
+		uintptr_t end() const { return base + size; }
+		bool contains(uintptr_t ea) const { return base <= ea && ea - base < size; }
+	};
+
+private:
+	/* private members */
+	mutable ReadWriteLock m_lock;
+	std::vector<Image> m_images;	// sorted by base address
+	unsigned long m_source;			// the generation of the modules that this was built from
+
+public:
+	/* scoping methods */
+	SymbolTable() : m_source(0) {}
+	~SymbolTable() {}
+
+	/* methods */
+	static std::string name(const std::string& path);
+
+	// Read the export directory of a PE image. Forwarded exports are skipped,
+	// and an export with no name is named by its ordinal.
+	static std::vector<Export> exports(const pe::View& image);		// throws std::out_of_range
+	static std::vector<Export> exports(uintptr_t base, size_t size);
+
+	// Rebuild from a list of modules, only parsing the images that weren't already known.
+	size_t refresh(const std::vector<Module>& modules, unsigned long generation);
+	size_t assign(std::vector<Image> images);
+	unsigned long source() const;
+
+	bool resolve(uintptr_t ea, std::string& result) const;
+	bool resolve(uintptr_t ea, std::ostream& os) const;
+};
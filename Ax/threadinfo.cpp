@@ -0,0 +1,313 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <winternl.h>
+#include <tlhelp32.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "threadinfo.h"
+#include "scanner.h"
+
+/** platform-specific enumeration */
+#if defined(_WIN32)
+namespace threadinfo {
+	/* the parts of the NDK that aren't in winternl.h */
+	struct THREAD_BASIC_INFORMATION {
+		LONG ExitStatus;
+		PVOID TebBaseAddress;
+		struct { PVOID UniqueProcess, UniqueThread; } ClientId;
+		KAFFINITY AffinityMask;
+		LONG Priority;
+		LONG BasePriority;
+	};
+
+	typedef NTSTATUS(WINAPI *PNtQueryInformationThread)(HANDLE ThreadHandle, ::THREADINFOCLASS ThreadInformationClass, PVOID ThreadInformation, ULONG ThreadInformationLength, PULONG ReturnLength);
+
+	/*
+		The TEB starts with an NT_TIB, which is followed by EnvironmentPointer
+		and then the ClientId. All of these are pointer-sized.
+	*/
+	enum { tib_stackbase = 1, tib_stacklimit = 2, teb_uniquethread = 9 };
+
+	std::vector<uint32_t>
+	enumerate()
+	{
+		std::vector<uint32_t> res;
+		THREADENTRY32 te;
+
+		HANDLE hSnapshot = ::CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+		if (hSnapshot == INVALID_HANDLE_VALUE)
+			return res;
+
+		// the snapshot always includes every thread in the system
+		auto pid = ::GetCurrentProcessId();
+		te.dwSize = sizeof(te);
+		for (auto ok = ::Thread32First(hSnapshot, &te); ok; ok = ::Thread32Next(hSnapshot, &te))
+			if (te.th32OwnerProcessID == pid)
+				res.push_back(te.th32ThreadID);
+
+		::CloseHandle(hSnapshot);
+		return res;
+	}
+
+	bool
+	locate(uint32_t tid, ThreadInfo& result)
+	{
+		static PNtQueryInformationThread NtQueryInformationThread = NULL;
+
+		if (NtQueryInformationThread == NULL) {
+			HMODULE hNtDll = ::GetModuleHandleW(L"ntdll.dll");
+			if (hNtDll == NULL)
+				return false;
+
+			NtQueryInformationThread = reinterpret_cast<PNtQueryInformationThread>(::GetProcAddress(hNtDll, "NtQueryInformationThread"));
+			if (NtQueryInformationThread == NULL)
+				return false;
+		}
+
+		HANDLE hThread = ::OpenThread(THREAD_QUERY_INFORMATION, FALSE, tid);
+		if (hThread == NULL)
+			return false;
+
+		THREAD_BASIC_INFORMATION info;
+		ULONG dwLength = 0;
+		memset(&info, 0, sizeof(info));
+		auto notok = NtQueryInformationThread(hThread, static_cast<::THREADINFOCLASS>(0), &info, sizeof(info), &dwLength);
+		::CloseHandle(hThread);
+
+		if (notok || dwLength < offsetof(THREAD_BASIC_INFORMATION, TebBaseAddress) + sizeof(info.TebBaseAddress))
+			return false;
+
+		result.tid = tid;
+		result.teb = reinterpret_cast<uintptr_t>(info.TebBaseAddress);
+		result.created = 0;
+		return inspect(result);
+	}
+
+	bool
+	inspect(ThreadInfo& info)
+	{
+		if (info.teb == 0)
+			return false;
+
+		// a TEB that's been freed or reused by another thread won't have the same id in its ClientId
+		try {
+			auto p = reinterpret_cast<const volatile uintptr_t*>(info.teb);
+			if (p[teb_uniquethread] != info.tid)
+				return false;
+			info.stackbase = p[tib_stackbase];
+			info.stacklimit = p[tib_stacklimit];
+		}
+		catch (...) {
+			return false;
+		}
+		return true;
+	}
+}
+#else
+namespace threadinfo {
+	// the start time of a task in clock ticks since boot, which is the 22nd field of its stat file
+	static bool
+	starttime(uint32_t tid, uint64_t& result)
+	{
+		std::ostringstream path;
+		path << "/proc/self/task/" << tid << "/stat";
+
+		std::ifstream stat(path.str());
+		std::string line;
+		if (!std::getline(stat, line))
+			return false;
+
+		// the command can contain spaces, so the fields are counted from the parenthesis that closes it
+		auto close = line.rfind(')');
+		if (close == std::string::npos)
+			return false;
+
+		std::istringstream is(line.substr(close + 1));
+		std::string field;
+		for (int i = 3; i <= 22; i++)
+			if (!(is >> field))
+				return false;
+		result = std::strtoull(field.c_str(), nullptr, 10);
+		return true;
+	}
+
+	std::vector<uint32_t>
+	enumerate()
+	{
+		std::vector<uint32_t> res;
+
+		DIR* dir = opendir("/proc/self/task");
+		if (dir == nullptr)
+			return res;
+
+		while (auto entry = readdir(dir)) {
+			char* stop;
+			auto tid = std::strtoul(entry->d_name, &stop, 10);
+			if (*stop == '\0' && stop != entry->d_name)
+				res.push_back(static_cast<uint32_t>(tid));
+		}
+		closedir(dir);
+		return res;
+	}
+
+	/*
+		There's no equivalent of a TEB that can be found for another thread, so
+		the calling thread reports its pthread descriptor and stack while every
+		other thread only reports its id.
+	*/
+	bool
+	locate(uint32_t tid, ThreadInfo& result)
+	{
+		result.tid = tid;
+		result.teb = result.stackbase = result.stacklimit = 0;
+		if (!starttime(tid, result.created))
+			return false;
+		return inspect(result);
+	}
+
+	bool
+	inspect(ThreadInfo& info)
+	{
+		uint64_t created;
+		if (!starttime(info.tid, created) || created != info.created)
+			return false;
+		if (info.tid != static_cast<uint32_t>(syscall(SYS_gettid)))
+			return true;
+
+		pthread_attr_t attr;
+		if (pthread_getattr_np(pthread_self(), &attr) != 0)
+			return true;
+
+		void* stack;
+		size_t size;
+		if (pthread_attr_getstack(&attr, &stack, &size) == 0) {
+			info.teb = static_cast<uintptr_t>(pthread_self());
+			info.stacklimit = reinterpret_cast<uintptr_t>(stack);
+			info.stackbase = info.stacklimit + size;
+		}
+		pthread_attr_destroy(&attr);
+		return true;
+	}
+}
+#endif
+
+/** ThreadTable */
+size_t
+ThreadTable::refresh()
+{
+	std::vector<ThreadInfo> threads;
+
+	// a thread that's already known only needs to be inspected, and anything that's exited is dropped
+	auto known = snapshot();
+	auto it = known.begin();
+
+	auto tids = threadinfo::enumerate();
+	std::sort(tids.begin(), tids.end());
+	for (auto tid : tids) {
+		while (it != known.end() && it->tid < tid)
+			++it;
+
+		ThreadInfo info = { tid, 0, 0, 0, 0 };
+		if (it != known.end() && it->tid == tid) {
+			info = *it;
+			if (threadinfo::inspect(info)) {
+				threads.push_back(info);
+				continue;
+			}
+		}
+
+		// threads that can't be located are still listed so that the enumeration is complete
+		if (!threadinfo::locate(tid, info))
+			info.teb = info.stackbase = info.stacklimit = 0;
+		threads.push_back(info);
+	}
+	return assign(std::move(threads));
+}
+
+size_t
+ThreadTable::assign(std::vector<ThreadInfo> threads)
+{
+	std::map<uint32_t, ThreadInfo> res;
+	for (auto& info : threads)
+		res[info.tid] = info;
+
+	WriteLock lock(m_lock);
+	m_threads.swap(res);
+	m_generation++;
+	return m_threads.size();
+}
+
+bool
+ThreadTable::find(uint32_t tid, ThreadInfo& result)
+{
+	bool cached = false;
+	{
+		ReadLock lock(m_lock);
+		auto it = m_threads.find(tid);
+		if (it != m_threads.end()) {
+			result = it->second;
+			cached = true;
+		}
+	}
+
+	if (cached && threadinfo::inspect(result))
+		return true;
+	if (!threadinfo::locate(tid, result))
+		return false;
+
+	WriteLock lock(m_lock);
+	m_threads[tid] = result;
+	return true;
+}
+
+std::vector<ThreadInfo>
+ThreadTable::snapshot() const
+{
+	std::vector<ThreadInfo> res;
+
+	ReadLock lock(m_lock);
+	res.reserve(m_threads.size());
+	for (auto& item : m_threads)
+		res.push_back(item.second);
+	return res;
+}
+
+unsigned long
+ThreadTable::generation() const
+{
+	ReadLock lock(m_lock);
+	return m_generation;
+}
+
+size_t
+ThreadTable::size() const
+{
+	ReadLock lock(m_lock);
+	return m_threads.size();
+}
+
+/*
+	A thread is written as its id followed by its environment block and the
+	base and limit of its stack. Each of them is in hex.
+
+		1a2c 000000000030f000 0000000000190000 000000000018b000
+*/
+std::string
+ThreadTable::format(const ThreadInfo& info)
+{
+	std::ostringstream os;
+	os << std::hex << info.tid << " " << scan::format(info.teb) << " " << scan::format(info.stackbase) << " " << scan::format(info.stacklimit);
+	return os.str();
+}
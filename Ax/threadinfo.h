@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "threading.h"
+
+/** a thread in this process, along with its environment block and the range of its stack */
+struct ThreadInfo {
+	uint32_t tid;
+	uintptr_t teb;
+	uintptr_t stackbase;	// the highest address of the stack
+	uintptr_t stacklimit;	// the lowest address that's been committed
+	uint64_t created;		// distinguishes a thread from a later one that reuses its id
+
+	bool contains(uintptr_t ea) const { return stacklimit <= ea && ea < stackbase; }
+};
+
+/** platform-specific enumeration */
+namespace threadinfo {
+	std::vector<uint32_t> enumerate();
+
+	// Find the environment block for `tid`, which is the expensive part.
+	bool locate(uint32_t tid, ThreadInfo& result);
+
+	// Check that the thread hasn't exited or been replaced since it was
+	// located, and re-read its stack range since the limit moves as it grows.
+	bool inspect(ThreadInfo& info);
+}
+
+/** cache of the threads in the process. a thread is only located once, and is dropped when it exits. */
+class ThreadTable {
+private:
+	/* private members */
+	mutable ReadWriteLock m_lock;
+	std::map<uint32_t, ThreadInfo> m_threads;
+	unsigned long m_generation;
+
+public:
+	/* scoping methods */
+	ThreadTable() : m_generation(0) {}
+	~ThreadTable() {}
+
+	/* methods */
+	size_t refresh();
+	size_t assign(std::vector<ThreadInfo> threads);
+
+	bool find(uint32_t tid, ThreadInfo& result);
+	std::vector<ThreadInfo> snapshot() const;
+
+	unsigned long generation() const;
+	size_t size() const;
+
+	static std::string format(const ThreadInfo& info);
+};
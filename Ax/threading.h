@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+/** synchronization primitives */
+typedef std::shared_timed_mutex ReadWriteLock;
+typedef std::shared_lock<ReadWriteLock> ReadLock;
+typedef std::unique_lock<ReadWriteLock> WriteLock;
+
+/** per-thread instances of some engine state */
+
+/*
+	Each thread keeps a thread_local cache of the slots that it owns, so
+	that finding its own instance doesn't take a lock. A slot is released
+	when the thread that owns it exits, and the cache is keyed by an id
+	that's never reused so that a new instance (or one that was cleared)
+	can't be handed a stale slot.
+*/
+template <typename T>
+class PerThread {
+public:
+	/* type-definitions */
+	typedef std::function<T*()> factory;
+
+private:
+	// the slots of every thread, which outlive the instance for as long as a thread is releasing its own
+	struct State {
+		std::mutex lock;
+		std::unordered_map<const void*, std::unique_ptr<T>> slots;	// keyed by the owning thread's cache
+	};
+
+	struct Entry {
+		unsigned long long id;
+		T* slot;
+		std::weak_ptr<State> state;
+	};
+
+	// the slots that belong to the calling thread, which are released when it exits
+	struct Cache {
+		std::vector<Entry> entries;
+
+		~Cache() {
+			for (auto& entry : entries) {
+				auto state = entry.state.lock();
+				if (!state)
+					continue;
+				std::lock_guard<std::mutex> lock(state->lock);
+				state->slots.erase(this);
+			}
+		}
+	};
+
+	static Cache& cache() {
+		static thread_local Cache res;
+		return res;
+	}
+
+	static unsigned long long next() {
+		static std::atomic<unsigned long long> counter(1);
+		return counter++;
+	}
+
+	/* private members */
+	std::shared_ptr<State> m_state;
+	std::atomic<unsigned long long> m_id;
+	factory m_factory;
+
+public:
+	/* scoping methods */
+	PerThread(factory f) : m_state(std::make_shared<State>()), m_id(next()), m_factory(f) {}
+	~PerThread() {}
+
+	PerThread(const PerThread&) = delete;
+	PerThread& operator=(const PerThread&) = delete;
+
+	/* methods */
+
+	// Return the instance that belongs to the calling thread, creating it if necessary.
+	T& get() {
+		const auto id = m_id.load(std::memory_order_acquire);
+		auto& entries = cache().entries;
+		for (auto& entry : entries)
+			if (entry.id == id)
+				return *entry.slot;
+
+		std::unique_ptr<T> slot(m_factory());
+		auto res = slot.get();
+		{
+			std::lock_guard<std::mutex> lock(m_state->lock);
+			m_state->slots[&cache()] = std::move(slot);
+		}
+
+		// forget any entries for instances that are gone or that were cleared since this thread last used them
+		auto state = m_state.get();
+		entries.erase(std::remove_if(entries.begin(), entries.end(), [state](const Entry& entry) {
+			auto owner = entry.state.lock();
+			return !owner || owner.get() == state;
+		}), entries.end());
+
+		Entry entry = { id, res, m_state };
+		entries.push_back(entry);
+		return *res;
+	}
+
+	size_t size() const {
+		std::lock_guard<std::mutex> lock(m_state->lock);
+		return m_state->slots.size();
+	}
+
+	// Only safe to call when no other thread is holding onto its instance.
+	void clear() {
+		std::lock_guard<std::mutex> lock(m_state->lock);
+		m_id.store(next(), std::memory_order_release);
+		m_state->slots.clear();
+	}
+};
+
+/** objects that a client refers to by an integer handle */
+template <typename T>
+class HandleTable {
+private:
+	/* private members */
+	std::mutex m_lock;
+	std::map<unsigned long, std::shared_ptr<T>> m_objects;
+	unsigned long m_next;
+
+public:
+	/* scoping methods */
+	HandleTable() : m_next(1) {}
+	~HandleTable() {}
+
+	HandleTable(const HandleTable&) = delete;
+	HandleTable& operator=(const HandleTable&) = delete;
+
+	/* methods */
+	unsigned long add(std::shared_ptr<T> object) {
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto handle = m_next++;
+		m_objects[handle] = object;
+		return handle;
+	}
+
+	std::shared_ptr<T> find(unsigned long handle) {
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto it = m_objects.find(handle);
+		return (it == m_objects.end()) ? nullptr : it->second;
+	}
+
+	bool close(unsigned long handle) {
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_objects.erase(handle) > 0;
+	}
+};
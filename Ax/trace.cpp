@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "trace.h"
+#include "transfer.h"
+
+namespace {
+	const char magic[8] = { 'A', 'X', 'T', 'R', 'A', 'C', 'E', 1 };
+
+	inline size_t
+	put(uint8_t* p, uint64_t value)
+	{
+		size_t res = 0;
+		while (value >= 0x80) {
+			p[res++] = static_cast<uint8_t>(value) | 0x80;
+			value >>= 7;
+		}
+		p[res++] = static_cast<uint8_t>(value);
+		return res;
+	}
+
+	inline size_t
+	get(const uint8_t* p, size_t size, uint64_t& value)
+	{
+		value = 0;
+		for (size_t i = 0; i < size && i < 10; i++) {
+			value |= static_cast<uint64_t>(p[i] & 0x7f) << (7 * i);
+			if (!(p[i] & 0x80))
+				return i + 1;
+		}
+		return 0;
+	}
+
+	inline uint64_t
+	truncate(uint64_t value, uint64_t size)
+	{
+		return (size < 8) ? value & ((uint64_t(1) << (8 * size)) - 1) : value;
+	}
+
+	inline uint64_t
+	now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+/** encoding */
+size_t
+trace::encode(const Entry& entry, uint8_t* buffer)
+{
+	size_t res = 0;
+	buffer[res++] = static_cast<uint8_t>(entry.op) | (entry.faulted ? 0x80 : 0);
+	res += put(buffer + res, entry.timestamp);
+	res += put(buffer + res, entry.address);
+	res += put(buffer + res, entry.size);
+	res += put(buffer + res, entry.value);
+	res += put(buffer + res, entry.result);
+	return res;
+}
+
+size_t
+trace::decode(const uint8_t* buffer, size_t size, Entry& entry)
+{
+	if (size < 1)
+		return 0;
+
+	entry.op = static_cast<op_t>(buffer[0] & 0x7f);
+	entry.faulted = (buffer[0] & 0x80) != 0;
+
+	uint64_t* fields[] = { &entry.timestamp, &entry.address, &entry.size, &entry.value, &entry.result };
+	size_t res = 1;
+	for (auto field : fields) {
+		auto n = get(buffer + res, size - res, *field);
+		if (n == 0)
+			return 0;
+		res += n;
+	}
+	return res;
+}
+
+const char*
+trace::name(op_t op)
+{
+	static const char* names[] = { "", "load", "store", "read", "write", "fill", "copy", "disasm", "dump" };
+	return (op < sizeof(names) / sizeof(*names)) ? names[op] : "";
+}
+
+/** Recorder */
+trace::Recorder::Recorder(size_t capacity) :
+	m_capacity(1), m_head(0), m_tail(0), m_dropped(0), m_enabled(false), m_start(now())
+{
+	// the capacity is a power of two so that a position can be masked into the ring
+	while (m_capacity < capacity)
+		m_capacity <<= 1;
+	m_ring.reset(new std::atomic<uint8_t>[m_capacity]);
+	for (size_t i = 0; i < m_capacity; i++)
+		m_ring[i].store(0, std::memory_order_relaxed);
+}
+
+bool
+trace::Recorder::record(op_t op, uint64_t address, uint64_t size, uint64_t value, uint64_t result, bool faulted)
+{
+	if (!enabled())
+		return false;
+
+	Entry entry = { op, faulted, now() - m_start.load(std::memory_order_relaxed), address, size, value, result };
+	uint8_t buffer[1 + maximum];
+	auto length = encode(entry, buffer + 1);
+	auto total = length + 1;
+
+	// reserve room for the entry, and drop it if the consumer has fallen behind
+	auto head = m_head.load(std::memory_order_relaxed);
+	do {
+		if (head + total - m_tail.load(std::memory_order_acquire) > m_capacity) {
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	} while (!m_head.compare_exchange_weak(head, head + total, std::memory_order_relaxed));
+
+	// the length goes last since it's what tells the consumer that the entry is complete
+	for (size_t i = 1; i < total; i++)
+		m_ring[(head + i) & (m_capacity - 1)].store(buffer[i], std::memory_order_relaxed);
+	m_ring[head & (m_capacity - 1)].store(static_cast<uint8_t>(length), std::memory_order_release);
+	return true;
+}
+
+void
+trace::Recorder::start()
+{
+	m_dropped = 0;
+	m_start = now();
+	m_enabled = true;
+}
+
+size_t
+trace::Recorder::consume(const std::function<void(const uint8_t*, size_t)>& callback)
+{
+	std::lock_guard<std::mutex> lock(m_consumer);
+
+	uint8_t buffer[1 + maximum];
+	size_t res = 0;
+	auto tail = m_tail.load(std::memory_order_relaxed);
+	for (;;) {
+		// stop at the first entry that hasn't been completely written
+		auto length = m_ring[tail & (m_capacity - 1)].load(std::memory_order_acquire);
+		if (length == 0)
+			break;
+
+		// copy the entry out and clear it so its length reads as empty the next time around
+		auto total = static_cast<size_t>(length) + 1;
+		for (size_t i = 0; i < total; i++) {
+			auto& slot = m_ring[(tail + i) & (m_capacity - 1)];
+			buffer[i] = slot.load(std::memory_order_relaxed);
+			slot.store(0, std::memory_order_relaxed);
+		}
+		tail += total;
+		m_tail.store(tail, std::memory_order_release);
+
+		callback(buffer, total);
+		res++;
+	}
+	return res;
+}
+
+size_t
+trace::Recorder::drain(std::vector<Entry>& result)
+{
+	return consume([&result](const uint8_t* frame, size_t size) {
+		Entry entry;
+		if (decode(frame + 1, size - 1, entry))
+			result.push_back(entry);
+	});
+}
+
+size_t
+trace::Recorder::flush(std::ostream& os)
+{
+	return consume([&os](const uint8_t* frame, size_t size) {
+		os.write(reinterpret_cast<const char*>(frame), size);
+	});
+}
+
+/** trace files */
+void
+trace::header(std::ostream& os)
+{
+	os.write(magic, sizeof(magic));
+}
+
+std::vector<trace::Entry>
+trace::parse(std::istream& is)
+{
+	std::vector<Entry> res;
+
+	char signature[sizeof(magic)];
+	if (!is.read(signature, sizeof(signature)) || memcmp(signature, magic, sizeof(magic)) != 0)
+		return res;
+
+	// a file can hold several flushes, so another header is skipped wherever one appears
+	uint8_t buffer[maximum];
+	for (int length; (length = is.get()) != EOF; ) {
+		if (length == magic[0] && is.read(signature + 1, sizeof(signature) - 1)) {
+			if (memcmp(signature + 1, magic + 1, sizeof(magic) - 1) == 0)
+				continue;
+			break;
+		}
+		if (length == 0 || static_cast<size_t>(length) > maximum)
+			break;
+		if (!is.read(reinterpret_cast<char*>(buffer), length))
+			break;
+
+		Entry entry;
+		if (!decode(buffer, length, entry))
+			break;
+		res.push_back(entry);
+	}
+	return res;
+}
+
+/** MemoryBackend */
+void
+trace::MemoryBackend::map(uint64_t address, size_t size)
+{
+	const uint64_t pagesize = Snapshot::pagesize;
+	for (auto page = address - address % pagesize; page < address + size; page += pagesize)
+		m_pages[page].resize(pagesize);
+}
+
+void
+trace::MemoryBackend::assign(uint64_t address, const void* buffer, size_t size)
+{
+	map(address, size);
+	write(address, buffer, size);
+}
+
+size_t
+trace::MemoryBackend::read(uint64_t address, void* buffer, size_t size)
+{
+	const uint64_t pagesize = Snapshot::pagesize;
+	auto out = static_cast<uint8_t*>(buffer);
+	size_t res = 0;
+	while (res < size) {
+		auto ea = address + res;
+		auto it = m_pages.find(ea - ea % pagesize);
+		if (it == m_pages.end())
+			break;
+		auto offset = static_cast<size_t>(ea % pagesize);
+		auto count = (std::min)(size - res, static_cast<size_t>(pagesize) - offset);
+		memcpy(out + res, it->second.data() + offset, count);
+		res += count;
+	}
+	return res;
+}
+
+size_t
+trace::MemoryBackend::write(uint64_t address, const void* buffer, size_t size)
+{
+	const uint64_t pagesize = Snapshot::pagesize;
+	auto in = static_cast<const uint8_t*>(buffer);
+	size_t res = 0;
+	while (res < size) {
+		auto ea = address + res;
+		auto it = m_pages.find(ea - ea % pagesize);
+		if (it == m_pages.end())
+			break;
+		auto offset = static_cast<size_t>(ea % pagesize);
+		auto count = (std::min)(size - res, static_cast<size_t>(pagesize) - offset);
+		memcpy(it->second.data() + offset, in + res, count);
+		res += count;
+	}
+	return res;
+}
+
+/** SnapshotBackend */
+size_t
+trace::SnapshotBackend::read(uint64_t address, void* buffer, size_t size)
+{
+	const uint64_t pagesize = Snapshot::pagesize;
+	auto out = static_cast<uint8_t*>(buffer);
+	size_t res = 0;
+
+	// each page comes from whichever of the written pages or the snapshot has it
+	while (res < size) {
+		auto ea = address + res;
+		auto count = (std::min)(size - res, static_cast<size_t>(pagesize - ea % pagesize));
+		auto n = m_written.read(ea, out + res, count);
+		if (n == 0)
+			n = m_snapshot->read(static_cast<uintptr_t>(ea), out + res, count);
+		res += n;
+		if (n < count)
+			break;
+	}
+	return res;
+}
+
+size_t
+trace::SnapshotBackend::write(uint64_t address, const void* buffer, size_t size)
+{
+	const uint64_t pagesize = Snapshot::pagesize;
+	auto in = static_cast<const uint8_t*>(buffer);
+	size_t res = 0;
+
+	// a page is copied out of the snapshot the first time it's written to
+	std::vector<uint8_t> page(pagesize);
+	while (res < size) {
+		auto ea = address + res;
+		auto base = ea - ea % pagesize;
+		auto count = (std::min)(size - res, static_cast<size_t>(base + pagesize - ea));
+		if (m_written.read(base, page.data(), 1) == 0) {
+			if (m_snapshot->read(static_cast<uintptr_t>(base), page.data(), pagesize) != pagesize)
+				break;
+			m_written.assign(base, page.data(), pagesize);
+		}
+		res += m_written.write(ea, in + res, count);
+	}
+	return res;
+}
+
+/** ProcessBackend */
+size_t
+trace::ProcessBackend::read(uint64_t address, void* buffer, size_t size)
+{
+	return transfer::copy(reinterpret_cast<uintptr_t>(buffer), static_cast<uintptr_t>(address), size, nullptr);
+}
+
+size_t
+trace::ProcessBackend::write(uint64_t address, const void* buffer, size_t size)
+{
+	return transfer::write(static_cast<uintptr_t>(address), static_cast<const uint8_t*>(buffer), size, nullptr);
+}
+
+/** RecordingBackend */
+size_t
+trace::RecordingBackend::read(uint64_t address, void* buffer, size_t size)
+{
+	auto res = m_backend.read(address, buffer, size);
+	if (!m_recorder.enabled())
+		return res;
+
+	// a load that faults has no value, just like the ones that CLeaker records
+	if (size <= sizeof(uint64_t)) {
+		uint64_t value = 0;
+		if (res == size)
+			memcpy(&value, buffer, size);
+		m_recorder.record(load, address, size, 0, value, res < size);
+	}
+	else
+		m_recorder.record(trace::read, address, size, 0, res, res < size);
+	return res;
+}
+
+size_t
+trace::RecordingBackend::write(uint64_t address, const void* buffer, size_t size)
+{
+	auto res = m_backend.write(address, buffer, size);
+	m_recorder.record(trace::write, address, size, 0, res, res < size);
+	return res;
+}
+
+/** replaying */
+trace::Summary
+trace::replay(const std::vector<Entry>& entries, Backend& backend)
+{
+	Summary res = { 0, 0, 0, 0, 0.0, {} };
+	std::vector<uint8_t> scratch;
+
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < entries.size(); i++) {
+		auto& entry = entries[i];
+		bool same = true;
+
+		auto size = static_cast<size_t>(entry.size);
+		switch (entry.op) {
+		case load:
+		case store: {
+			if (size > sizeof(uint64_t)) {
+				same = false;
+				break;
+			}
+
+			uint64_t value = 0;
+			auto faulted = backend.read(entry.address, &value, size) != size;
+			if (!faulted && entry.op == store)
+				faulted = backend.write(entry.address, &entry.value, size) != size;
+
+			same = (faulted == entry.faulted) && (faulted || value == truncate(entry.result, entry.size));
+			break;
+		}
+
+		// the source is staged first so that an overlapping copy behaves like memmove
+		case copy: {
+			scratch.resize(size);
+			auto count = backend.read(entry.value, scratch.data(), size);
+			count = backend.write(entry.address, scratch.data(), count);
+			same = (count == entry.result);
+			break;
+		}
+
+		// the contents aren't recorded, so these can only be compared by how much was accessible
+		case write:
+		case fill:
+			res.skipped++;
+			// fall through
+		case read: {
+			scratch.resize(size);
+			same = (backend.read(entry.address, scratch.data(), size) == entry.result);
+			break;
+		}
+
+		case disasm:
+		case dump: {
+			scratch.resize(size);
+			same = ((backend.read(entry.address, scratch.data(), size) != size) == entry.faulted);
+			break;
+		}
+
+		default:
+			res.skipped++;
+			continue;
+		}
+
+		res.entries++;
+		res.bytes += entry.size;
+		if (!same) {
+			res.mismatches++;
+			res.diverged.push_back(i);
+		}
+	}
+	res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return res;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "snapshot.h"
+
+/** recording every memory access so that a session can be replayed later */
+namespace trace {
+	/* type-definitions */
+	enum op_t : uint8_t {
+		load = 1,	// an integer of `size` bytes was read, and result is its value
+		store,		// `value` was stored, and result is what was there before
+		read,		// `size` bytes were read by a string or bulk accessor, and result is how many were readable
+		write,		// `size` bytes were written, and result is how many were
+		fill,		// like write
+		copy,		// `size` bytes were copied from `value` to `address`, and result is how many were
+		disasm,		// result instructions were decoded from `size` bytes
+		dump,		// `size` bytes were dumped
+	};
+
+	struct Entry {
+		op_t op;
+		bool faulted;
+		uint64_t timestamp;		// nanoseconds since the recorder was started
+		uint64_t address;
+		uint64_t size;
+		uint64_t value;
+		uint64_t result;
+	};
+
+	/* utilities */
+	const size_t maximum = 1 + 5 * 10;	// the largest an encoded entry can be
+	size_t encode(const Entry& entry, uint8_t* buffer);
+	size_t decode(const uint8_t* buffer, size_t size, Entry& entry);
+	const char* name(op_t op);
+
+	/*
+		A lock-free ring of encoded entries that any number of threads can
+		record into while a single consumer drains it. Each entry is prefixed
+		with its length, which is stored last so that the consumer never sees
+		an entry that's only partially written. An entry that doesn't fit is
+		dropped rather than blocking the thread that's recording it.
+	*/
+	class Recorder {
+	private:
+		/* private members */
+		std::unique_ptr<std::atomic<uint8_t>[]> m_ring;
+		size_t m_capacity;
+		std::atomic<uint64_t> m_head, m_tail, m_dropped;
+		std::atomic<bool> m_enabled;
+		std::atomic<uint64_t> m_start;
+		std::mutex m_consumer;
+
+		size_t consume(const std::function<void(const uint8_t*, size_t)>& callback);
+
+	public:
+		/* scoping methods */
+		Recorder(size_t capacity = 0x100000);
+		~Recorder() {}
+
+		Recorder(const Recorder&) = delete;
+		Recorder& operator=(const Recorder&) = delete;
+
+		/* methods used by the threads being recorded */
+		bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+		bool record(op_t op, uint64_t address, uint64_t size, uint64_t value, uint64_t result, bool faulted = false);
+
+		/* methods used by the consumer, which return the number of entries that were consumed */
+		void start();
+		void stop() { m_enabled = false; }
+		size_t drain(std::vector<Entry>& result);
+		size_t flush(std::ostream& os);
+		uint64_t dropped() const { return m_dropped.load(); }
+	};
+
+	/* a trace file is a header followed by each length-prefixed entry */
+	void header(std::ostream& os);
+	std::vector<Entry> parse(std::istream& is);
+
+	/** the memory that a trace is replayed against */
+	class Backend {
+	public:
+		virtual ~Backend() {}
+
+		// Return the number of bytes that could be read or written before hitting something that isn't mapped.
+		virtual size_t read(uint64_t address, void* buffer, size_t size) = 0;
+		virtual size_t write(uint64_t address, const void* buffer, size_t size) = 0;
+	};
+
+	/* sparse pages that only exist once they've been mapped */
+	class MemoryBackend : public Backend {
+	private:
+		/* private members */
+		std::map<uint64_t, std::vector<uint8_t>> m_pages;
+
+	public:
+		void map(uint64_t address, size_t size);
+		void assign(uint64_t address, const void* buffer, size_t size);
+
+		size_t read(uint64_t address, void* buffer, size_t size) override;
+		size_t write(uint64_t address, const void* buffer, size_t size) override;
+	};
+
+	/* reads come from a snapshot, and writes go to pages that are copied out of it */
+	class SnapshotBackend : public Backend {
+	private:
+		/* private members */
+		std::shared_ptr<Snapshot> m_snapshot;
+		MemoryBackend m_written;
+
+	public:
+		SnapshotBackend(std::shared_ptr<Snapshot> snapshot) : m_snapshot(snapshot) {}
+
+		size_t read(uint64_t address, void* buffer, size_t size) override;
+		size_t write(uint64_t address, const void* buffer, size_t size) override;
+	};
+
+	/* the memory of this process, copied a page at a time so that a fault stops at the page that caused it */
+	class ProcessBackend : public Backend {
+	public:
+		size_t read(uint64_t address, void* buffer, size_t size) override;
+		size_t write(uint64_t address, const void* buffer, size_t size) override;
+	};
+
+	/*
+		Every access that's made through another backend, recorded the same
+		way that CLeaker records its own. A read of up to 8 bytes is recorded
+		as a load of the integer that was read, anything larger as a read,
+		and a write as a write.
+	*/
+	class RecordingBackend : public Backend {
+	private:
+		/* private members */
+		Backend& m_backend;
+		Recorder& m_recorder;
+
+	public:
+		RecordingBackend(Backend& backend, Recorder& recorder) : m_backend(backend), m_recorder(recorder) {}
+
+		size_t read(uint64_t address, void* buffer, size_t size) override;
+		size_t write(uint64_t address, const void* buffer, size_t size) override;
+	};
+
+	/* what happened when a trace was replayed */
+	struct Summary {
+		uint64_t entries, bytes, mismatches, skipped;
+		double seconds;
+		std::vector<size_t> diverged;	// the index of every entry whose result differed
+	};
+
+	// Re-drive each access against `backend`. Only loads, stores, and copies
+	// can be reproduced exactly, and everything else is replayed as an access
+	// of the same size whose readable extent is compared with the original.
+	Summary replay(const std::vector<Entry>& entries, Backend& backend);
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "transfer.h"
+
+/** utilities */
+namespace {
+	/* the number of bytes from ea up to the next page boundary, but no more than n */
+	inline size_t
+	extent(uintptr_t ea, size_t n)
+	{
+		return (std::min)(n, transfer::pagesize - (ea & (transfer::pagesize - 1)));
+	}
+
+	/*
+		Apply `f(offset, size)` to each piece of [0, n) such that neither ea+offset
+		nor other+offset crosses a page boundary. Whatever faults stops the walk.
+	*/
+	template <typename F>
+	size_t
+	paged(uintptr_t ea, uintptr_t other, size_t n, F f)
+	{
+		size_t offset = 0;
+		while (offset < n) {
+			auto size = (std::min)(extent(ea + offset, n - offset), extent(other + offset, n - offset));
+			try {
+				f(offset, size);
+			}
+			catch (...) {
+				break;
+			}
+			offset += size;
+		}
+		return offset;
+	}
+}
+
+namespace transfer {
+	std::string
+	format(const std::vector<uint8_t>& bytes)
+	{
+		std::ostringstream os;
+		os << std::hex << std::setfill('0');
+		for (auto b : bytes)
+			os << std::setw(2) << static_cast<unsigned>(b);
+		return os.str();
+	}
+}
+
+/** writing */
+namespace transfer {
+	size_t
+	write(uintptr_t ea, const uint8_t* data, size_t n, std::vector<uint8_t>* previous)
+	{
+		auto p = reinterpret_cast<uint8_t*>(ea);
+		if (previous)
+			previous->resize(n);
+
+		// the original contents are read before each page is written so that they line up with what was written
+		auto res = paged(ea, ea, n, [&](size_t offset, size_t size) {
+			if (previous)
+				memcpy(previous->data() + offset, p + offset, size);
+			memcpy(p + offset, data + offset, size);
+		});
+
+		if (previous)
+			previous->resize(res);
+		return res;
+	}
+
+	size_t
+	fill(uintptr_t ea, size_t n, const std::vector<uint8_t>& pattern, std::vector<uint8_t>* previous)
+	{
+		if (pattern.empty())
+			throw std::invalid_argument("pattern");
+
+		// lay out enough of the pattern to cover any page at any phase so that each page is a single copy
+		std::vector<uint8_t> repeated;
+		auto length = (std::min)(n, pagesize + pattern.size());
+		repeated.reserve(length);
+		while (repeated.size() < length)
+			repeated.insert(repeated.end(), pattern.begin(), pattern.begin() + (std::min)(pattern.size(), length - repeated.size()));
+
+		auto p = reinterpret_cast<uint8_t*>(ea);
+		if (previous)
+			previous->resize(n);
+
+		auto res = paged(ea, ea, n, [&](size_t offset, size_t size) {
+			if (previous)
+				memcpy(previous->data() + offset, p + offset, size);
+			memcpy(p + offset, repeated.data() + offset % pattern.size(), size);
+		});
+
+		if (previous)
+			previous->resize(res);
+		return res;
+	}
+
+	size_t
+	copy(uintptr_t dst, uintptr_t src, size_t n, std::vector<uint8_t>* previous)
+	{
+		// overlapping ranges are staged through a buffer so that the source is read before any of it is overwritten
+		if (src < dst + n && dst < src + n) {
+			std::vector<uint8_t> staged;
+			read(src, n, staged);
+			return write(dst, staged.data(), staged.size(), previous);
+		}
+
+		auto p = reinterpret_cast<uint8_t*>(dst);
+		auto q = reinterpret_cast<const uint8_t*>(src);
+		if (previous)
+			previous->resize(n);
+
+		// a piece never straddles a page on either side, so a fault in the source or destination is exact
+		auto res = paged(dst, src, n, [&](size_t offset, size_t size) {
+			if (previous)
+				memcpy(previous->data() + offset, p + offset, size);
+			memcpy(p + offset, q + offset, size);
+		});
+
+		if (previous)
+			previous->resize(res);
+		return res;
+	}
+
+	size_t
+	read(uintptr_t ea, size_t n, std::vector<uint8_t>& result)
+	{
+		auto p = reinterpret_cast<const uint8_t*>(ea);
+		result.resize(n);
+
+		auto res = paged(ea, ea, n, [&](size_t offset, size_t size) {
+			memcpy(result.data() + offset, p + offset, size);
+		});
+		result.resize(res);
+		return res;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/** bulk writes that stop cleanly at the first page that faults */
+namespace transfer {
+	/* type-definitions */
+	const size_t pagesize = 0x1000;
+
+	/* utilities */
+	std::string format(const std::vector<uint8_t>& bytes);
+
+	/*
+		Each of these is applied a page at a time, and returns the number of
+		bytes that were written before the first fault. If `previous` is not
+		null, then it receives the original contents of the bytes that were
+		written.
+	*/
+	size_t write(uintptr_t ea, const uint8_t* data, size_t n, std::vector<uint8_t>* previous);
+	size_t fill(uintptr_t ea, size_t n, const std::vector<uint8_t>& pattern, std::vector<uint8_t>* previous);
+	size_t copy(uintptr_t dst, uintptr_t src, size_t n, std::vector<uint8_t>* previous);
+
+	/* read as much of [ea, ea+n) as possible into `result` */
+	size_t read(uintptr_t ea, size_t n, std::vector<uint8_t>& result);
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "vtables.h"
+#include "parallel.h"
+#include "scanner.h"
+
+/** utilities */
+namespace vtables {
+	bool
+	readonly(const Region& region)
+	{
+		return region.readable() && !region.writable() && !region.executable();
+	}
+
+	/*
+		The number of entries is in decimal.
+
+			00007ff812345678 12 ntdll
+	*/
+	std::string
+	format(const Table& table, const std::string& module)
+	{
+		std::ostringstream os;
+		os << scan::format(table.address) << " " << std::dec << table.length << " " << module;
+		return os.str();
+	}
+}
+
+/** searching */
+namespace vtables {
+	/*
+		Each shard reports every run that's long enough, along with any run
+		that touches either end of it no matter how short it is. The sink
+		sees the runs in address order, so a run that was split between two
+		shards is joined back together before it's checked against the
+		minimum.
+	*/
+	std::vector<Table>
+	search(const std::vector<Region>& regions, size_t width, const pointers::Targets& code, size_t minimum, size_t threads)
+	{
+		std::vector<Table> res;
+		Table pending = { 0, 0 };
+
+		if (width != sizeof(uint32_t) && width != sizeof(uint64_t))
+			throw std::invalid_argument("width");
+
+		auto kernel = (width == sizeof(uint64_t)) ? &pointers::search8 : &pointers::search4;
+		auto items = parallel::shard(scan::coalesce(regions), 0x100000, 0);
+
+		auto finish = [&res, &pending, minimum]() {
+			if (pending.length >= minimum)
+				res.push_back(pending);
+			pending.length = 0;
+		};
+
+		parallel::run<Table>(items, threads,
+			[kernel, &code, width, minimum](const parallel::Item& item, std::vector<Table>& hits) {
+				Table run = { 0, 0 };
+				auto emit = [&]() {
+					if (run.length && (run.length >= minimum || run.address == item.base || run.end(width) == item.base + item.size))
+						hits.push_back(run);
+				};
+
+				kernel(item.base, item.size, code, [&](const pointers::Found& found) {
+					if (run.length && run.end(width) == found.location)
+						run.length++;
+					else {
+						emit();
+						run.address = found.location;
+						run.length = 1;
+					}
+					return true;
+				});
+				emit();
+			},
+			[&pending, &finish, width](std::vector<Table>& hits) {
+				for (auto& run : hits) {
+					if (pending.length && pending.end(width) == run.address) {
+						pending.length += run.length;
+						continue;
+					}
+					finish();
+					pending = run;
+				}
+			}
+		);
+		finish();
+		return res;
+	}
+}
+
+/** Cache */
+namespace vtables {
+	bool
+	Cache::find(const Module& module, size_t width, size_t minimum, std::vector<Table>& result) const
+	{
+		ReadLock lock(m_lock);
+		auto it = m_entries.find(module.base);
+		if (it == m_entries.end())
+			return false;
+
+		auto& entry = it->second;
+		if (entry.module.size != module.size || entry.module.path != module.path || entry.width != width || entry.minimum != minimum)
+			return false;
+		result = entry.tables;
+		return true;
+	}
+
+	void
+	Cache::assign(const Module& module, size_t width, size_t minimum, std::vector<Table> tables)
+	{
+		Entry entry = { module, width, minimum, {} };
+		entry.tables.swap(tables);
+
+		WriteLock lock(m_lock);
+		m_entries[module.base] = std::move(entry);
+	}
+
+	size_t
+	Cache::retain(const std::vector<Module>& modules)
+	{
+		WriteLock lock(m_lock);
+		for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+			auto& entry = it->second;
+			auto found = std::find_if(modules.begin(), modules.end(), [&entry](const Module& module) {
+				return module.base == entry.module.base && module.size == entry.module.size && module.path == entry.module.path;
+			});
+			it = (found == modules.end()) ? m_entries.erase(it) : std::next(it);
+		}
+		return m_entries.size();
+	}
+
+	size_t
+	Cache::size() const
+	{
+		ReadLock lock(m_lock);
+		return m_entries.size();
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pointers.h"
+#include "regions.h"
+#include "threading.h"
+
+/** finding tables of function pointers (such as vtables) in read-only data */
+namespace vtables {
+	/* type-definitions */
+	struct Table {
+		uintptr_t address;
+		size_t length;		// the number of entries
+
+		uintptr_t end(size_t width) const { return address + length * width; }
+		bool operator<(const Table& other) const { return address < other.address; }
+	};
+
+	/* utilities */
+	bool readonly(const Region& region);
+
+	// A table is its address, the number of entries, and the name of the module that it was found in.
+	std::string format(const Table& table, const std::string& module);
+
+	// Find every run of at least `minimum` consecutive aligned values of `width` bytes that land in `code`.
+	std::vector<Table> search(const std::vector<Region>& regions, size_t width, const pointers::Targets& code, size_t minimum, size_t threads);
+
+	/* the tables that were found in each module, which are reused until the module is unloaded */
+	class Cache {
+	private:
+		struct Entry {
+			Module module;
+			size_t width, minimum;
+			std::vector<Table> tables;
+		};
+
+		mutable ReadWriteLock m_lock;
+		std::map<uintptr_t, Entry> m_entries;
+
+	public:
+		bool find(const Module& module, size_t width, size_t minimum, std::vector<Table>& result) const;
+		void assign(const Module& module, size_t width, size_t minimum, std::vector<Table> tables);
+
+		// Drop every entry whose module isn't loaded anymore.
+		size_t retain(const std::vector<Module>& modules);
+		size_t size() const;
+	};
+}
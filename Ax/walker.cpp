@@ -0,0 +1,253 @@
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "walker.h"
+#include "scanner.h"
+
+namespace {
+	/* read a pointer of `width` bytes, or return false if it can't be */
+	inline bool
+	load(trace::Backend& backend, uint64_t ea, size_t width, uint64_t& value)
+	{
+		if (ea < walk::lowest)
+			return false;
+
+		value = 0;
+		return backend.read(ea, &value, width) == width;
+	}
+
+	/* a recursive-descent parser that emits the program in postfix order */
+	class Parser {
+	private:
+		const std::string& m_text;
+		size_t m_index;
+		int m_depth;
+
+		void skip() {
+			while (m_index < m_text.size() && isspace(static_cast<unsigned char>(m_text[m_index])))
+				m_index++;
+		}
+
+		bool accept(char ch) {
+			skip();
+			if (m_index < m_text.size() && m_text[m_index] == ch) {
+				m_index++;
+				return true;
+			}
+			return false;
+		}
+
+		[[noreturn]] void error(const char* message) {
+			std::ostringstream os;
+			os << message << " at offset " << m_index;
+			throw std::invalid_argument(os.str());
+		}
+
+	public:
+		std::vector<walk::Path::Op> program;
+
+		Parser(const std::string& text) : m_text(text), m_index(0), m_depth(0) {}
+
+		void emit(walk::Path::Op::kind_t kind, uint64_t value = 0) {
+			walk::Path::Op op = { kind, value };
+			program.push_back(op);
+		}
+
+		void expression() {
+			term();
+			for (;;) {
+				if (accept('+')) {
+					term();
+					emit(walk::Path::Op::add);
+				}
+				else if (accept('-')) {
+					term();
+					emit(walk::Path::Op::subtract);
+				}
+				else
+					break;
+			}
+		}
+
+		void term() {
+			skip();
+			if (accept('[')) {
+				if (++m_depth > 0x100)
+					error("too deeply nested");
+				expression();
+				if (!accept(']'))
+					error("expected ]");
+				m_depth--;
+				emit(walk::Path::Op::dereference);
+				return;
+			}
+
+			if (m_text.compare(m_index, 4, "base") == 0) {
+				m_index += 4;
+				emit(walk::Path::Op::base);
+				return;
+			}
+
+			// numbers are decimal unless they're prefixed with 0x
+			const char* start = m_text.c_str() + m_index;
+			char* stop;
+			auto value = strtoull(start, &stop, (start[0] == '0' && (start[1] == 'x' || start[1] == 'X')) ? 16 : 10);
+			if (stop == start || !isxdigit(static_cast<unsigned char>(*start)))
+				error("expected a number, base, or [");
+			m_index += stop - start;
+			emit(walk::Path::Op::constant, value);
+		}
+
+		void parse() {
+			expression();
+			skip();
+			if (m_index != m_text.size())
+				error("unexpected character");
+		}
+	};
+}
+
+/** Path */
+walk::Path::Path(const std::string& expression)
+{
+	Parser parser(expression);
+	parser.parse();
+	m_program.swap(parser.program);
+}
+
+size_t
+walk::Path::hops() const
+{
+	size_t res = 0;
+	for (auto& op : m_program)
+		res += (op.kind == Op::dereference) ? 1 : 0;
+	return res;
+}
+
+bool
+walk::Path::evaluate(trace::Backend& backend, uint64_t base, size_t width, uint64_t& result, uint64_t& fault) const
+{
+	std::vector<uint64_t> stack;
+	stack.reserve(m_program.size());
+
+	for (auto& op : m_program) {
+		uint64_t value;
+		switch (op.kind) {
+		case Op::constant:
+			stack.push_back(op.value);
+			break;
+
+		case Op::base:
+			stack.push_back(base);
+			break;
+
+		case Op::add:
+			value = stack.back();
+			stack.pop_back();
+			stack.back() += value;
+			break;
+
+		case Op::subtract:
+			value = stack.back();
+			stack.pop_back();
+			stack.back() -= value;
+			break;
+
+		case Op::dereference:
+			if (!load(backend, stack.back(), width, value)) {
+				fault = stack.back();
+				return false;
+			}
+			stack.back() = value;
+			break;
+		}
+	}
+
+	result = stack.back();
+	return true;
+}
+
+/** lists */
+walk::List
+walk::list(trace::Backend& backend, uint64_t head, uint64_t offset, size_t width, size_t limit)
+{
+	List res = { List::complete, 0, {} };
+
+	uint64_t link;
+	if (!load(backend, head, width, link)) {
+		res.status = List::fault;
+		res.where = head;
+		return res;
+	}
+
+	// Brent's algorithm remembers a link at each power of two, and a cycle is found when it comes back around to it
+	uint64_t checkpoint = head;
+	size_t power = 1, steps = 0;
+	while (link != head) {
+		if (res.nodes.size() >= limit) {
+			res.status = List::limit;
+			res.where = link;
+			break;
+		}
+		if (link == checkpoint) {
+			res.status = List::cycle;
+			break;
+		}
+		if (++steps == power) {
+			checkpoint = link;
+			power <<= 1;
+			steps = 0;
+		}
+
+		uint64_t next;
+		if (!load(backend, link, width, next)) {
+			res.status = List::fault;
+			res.where = link;
+			break;
+		}
+		res.nodes.push_back(link - offset);
+		link = next;
+	}
+
+	// the cycle may have been walked more than once, so only keep the nodes up to the first one that repeats
+	if (res.status == List::cycle) {
+		std::unordered_set<uint64_t> seen;
+		for (size_t i = 0; i < res.nodes.size(); i++) {
+			if (seen.insert(res.nodes[i]).second)
+				continue;
+			res.nodes.resize(i);
+			break;
+		}
+		res.where = link;
+		if (!res.nodes.empty()) {
+			uint64_t next;
+			if (load(backend, res.nodes.back() + offset, width, next))
+				res.where = next;
+		}
+	}
+	return res;
+}
+
+/*
+	A walk is written as each node followed by a line that explains why the
+	walk stopped if it didn't complete.
+
+		00000000003a2b40
+		00000000003a2c10
+		fault 00000000baadf00d
+*/
+std::string
+walk::format(const List& list)
+{
+	static const char* names[] = { "complete", "limit", "cycle", "fault" };
+
+	std::ostringstream os;
+	for (auto node : list.nodes)
+		os << scan::format(static_cast<uintptr_t>(node)) << "\n";
+	if (list.status != List::complete)
+		os << names[list.status] << " " << scan::format(static_cast<uintptr_t>(list.where)) << "\n";
+	return os.str();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+/** following chains of pointers natively instead of a round trip per hop, reading them from a backend */
+namespace walk {
+	/* type-definitions */
+	const uint64_t lowest = 0x10000;	// nothing below this is ever mapped, so it's treated as a fault without touching it
+
+	/*
+		A pointer expression that's compiled into a small stack program. Brackets
+		dereference whatever is inside of them, and `base` is the address that
+		the expression is evaluated against.
+
+			[[base+0x18]+0x10]+8
+	*/
+	class Path {
+	public:
+		/* type-definitions */
+		struct Op {
+			enum kind_t { constant, base, add, subtract, dereference } kind;
+			uint64_t value;
+		};
+
+	private:
+		/* private members */
+		std::vector<Op> m_program;
+
+	public:
+		/* scoping methods */
+		Path(const std::string& expression);	// throws std::invalid_argument
+		~Path() {}
+
+		/* methods */
+		size_t hops() const;
+
+		// Evaluate against `base` using pointers of `width` bytes. If a hop
+		// faults, then this returns false and `fault` gets the address.
+		bool evaluate(trace::Backend& backend, uint64_t base, size_t width, uint64_t& result, uint64_t& fault) const;
+	};
+
+	/* what a list walk collected, and why it stopped */
+	struct List {
+		enum status_t { complete, limit, cycle, fault } status;
+		uint64_t where;		// the link that stopped the walk if it didn't complete
+		std::vector<uint64_t> nodes;
+	};
+
+	// Follow the Flink of each LIST_ENTRY starting at the `head` sentinel until
+	// it returns there. Each node is the address of the link minus `offset`,
+	// so that it's the address of the record that contains it.
+	List list(trace::Backend& backend, uint64_t head, uint64_t offset, size_t width, size_t limit);
+
+	std::string format(const List& list);
+}
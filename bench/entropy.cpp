@@ -0,0 +1,65 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+#include "bench.h"
+#include "entropy.h"
+#include "mapping.h"
+#include "parallel.h"
+
+/*
+	Classifying every page of a 1GB mapping, for each width of pointer. The
+	pointers in the corpus are all within the 256MB that starts at
+	0x7ff800000000, which is what's taken to be mapped. A single page of
+	each kind is also timed since the zero and uniform pages skip the
+	histogram.
+*/
+namespace {
+	const size_t corpus = 0x4000000, copies = 16;
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Mapping mapping(bench::corpus(options.quick ? 0x1000000 : corpus, 45), options.quick ? 1 : copies);
+	auto regions = mapping.regions();
+	auto threads = parallel::workers(0);
+	auto counts = (threads > 1) ? std::vector<size_t>{ 1, threads } : std::vector<size_t>{ 1 };
+	pointers::Targets targets({ { 0x00007ff800000000ull, 0x00007ff810000000ull } });
+
+	// the first page of the corpus that's been classified as each kind
+	std::vector<uintptr_t> samples(entropy::compressed + 1, 0);
+	for (auto& page : entropy::measure(regions, sizeof(uint64_t), targets, 1))
+		if (!samples[page.kind])
+			samples[page.kind] = page.base;
+
+	bench::Suite suite;
+	for (size_t kind = 0; kind < samples.size(); kind++) {
+		auto ea = samples[kind];
+		if (!ea)
+			continue;
+		suite.add(std::string("page/") + entropy::name(static_cast<entropy::kind_t>(kind)), entropy::pagesize, [ea, &targets]() {
+			entropy::measure(ea, entropy::pagesize, sizeof(uint64_t), targets);
+		});
+	}
+
+	for (size_t width : { sizeof(uint32_t), sizeof(uint64_t) }) {
+		for (auto count : counts) {
+			auto name = "measure/width=" + std::to_string(width) + "/threads=" + std::to_string(count);
+			suite.add(name, mapping.size(), [&regions, &targets, width, count]() {
+				entropy::measure(regions, width, targets, count);
+			});
+		}
+	}
+	return bench::execute(suite, options);
+}
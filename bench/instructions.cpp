@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "instructions.h"
+
+/*
+	Building the instruction index of 4MB of generated x64 code, and then
+	querying it with the kinds of queries that are asked for most often. A
+	query's rate is over the bytes that the index occupies, which is also
+	written to stderr along with the number of instructions.
+*/
+namespace {
+	const size_t corpus = 0x400000;
+
+	const struct {
+		const char* name;
+		const char* query;
+	} queries[] = {
+		{ "displacement", "mov ops=reg,mem disp=0x8" },
+		{ "immediate", "imm=0x4d5a" },
+		{ "indirect", "call indirect" },
+	};
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	auto code = bench::code(options.quick ? 0x10000 : corpus, 50);
+	Region region = { reinterpret_cast<uintptr_t>(code.data()), reinterpret_cast<uintptr_t>(code.data()), code.size(), memory::state_commit, memory::protect_execute_read, 0 };
+	std::vector<Region> regions(1, region);
+
+	auto index = std::make_shared<const instructions::Index>(instructions::build(region.base, regions, CS_MODE_64));
+	std::cerr << "index of " << index->size() << " instructions in " << index->footprint() << " bytes" << std::endl;
+
+	bench::Suite suite;
+	suite.add("build/64", code.size(), [&regions, &region]() {
+		instructions::build(region.base, regions, CS_MODE_64);
+	});
+
+	for (auto& item : queries) {
+		auto query = instructions::parse(item.query);
+		suite.add(std::string("find/") + item.name, index->footprint(), [index, query]() {
+			index->find(query, 0);
+		});
+	}
+	return bench::execute(suite, options);
+}
@@ -0,0 +1,133 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "disassembler.h"
+#include "readers.h"
+#include "sink.h"
+
+/*
+	The engines behind the original methods of the control: decoding each
+	mode in each syntax, dumping with each of the dumptypes, and reading
+	with each of the integer and floating-point readers. Decoding and
+	dumping are each run into a narrow stream and into the WideStream that
+	the control returns its text through. The code is the generated x64
+	corpus, which the 16 and 32-bit modes decode as whatever it happens to
+	be, and everything else reads the data corpus. The decoding cases are
+	only registered when the capstone that was linked in can decode x86,
+	since their baseline is only meaningful when recorded against one that
+	does.
+*/
+namespace {
+	const size_t instructions = 256, dumped = 0x1000;
+
+	// whether the disassembler decodes "mov rax, rcx; ret" as the two instructions that it is
+	bool
+	available()
+	{
+		static const uint8_t code[] = { 0x48, 0x89, 0xc8, 0xc3 };
+		try {
+			Disassembler d(CS_MODE_64);
+			return d.count(reinterpret_cast<intptr_t>(code), sizeof(code)) == 2 && d.size(reinterpret_cast<intptr_t>(code), 1) == 3;
+		}
+		catch (...) {
+		}
+		return false;
+	}
+
+	// each reader walks the whole corpus so that its loads aren't all hitting the same line
+	template<typename T> void
+	reader(bench::Suite& suite, const char* name, T(*read)(intptr_t), const std::vector<uint8_t>& corpus)
+	{
+		suite.add(std::string("read/") + name, corpus.size() - corpus.size() % sizeof(T), [read, &corpus]() {
+			volatile T sink;
+			auto p = reinterpret_cast<intptr_t>(corpus.data());
+			for (size_t i = 0; i + sizeof(T) <= corpus.size(); i += sizeof(T))
+				sink = read(p + i);
+			(void)sink;
+		});
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	auto code = bench::code(0x10000, 46);
+	auto data = bench::corpus(0x10000, 46);
+	auto ea = reinterpret_cast<intptr_t>(code.data());
+
+	bench::Suite suite;
+	std::vector<std::unique_ptr<Disassembler>> engines;
+	std::ostringstream os;
+	WideStream ws;
+
+	auto modes = available() ? std::vector<cs_mode>{ CS_MODE_16, CS_MODE_32, CS_MODE_64 } : std::vector<cs_mode>{};
+	if (modes.empty())
+		std::cerr << "the disassembler can't decode x86, so the disasm cases are skipped" << std::endl;
+
+	for (auto mode : modes) {
+		engines.emplace_back(new Disassembler(mode));
+		auto d = engines.back().get();
+		auto bits = std::to_string(d->m_bits);
+		auto n = d->size(ea, instructions);
+		suite.add("disasm/size/" + bits, n, [d, ea]() { d->size(ea, instructions); });
+
+		for (auto p = &utils::SyntaxList[0]; p->identifier; p++) {
+			engines.emplace_back(new Disassembler(mode));
+			auto e = engines.back().get();
+			e->syntax(p->option);
+			suite.add("disasm/disasm/" + bits + "/" + p->identifier, n, [e, ea, &os]() {
+				os.str(std::string());
+				e->disasm(ea, instructions, os);
+			});
+			suite.add("disasm/wide/" + bits + "/" + p->identifier, n, [e, ea, &ws]() {
+				ws.reset();
+				e->disasm(ea, instructions, ws);
+				ws.flush();
+			});
+		}
+	}
+
+	// every dumper writes into the same streams since only one case runs at a time
+	Dumper dumper(64, 16);
+	for (auto p = &utils::dumptypes[0]; p->type; p++) {
+		auto method = p->dumper;
+		auto start = reinterpret_cast<intptr_t>(data.data());
+		auto n = dumped / p->size;
+		suite.add(std::string("dump/") + p->type, n * p->size, [&dumper, &os, method, start, n]() {
+			os.str(std::string());
+			(dumper.*method)(start, n, os);
+		});
+		suite.add(std::string("dump/wide/") + p->type, n * p->size, [&dumper, &ws, method, start, n]() {
+			ws.reset();
+			(dumper.*method)(start, n, ws);
+			ws.flush();
+		});
+	}
+
+	reader(suite, "ubyte1", &utils::ubyte1, data);
+	reader(suite, "sbyte1", &utils::sbyte1, data);
+	reader(suite, "uint2", &utils::uint2, data);
+	reader(suite, "sint2", &utils::sint2, data);
+	reader(suite, "uint4", &utils::uint4, data);
+	reader(suite, "sint4", &utils::sint4, data);
+	reader(suite, "uint8", &utils::uint8, data);
+	reader(suite, "sint8", &utils::sint8, data);
+	reader(suite, "binary32", &utils::binary32, data);
+	reader(suite, "binary64", &utils::binary64, data);
+	return bench::execute(suite, options);
+}
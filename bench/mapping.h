@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "regions.h"
+
+/*
+	A mapping that repeats a smaller corpus back to back, so that a scan can
+	cover gigabytes while the process only pays for the corpus. Every copy
+	shares the corpus' pages until it's written to.
+*/
+class Mapping {
+private:
+	uint8_t* m_base;
+	size_t m_size;
+
+public:
+	Mapping(const std::vector<uint8_t>& corpus, size_t copies) : m_base(nullptr), m_size(corpus.size() * copies) {
+		if (corpus.empty() || corpus.size() % sysconf(_SC_PAGESIZE) || !copies)
+			throw std::invalid_argument("corpus");
+
+		int fd = memfd_create("corpus", 0);
+		if (fd < 0)
+			throw std::runtime_error("memfd_create");
+		if (write(fd, corpus.data(), corpus.size()) != static_cast<ssize_t>(corpus.size())) {
+			close(fd);
+			throw std::runtime_error("write");
+		}
+
+		// reserve the whole range first so that each copy can be placed right after the previous one
+		auto reserved = mmap(nullptr, m_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (reserved == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("mmap");
+		}
+		m_base = static_cast<uint8_t*>(reserved);
+
+		for (size_t i = 0; i < copies; i++) {
+			if (mmap(m_base + i * corpus.size(), corpus.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+				munmap(m_base, m_size);
+				close(fd);
+				throw std::runtime_error("mmap");
+			}
+		}
+		close(fd);
+	}
+
+	~Mapping() {
+		munmap(m_base, m_size);
+	}
+
+	Mapping(const Mapping&) = delete;
+	Mapping& operator=(const Mapping&) = delete;
+
+	uint8_t* data() const { return m_base; }
+	size_t size() const { return m_size; }
+
+	// the whole mapping as a single region
+	std::vector<Region> regions() const {
+		Region region = { reinterpret_cast<uintptr_t>(m_base), reinterpret_cast<uintptr_t>(m_base), m_size, memory::state_commit, memory::protect_readwrite, memory::type_mapped };
+		return std::vector<Region>(1, region);
+	}
+};
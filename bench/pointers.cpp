@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+#include "bench.h"
+#include "mapping.h"
+#include "parallel.h"
+#include "pointers.h"
+
+/*
+	The pointer search over a 1GB mapping, for each width and for a growing
+	number of target intervals. The pointers in the corpus are spread over
+	256MB starting at 0x7ff800000000, and the 64-bit intervals are spread
+	over the same range so that only some of the candidates land in one of
+	them. The 32-bit intervals are spread over 256MB of the noise instead.
+*/
+namespace {
+	const size_t corpus = 0x4000000, copies = 16;
+	const size_t counts[] = { 1, 16, 256 };
+
+	pointers::Targets
+	targets(size_t count, uint64_t base)
+	{
+		const uint64_t range = 0x10000000ull;
+		std::vector<pointers::Interval> res;
+		for (size_t i = 0; i < count; i++) {
+			auto start = base + i * (range / count);
+			pointers::Interval interval = { start, start + 0x1000 };
+			res.push_back(interval);
+		}
+		return pointers::Targets(res);
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Mapping mapping(bench::corpus(options.quick ? 0x1000000 : corpus, 31), options.quick ? 1 : copies);
+	auto regions = mapping.regions();
+	auto base = reinterpret_cast<uintptr_t>(mapping.data());
+	auto threads = parallel::workers(0);
+
+	bench::Suite suite;
+	for (auto count : counts) {
+		auto narrow = targets(count, 0x10000000ull), set = targets(count, 0x00007ff800000000ull);
+		auto suffix = "/targets=" + std::to_string(count);
+
+		suite.add("search4" + suffix, mapping.size(), [narrow, base, &mapping]() {
+			size_t hits = 0;
+			pointers::search4(base, mapping.size(), narrow, [&hits](const pointers::Found&) { hits++; return true; });
+		});
+
+		suite.add("search8" + suffix, mapping.size(), [set, base, &mapping]() {
+			size_t hits = 0;
+			pointers::search8(base, mapping.size(), set, [&hits](const pointers::Found&) { hits++; return true; });
+		});
+
+		suite.add("sharded8" + suffix + "/threads=" + std::to_string(threads), mapping.size(), [set, &regions, threads]() {
+			pointers::search(regions, sizeof(uint64_t), set, static_cast<size_t>(-1), threads);
+		});
+	}
+	return bench::execute(suite, options);
+}
@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+#include "bench.h"
+#include "extractor.h"
+#include "mapping.h"
+#include "parallel.h"
+#include "pointers.h"
+#include "scanner.h"
+
+/*
+	How the sharded scans scale from a single thread up to every core. Each
+	one covers a 2GB mapping, which only takes 64MB of memory since it's the
+	same corpus over and over.
+*/
+namespace {
+	const size_t corpus = 0x4000000, copies = 32;
+
+	// the thread counts that are measured, which are the powers of 2 up to the number of cores and then that number
+	std::vector<size_t>
+	counts()
+	{
+		std::vector<size_t> res;
+		auto cores = parallel::workers(0);
+		for (size_t count = 1; count < cores; count *= 2)
+			res.push_back(count);
+		res.push_back(cores);
+		return res;
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Mapping mapping(bench::corpus(options.quick ? 0x1000000 : corpus, 28), options.quick ? 1 : copies);
+	auto regions = mapping.regions();
+
+	// the start of an executable's header, which only shows up by chance in the noise
+	std::vector<uint8_t> pattern = { 0x4d, 0x5a, 0x90, 0x00, 0x03, 0x00 };
+
+	// the pointers in the corpus are spread over 256MB, so this only finds a handful of them
+	pointers::Targets targets({ { 0x00007ff800000000ull, 0x00007ff800040000ull } });
+
+	bench::Suite suite;
+	for (auto threads : counts()) {
+		auto suffix = "/threads=" + std::to_string(threads);
+
+		suite.add("bytes" + suffix, mapping.size(), [&regions, &pattern, threads]() {
+			scan::bytes(regions, pattern, threads);
+		});
+
+		// the text in the corpus is in lines shorter than this, so the scan is measured rather than the results it collects
+		suite.add("strings" + suffix, mapping.size(), [&regions, threads]() {
+			strings::extract(regions, 64, static_cast<size_t>(-1), threads);
+		});
+
+		suite.add("pointers" + suffix, mapping.size(), [&regions, &targets, threads]() {
+			pointers::search(regions, sizeof(uint64_t), targets, static_cast<size_t>(-1), threads);
+		});
+	}
+	return bench::execute(suite, options);
+}
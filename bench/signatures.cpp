@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "bench.h"
+#include "mapping.h"
+#include "parallel.h"
+#include "scanner.h"
+#include "signatures.h"
+
+/*
+	How the signature matcher holds up as the set grows. A scan's rate is
+	the bytes that it covers per second, and a compile's rate is the number
+	of signatures per second since it doesn't read any memory.
+*/
+namespace {
+	const size_t corpus = 0x4000000, copies = 8;
+	const size_t sizes[] = { 8, 64, 512 };
+
+	/*
+		A set of `count` signatures of 4 to 16 bytes. A quarter of them have
+		a wildcard nibble and an eighth are anchored, and the rest are plain
+		bytes. The first few come from the corpus so that there's something
+		for the scan to report.
+	*/
+	std::string
+	source(size_t count, uint32_t seed)
+	{
+		static const char* found[] = { "00 00 f8 7f 00 00", "^ 00 00 00 00", "54 68 65 20 71 75 69 63 6b" };
+		std::mt19937 random(seed);
+		std::ostringstream os;
+
+		for (size_t i = 0; i < count; i++) {
+			if (i < sizeof(found) / sizeof(*found)) {
+				os << found[i] << "\n";
+				continue;
+			}
+
+			if (random() % 8 == 0)
+				os << "^10 ";
+			auto length = 4 + random() % 13;
+			auto wildcard = (random() % 4 == 0) ? random() % length : length;
+			for (size_t n = 0; n < length; n++) {
+				auto byte = random() % 0x100;
+				os << std::hex << (byte >> 4);
+				if (n == wildcard)
+					os << "?";
+				else
+					os << (byte & 0xf);
+				os << " ";
+			}
+			os << "\n";
+		}
+		return os.str();
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Mapping mapping(bench::corpus(options.quick ? 0x1000000 : corpus, 29), options.quick ? 1 : copies);
+	auto regions = mapping.regions();
+	auto base = reinterpret_cast<uintptr_t>(mapping.data());
+	auto threads = parallel::workers(0);
+
+	bench::Suite suite;
+	for (auto count : sizes) {
+		auto text = source(count, 29 + static_cast<uint32_t>(count));
+		auto set = std::make_shared<SignatureSet>(text);
+		auto suffix = "/signatures=" + std::to_string(count);
+
+		suite.add("compile" + suffix, count, [text]() {
+			SignatureSet compiled(text);
+		});
+
+		suite.add("scan" + suffix, mapping.size(), [set, base, &mapping]() {
+			size_t hits = 0;
+			set->scan(base, mapping.size(), 0, [&hits](const SignatureSet::Hit&) { hits++; });
+		});
+
+		suite.add("sharded" + suffix + "/threads=" + std::to_string(threads), mapping.size(), [set, &regions, threads]() {
+			scan::signatures(regions, *set, threads);
+		});
+	}
+	return bench::execute(suite, options);
+}
@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+#include "mapping.h"
+#include "parallel.h"
+#include "snapshot.h"
+
+/*
+	Diffing a snapshot of a 1GB mapping where nothing has changed, and where
+	one page in every 1024 has. Neither diff updates the snapshot, so every
+	iteration does the same work. The hash of a single page is also timed
+	since it's what an unchanged page costs.
+*/
+namespace {
+	const size_t corpus = 0x4000000, copies = 16, stride = 1024;
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Mapping mapping(bench::corpus(options.quick ? 0x1000000 : corpus, 32), options.quick ? 1 : copies);
+	auto regions = mapping.regions();
+	auto threads = parallel::workers(0);
+	auto counts = (threads > 1) ? std::vector<size_t>{ 1, threads } : std::vector<size_t>{ 1 };
+
+	// one snapshot is taken before the pages are changed and the other one after
+	auto changed = std::make_shared<Snapshot>(regions, threads);
+	for (size_t offset = 0; offset < mapping.size(); offset += stride * Snapshot::pagesize)
+		mapping.data()[offset + 0x100] ^= 0xff;
+	auto unchanged = std::make_shared<Snapshot>(regions, threads);
+
+	bench::Suite suite;
+	suite.add("hash/page", Snapshot::pagesize, [&mapping]() {
+		Snapshot::hash(mapping.data(), Snapshot::pagesize);
+	});
+
+	for (auto count : counts) {
+		auto suffix = "/threads=" + std::to_string(count);
+
+		suite.add("diff/unchanged" + suffix, mapping.size(), [unchanged, &regions, count]() {
+			unchanged->diff(regions, count, false);
+		});
+
+		suite.add("diff/changed" + suffix, mapping.size(), [changed, &regions, count]() {
+			changed->diff(regions, count, false);
+		});
+	}
+	return bench::execute(suite, options);
+}
@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "symbols.h"
+
+/*
+	Resolving addresses against a table of 2048 synthetic modules with 2048
+	exports each, which is about what a large process has loaded. Each
+	iteration resolves a batch of addresses that either land past an export,
+	are outside of every module, or fall in the gap between two modules, both
+	into a string and through the stream that the annotated listings use. A
+	case's rate is over the addresses in its batch.
+*/
+namespace {
+	const size_t modules = 2048, exported = 2048, batch = 0x1000;
+	const uintptr_t first = 0x00007ff800000000ull, stride = 0x200000, spacing = 0x1f0;
+
+	std::vector<SymbolTable::Image>
+	images(size_t count, size_t exports)
+	{
+		std::vector<SymbolTable::Image> res;
+		for (size_t i = 0; i < count; i++) {
+			SymbolTable::Image image = { first + i * stride, 0x1000 + exports * spacing, "module" + std::to_string(i), {} };
+			for (size_t j = 0; j < exports; j++) {
+				SymbolTable::Export item = { static_cast<uint32_t>(0x1000 + j * spacing), "export" + std::to_string(j) };
+				image.exports.push_back(std::move(item));
+			}
+			res.push_back(std::move(image));
+		}
+		return res;
+	}
+
+	/* a batch of addresses that are spread over every module so that the lookups don't all hit the same lines */
+	std::vector<uintptr_t>
+	addresses(const std::string& kind, size_t count, size_t exports)
+	{
+		std::vector<uintptr_t> res;
+		uint32_t state = 41;
+		for (size_t i = 0; i < batch; i++) {
+			state = state * 1664525 + 1013904223;
+			auto module = first + (state >> 8) % count * stride;
+			auto size = 0x1000 + exports * spacing;
+			if (kind == "hit")
+				res.push_back(module + 0x1000 + (state >> 4) % exports * spacing + state % spacing);
+			else if (kind == "between")
+				res.push_back(module + size + (state >> 4) % (stride - size));
+			else
+				res.push_back((state & 1) ? first - 1 - (state >> 4) : first + count * stride + (state >> 4));
+		}
+		return res;
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	bench::Options options;
+	try {
+		options = bench::options(argc, argv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "invalid option: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	auto count = options.quick ? modules / 16 : modules, exports = options.quick ? exported / 16 : exported;
+	SymbolTable table;
+	table.assign(images(count, exports));
+
+	bench::Suite suite;
+	std::string result;
+	std::ostringstream os;
+
+	for (auto kind : { "hit", "miss", "between" }) {
+		auto items = addresses(kind, count, exports);
+		auto bytes = items.size() * sizeof(uintptr_t);
+		suite.add(std::string("resolve/") + kind, bytes, [&table, &result, items]() {
+			for (auto ea : items)
+				table.resolve(ea, result);
+		});
+		suite.add(std::string("format/") + kind, bytes, [&table, &os, items]() {
+			os.str(std::string());
+			for (auto ea : items)
+				table.resolve(ea, os);
+		});
+	}
+	return bench::execute(suite, options);
+}
@@ -1,4 +1,5 @@
 import * as utils from './utils';
+import * as memory from './memory';
 
 import * as L from 'loglevel';
 const Log = L.getLogger('Ax.ax');
@@ -30,6 +31,19 @@ export function getProcessPeb() {
     return Ax.Peb();
 }
 
+// Return the TEB for the thread `tid`, or the current thread if it's 0
+export function getThreadTeb(tid=0) {
+    return Ax.Teb(tid);
+}
+
+// Return [{tid, teb, stackbase, stacklimit}] for each thread in the process
+export function thread_list() {
+    return Ax.thread_list().split('\n').filter(line => line.length).map(line => {
+        let [tid, teb, stackbase, stacklimit] = line.split(' ').map(n => parseInt(n, 16));
+        return {tid, teb, stackbase, stacklimit};
+    });
+}
+
 export function ansistring(address) {
     return Ax.ansistring(address);
 }
@@ -58,6 +72,336 @@ export function mem_type(address) {
     return Ax.mem_type(address);
 }
 
+// Re-read the cached region map and module table
+export function refresh() {
+    return Ax.refresh();
+}
+
+/*
+ * Background jobs
+ * Start a native `operation` ("executables", "bytes", or "crc32") over the
+ * range [address, address+size) and return a handle for polling it.
+ */
+export const JobState = { pending: 0, running: 1, finished: 2, cancelled: 3, failed: 4 };
+
+export function job_start(operation, address, size, argument='') {
+    return Ax.job_start(operation, address, size, argument);
+}
+
+// Return the next chunk of newline-separated results from a job.
+export function job_poll(handle) {
+    return Ax.job_poll(handle);
+}
+
+export function job_progress(handle) {
+    return Ax.job_progress(handle);
+}
+
+export function job_wait(handle, timeout=0xffffffff) {
+    return Ax.job_wait(handle, timeout);
+}
+
+export function job_cancel(handle) {
+    return Ax.job_cancel(handle);
+}
+
+export function job_close(handle) {
+    return Ax.job_close(handle);
+}
+
+// Number of native workers a scan is sharded across (0 for one per processor)
+export function threads(count) {
+    if (count !== undefined)
+        Ax.threads = count;
+    return Ax.threads;
+}
+
+/*
+ * Scan the readable memory within [address, address+size) for an array of
+ * `bytes` and return the sorted addresses of every match.
+ */
+export function scan_bytes(bytes, address, size) {
+    let pattern = bytes.map(n => ('0' + (n & 0xff).toString(16)).slice(-2)).join(' ');
+    let res = Ax.scan_bytes(address, size, pattern);
+    return res.split('\n').filter(line => line.length).map(line => parseInt(line, 16));
+}
+
+/*
+ * Scan the readable memory within [address, address+size) for every one of
+ * the `signatures` in a single pass. Each signature is a string of hex bytes
+ * where a nibble can be "?", optionally prefixed with "^" (page-aligned) or
+ * "^N" (aligned to N). Returns a sorted list of [address, index] pairs.
+ */
+export function scan_signatures(signatures, address, size) {
+    let res = Ax.scan_signatures(address, size, signatures.join('\n'));
+    return res.split('\n').filter(line => line.length).map(line => {
+        let [ea, id] = line.split(' ');
+        return [parseInt(ea, 16), parseInt(id, 10)];
+    });
+}
+
+/*
+ * Extract up to `limit` printable ASCII and UTF-16LE strings of at least
+ * `minimum` characters from [address, address+size). Returns a sorted list
+ * of [address, encoding, text] tuples where encoding is "ascii" or "utf16".
+ */
+export function scan_strings(address, size, minimum=4, limit=1000) {
+    let res = Ax.scan_strings(address, size, minimum, limit);
+    return res.split('\n').filter(line => line.length).map(line => {
+        let [ea, encoding] = line.split(' ', 2);
+        let text = line.slice(ea.length + encoding.length + 2);
+        return [parseInt(ea, 16), encoding, text];
+    });
+}
+
+/*
+ * Search [address, address+size) for pointer-sized values that land within
+ * any of the [start, stop) pairs in `intervals`. Returns a sorted list of
+ * [location, value] pairs.
+ */
+export function scan_pointers(address, size, intervals, limit=1000) {
+    let text = intervals.map(([start, stop]) => `${start.toString(16)} ${stop.toString(16)}`).join('\n');
+    let res = Ax.scan_pointers(address, size, text, limit);
+    return res.split('\n').filter(line => line.length).map(line => {
+        let [location, value] = line.split(' ');
+        return [parseInt(location, 16), parseInt(value, 16)];
+    });
+}
+
+/*
+ * Snapshots
+ * Capture the readable pages in [address, address+size) so that they can be
+ * diffed later. A diff returns a list of [page, kind, ranges] where kind is
+ * "modified" or "missing" and ranges is a list of [offset, size] within the
+ * page. If `update` is set, the next diff is relative to this one.
+ */
+export function snapshot_capture(address, size) {
+    return Ax.snapshot_capture(address, size);
+}
+
+export function snapshot_diff(handle, update=false) {
+    let res = Ax.snapshot_diff(handle, update);
+    return res.split('\n').filter(line => line.length).map(line => {
+        let [page, kind, ...ranges] = line.split(' ');
+        return [parseInt(page, 16), kind, ranges.map(range => range.split(':').map(n => parseInt(n, 16)))];
+    });
+}
+
+export function snapshot_close(handle) {
+    return Ax.snapshot_close(handle);
+}
+
+/*
+ * Cursors
+ * Open a cursor over the same text that dump() or disassemble() would
+ * return, and then read it back with next() a chunk of at most `maxChars`
+ * characters at a time. An exhausted cursor returns an empty string.
+ */
+export function open_dump(address, count, type='uint8_t') {
+    return Ax.open_dump(address, count, type);
+}
+
+export function open_disasm(address, count) {
+    return Ax.open_disasm(address, count);
+}
+
+export function next(handle, maxChars=0x10000) {
+    return Ax.next(handle, maxChars);
+}
+
+export function close(handle) {
+    return Ax.close(handle);
+}
+
+// Yield each chunk of a cursor and then close it.
+export function* chunks(handle, maxChars=0x10000) {
+    try {
+        for (let chunk = Ax.next(handle, maxChars); chunk.length; chunk = Ax.next(handle, maxChars))
+            yield chunk;
+    } finally {
+        Ax.close(handle);
+    }
+}
+
+/*
+ * Instrumentation
+ * While instrumented, every native method counts its calls, the bytes it
+ * touched, and its faults, and times each of its phases. stats() returns an
+ * object keyed by method where each phase is {count, mean, p50, p99, max}
+ * in nanoseconds.
+ */
+export function instrumented(enable) {
+    if (enable !== undefined)
+        Ax.instrumented = enable;
+    return Ax.instrumented;
+}
+
+export function stats() {
+    let res = {};
+    for (let line of Ax.stats().split('\n').filter(line => line.length)) {
+        let [method, ...fields] = line.split(' ');
+        let item = res[method] = {};
+        for (let field of fields) {
+            let [name, value] = field.split('=');
+            let numbers = value.split(':').map(n => parseInt(n, 10));
+            item[name] = (numbers.length > 1)? {count: numbers[0], mean: numbers[1], p50: numbers[2], p99: numbers[3], max: numbers[4]} : numbers[0];
+        }
+    }
+    return res;
+}
+
+export function stats_reset() {
+    return Ax.stats_reset();
+}
+
+/*
+ * Access tracing
+ * While tracing, every native access is recorded as its operation, address,
+ * size, result and timestamp. This covers the integer, string and bulk
+ * accessors, disassembly, dumps, and the reads made by pointer, list and heap
+ * walks. The scans, jobs and snapshots read whole regions across threads and
+ * aren't recorded. trace_flush() appends whatever has been recorded to a file
+ * and returns the number of entries, and trace_dropped() counts the entries
+ * that were lost because nothing flushed them in time.
+ *
+ * A trace can be replayed on Linux with the "replay" program from the CMake
+ * build, against memory images that are loaded at their original addresses.
+ */
+export function trace_start() {
+    return Ax.trace_start();
+}
+
+export function trace_stop() {
+    return Ax.trace_stop();
+}
+
+export function trace_flush(path) {
+    return Ax.trace_flush(path);
+}
+
+export function trace_dropped() {
+    return Ax.trace_dropped();
+}
+
+/*
+ * Pointer chains
+ * evaluate() resolves an expression such as "[[base+0x18]+0x10]+8" with a
+ * single native call. walk_list() follows the Flink of each LIST_ENTRY from
+ * the sentinel at `head` until it comes back around, and returns {nodes,
+ * status, where}. Each node is the link minus `offset`, and status is one
+ * of 'complete', 'limit', 'cycle', or 'fault' where `where` is the link
+ * that stopped the walk.
+ */
+export function evaluate(base, expression) {
+    return Ax.evaluate(base, expression);
+}
+
+export function walk_list(head, offset=0, limit=0) {
+    let res = {nodes: [], status: 'complete', where: undefined};
+    for (let line of Ax.walk_list(head, offset, limit).split('\n').filter(line => line.length)) {
+        let [first, second] = line.split(' ');
+        if (second === undefined)
+            res.nodes.push(parseInt(first, 16));
+        else
+            [res.status, res.where] = [first, parseInt(second, 16)];
+    }
+    return res;
+}
+
+/*
+ * Batched strings
+ * Decode many UNICODE_STRING or ANSI_STRING structures with a single native
+ * call, either from a list of their addresses or from an array of them.
+ * Each result is {address, status, text} where status is one of 'ok',
+ * 'truncated', 'invalid', 'unmapped', or 'fault'. A length larger than `cap`
+ * bytes is truncated to it.
+ */
+function decoded(res) {
+    const unescape = text => text.replace(/\\(\\|x[0-9a-f]{2}|u[0-9a-f]{4})/g, (_, escape) => (escape == '\\')? '\\' : String.fromCharCode(parseInt(escape.slice(1), 16)));
+    return res.split('\n').filter(line => line.length).map(line => {
+        let [address, status, ...text] = line.split(' ');
+        return {address: parseInt(address, 16), status: status, text: (text.length > 0)? unescape(text.join(' ')) : undefined};
+    });
+}
+
+export function read_strings(kind, addresses, cap=0) {
+    return decoded(Ax.read_strings(kind, addresses.map(ea => ea.toString(16)).join(' '), cap));
+}
+
+export function read_string_array(kind, address, count, stride=0, cap=0) {
+    return decoded(Ax.read_string_array(kind, address, count, stride, cap));
+}
+
+// Yield each record that a job produces until its stream is exhausted.
+export function* job_results(handle) {
+    for (;;) {
+        let state = Ax.job_wait(handle, 50);
+        let chunk = Ax.job_poll(handle);
+        for (let record of chunk.split('\n'))
+            if (record.length)
+                yield record;
+        if (!chunk.length && state != JobState.pending && state != JobState.running)
+            return;
+    }
+}
+
+/*
+ * Bulk writing
+ * Each of these is a single native call that stops at the first page that
+ * can't be written. They return [count, previous] where count is the number
+ * of bytes written, and previous is an array of the bytes that were there
+ * before if `previous` was set.
+ */
+const hexbytes = bytes => bytes.map(b => ('0' + (b & 0xff).toString(16)).slice(-2)).join('');
+
+function transferred(res) {
+    let [count, original] = res.split(' ');
+    let previous = (original === undefined)? undefined : Array.from({length: original.length / 2}, (_, i) => parseInt(original.substr(2 * i, 2), 16));
+    return [parseInt(count, 16), previous];
+}
+
+export function write(address, bytes, previous=false) {
+    memory.invalidate();
+    return transferred(Ax.write(address, hexbytes(bytes), previous));
+}
+
+export function fill(address, size, pattern, previous=false) {
+    memory.invalidate();
+    return transferred(Ax.fill(address, size, hexbytes(pattern), previous));
+}
+
+export function copy(destination, source, size, previous=false) {
+    memory.invalidate();
+    return transferred(Ax.copy(destination, source, size, previous));
+}
+
+// Read up to `size` bytes from `address` in a single call, stopping at the first page that can't be read.
+export function read(address, size) {
+    let [count, bytes] = transferred(Ax.read(address, size));
+    return bytes.slice(0, count);
+}
+
+/*
+ * Memory Backend
+ * Attempt to write an array of `bytes` to `address`.
+ * Returns the number of bytes successfully written.
+ */
+export function bulkwrite(address, bytes) {
+    if (!bytes.length)
+        return 0;
+    let [res, _] = write(address, bytes);
+    return res;
+}
+
+/*
+ * Memory Backend
+ * Attempt to read `size` bytes from `address`.
+ * Returns an array of the bytes that were read.
+ */
+export function bulkread(address, size) {
+    return size? read(address, size) : [];
+}
+
 /*
  * Memory Backend
  * Attempt to write an unsigned `integral` of `size` bytes to `address`.
@@ -111,6 +455,16 @@ export function fakestore(address, size, integral) {
     return 0;
 }
 
+// Simulates a bulk write that never succeeds.
+export function fakewrite(address, bytes) {
+    return 0;
+}
+
+// Simulates a bulk read where every byte is 0.
+export function fakeread(address, size) {
+    return new Array(size).fill(0);
+}
+
 // internal ActiveX object that this module wraps.
 let ax;
 try {
@@ -119,6 +473,8 @@ try {
     // assign our Ax-based implementations to the memory backend.
     global.document.__load__ = load;
     global.document.__store__ = store;
+    global.document.__write__ = bulkwrite;
+    global.document.__read__ = bulkread;
 
 } catch(e) {
     Log.error("Unable to instantiate Ax-Control using typename \"Ax.Leaker.1\".");
@@ -135,5 +491,166 @@ try {
     Log.warn(`Assigning fake memory backend due to instantiation failure.`);
     global.document.__load__ = fakeload;
     global.document.__store__ = fakestore;
+    global.document.__write__ = fakewrite;
+    global.document.__read__ = fakeread;
 }
 export const Ax = ax;
+
+/*
+ * Symbols
+ * An address inside of a module resolves to "module!export+0xoffset", or to
+ * "module+0xoffset" when no export precedes it. While annotating,
+ * disassemble() follows each instruction that refers to an address with its
+ * symbol. A "symbols" dump lists one pointer per line with its symbol.
+ */
+export function annotate(enable) {
+    if (enable !== undefined)
+        Ax.annotate = enable;
+    return Ax.annotate;
+}
+
+export function symbolize(address) {
+    return Ax.symbolize(address);
+}
+
+/*
+ * Functions
+ * On x64 the exception directory of each module gives the bounds of every
+ * function that isn't a leaf. function_at() returns {begin, end, unwind,
+ * primary} for the entry containing `address`, where primary is the start
+ * of the function that a chained entry belongs to.
+ */
+export function function_at(address) {
+    let [begin, end, unwind, primary] = Ax.function_at(address).split(' ').map(n => parseInt(n, 16));
+    return {begin, end, unwind, primary};
+}
+
+// Disassemble the whole function that contains `address`
+export function disassemble_function(address) {
+    return Ax.disassemble_function(address);
+}
+
+/*
+ * Stacks
+ * Scan [low, high) for values that return into a module right after a call.
+ * Each candidate is {slot, value, score, kind, target, symbol}, where kind is
+ * "direct" or "indirect" and target is the destination of a direct call.
+ * They're ranked by score, and then by their slot.
+ */
+export function stack_scan(low, high, limit=0) {
+    return Ax.stack_scan(low, high, limit).split('\n').filter(line => line.length).map(line => {
+        let [slot, value, score, kind, target, symbol] = line.split(' ');
+        return {slot: parseInt(slot, 16), value: parseInt(value, 16), score: parseInt(score, 10), kind, target: parseInt(target, 16), symbol};
+    });
+}
+
+/*
+ * Tables
+ * Sweep the read-only data of every module (or only the one containing
+ * `address`) for runs of at least `minimum` pointers into code, such as
+ * vtables. Each table is {address, length, module}. A module is only swept
+ * once while it stays loaded.
+ */
+export function scan_vtables(address=0, minimum=0) {
+    return Ax.scan_vtables(address, minimum).split('\n').filter(line => line.length).map(line => {
+        let [address, length, module] = line.split(' ');
+        return {address: parseInt(address, 16), length: parseInt(length, 10), module};
+    });
+}
+
+/*
+ * Classification
+ * Measure every readable page in [address, address+size). Each page is
+ * {address, entropy, zeros, printable, pointers, kind}, where entropy is in
+ * bits, each of the ratios is between 0 and 1, and kind is one of the names
+ * in entropy_kinds.
+ */
+export const entropy_kinds = ['mixed', 'zero', 'uniform', 'text', 'pointer', 'compressed'];
+
+export function scan_entropy(address, size) {
+    let res = [];
+    for (let line of Ax.scan_entropy(address, size).split('\n').filter(line => line.length)) {
+        let [start, count, data] = line.split(' ');
+        start = parseInt(start, 16);
+        for (let i = 0; i < parseInt(count, 10); i++) {
+            let [entropy, zeros, printable, pointers, kind] = [0, 1, 2, 3, 4].map(n => parseInt(data.substr(10 * i + 2 * n, 2), 16));
+            res.push({address: start + i * 0x1000, entropy: entropy / 32, zeros: zeros / 255, printable: printable / 255, pointers: pointers / 255, kind: entropy_kinds[kind]});
+        }
+    }
+    return res;
+}
+
+/*
+ * Integrity
+ * Compare the module containing `address` (or every module if it's 0)
+ * against the file it was loaded from, after relocating the file for where
+ * the module was loaded. The scope is one of integrity_scopes, where 'code'
+ * is the executable sections and 'readonly' adds every section that isn't
+ * writable except for the import address table. Each patch is
+ * {address, size, module, expected, actual}, where expected and actual are
+ * arrays of (at most the first 64) bytes.
+ */
+export const integrity_scopes = ['code', 'readonly'];
+
+export function module_integrity(address=0, scope='code') {
+    const bytes = s => Array.from({length: s.length / 2}, (_, i) => parseInt(s.substr(2 * i, 2), 16));
+    return Ax.module_integrity(address, integrity_scopes.indexOf(scope)).split('\n').filter(line => line.length).map(line => {
+        let [ea, size, module, expected, actual] = line.split(' ');
+        return {address: parseInt(ea, 16), size: parseInt(size, 10), module, expected: bytes(expected), actual: bytes(actual)};
+    });
+}
+
+/*
+ * Heaps
+ * Walk the NT heap at `address`, or every heap in the environment block's
+ * ProcessHeaps if it's 0. Each heap is {address, kind, segments, corrupt,
+ * entries} where kind is one of heap_kinds, and corrupt is set when the walk
+ * stopped at a header that didn't decode. Each entry is
+ * {address, size, busy, flags} where address is its header and size
+ * includes it. At most `limit` entries are returned for each heap if it's
+ * not 0.
+ */
+export const heap_kinds = ['invalid', 'nt', 'segment'];
+
+export function heap_walk(address=0, limit=0) {
+    let res = [];
+    for (let line of Ax.heap_walk(address, limit).split('\n').filter(line => line.length)) {
+        let fields = line.split(' ');
+        if (fields[0] == 'heap') {
+            let [_, ea, kind, segments, count, corrupt] = fields;
+            res.push({address: parseInt(ea, 16), kind, segments: parseInt(segments, 10), corrupt: corrupt !== undefined, entries: []});
+            continue;
+        }
+        let [ea, size, flags] = fields.map(n => parseInt(n, 16));
+        res[res.length - 1].entries.push({address: ea, size, busy: (flags & 1) != 0, flags});
+    }
+    return res;
+}
+
+/*
+ * Instructions
+ * Find the instructions in the module containing `address` that match a
+ * query, decoding the module with the current bits the first time that
+ * it's asked about. A query is a list of terms such as a mnemonic, a flag
+ * (jump, call, ret, interrupt, relative, indirect, memory, immediate), or
+ * ops=<kinds> (reg, imm, mem, or * for each operand), disp=<n>, imm=<n>,
+ * and base=<register>. The result is {base, count, footprint, matches}
+ * where count is the number of instructions in the index, footprint is
+ * the bytes it occupies, and each match is {address, size}. At most
+ * `limit` matches are returned if it's not 0.
+ *
+ *     query_instructions(module, 'mov ops=reg,mem disp=0x1c8')
+ *     query_instructions(module, 'imm=0x4d5a')
+ *     query_instructions(module, 'call indirect')
+ */
+export function query_instructions(address, query, limit=0) {
+    let [header, ...lines] = Ax.query_instructions(address, query, limit).split('\n').filter(line => line.length);
+    let [_, base, count, footprint] = header.split(' ');
+    return {
+        base: parseInt(base, 16), count: parseInt(count, 10), footprint: parseInt(footprint, 10),
+        matches: lines.map(line => {
+            let [ea, size] = line.split(' ');
+            return {address: parseInt(ea, 16), size: parseInt(size, 10)};
+        }),
+    };
+}
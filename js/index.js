@@ -17,6 +17,8 @@ const Log = L.getLogger('Ax.index');
 
 global.document.__load__ = Ax.load;
 global.document.__store__ = Ax.store;
+global.document.__write__ = Ax.bulkwrite;
+global.document.__read__ = Ax.bulkread;
 
 function redirect_log(log, E, width=120, height=10) {
     // Create a textarea for output
@@ -296,12 +296,14 @@ export class Jcontainer extends Jtype {
     size() {
         return this._value.reduce((total, instance) => total + instance.size(), 0);
     }
+    /* Buffer the whole container with a single read, replacing whatever was buffered before, so that each of its fields is loaded from it. */
+    fill() {
+        memory.prefetch(this.address, this.size());
+        return this;
+    }
+    /* The fields are laid out back-to-back, so the bytes are read in one shot instead of per field. */
     bytes() {
-        const value = this._value;
-        return Lazy.default(value)
-                   .map(n => n.bytes())
-                   .flatten()
-                   .toArray();
+        return memory.load(this.address, this.size());
     }
     serialize() {
         const value = this._value;
@@ -353,6 +355,7 @@ export class Jarray extends Jcontainer {
             ea += res.size();
             count -= 1;
         }
+        this.fill();
     }
 }
 
@@ -414,6 +417,7 @@ export class Jstruct extends Jcontainer {
                 ea += res.size();
             }
         );
+        this.fill();
     }
     repr() {
         const fields = this.Fields;
@@ -55,11 +55,126 @@ export function fload(ea, c) {
     return [0, 0];
 }
 
+/*
+ * Read-ahead buffer
+ * A load that misses fetches the aligned blocks around it with a single call
+ * to the `__read__` backend, and the loads that follow it are served from
+ * those blocks. The blocks are a snapshot, so they only live until the next
+ * prefetch: each container's fill and each load that misses starts from an
+ * empty buffer instead of one left behind by an earlier call. They're also
+ * dropped on every store, and can be dropped explicitly with `invalidate()`
+ * when the memory is known to have changed underneath us. Buffering is only
+ * used when the backend provides its own `__read__`, since the default one is
+ * no faster than loading each integer.
+ */
+export const BlockSize = 0x100;
+const MaxBlocks = 64;
+
+const readahead = {
+    enabled: true,
+    blocks: new Map(),      // aligned address -> array of bytes
+};
+export const counters = {hits: 0, misses: 0, fetches: 0, fetched: 0, invalidations: 0};
+
+// Enable or disable the read-ahead buffer, and return whether it's enabled.
+export function buffering(enable) {
+    if (enable !== undefined) {
+        readahead.enabled = enable;
+        invalidate();
+    }
+    return readahead.enabled;
+}
+
+// Drop every block that has been buffered.
+export function invalidate() {
+    if (readahead.blocks.size)
+        counters.invalidations++;
+    readahead.blocks.clear();
+}
+
+export function reset_counters() {
+    for (let k of Object.keys(counters))
+        counters[k] = 0;
+}
+
+/* addresses can be larger than 32-bits, so they're aligned with arithmetic instead of a mask */
+const BlockAlign = (ea) => ea - ea % BlockSize;
+
+/*
+ * Replace the buffer with the blocks covering [address, address+size), which
+ * are fetched with a single call to `__read__`. Whatever was buffered before is
+ * dropped first. Nothing is buffered past the point where the read stopped, so
+ * those loads fall through to the backend.
+ */
+export function prefetch(address, size) {
+    if (!readahead.enabled || global.document.__read__ === __read__ || size <= 0)
+        return 0;
+    invalidate();
+
+    // trim the range to what we're willing to keep
+    const start = BlockAlign(address);
+    const stop = Math.min(BlockAlign(address + size - 1) + BlockSize, start + MaxBlocks * BlockSize);
+
+    const bytes = global.document.__read__(start, stop - start) || [];
+    counters.fetches++;
+    counters.fetched += bytes.length;
+
+    for (let offset = 0; offset < bytes.length; offset += BlockSize)
+        readahead.blocks.set(start + offset, bytes.slice(offset, offset + BlockSize));
+    return bytes.length;
+}
+
+/* Return the `size` bytes at `address` from the buffer, or undefined if they aren't all readable. */
+function buffered(address, size) {
+    if (!readahead.enabled || global.document.__read__ === __read__ || size > MaxBlocks * BlockSize)
+        return undefined;
+
+    const collect = () => {
+        let [res, ea] = [[], address];
+        while (res.length < size) {
+            const base = BlockAlign(ea);
+            const block = readahead.blocks.get(base);
+            if (block === undefined || ea - base >= block.length)
+                return undefined;
+            const count = Math.min(block.length - (ea - base), size - res.length);
+            for (let i = 0; i < count; i++)
+                res.push(block[ea - base + i]);
+            ea += count;
+        }
+        return res;
+    };
+
+    let res = collect();
+    if (res !== undefined) {
+        counters.hits++;
+        return res;
+    }
+
+    // a miss starts over from memory rather than adding to what an earlier call buffered
+    counters.misses++;
+    prefetch(address, size);
+    return collect();
+}
+
 /*
  * Store an array of bytes to `address`.
  * Return the number of bytes that were written.
  */
 export function store(address, bytes) {
+    invalidate();
+    let res = global.document.__write__(address, bytes);
+    if (res > bytes.length)
+        throw new errors.StoreError(`store(${address}, ${bytes.toString()}) : Wrote ${res - bytes.length} bytes more than expected.`);
+    return res;
+}
+
+/*
+ * Store an array of bytes to `address` as a sequence of integers using `fstore`.
+ * This is the fallback for a backend that can't write a buffer in a single call.
+ */
+export function storeints(address, bytes) {
+    invalidate();
+
     // Figure out the maximum number of bytes we can write accurately
     const INTEGER_BITS = Math.pow(2, Math.trunc(Math.log(MAX_SAFE_INTEGER_BITS) / Math.log(2)));
     const INTEGER_BYTES = INTEGER_BITS / 8;
@@ -69,17 +184,17 @@ export function store(address, bytes) {
     do {
         // figure out the integer and it's size
         let ci = (state.length > INTEGER_BYTES)? INTEGER_BYTES : state.length;
-        let ni = state.slice(0, ci).reduce((agg, n) => agg * 256 + n);
+        let ni = state.slice(0, ci).reduceRight((agg, n) => agg * 256 + n, 0);
 
         // try storing the integer to our address
         let cb = fstore(ea, ci, ni);
         if (!cb) {
             // FIXME: maybe throw an error here?
-            Log.error(`store(${address}, ${bytes.toString()}) : Unable to write ${ci} leftover bytes for ${ni} to ${ea}.`);
+            Log.error(`storeints(${address}, ${bytes.toString()}) : Unable to write ${ci} leftover bytes for ${ni} to ${ea}.`);
             return res;
         }
         if (cb > ci)
-            Log.warn(`store(${address}, ${bytes.toString()}) : Accidentally wrote more bytes than intended. (${cb} > ${ci})`);
+            Log.warn(`storeints(${address}, ${bytes.toString()}) : Accidentally wrote more bytes than intended. (${cb} > ${ci})`);
 
         // whee, now we can slice out the part of the array we processed
         state = state.slice(cb);
@@ -87,7 +202,7 @@ export function store(address, bytes) {
     } while (state.length > 0);
 
     if (res > bytes.length)
-        throw new errors.StoreError(`store(${address}, ${bytes.toString()}) : Wrote ${res - bytes.length} bytes more than expected.`);
+        throw new errors.StoreError(`storeints(${address}, ${bytes.toString()}) : Wrote ${res - bytes.length} bytes more than expected.`);
     return res;
 }
 
@@ -106,6 +221,7 @@ export function storeui(address, size, integral) {
 
     // XXX: n >>> 0 will convert 32-bit signed to unsigned
 
+    invalidate();
     return storei(address, size, integral);
 }
 
@@ -124,6 +240,7 @@ export function storesi(address, size, integral) {
 
     // Unsign our signed `integral`, and then just forward to storeui.
     let res = (integral < 0)? integral + MAX_INTEGRAL : integral;
+    invalidate();
     return storei(address, size, res);
 }
 
@@ -156,9 +273,12 @@ function storei(address, size, integral) {
  * integers containing their values.
  */
 export function load(address, size) {
-    // calls __load__(...) until it returns a size that's less than or equal to `c`;
+    let res = buffered(address, size);
+    if (res !== undefined)
+        return res;
 
-    let res = [];
+    // calls __load__(...) until it returns a size that's less than or equal to `c`;
+    res = [];
     let [ea, total] = [address, 0];
     while (total < size) {
         let [cb, n] = fload(ea, size);
@@ -212,6 +332,9 @@ export function loadsi(address, size) {
  * Internal implementation of loadui and loadsi.
  */
 function loadi(address, size) {
+    const bytes = buffered(address, size);
+    if (bytes !== undefined)
+        return bytes.reduceRight((agg, n) => agg * 256 + n, 0);
 
     // consume as many integers as we need from `address`.
     let [ea, components, total] = [address, [], 0];
@@ -426,6 +549,46 @@ function __store__(address, size, integral) {
     throw new errors.MissingBackendError('store');
 }
 
+/*
+ * Backend:
+ * Attempt to write an array of `bytes` to `address` in a single call.
+ * Returns the number of bytes successfully written. If this isn't
+ * defined, the bytes are written an integer at a time with `__store__`.
+ *
+ * Example:
+ * __write__(ea, [0x41, 0x42, 0x43]) -> 3
+ */
+function __write__(address, bytes) {
+    return storeints(address, bytes);
+}
+
+/*
+ * Backend
+ * Attempt to read `size` bytes from `address` in a single call. Returns an
+ * array of the bytes that were read, which stops short at the first byte that
+ * couldn't be. If this isn't defined, the bytes are read an integer at a time
+ * with `__load__` and nothing is buffered.
+ *
+ * Example:
+ * __read__(ea, 3) -> [0x41, 0x42, 0x43]
+ */
+function __read__(address, size) {
+    let [res, ea] = [[], address];
+    try {
+        while (res.length < size) {
+            let [cb, n] = fload(ea, Math.min(4, size - res.length));
+            if (!cb) break;
+            for (let i = 0; i < cb; i++) {
+                res.push(n % 256);
+                n = Math.trunc(n / 256);
+            }
+            ea += cb;
+        }
+    } catch(e) {
+    }
+    return res.slice(0, size);
+}
+
 /*
  * Backend
  * Attempt to read an unsigned integer of up to `size` bytes from `address`.
@@ -443,6 +606,14 @@ function __load__(address, size) {
 if (!global.document.hasOwnProperty('__store__'))
     global.document.__store__ = __store__;
 
+// Check to see if __write__ was defined. Assign a default if not.
+if (!global.document.hasOwnProperty('__write__'))
+    global.document.__write__ = __write__;
+
 // Check to see if __load__ was defined. Assign a default if not.
 if (!global.document.hasOwnProperty('__load__'))
     global.document.__load__ = __load__;
+
+// Check to see if __read__ was defined. Assign a default if not.
+if (!global.document.hasOwnProperty('__read__'))
+    global.document.__read__ = __read__;
@@ -5,7 +5,7 @@ import * as Err from 'errors';
 const errors = Err.default;
 
 // pstypes.js
-class LDR_DATA_TABLE_ENTRY extends J.Jstruct {
+export class LDR_DATA_TABLE_ENTRY extends J.Jstruct {
     static typename() { return 'LDR_DATA_TABLE_ENTRY'; }
     get Fields() {
         return [
@@ -21,6 +21,12 @@ Err.create({
     parent: Err.RuntimeError,
 });
 
+Err.create({
+    name: 'ThreadNotFoundError',
+    defaultExplanation: 'Unable to locate the stack of the specified thread.',
+    parent: Err.RuntimeError,
+});
+
 /*
  * Scan across a memory region looking for MZ headers by iterating over mappings.
  * Return an array of all addresses in [0x1000, 0x7fffffff] that start with MZ
@@ -232,13 +238,17 @@ function _ReadBytes(ea, bytes=1) {
  *  _WriteData(ea, new_bytes, 1);
  */
 function _WriteData(ea, new_bytes, bytes=1) {
-    Lazy.range(ea, ea + (new_bytes.length)*bytes, bytes)
-        .zip(new_bytes)
-        .each( z => {
-            const [addr, b] = [z[0], z[1]];
-            Log.debug(`Writing ${bytes} bytes: Addr: ${addr} (${utils.toHex(addr)}), New Bytes: ${b} (${utils.toHex(b)})`);
-            memory.storeui(addr, bytes, b);
-        });
+    // lay out every number as little-endian so that the whole buffer is written at once. a negative
+    // number is floored and then wrapped into 0-255 so that it's written as its two's complement.
+    const data = [];
+    for (let n of new_bytes)
+        for (let i = 0; i < bytes; i++)
+            data.push(((Math.floor(n / Math.pow(2, 8 * i)) % 256) + 256) % 256);
+
+    Log.debug(`Writing ${data.length} bytes: Addr: ${ea} (${utils.toHex(ea)})`);
+    const res = memory.store(ea, data);
+    if (res < data.length)
+        throw new errors.StoreError(`_WriteData(${ea}, ${new_bytes.toString()}, ${bytes}) : Unable to write ${data.length - res} bytes to ${ea + res}.`);
 }
 
 /*
@@ -333,13 +343,13 @@ export function* LdrWalk(pebaddr) {
     let ldrp = peb.field('Ldr');
     let ldr = ldrp.d;
     let ml = ldr.field('InLoadOrderModuleLoadList');
-    let res = ml.field('Flink');
-    let sentinel = res;
-    while (res.int() != sentinel.address) {
-        res = res.d;
-        yield res;
-        res = res.field('InLoadOrderLinks').field('Flink');
-    }
+
+    // the links are all followed with a single native call
+    let walk = Ax.walk_list(ml.address);
+    for (let ea of walk.nodes)
+        yield ml.new(pstypes.LDR_DATA_TABLE_ENTRY, ea);
+    if (walk.status == 'fault')
+        throw new errors.InvalidAddressError(`LdrWalk(${pebaddr}) : Unable to follow the link at ${walk.where}.`);
     return;
 }
 
@@ -518,3 +528,24 @@ export function CRCFindModule(addrs, num_bytes, target) {
 
     return crcs[target];
 }
+
+/*
+ * Scan the stack of a thread for the return addresses of its frames
+ *
+ * Arguments:
+ *  tid - Id of the thread, or 0 for the current thread
+ *  limit - Maximum number of candidates to return, or 0 for all of them
+ *
+ * Example - List the most likely frames of the current thread
+ *  for (let frame of ThreadStackScan(0, 16))
+ *      Log.debug(utils.toHex(frame.slot), frame.symbol);
+ *
+ * Return - Array of candidates ranked the same way as Ax.stack_scan
+ */
+export function ThreadStackScan(tid=0, limit=0) {
+    let teb = tid ? 0 : Ax.getThreadTeb(0);
+    let thread = Ax.thread_list().find(item => tid ? item.tid === tid : item.teb === teb);
+    if (thread === undefined || !thread.stackbase)
+        throw new errors.ThreadNotFoundError(`Unable to locate the stack of thread ${tid}`);
+    return Ax.stack_scan(thread.stacklimit, thread.stackbase, limit);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+/** just enough of a test framework to report each failed check and exit with whether any did */
+namespace check {
+	inline int&
+	failures()
+	{
+		static int res = 0;
+		return res;
+	}
+
+	inline void
+	fail(const char* file, int line, const char* expression)
+	{
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+		failures()++;
+	}
+
+	inline int
+	result()
+	{
+		if (failures())
+			fprintf(stderr, "%d check(s) failed\n", failures());
+		return failures() ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+}
+
+#define CHECK(expression) ((expression) ? (void)0 : check::fail(__FILE__, __LINE__, #expression))
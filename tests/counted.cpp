@@ -0,0 +1,172 @@
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "counted.h"
+
+namespace {
+	const size_t width = sizeof(void*);
+
+	/* a UNICODE_STRING or ANSI_STRING laid out the way the NDK does for this process */
+	struct Header {
+		uint16_t length, maximum;
+		uint8_t padding[width - 2 * sizeof(uint16_t)];
+		const void* buffer;
+	};
+
+	Header
+	header(const void* buffer, uint16_t length, uint16_t maximum)
+	{
+		Header res;
+		memset(&res, 0, sizeof(res));
+		res.length = length;
+		res.maximum = maximum;
+		res.buffer = buffer;
+		return res;
+	}
+
+	uint64_t
+	address(const void* p)
+	{
+		return reinterpret_cast<uintptr_t>(p);
+	}
+
+	std::string
+	format(const counted::Result& result)
+	{
+		std::ostringstream os;
+		counted::format(result, os);
+		return os.str();
+	}
+}
+
+/* the length is in bytes, and the text is each code unit or byte */
+void
+test_counted_decode()
+{
+	const char16_t wide[] = u"C:\\Windows\\ntdll.dll";
+	const char narrow[] = "kernel32";
+	auto unicode = header(wide, 20 * sizeof(char16_t), sizeof(wide));
+	auto ansi = header(narrow, 8, sizeof(narrow));
+	CHECK(counted::size(width) == sizeof(Header));
+
+	auto result = counted::decode(counted::unicode, address(&unicode), width, 0x1000, nullptr);
+	CHECK(result.status == counted::Result::ok);
+	CHECK(result.buffer == address(wide));
+	CHECK(result.text == std::u16string(wide));
+
+	result = counted::decode(counted::ansi, address(&ansi), width, 0x1000, nullptr);
+	CHECK(result.status == counted::Result::ok);
+	CHECK(result.text == u"kernel32");
+
+	// an empty string never touches its buffer
+	auto empty = header(nullptr, 0, 0);
+	result = counted::decode(counted::unicode, address(&empty), width, 0x1000, nullptr);
+	CHECK(result.status == counted::Result::ok && result.text.empty());
+}
+
+/* a unicode string that's cut off still ends on a whole code unit */
+void
+test_counted_truncated()
+{
+	const char16_t wide[] = u"abcdefgh";
+	auto unicode = header(wide, 16, 18);
+
+	auto result = counted::decode(counted::unicode, address(&unicode), width, 7, nullptr);
+	CHECK(result.status == counted::Result::truncated);
+	CHECK(result.text == u"abc");
+
+	result = counted::decode(counted::ansi, address(&unicode), width, 7, nullptr);
+	CHECK(result.status == counted::Result::truncated && result.text.size() == 7);
+
+	result = counted::decode(counted::unicode, address(&unicode), width, 16, nullptr);
+	CHECK(result.status == counted::Result::ok && result.text == u"abcdefgh");
+}
+
+/* headers that can't be right are rejected before their buffer is read */
+void
+test_counted_invalid()
+{
+	auto longer = header(reinterpret_cast<const void*>(0x10), 8, 4);
+	CHECK(counted::decode(counted::ansi, address(&longer), width, 0x1000, nullptr).status == counted::Result::invalid);
+
+	auto odd = header(reinterpret_cast<const void*>(0x10), 3, 4);
+	CHECK(counted::decode(counted::unicode, address(&odd), width, 0x1000, nullptr).status == counted::Result::invalid);
+}
+
+/* with a region map, a buffer has to be entirely readable according to it */
+void
+test_counted_unmapped()
+{
+	std::vector<char> memory(0x100, 'x');
+	auto ea = address(memory.data());
+	auto inside = header(memory.data(), 0x80, 0x80), across = header(memory.data() + 0xc0, 0x80, 0x80);
+
+	RegionMap map;
+	Region region = { ea, ea, memory.size(), memory::state_commit, memory::protect_readwrite, 0 };
+	map.assign(std::vector<Region>(1, region));
+
+	CHECK(counted::decode(counted::ansi, address(&inside), width, 0x1000, &map).status == counted::Result::ok);
+	auto result = counted::decode(counted::ansi, address(&across), width, 0x1000, &map);
+	CHECK(result.status == counted::Result::unmapped && result.text.empty());
+	CHECK(format(result).find(" unmapped\n") != std::string::npos);
+
+	// a buffer that lies about where it is
+	auto wild = header(reinterpret_cast<const void*>(0x10), 4, 4);
+	CHECK(counted::decode(counted::ansi, address(&wild), width, 0x1000, &map).status == counted::Result::unmapped);
+
+	// a batch decodes each address on its own
+	auto results = counted::decode(counted::ansi, std::vector<uint64_t>{ address(&inside), address(&across) }, width, 0x1000, &map);
+	CHECK(results.size() == 2 && results[0].status == counted::Result::ok && results[1].status == counted::Result::unmapped);
+}
+
+/* only printable ASCII is written as-is */
+void
+test_counted_format()
+{
+	counted::Result unicode = { counted::Result::ok, counted::unicode, 0x402000, 0, u"caf\u00e9\\\n" };
+	CHECK(format(unicode) == "0000000000402000 ok caf\\u00e9\\\\\\u000a\n");
+
+	counted::Result ansi = { counted::Result::truncated, counted::ansi, 0x402010, 0, std::u16string(1, char16_t(0xe9)) + u"!" };
+	CHECK(format(ansi) == "0000000000402010 truncated \\xe9!\n");
+
+	counted::Result fault = { counted::Result::fault, counted::ansi, 0x402020, 0, {} };
+	CHECK(format(fault) == "0000000000402020 fault\n");
+}
+
+void
+test_counted_utilities()
+{
+	CHECK(counted::parse("402000, 402010 ,402020\n7ff800000000") == (std::vector<uint64_t>{ 0x402000, 0x402010, 0x402020, 0x7ff800000000 }));
+	CHECK(counted::parse("  ").empty());
+	CHECK(counted::stride(0x1000, 3, 0x10) == (std::vector<uint64_t>{ 0x1000, 0x1010, 0x1020 }));
+
+	bool thrown = false;
+	try {
+		counted::parse("402000 40200g");
+	}
+	catch (const std::invalid_argument&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+
+	counted::kind_t kind;
+	CHECK(counted::kind("UNICODE_STRING", kind) && kind == counted::unicode);
+	CHECK(counted::kind("ansi", kind) && kind == counted::ansi);
+	CHECK(!counted::kind("utf8", kind));
+}
+
+int
+main()
+{
+	test_counted_decode();
+	test_counted_truncated();
+	test_counted_invalid();
+	test_counted_unmapped();
+	test_counted_format();
+	test_counted_utilities();
+	return check::result();
+}
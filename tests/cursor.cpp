@@ -0,0 +1,145 @@
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "cursor.h"
+
+namespace {
+	/* everything that's left in a cursor, taken `maximum` characters at a time */
+	std::string
+	drain(Cursor& cursor, size_t maximum, size_t* chunks = nullptr)
+	{
+		std::string res, chunk;
+		size_t count = 0;
+		while (cursor.next(maximum, chunk)) {
+			if (chunk.size() > maximum)
+				return std::string("oversized chunk");
+			res += chunk;
+			count++;
+		}
+		if (chunks)
+			*chunks = count;
+		return res;
+	}
+
+	/* pieces that are numbered so that it's obvious when one is dropped or repeated */
+	Cursor::producer
+	pieces(size_t count, size_t& produced, size_t failure = static_cast<size_t>(-1))
+	{
+		produced = 0;
+		return [count, &produced, failure](std::ostream& os) {
+			if (produced == failure)
+				throw std::runtime_error("piece");
+			os << "piece " << produced++ << "\n";
+			return produced < count;
+		};
+	}
+}
+
+/* chunks never exceed the maximum, and only as much is produced as is needed to fill them */
+void
+test_cursor_chunks()
+{
+	size_t produced;
+	std::string expected;
+	for (size_t i = 0; i < 10; i++)
+		expected += "piece " + std::to_string(i) + "\n";
+
+	Cursor cursor(pieces(10, produced));
+	std::string chunk;
+	CHECK(cursor.next(5, chunk) && chunk == "piece");
+	CHECK(produced == 1);
+	CHECK(cursor.next(3, chunk) && chunk == " 0\n");
+	CHECK(produced == 1);
+
+	size_t chunks;
+	CHECK("piece 0\n" + drain(cursor, 7, &chunks) == expected);
+	CHECK(chunks == (expected.size() - 8 + 6) / 7);
+	CHECK(produced == 10);
+	CHECK(!cursor.next(7, chunk) && chunk.empty());
+	CHECK(!cursor.failed());
+
+	for (size_t maximum : { 1, 13, 0x10000 }) {
+		Cursor again(pieces(10, produced));
+		CHECK(drain(again, maximum) == expected);
+	}
+}
+
+/* a piece that throws ends the stream after everything before it has been handed out */
+void
+test_cursor_failure()
+{
+	size_t produced;
+	Cursor cursor(pieces(10, produced, 3));
+	CHECK(drain(cursor, 4) == "piece 0\npiece 1\npiece 2\n");
+	CHECK(cursor.failed());
+
+	Cursor empty([](std::ostream&) { return false; });
+	std::string chunk;
+	CHECK(!empty.next(16, chunk) && chunk.empty());
+	CHECK(!empty.failed());
+}
+
+/* a dump cursor produces exactly what the dumper would have, whatever the chunk size */
+void
+test_cursor_dump()
+{
+	std::vector<uint8_t> buffer(0x1000);
+	for (size_t i = 0; i < buffer.size(); i++)
+		buffer[i] = static_cast<uint8_t>(i * 13);
+	auto ea = reinterpret_cast<intptr_t>(buffer.data());
+
+	Dumper dumper(64, 16);
+	for (size_t count : { 1, 15, 16, 17, 200 }) {
+		std::ostringstream bytes, dwords;
+		dumper.dump<uint8_t>(ea, count, bytes);
+		dumper.dump<uint32_t>(ea, count, dwords);
+
+		for (size_t maximum : { 1, 40, 0x10000 }) {
+			CHECK(drain(*Cursor::dump(dumper, &Dumper::dump<uint8_t>, sizeof(uint8_t), ea, count), maximum) == bytes.str());
+			CHECK(drain(*Cursor::dump(dumper, &Dumper::dump<uint32_t>, sizeof(uint32_t), ea, count), maximum) == dwords.str());
+		}
+	}
+
+	CHECK(drain(*Cursor::dump(dumper, &Dumper::dump<uint8_t>, sizeof(uint8_t), ea, 0), 16).empty());
+}
+
+/* a disassembly cursor joins its batches the same way that a single call does */
+void
+test_cursor_disasm()
+{
+	// "mov rax, rcx" and "nop" over and over, followed by enough room for the decoder to read ahead
+	std::vector<uint8_t> code;
+	for (size_t i = 0; i < 0x300; i++) {
+		code.insert(code.end(), { 0x48, 0x89, 0xc8 });
+		code.push_back(0x90);
+	}
+	code.resize(code.size() + 0x20, 0x90);
+	auto ea = reinterpret_cast<intptr_t>(code.data());
+
+	auto disassembler = std::make_shared<Disassembler>(CS_MODE_64);
+	for (size_t count : { 1, 0x100, 0x101, 0x555 }) {
+		std::ostringstream expected;
+		CHECK(disassembler->disasm(ea, count, expected) == count);
+
+		for (size_t maximum : { 7, 0x10000 }) {
+			auto cursor = Cursor::disasm(disassembler, ea, count);
+			CHECK(drain(*cursor, maximum) == expected.str());
+			CHECK(!cursor->failed());
+		}
+	}
+}
+
+int
+main()
+{
+	test_cursor_chunks();
+	test_cursor_failure();
+	test_cursor_dump();
+	test_cursor_disasm();
+	return check::result();
+}
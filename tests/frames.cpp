@@ -0,0 +1,141 @@
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "frames.h"
+
+namespace {
+	const uintptr_t module = 0x400000;
+
+	/* a verifier that knows which values follow a call, and counts how often it's asked */
+	frames::verifier
+	sites(const std::map<uint64_t, frames::Site>& known, size_t& asked)
+	{
+		asked = 0;
+		return [known, &asked](uint64_t value, frames::Site& result) {
+			asked++;
+			if (value == module + 0x1666)
+				throw std::runtime_error("fault");
+			auto it = known.find(value);
+			if (it == known.end())
+				return false;
+			result = it->second;
+			return true;
+		};
+	}
+
+	template<typename T> std::vector<Region>
+	stack(const std::vector<T>& values)
+	{
+		Region region = { reinterpret_cast<uintptr_t>(values.data()), reinterpret_cast<uintptr_t>(values.data()), values.size() * sizeof(T), memory::state_commit, memory::protect_readwrite, 0 };
+		return std::vector<Region>(1, region);
+	}
+}
+
+/* only values that follow a call are kept, each is only verified once, and they're ranked by their evidence */
+void
+test_frames_scan()
+{
+	const std::map<uint64_t, frames::Site> known = {
+		{ module + 0x1234, { frames::direct, module + 0x1100 } },
+		{ module + 0x1500, { frames::indirect, 0 } },
+		{ module + 0x1780, { frames::direct, module + 0x1790 } },
+	};
+	std::vector<uint64_t> values = { 0, module + 0x1500, module + 0x1234, 0x12345, module + 0x1800, module + 0x1666, module + 0x1234, module + 0x1780 };
+	pointers::Targets code({ { module + 0x1000, module + 0x2000 } });
+
+	FunctionTable functions;
+	FunctionTable::Image image = { module, 0x10000, { { 0x1100, 0x1300, 0x3000, 0x1100 }, { 0x1700, 0x1800, 0x3010, 0x1700 } } };
+	functions.assign(std::vector<FunctionTable::Image>(1, image));
+
+	size_t asked, verified;
+	auto found = frames::scan(stack(values), sizeof(uint64_t), code, sites(known, asked), &functions, 0, &verified);
+	CHECK(asked == 5 && verified == 5);
+	CHECK(found.size() == 4);
+	if (found.size() == 4) {
+		auto ea = reinterpret_cast<uintptr_t>(values.data());
+
+		// a direct call to the start of a function from inside of another one
+		CHECK(found[0].slot == ea + 2 * sizeof(uint64_t) && found[0].value == module + 0x1234 && found[0].score == 4);
+		CHECK(found[1].slot == ea + 6 * sizeof(uint64_t) && found[1].score == 4);
+		CHECK(found[0].site.kind == frames::direct && found[0].site.target == module + 0x1100);
+
+		// a direct call into the middle of a function
+		CHECK(found[2].value == module + 0x1780 && found[2].score == 3);
+
+		// an indirect call from outside of any function
+		CHECK(found[3].value == module + 0x1500 && found[3].score == 1 && found[3].site.kind == frames::indirect);
+	}
+
+	// without the exception directory only the kind of call counts
+	found = frames::scan(stack(values), sizeof(uint64_t), code, sites(known, asked), nullptr, 2, nullptr);
+	CHECK(found.size() == 2);
+	CHECK(found.size() == 2 && found[0].score == 2 && found[0].value == module + 0x1234 && found[1].value == module + 0x1234);
+}
+
+/* a 32-bit stack is read with the narrower kernel */
+void
+test_frames_narrow()
+{
+	const std::map<uint64_t, frames::Site> known = { { module + 0x1234, { frames::indirect, 0 } } };
+	std::vector<uint32_t> values = { 0, module + 0x1234, module + 0x1000, 0 };
+	pointers::Targets code({ { module + 0x1000, module + 0x2000 } });
+
+	size_t asked, verified;
+	auto found = frames::scan(stack(values), sizeof(uint32_t), code, sites(known, asked), nullptr, 0, &verified);
+	CHECK(verified == 2);
+	CHECK(found.size() == 1 && found[0].slot == reinterpret_cast<uintptr_t>(&values[1]) && found[0].score == 1);
+}
+
+/* the values are as wide as the stack, and the symbol is only written when there is one */
+void
+test_frames_format()
+{
+	frames::Candidate candidate = { 0x14f8a8, module + 0x1234, { frames::direct, module + 0x1100 }, 4 };
+	CHECK(frames::format(candidate, 8, nullptr) == "000000000014f8a8 0000000000401234 4 direct 0000000000401100");
+
+	SymbolTable symbols;
+	SymbolTable::Image image = { module, 0x10000, "sample", { { 0x1200, "Start" } } };
+	symbols.assign(std::vector<SymbolTable::Image>(1, image));
+	CHECK(frames::format(candidate, 8, &symbols) == "000000000014f8a8 0000000000401234 4 direct 0000000000401100 sample!Start+0x34");
+
+	candidate.value = 0x12345;
+	candidate.site.kind = frames::indirect;
+	candidate.site.target = 0;
+	CHECK(frames::format(candidate, 4, &symbols) == "000000000014f8a8 00012345 4 indirect 00000000");
+	CHECK(std::string(frames::name(frames::none)) == "none");
+}
+
+/* each form of a call is recognized by the instruction that ends at the return address */
+void
+test_frames_verify()
+{
+	const uint8_t code[] = {
+		0x90, 0x90, 0x90,
+		0xe8, 0x10, 0x00, 0x00, 0x00,		// call +0x10
+		0xff, 0xd0,							// call rax
+		0xff, 0x15, 0x00, 0x01, 0x00, 0x00,	// call [rip+0x100]
+		0x90, 0x90,
+	};
+	auto ea = reinterpret_cast<uint64_t>(code);
+
+	Disassembler disassembler(CS_MODE_64);
+	frames::Site site;
+	CHECK(frames::verify(disassembler, ea + 8, site) && site.kind == frames::direct && site.target == ea + 8 + 0x10);
+	CHECK(frames::verify(disassembler, ea + 10, site) && site.kind == frames::indirect && site.target == 0);
+	CHECK(frames::verify(disassembler, ea + 16, site) && site.kind == frames::indirect);
+	CHECK(!frames::verify(disassembler, ea + 3, site));
+	CHECK(!frames::verify(disassembler, ea + 18, site));
+}
+
+int
+main()
+{
+	test_frames_scan();
+	test_frames_narrow();
+	test_frames_format();
+	test_frames_verify();
+	return check::result();
+}
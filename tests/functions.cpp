@@ -0,0 +1,171 @@
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "functions.h"
+#include "image.h"
+#include "pe.h"
+
+namespace {
+	const uint32_t text = 0x1000, rdata = 0x2000, exception = 0x3000;
+	const uint64_t base = 0x140000000;
+
+	std::vector<uint8_t>
+	entry(uint32_t begin, uint32_t end, uint32_t unwind)
+	{
+		std::vector<uint8_t> res;
+		image::put<uint32_t>(res, 0, begin);
+		image::put<uint32_t>(res, 4, end);
+		image::put<uint32_t>(res, 8, unwind);
+		return res;
+	}
+
+	/*
+		Four functions, where the second is chained to the first through the
+		RUNTIME_FUNCTION that follows its unwind codes, and the third points
+		directly at the second's entry. The table is out of order, and also
+		has an empty entry and one whose unwind info is out of bounds.
+	*/
+	std::vector<uint8_t>
+	sample(bool wide)
+	{
+		std::vector<uint8_t> unwind;
+		image::put<uint8_t>(unwind, 0x00, 0x01);				// version 1 without any flags
+		image::put<uint8_t>(unwind, 0x10, 0x01 | (0x4 << 3));	// UNW_FLAG_CHAININFO
+		image::put<uint8_t>(unwind, 0x12, 1);					// a single code, which is padded to two
+		unwind.resize(0x18, 0);
+		auto chained = entry(text, text + 0x40, rdata);
+		unwind.insert(unwind.end(), chained.begin(), chained.end());
+
+		std::vector<std::vector<uint8_t>> entries = {
+			entry(text + 0xc0, text + 0x100, rdata),
+			entry(text + 0x40, text + 0x80, rdata + 0x10),
+			entry(text, text + 0x40, rdata),
+			entry(text + 0x80, text + 0xc0, (exception + 0x0c) | 1),
+			entry(text + 0x100, text + 0x100, rdata),
+			entry(text + 0x140, text + 0x180, 0x90000),
+		};
+		std::vector<uint8_t> table;
+		for (auto& item : entries)
+			table.insert(table.end(), item.begin(), item.end());
+
+		std::vector<image::Section> sections = {
+			{ ".text", text, pe::section_execute | pe::section_read, std::vector<uint8_t>(0x200, 0xcc) },
+			{ ".rdata", rdata, pe::section_read, unwind },
+			{ ".pdata", exception, pe::section_read, table },
+		};
+		image::Directories directories = { { pe::directory_exception, { exception, static_cast<uint32_t>(table.size()) } } };
+		return image::file(wide, base, sections, directories);
+	}
+}
+
+/* the table is sorted, and each entry knows which function it's a part of */
+void
+test_pdata_parse()
+{
+	auto file = sample(true);
+	auto mapped = pe::map(pe::View(file.data(), file.size(), false));
+
+	auto functions = pdata::parse(pe::View(mapped.data(), mapped.size(), true));
+	CHECK(functions.size() == 5);
+	CHECK(std::is_sorted(functions.begin(), functions.end()));
+	CHECK(functions[0].begin == text && functions[0].primary == text);
+	CHECK(functions[1].begin == text + 0x40 && functions[1].primary == text);
+	CHECK(functions[2].begin == text + 0x80 && functions[2].unwind == ((exception + 0x0c) | 1) && functions[2].primary == text);
+	CHECK(functions[3].begin == text + 0xc0 && functions[3].primary == text + 0xc0);
+
+	// unwind info that can't be read only loses the chain
+	CHECK(functions[4].begin == text + 0x140 && functions[4].primary == text + 0x140);
+
+	// the file reads the same as the mapped image
+	auto unmapped = pdata::parse(pe::View(file.data(), file.size(), false));
+	CHECK(unmapped.size() == functions.size());
+	for (size_t i = 0; i < unmapped.size() && i < functions.size(); i++)
+		CHECK(unmapped[i].begin == functions[i].begin && unmapped[i].end == functions[i].end && unmapped[i].primary == functions[i].primary);
+
+	// a PE32 image has no table, and a table that's cut off throws
+	auto narrow = sample(false);
+	CHECK(pdata::parse(pe::View(narrow.data(), narrow.size(), false)).empty());
+
+	bool thrown = false;
+	mapped.resize(exception + 0x10);
+	try {
+		pdata::parse(pe::View(mapped.data(), mapped.size(), true));
+	}
+	catch (const std::out_of_range&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+/* a lookup finds the entry that contains the address, and the function finds the entry it's chained to */
+void
+test_functiontable_find()
+{
+	auto file = sample(true);
+	auto mapped = pe::map(pe::View(file.data(), file.size(), false));
+	FunctionTable::Image image = { base, mapped.size(), pdata::parse(pe::View(mapped.data(), mapped.size(), true)) };
+
+	FunctionTable table;
+	CHECK(table.assign(std::vector<FunctionTable::Image>(1, image)) == 1);
+
+	FunctionTable::Range range;
+	CHECK(table.find(base + text + 0x90, range));
+	CHECK(range.begin == base + text + 0x80 && range.end == base + text + 0xc0);
+	CHECK(range.primary == base + text);
+	CHECK(table.function(base + text + 0x90, range));
+	CHECK(range.begin == base + text && range.end == base + text + 0x40 && range.unwind == base + rdata);
+
+	CHECK(table.function(base + text + 0xc0, range) && range.begin == base + text + 0xc0);
+	CHECK(FunctionTable::format(range) == "00000001400010c0 0000000140001100 0000000140002000 00000001400010c0");
+
+	// the gaps between functions and the addresses outside of any image aren't in one
+	CHECK(!table.find(base + text + 0x100, range));
+	CHECK(!table.find(base + text + 0x120, range));
+	CHECK(!table.find(base - 1, range));
+	CHECK(!table.find(base + mapped.size(), range));
+}
+
+/* the loaded modules are parsed where they are, and only once for as long as they stay put */
+void
+test_functiontable_refresh()
+{
+	auto file = sample(true);
+	auto mapped = pe::map(pe::View(file.data(), file.size(), false));
+	std::vector<uint8_t> garbage(0x1000, 0x90);
+
+	auto ea = reinterpret_cast<uintptr_t>(mapped.data());
+	std::vector<Module> modules = {
+		{ ea, mapped.size(), "/sample.dll" },
+		{ reinterpret_cast<uintptr_t>(garbage.data()), garbage.size(), "/garbage.dll" },
+	};
+
+	FunctionTable table;
+	CHECK(table.refresh(modules, 7) == 1);
+	CHECK(table.source() == 7);
+
+	FunctionTable::Range range;
+	CHECK(table.function(ea + text + 0x50, range) && range.begin == ea + text);
+
+	// the table isn't read again for a module that hasn't moved
+	image::put<uint32_t>(mapped, exception + 0x18, text + 0x20);
+	CHECK(table.refresh(modules, 8) == 1);
+	CHECK(table.find(ea + text + 0x10, range) && range.begin == ea + text);
+
+	modules.pop_back();
+	// but it is once its size has changed
+	modules.front().size--;
+	CHECK(table.refresh(modules, 9) == 1);
+	CHECK(!table.find(ea + text + 0x10, range));
+	CHECK(table.find(ea + text + 0x30, range) && range.begin == ea + text + 0x20);
+	CHECK(table.source() == 9);
+}
+
+int
+main()
+{
+	test_pdata_parse();
+	test_functiontable_find();
+	test_functiontable_refresh();
+	return check::result();
+}
@@ -0,0 +1,209 @@
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "check.h"
+#include "heaps.h"
+
+namespace {
+	const uint64_t peb = 0x10000000, heap = 0x20000000, second = 0x20100000, list = 0x10001000;
+	const uint32_t signature = 0xffeeffee;
+
+	// the key that a 64-bit heap encodes its headers with
+	const uint8_t key[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0x3c, 0xa5, 0x5a, 0x00, 0x77, 0x19, 0xe2, 0x81 };
+
+	template<typename T> void
+	put(trace::MemoryBackend& memory, uint64_t address, T value)
+	{
+		memory.assign(address, &value, sizeof(value));
+	}
+
+	/* a 64-bit _HEAP_ENTRY with its checksum, encoded with the key */
+	void
+	entry(trace::MemoryBackend& memory, uint64_t address, uint16_t granules, uint8_t flags, bool corrupt = false)
+	{
+		uint8_t header[16] = { 0 };
+		memcpy(header + 0x08, &granules, sizeof(granules));
+		header[0x0a] = flags;
+		header[0x0b] = static_cast<uint8_t>(header[0x08] ^ header[0x09] ^ header[0x0a] ^ (corrupt ? 1 : 0));
+		header[0x0f] = 0x08;
+		for (size_t i = 0; i < sizeof(header); i++)
+			header[i] ^= key[i];
+		memory.assign(address, header, sizeof(header));
+	}
+
+	/* the _HEAP_SEGMENT fields that the walk reads */
+	void
+	segment(trace::MemoryBackend& memory, uint64_t address, uint64_t first, uint64_t lastvalid)
+	{
+		put<uint32_t>(memory, address + 0x10, signature);
+		put<uint64_t>(memory, address + 0x40, first);
+		put<uint64_t>(memory, address + 0x48, lastvalid);
+
+		// an empty list of uncommitted ranges points back at itself
+		put<uint64_t>(memory, address + 0x60, address + 0x60);
+	}
+
+	/*
+		A 64-bit heap with two segments, where the heap's list of them is
+		linked into the same ring. The first segment has an uncommitted
+		range in the middle of it which isn't mapped.
+
+			heap+0x740 0x30 busy
+			heap+0x770 0x120 busy
+			heap+0x890 0x770 free
+			(uncommitted through heap+0x3000)
+			heap+0x3000 0x100 busy|last
+			second+0x80 0x40 busy
+			second+0xc0 0x40 busy|last
+	*/
+	void
+	sample(trace::MemoryBackend& memory)
+	{
+		memory.map(heap, 0x1000);
+		memory.map(heap + 0x3000, 0x1000);
+		memory.map(second, 0x1000);
+
+		segment(memory, heap, heap + 0x740, heap + 0x3100);
+		segment(memory, second, second + 0x80, second + 0x100);
+		put<uint32_t>(memory, heap + 0x7c, 0x100000);
+		memory.assign(heap + 0x80, key, sizeof(key));
+
+		// heap+0x18 -> second+0x18 -> the list head at heap+0x120 -> heap+0x18
+		put<uint64_t>(memory, heap + 0x18, second + 0x18);
+		put<uint64_t>(memory, second + 0x18, heap + 0x120);
+		put<uint64_t>(memory, heap + 0x120, heap + 0x18);
+
+		// the uncommitted range of the first segment
+		put<uint64_t>(memory, heap + 0x60, heap + 0x600);
+		put<uint64_t>(memory, heap + 0x600, heap + 0x60);
+		put<uint64_t>(memory, heap + 0x610, heap + 0x1000);
+		put<uint64_t>(memory, heap + 0x618, 0x2000);
+
+		entry(memory, heap + 0x740, 0x03, heaps::busy);
+		entry(memory, heap + 0x770, 0x12, heaps::busy);
+		entry(memory, heap + 0x890, 0x77, 0);
+		entry(memory, heap + 0x3000, 0x10, heaps::busy | heaps::last);
+		entry(memory, second + 0x80, 0x04, heaps::busy);
+		entry(memory, second + 0xc0, 0x04, heaps::busy | heaps::last);
+	}
+}
+
+/* every segment is walked, each header is decoded, and the uncommitted range is skipped */
+void
+test_heaps_walk()
+{
+	trace::MemoryBackend memory;
+	sample(memory);
+
+	auto result = heaps::walk(memory, heap, 8, 0);
+	CHECK(result.kind == heaps::nt);
+	CHECK(result.segments == 2);
+	CHECK(!result.corrupt);
+	CHECK(result.entries.size() == 6);
+	if (result.entries.size() == 6) {
+		CHECK(result.entries[0].address == heap + 0x740 && result.entries[0].size == 0x30 && result.entries[0].flags == heaps::busy);
+		CHECK(result.entries[0].unused == 0x08);
+		CHECK(result.entries[2].address == heap + 0x890 && result.entries[2].size == 0x770 && result.entries[2].flags == 0);
+		CHECK(result.entries[3].address == heap + 0x3000 && result.entries[3].flags == (heaps::busy | heaps::last));
+		CHECK(result.entries[4].address == second + 0x80 && result.entries[4].size == 0x40);
+	}
+
+	CHECK(heaps::format(result).find("heap 0000000020000000 nt 2 6\n0000000020000740 30 01\n0000000020000770 120 01\n") == 0);
+
+	// the limit stops the walk partway through the first segment
+	result = heaps::walk(memory, heap, 8, 2);
+	CHECK(result.entries.size() == 2 && result.segments == 1 && !result.corrupt);
+}
+
+/* a header whose checksum doesn't match ends its segment's walk, but not the others */
+void
+test_heaps_corrupt()
+{
+	trace::MemoryBackend memory;
+	sample(memory);
+	entry(memory, heap + 0x770, 0x12, heaps::busy, true);
+
+	auto result = heaps::walk(memory, heap, 8, 0);
+	CHECK(result.corrupt);
+	CHECK(result.segments == 2);
+	CHECK(result.entries.size() == 3);
+	CHECK(result.entries.size() == 3 && result.entries[0].address == heap + 0x740 && result.entries[1].address == second + 0x80);
+	CHECK(heaps::format(result).find("heap 0000000020000000 nt 2 3 corrupt\n") == 0);
+
+	// so does a header in memory that isn't mapped
+	trace::MemoryBackend missing;
+	sample(missing);
+	put<uint64_t>(missing, heap + 0x618, 0x1000);
+	result = heaps::walk(missing, heap, 8, 0);
+	CHECK(result.corrupt && result.entries.size() == 5);
+
+	// and one that was decoded with the wrong key has a checksum that doesn't match either
+	trace::MemoryBackend rekeyed;
+	sample(rekeyed);
+	put<uint8_t>(rekeyed, heap + 0x88, 0x3d);
+	result = heaps::walk(rekeyed, heap, 8, 0);
+	CHECK(result.corrupt && result.entries.empty());
+}
+
+/* a heap without a mask isn't encoded, which is also how the 32-bit layout is tested */
+void
+test_heaps_narrow()
+{
+	const uint64_t base = 0x00400000;
+	trace::MemoryBackend memory;
+	memory.map(base, 0x1000);
+	put<uint32_t>(memory, base + 0x08, signature);
+	put<uint32_t>(memory, base + 0x10, base + 0x10);
+	put<uint32_t>(memory, base + 0x24, base + 0x580);
+	put<uint32_t>(memory, base + 0x28, base + 0x600);
+	put<uint32_t>(memory, base + 0x38, base + 0x38);
+
+	for (auto& item : { std::make_pair(0x580u, uint16_t(0x08)), std::make_pair(0x5c0u, uint16_t(0x08)) }) {
+		uint8_t header[8] = { 0 };
+		memcpy(header, &item.second, sizeof(item.second));
+		header[2] = heaps::busy;
+		header[3] = static_cast<uint8_t>(header[0] ^ header[1] ^ header[2]);
+		memory.assign(base + item.first, header, sizeof(header));
+	}
+
+	auto result = heaps::walk(memory, base, 4, 0);
+	CHECK(result.kind == heaps::nt && result.segments == 1 && !result.corrupt);
+	CHECK(result.entries.size() == 2 && result.entries[1].address == base + 0x5c0 && result.entries[1].size == 0x40);
+}
+
+/* the heaps of a process come from its environment block, and anything else is recognized by its signature */
+void
+test_heaps_process()
+{
+	trace::MemoryBackend memory;
+	sample(memory);
+	memory.map(peb, 0x2000);
+	put<uint32_t>(memory, peb + 0xe8, 3);
+	put<uint64_t>(memory, peb + 0xf0, list);
+	put<uint64_t>(memory, list, heap);
+	put<uint64_t>(memory, list + 8, second);
+	put<uint64_t>(memory, list + 16, 0x30000000);
+
+	auto found = heaps::process(memory, peb, 8);
+	CHECK(found == (std::vector<uint64_t>{ heap, second, 0x30000000 }));
+
+	memory.map(0x30000000, 0x1000);
+	put<uint32_t>(memory, 0x30000010, 0xddeeddee);
+	auto result = heaps::walk(memory, 0x30000000, 8, 0);
+	CHECK(result.kind == heaps::segment && result.entries.empty() && !result.corrupt);
+	CHECK(heaps::format(result) == "heap 0000000030000000 segment 0 0\n");
+
+	CHECK(heaps::walk(memory, 0x40000000, 8, 0).kind == heaps::invalid);
+	CHECK(heaps::process(memory, 0x40000000, 8).empty());
+}
+
+int
+main()
+{
+	test_heaps_walk();
+	test_heaps_corrupt();
+	test_heaps_narrow();
+	test_heaps_process();
+	return check::result();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** building small PE files for the tests of the engines that read them */
+namespace image {
+	const uint32_t alignment = 0x1000, filealignment = 0x200, headers = 0x400;
+
+	struct Section {
+		std::string name;
+		uint32_t address;			// rva, which has to be aligned and ascending
+		uint32_t characteristics;
+		std::vector<uint8_t> data;
+	};
+
+	typedef std::map<uint32_t, std::pair<uint32_t, uint32_t>> Directories;	// index to rva and size
+
+	template<typename T> inline void
+	put(std::vector<uint8_t>& data, size_t offset, T value)
+	{
+		if (data.size() < offset + sizeof(T))
+			data.resize(offset + sizeof(T), 0);
+		memcpy(&data[offset], &value, sizeof(T));
+	}
+
+	template<typename T> inline T
+	get(const std::vector<uint8_t>& data, size_t offset)
+	{
+		T res;
+		memcpy(&res, &data[offset], sizeof(T));
+		return res;
+	}
+
+	/* a PE32+ (or a PE32) file with its sections laid out one after another */
+	inline std::vector<uint8_t>
+	file(bool wide, uint64_t base, const std::vector<Section>& sections, const Directories& directories)
+	{
+		const size_t nt = 0x40, optional = nt + 0x18, count = 16;
+		const size_t size = wide ? 0x70 + 8 * count : 0x60 + 8 * count;
+		const size_t table = optional + size;
+
+		std::vector<uint8_t> res(headers, 0);
+		put<uint16_t>(res, 0, 0x5a4d);
+		put<uint32_t>(res, 0x3c, nt);
+		put<uint32_t>(res, nt, 0x4550);
+		put<uint16_t>(res, nt + 0x04, wide ? 0x8664 : 0x14c);
+		put<uint16_t>(res, nt + 0x06, static_cast<uint16_t>(sections.size()));
+		put<uint16_t>(res, nt + 0x14, static_cast<uint16_t>(size));
+
+		put<uint16_t>(res, optional, wide ? 0x20b : 0x10b);
+		if (wide)
+			put<uint64_t>(res, optional + 0x18, base);
+		else
+			put<uint32_t>(res, optional + 0x1c, static_cast<uint32_t>(base));
+		put<uint32_t>(res, optional + 0x20, alignment);
+		put<uint32_t>(res, optional + 0x24, filealignment);
+		put<uint32_t>(res, optional + 0x3c, headers);
+		put<uint32_t>(res, optional + (wide ? 0x6c : 0x5c), count);
+		for (auto& item : directories) {
+			put<uint32_t>(res, optional + (wide ? 0x70 : 0x60) + 8 * item.first, item.second.first);
+			put<uint32_t>(res, optional + (wide ? 0x74 : 0x64) + 8 * item.first, item.second.second);
+		}
+
+		uint32_t image = alignment;
+		for (size_t i = 0; i < sections.size(); i++) {
+			auto& section = sections[i];
+			auto header = table + i * 0x28;
+			auto raw = static_cast<uint32_t>((section.data.size() + filealignment - 1) & ~size_t(filealignment - 1));
+			auto offset = static_cast<uint32_t>(res.size());
+
+			memcpy(&res[header], section.name.c_str(), (std::min)(section.name.size(), size_t(8)));
+			put<uint32_t>(res, header + 0x08, static_cast<uint32_t>(section.data.size()));
+			put<uint32_t>(res, header + 0x0c, section.address);
+			put<uint32_t>(res, header + 0x10, raw);
+			put<uint32_t>(res, header + 0x14, offset);
+			put<uint32_t>(res, header + 0x24, section.characteristics);
+
+			res.resize(offset + raw, 0);
+			std::copy(section.data.begin(), section.data.end(), res.begin() + offset);
+			image = (std::max)(image, static_cast<uint32_t>((section.address + section.data.size() + alignment - 1) & ~size_t(alignment - 1)));
+		}
+		put<uint32_t>(res, optional + 0x38, image);
+		return res;
+	}
+}
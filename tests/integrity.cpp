@@ -0,0 +1,177 @@
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "image.h"
+#include "integrity.h"
+#include "pe.h"
+#include "scanner.h"
+
+namespace {
+	const uint64_t linked = 0x140000000;
+	const uint32_t text = 0x1000, rdata = 0x3000, data = 0x4000, reloc = 0x5000;
+	const uint32_t iat = rdata + 0x100;
+
+	/* a relocation block for `page` with each of `offsets` as a DIR64 */
+	void
+	block(std::vector<uint8_t>& relocations, uint32_t page, const std::vector<uint16_t>& offsets)
+	{
+		auto start = relocations.size();
+		image::put<uint32_t>(relocations, start, page);
+		image::put<uint32_t>(relocations, start + 4, static_cast<uint32_t>(8 + 2 * offsets.size()));
+		for (size_t i = 0; i < offsets.size(); i++)
+			image::put<uint16_t>(relocations, start + 8 + 2 * i, static_cast<uint16_t>((10 << 12) | offsets[i]));
+	}
+
+	/*
+		Code that spans two pages with a pointer in it, read-only data with
+		pointers and an import address table, writable data, and the
+		relocations for each of the pointers.
+	*/
+	std::vector<uint8_t>
+	sample()
+	{
+		std::vector<uint8_t> code(0x1800, 0x90), constants(0x200, 0x11), variables(0x100, 0x22), relocations;
+		image::put<uint64_t>(code, 0x10, linked + text + 0x400);
+		image::put<uint64_t>(constants, 0x00, linked + rdata + 0x80);
+		image::put<uint64_t>(constants, 0x08, linked + text);
+		block(relocations, text, { 0x10 });
+		block(relocations, rdata, { 0x00, 0x08 });
+
+		std::vector<image::Section> sections = {
+			{ ".text", text, pe::section_execute | pe::section_read, code },
+			{ ".rdata", rdata, pe::section_read, constants },
+			{ ".data", data, pe::section_read | pe::section_write, variables },
+			{ ".reloc", reloc, pe::section_read | pe::section_discardable, relocations },
+		};
+		image::Directories directories = {
+			{ pe::directory_basereloc, { reloc, static_cast<uint32_t>(relocations.size()) } },
+			{ pe::directory_iat, { iat, 0x10 } },
+		};
+		return image::file(true, linked, sections, directories);
+	}
+
+	/* the sample laid out and relocated for where its buffer happens to be, the way the loader would have */
+	std::vector<uint8_t>
+	load(const std::vector<uint8_t>& file)
+	{
+		auto res = pe::map(pe::View(file.data(), file.size(), false));
+		pe::relocate(res, reinterpret_cast<uintptr_t>(res.data()));
+		return res;
+	}
+}
+
+/* the expected image is relocated for its base and only covers the sections in its scope */
+void
+test_integrity_expected()
+{
+	auto file = sample();
+	auto loaded = load(file);
+	auto base = reinterpret_cast<uintptr_t>(loaded.data());
+
+	auto code = integrity::expected(file, base, integrity::code);
+	CHECK(code.base == base);
+	CHECK(code.spans.size() == 1 && code.spans[0].rva == text && code.spans[0].size == 0x1800);
+	CHECK(code.hashes.size() == 2);
+	CHECK(image::get<uint64_t>(code.contents, 0x10) == base + text + 0x400);
+
+	// the import address table is cut out of the read-only data, and the writable and discardable sections are left out
+	auto readonly = integrity::expected(file, base, integrity::readonly);
+	CHECK(readonly.spans.size() == 3);
+	if (readonly.spans.size() == 3) {
+		CHECK(readonly.spans[1].rva == rdata && readonly.spans[1].size == 0x100);
+		CHECK(readonly.spans[2].rva == iat + 0x10 && readonly.spans[2].size == 0xf0);
+		CHECK(image::get<uint64_t>(readonly.contents, readonly.spans[1].offset + 8) == base + text);
+	}
+
+	// an image that isn't a PE throws
+	bool thrown = false;
+	try {
+		integrity::expected(std::vector<uint8_t>(0x1000, 0), base, integrity::code);
+	}
+	catch (const std::invalid_argument&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+/* a module that was relocated somewhere other than where it was linked only differs where it's been patched */
+void
+test_integrity_compare()
+{
+	auto file = sample();
+	auto loaded = load(file);
+	auto base = reinterpret_cast<uintptr_t>(loaded.data());
+	CHECK(base != linked);
+
+	auto code = integrity::expected(file, base, integrity::code);
+	auto readonly = integrity::expected(file, base, integrity::readonly);
+	size_t unreadable = 1;
+	CHECK(integrity::compare(code, 0, &unreadable).empty());
+	CHECK(unreadable == 0);
+	CHECK(integrity::compare(readonly, 0, nullptr).empty());
+
+	// a hook, a second run that's close enough to be joined with it, a patch across a page, and one in each kind of data
+	loaded[text + 0x20] = 0xe9;
+	loaded[text + 0x21] = 0xcc;
+	loaded[text + 0x24] = 0xc3;
+	memset(&loaded[text + 0xffe], 0xcc, 4);
+	loaded[rdata + 0x40] = 0x33;
+	loaded[iat] = 0x44;
+	loaded[data] = 0x55;
+
+	auto patches = integrity::compare(code, 4, nullptr);
+	CHECK(patches.size() == 2);
+	if (patches.size() == 2) {
+		CHECK(patches[0].address == base + text + 0x20 && patches[0].size == 5);
+		CHECK(patches[0].expected == std::vector<uint8_t>({ 0x90, 0x90, 0x90, 0x90, 0x90 }));
+		CHECK(patches[0].actual == std::vector<uint8_t>({ 0xe9, 0xcc, 0x90, 0x90, 0xc3 }));
+		CHECK(patches[1].address == base + text + 0xffe && patches[1].size == 4);
+		CHECK(integrity::format(patches[0], "sample") == scan::format(base + text + 0x20) + " 5 sample 9090909090 e9cc9090c3");
+	}
+
+	// without a gap the runs are kept apart
+	patches = integrity::compare(code, 0, nullptr);
+	CHECK(patches.size() == 3);
+
+	patches = integrity::compare(readonly, 4, nullptr);
+	CHECK(patches.size() == 3);
+	CHECK(patches.size() == 3 && patches[2].address == base + rdata + 0x40 && patches[2].size == 1);
+
+	// a long patch only keeps the first of its bytes
+	memset(&loaded[text + 0x100], 0xcc, 0x100);
+	patches = integrity::compare(code, 0, nullptr);
+	CHECK(patches.size() == 4);
+	CHECK(patches.size() == 4 && patches[2].size == 0x100 && patches[2].expected.size() == integrity::captured && patches[2].actual.size() == integrity::captured);
+}
+
+/* the images are kept for as long as their module is loaded */
+void
+test_integrity_cache()
+{
+	Module module = { 0x10000, 0x8000, "/sample.dll" }, replaced = { 0x10000, 0x8000, "/replaced.dll" };
+	auto image = std::make_shared<const integrity::Image>();
+
+	integrity::Cache cache;
+	std::shared_ptr<const integrity::Image> result;
+	CHECK(!cache.find(module, integrity::code, result));
+	cache.assign(module, integrity::code, image);
+	CHECK(cache.find(module, integrity::code, result) && result == image);
+	CHECK(!cache.find(module, integrity::readonly, result));
+	CHECK(!cache.find(replaced, integrity::code, result));
+
+	CHECK(cache.retain({ module }) == 1);
+	CHECK(cache.retain({ replaced }) == 0);
+	CHECK(cache.size() == 0);
+}
+
+int
+main()
+{
+	test_integrity_expected();
+	test_integrity_compare();
+	test_integrity_cache();
+	return check::result();
+}
@@ -0,0 +1,200 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "extractor.h"
+#include "jobs.h"
+
+namespace {
+	const size_t shard = 0x100000;
+
+	/* a shard's worth of memory that's full of short strings */
+	std::vector<char>
+	corpus()
+	{
+		std::vector<char> res(shard, 0);
+		for (size_t offset = 0; offset + 64 <= res.size(); offset += 64)
+			memcpy(&res[offset], "the quick brown fox", 19);
+		return res;
+	}
+
+	/* the same memory listed as many separate regions, so that a scan of it takes a while */
+	std::vector<Region>
+	repeated(const std::vector<char>& buffer, size_t count)
+	{
+		Region region = { reinterpret_cast<uintptr_t>(buffer.data()), reinterpret_cast<uintptr_t>(buffer.data()), buffer.size(), memory::state_commit, memory::protect_readwrite, 0 };
+		return std::vector<Region>(count, region);
+	}
+
+	size_t
+	lines(const std::string& chunk)
+	{
+		size_t res = 0;
+		for (auto ch : chunk)
+			res += (ch == '\n') ? 1 : 0;
+		return res;
+	}
+}
+
+/* records are grouped into chunks, and the stream only ends once the job has */
+void
+test_job_chunks()
+{
+	Job job(16);
+	std::string chunk;
+	CHECK(job.next(chunk) && chunk.empty());
+
+	job.run([](Job& job) {
+		job.progress(0, 4);
+		for (int i = 0; i < 4; i++) {
+			job.emit("record " + std::to_string(i));
+			job.advance(1);
+		}
+	});
+	CHECK(job.state() == Job::finished);
+	CHECK(job.wait(0) == Job::finished);
+	CHECK(job.fraction() == 1.0);
+
+	size_t count = 0;
+	while (job.next(chunk))
+		count += lines(chunk);
+	CHECK(count == 4);
+	CHECK(!job.next(chunk) && chunk.empty());
+}
+
+/* an exception fails the job with its message, and a job that's cancelled before it starts never runs */
+void
+test_job_failures()
+{
+	Job failed(16);
+	failed.run([](Job& job) { job.emit("partial"); throw std::runtime_error("broken"); });
+	CHECK(failed.state() == Job::failed);
+	CHECK(failed.error() == "broken");
+
+	std::string chunk;
+	CHECK(failed.next(chunk) && chunk == "partial\n");
+
+	Job cancelled(16);
+	bool ran = false;
+	cancelled.cancel();
+	cancelled.run([&ran](Job&) { ran = true; });
+	CHECK(!ran);
+	CHECK(cancelled.state() == Job::cancelled);
+}
+
+/* nothing is started until there's something to run */
+void
+test_scheduler_lazy()
+{
+	{
+		Scheduler scheduler(2);
+		CHECK(scheduler.workers() == 0);
+		CHECK(!scheduler.find(1));
+		CHECK(!scheduler.close(1));
+	}
+
+	Scheduler scheduler(2);
+	auto first = scheduler.submit([](Job& job) { job.emit("first"); });
+	auto second = scheduler.submit([](Job& job) { job.emit("second"); });
+	CHECK(scheduler.workers() == 2);
+	CHECK(first != second);
+
+	auto job = scheduler.find(first);
+	CHECK(job && job->wait(static_cast<unsigned long>(-1)) == Job::finished);
+	std::string chunk;
+	CHECK(job->next(chunk) && chunk == "first\n");
+
+	CHECK(scheduler.find(second)->wait(static_cast<unsigned long>(-1)) == Job::finished);
+	CHECK(scheduler.close(second));
+	CHECK(!scheduler.find(second));
+	CHECK(scheduler.workers() == 2);
+}
+
+/* a scheduler that's destroyed with jobs still running asks them to stop and waits for them */
+void
+test_scheduler_teardown()
+{
+	std::shared_ptr<Job> job;
+	{
+		Scheduler scheduler(1);
+		auto handle = scheduler.submit([](Job& job) {
+			while (!job.interrupted())
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		});
+		job = scheduler.find(handle);
+		while (job->state() == Job::pending)
+			std::this_thread::yield();
+	}
+	CHECK(job->state() == Job::cancelled);
+}
+
+/* the strings job streams its results a shard at a time and finds the same ones as the synchronous scan */
+void
+test_strings_stream()
+{
+	auto buffer = corpus();
+	auto regions = repeated(buffer, 4);
+	auto expected = strings::extract(regions, 4, static_cast<size_t>(-1), 2);
+	CHECK(expected.size() == 4 * shard / 64);
+
+	Job job(0x1000);
+	job.run([&regions](Job& job) { strings::extract(job, regions, 4, 2); });
+	CHECK(job.state() == Job::finished);
+
+	std::string chunk, received, wanted;
+	while (job.next(chunk))
+		received += chunk;
+	for (auto& found : expected)
+		wanted += strings::format(found) + "\n";
+	CHECK(received == wanted);
+}
+
+/* results show up while the job is still running, and cancelling it stops the scan partway */
+void
+test_strings_cancel()
+{
+	const size_t count = 512;
+	auto buffer = corpus();
+	auto regions = repeated(buffer, count);
+
+	Scheduler scheduler(1);
+	auto job = scheduler.find(scheduler.submit([&regions](Job& job) { strings::extract(job, regions, 4, 2); }));
+
+	// wait for the first results, which have to arrive long before the scan is done
+	std::string chunk;
+	size_t received = 0;
+	bool streamed = false;
+	while (!received && job->next(chunk)) {
+		received += lines(chunk);
+		streamed = job->state() == Job::running;
+		if (!received)
+			std::this_thread::yield();
+	}
+	CHECK(received > 0);
+	CHECK(streamed);
+
+	job->cancel();
+	CHECK(job->wait(static_cast<unsigned long>(-1)) == Job::cancelled);
+	CHECK(job->fraction() < 1.0);
+
+	while (job->next(chunk))
+		received += lines(chunk);
+	CHECK(received < count * shard / 64);
+}
+
+int
+main()
+{
+	test_job_chunks();
+	test_job_failures();
+	test_scheduler_lazy();
+	test_scheduler_teardown();
+	test_strings_stream();
+	test_strings_cancel();
+	return check::result();
+}
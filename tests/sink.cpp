@@ -0,0 +1,120 @@
+#include <string>
+
+#include "check.h"
+#include "sink.h"
+
+namespace {
+	const size_t narrow = 0x400;
+
+	/* what the stream holds, narrowed back into a string */
+	std::string
+	contents(WideStream& os)
+	{
+		os.flush();
+		auto& buffer = os.buffer();
+		auto p = buffer.data();
+		std::string res;
+		for (size_t i = 0; i < buffer.size(); i++)
+			res.push_back(static_cast<char>(p[i]));
+		return res;
+	}
+
+	/* a string of `count` characters that doesn't repeat within the narrow area */
+	std::string
+	pattern(size_t count, size_t seed)
+	{
+		std::string res;
+		for (size_t i = 0; i < count; i++)
+			res.push_back(static_cast<char>('!' + (i * 7 + seed) % 90));
+		return res;
+	}
+}
+
+/* writes that fill the narrow area exactly, end one short of it, or run across it all keep their order */
+void
+test_sink_boundary()
+{
+	for (size_t before : { narrow - 1, narrow, narrow + 1 }) {
+		for (size_t after : { static_cast<size_t>(1), static_cast<size_t>(16), narrow, 3 * narrow }) {
+			WideStream os;
+			auto head = pattern(before, 1), tail = pattern(after, 2);
+			os << head << tail;
+			CHECK(os.buffer().size() == before + after);
+			CHECK(contents(os) == head + tail);
+		}
+	}
+
+	// single characters go through overflow when the narrow area is full
+	WideStream os;
+	std::string expected;
+	for (size_t i = 0; i < 3 * narrow + 5; i++) {
+		auto ch = static_cast<char>('a' + i % 26);
+		os.put(ch);
+		expected.push_back(ch);
+	}
+	CHECK(contents(os) == expected);
+
+	// appending directly lands after anything that's still narrow
+	os.reset();
+	os << "narrow ";
+	os.buffer().append("wide", 4);
+	CHECK(contents(os) == "narrow wide");
+}
+
+/* bytes above 0x7f are widened as unsigned, not sign-extended */
+void
+test_sink_nonascii()
+{
+	WideStream os;
+	os << "\xe9t\xe9 \xff" << '\x80';
+	os.buffer().append("\xa0\x7f", 2);
+
+	auto& buffer = os.buffer();
+	const char16_t expected[] = { 0xe9, 't', 0xe9, ' ', 0xff, 0x80, 0xa0, 0x7f };
+	CHECK(buffer.size() == sizeof(expected) / sizeof(*expected));
+	for (size_t i = 0; i < buffer.size() && i < sizeof(expected) / sizeof(*expected); i++)
+		CHECK(buffer.data()[i] == expected[i]);
+
+	// including the ones that go straight to the wide buffer
+	auto large = std::string(2 * narrow, '\xc3');
+	os.reset();
+	os << large;
+	CHECK(os.buffer().size() == large.size());
+	CHECK(os.buffer().data()[0] == 0xc3 && os.buffer().data()[large.size() - 1] == 0xc3);
+}
+
+/* a reset keeps the storage that was grown, but none of what was written into it */
+void
+test_sink_reset()
+{
+	WideStream os;
+	os << pattern(4 * narrow, 3);
+	auto storage = os.buffer().data();
+	CHECK(os.buffer().size() == 4 * narrow);
+
+	os.reset();
+	CHECK(os.buffer().size() == 0);
+	CHECK(contents(os).empty());
+
+	// something smaller than before is written into the same storage
+	os << "second" << 2;
+	CHECK(contents(os) == "second2");
+	CHECK(os.buffer().data() == storage);
+
+	// and the stream is usable again even after it failed
+	os.setstate(std::ios::failbit);
+	os.reset();
+	CHECK(os.good());
+	os << "third";
+	CHECK(contents(os) == "third");
+	CHECK(os.buffer().data() == storage);
+}
+
+int
+main()
+{
+	test_sink_boundary();
+	test_sink_nonascii();
+	test_sink_reset();
+	return check::result();
+}
@@ -0,0 +1,101 @@
+#include <cstring>
+#include <vector>
+
+#include "check.h"
+#include "snapshot.h"
+
+namespace {
+	const size_t pagesize = Snapshot::pagesize, count = 8;
+
+	/* page-aligned memory to take a snapshot of */
+	class Pages {
+	private:
+		std::vector<uint8_t> m_buffer;
+		uint8_t* m_base;
+
+	public:
+		Pages(size_t count) : m_buffer((count + 1) * pagesize, 0) {
+			auto ea = reinterpret_cast<uintptr_t>(m_buffer.data());
+			m_base = m_buffer.data() + (pagesize - ea % pagesize) % pagesize;
+			for (size_t i = 0; i < count * pagesize; i++)
+				m_base[i] = static_cast<uint8_t>(i * 7);
+		}
+
+		uint8_t* page(size_t index) { return m_base + index * pagesize; }
+		uintptr_t address(size_t index) { return reinterpret_cast<uintptr_t>(page(index)); }
+
+		std::vector<Region> regions(size_t first, size_t count) {
+			Region region = { address(first), address(first), count * pagesize, memory::state_commit, memory::protect_readwrite, 0 };
+			return std::vector<Region>(1, region);
+		}
+	};
+}
+
+/* only the bytes that changed are reported, until the snapshot is updated with them */
+void
+test_snapshot_modified()
+{
+	Pages memory(count);
+	auto regions = memory.regions(0, count);
+	Snapshot snapshot(regions, 2);
+	CHECK(snapshot.pages() == count);
+	CHECK(snapshot.diff(regions, 2, false).empty());
+
+	memset(memory.page(1) + 0x10, 0xee, 8);
+	memory.page(5)[0xff0] ^= 0xff;
+	memory.page(5)[0xff3] ^= 0xff;
+
+	for (int pass = 0; pass < 2; pass++) {
+		auto changes = snapshot.diff(regions, 2, pass > 0);
+		CHECK(changes.size() == 2);
+		if (changes.size() != 2)
+			continue;
+
+		CHECK(changes[0].kind == Snapshot::Change::modified && changes[0].page == memory.address(1));
+		CHECK(changes[0].ranges.size() == 1 && changes[0].ranges[0].offset == 0x10 && changes[0].ranges[0].size == 8);
+		CHECK(Snapshot::format(changes[0]).find(" modified 10:8") != std::string::npos);
+
+		CHECK(changes[1].page == memory.address(5));
+		CHECK(changes[1].ranges.size() == 2 && changes[1].ranges[0].offset == 0xff0 && changes[1].ranges[1].offset == 0xff3);
+	}
+
+	// the update took on the new contents
+	CHECK(snapshot.diff(regions, 2, false).empty());
+	uint8_t buffer[16];
+	CHECK(snapshot.read(memory.address(1) + 0x10, buffer, sizeof(buffer)) == sizeof(buffer));
+	CHECK(memcmp(buffer, memory.page(1) + 0x10, sizeof(buffer)) == 0);
+}
+
+/* pages that aren't readable anymore are missing, and are only reported once if the snapshot is updated */
+void
+test_snapshot_missing()
+{
+	Pages memory(count);
+	Snapshot snapshot(memory.regions(0, count), 1);
+
+	auto current = memory.regions(0, count - 2);
+	auto changes = snapshot.diff(current, 1, false);
+	CHECK(changes.size() == 2);
+	for (auto& change : changes)
+		CHECK(change.kind == Snapshot::Change::missing && change.ranges.empty());
+	CHECK(snapshot.pages() == count);
+
+	memory.page(0)[0] ^= 1;
+	changes = snapshot.diff(current, 1, true);
+	CHECK(changes.size() == 3);
+	CHECK(!changes.empty() && changes[0].kind == Snapshot::Change::modified);
+	CHECK(snapshot.pages() == count - 2);
+	CHECK(snapshot.diff(current, 1, true).empty());
+
+	// reading stops at the first page that isn't in the snapshot anymore
+	std::vector<uint8_t> buffer(3 * pagesize);
+	CHECK(snapshot.read(memory.address(count - 3), buffer.data(), buffer.size()) == pagesize);
+}
+
+int
+main()
+{
+	test_snapshot_modified();
+	test_snapshot_missing();
+	return check::result();
+}
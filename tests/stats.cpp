@@ -0,0 +1,204 @@
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "stats.h"
+
+namespace {
+	const size_t threads = 4, samples = 20000;
+
+	void
+	pause(int milliseconds)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+	}
+}
+
+/* a bucket covers [2^n, 2^(n+1)), except that 0 shares the first one and the last one takes everything above it */
+void
+test_stats_bucket()
+{
+	CHECK(Histogram::bucket(0) == 0);
+	CHECK(Histogram::bucket(1) == 0);
+	CHECK(Histogram::bucket(2) == 1);
+	CHECK(Histogram::bucket(3) == 1);
+
+	for (size_t n = 2; n < 64; n++) {
+		auto power = static_cast<uint64_t>(1) << n;
+		CHECK(Histogram::bucket(power - 1) == n - 1);
+		CHECK(Histogram::bucket(power) == n);
+		CHECK(Histogram::bucket(power + 1) == n);
+	}
+	CHECK(Histogram::bucket(UINT64_MAX) == Histogram::buckets - 1);
+}
+
+/* a percentile is the upper bound of the bucket that the rank falls in */
+void
+test_stats_percentile()
+{
+	Histogram histogram;
+	CHECK(histogram.percentile(0.5) == 0);
+
+	// a single value is in the same bucket for every fraction
+	for (size_t i = 0; i < 100; i++)
+		histogram.record(5);
+	CHECK(histogram.percentile(0.0) == 7);
+	CHECK(histogram.percentile(0.5) == 7);
+	CHECK(histogram.percentile(1.0) == 7);
+
+	// 90 fast samples and 10 slow ones, where the slow ones start at the 90th percentile
+	histogram.reset();
+	for (size_t i = 0; i < 90; i++)
+		histogram.record(10);
+	for (size_t i = 0; i < 10; i++)
+		histogram.record(1000);
+	CHECK(histogram.percentile(0.5) == 15);
+	CHECK(histogram.percentile(0.89) == 15);
+	CHECK(histogram.percentile(0.9) == 1023);
+	CHECK(histogram.percentile(0.99) == 1023);
+	CHECK(histogram.count() == 100 && histogram.sum() == 90 * 10 + 10 * 1000 && histogram.maximum() == 1000);
+
+	// the last bucket has no upper bound
+	histogram.reset();
+	histogram.record(UINT64_MAX);
+	CHECK(histogram.percentile(0.5) == UINT64_MAX);
+	CHECK(histogram.maximum() == UINT64_MAX);
+}
+
+/* a reset clears the counts, the totals and the maximum */
+void
+test_stats_reset()
+{
+	Histogram histogram;
+	for (uint64_t value = 1; value < 0x10000; value <<= 1)
+		histogram.record(value);
+	CHECK(histogram.count() == 16);
+
+	histogram.reset();
+	CHECK(histogram.count() == 0 && histogram.sum() == 0 && histogram.maximum() == 0);
+	CHECK(histogram.percentile(0.5) == 0 && histogram.percentile(1.0) == 0);
+
+	histogram.record(3);
+	CHECK(histogram.count() == 1 && histogram.maximum() == 3 && histogram.percentile(1.0) == 3);
+
+	// and the same goes for everything counted for a method
+	Statistics statistics;
+	statistics.enable(true);
+	auto& method = statistics.method("reset");
+	{
+		Probe probe(statistics, method);
+		probe.enter(MethodStats::engine);
+		probe.bytes(16);
+		probe.fault();
+	}
+	CHECK(!statistics.format().empty());
+
+	statistics.reset();
+	CHECK(method.calls == 0 && method.bytes == 0 && method.faults == 0);
+	for (auto& latency : method.latency)
+		CHECK(latency.count() == 0);
+	CHECK(statistics.format().empty());
+}
+
+/* samples recorded from several threads at once all land */
+void
+test_stats_concurrent()
+{
+	Histogram histogram;
+	std::vector<std::thread> pool;
+	for (size_t t = 0; t < threads; t++)
+		pool.emplace_back([&histogram, t]() {
+			for (size_t i = 0; i < samples; i++)
+				histogram.record(i % 1000 + t);
+		});
+	for (auto& thread : pool)
+		thread.join();
+
+	uint64_t sum = 0;
+	for (size_t t = 0; t < threads; t++)
+		for (size_t i = 0; i < samples; i++)
+			sum += i % 1000 + t;
+
+	CHECK(histogram.count() == threads * samples);
+	CHECK(histogram.sum() == sum);
+	CHECK(histogram.maximum() == 999 + threads - 1);
+	CHECK(histogram.percentile(1.0) == 1023);
+}
+
+/* a probe does nothing at all while the statistics are disabled */
+void
+test_stats_disabled()
+{
+	Statistics statistics;
+	auto& method = statistics.method("disabled");
+	CHECK(!statistics.enabled());
+	{
+		Probe probe(statistics, method);
+		probe.enter(MethodStats::guard);
+		probe.enter(MethodStats::engine);
+		probe.bytes(0x1000);
+		probe.fault();
+	}
+	CHECK(method.calls == 0 && method.bytes == 0 && method.faults == 0);
+	for (auto& latency : method.latency)
+		CHECK(latency.count() == 0);
+	CHECK(statistics.format().empty());
+
+	// a probe that was started while disabled stays that way
+	{
+		Probe probe(statistics, method);
+		statistics.enable(true);
+		probe.enter(MethodStats::engine);
+	}
+	CHECK(method.calls == 0 && method.latency[MethodStats::engine].count() == 0);
+}
+
+/* each enter() charges the time since the previous one to the phase that was being timed */
+void
+test_stats_phases()
+{
+	Statistics statistics;
+	statistics.enable(true);
+	auto& method = statistics.method("phases");
+	{
+		Probe probe(statistics, method);
+		pause(5);
+		probe.enter(MethodStats::guard);
+		pause(2);
+		probe.enter(MethodStats::engine);
+		pause(20);
+		probe.enter(MethodStats::conversion);
+		probe.bytes(48);
+	}
+
+	auto& guard = method.latency[MethodStats::guard];
+	auto& engine = method.latency[MethodStats::engine];
+	auto& conversion = method.latency[MethodStats::conversion];
+	auto& total = method.latency[MethodStats::total];
+	CHECK(method.calls == 1 && method.bytes == 48);
+	CHECK(guard.count() == 1 && engine.count() == 1 && conversion.count() == 1 && total.count() == 1);
+
+	// the time before the first phase only counts towards the total
+	CHECK(guard.sum() >= 2000000);
+	CHECK(engine.sum() >= 20000000);
+	CHECK(total.sum() >= 27000000);
+	CHECK(total.sum() >= guard.sum() + engine.sum() + conversion.sum());
+
+	auto text = statistics.format();
+	CHECK(text.find("phases calls=1 bytes=48 faults=0 total=1:") == 0);
+	CHECK(text.find(" engine=1:") != std::string::npos);
+}
+
+int
+main()
+{
+	test_stats_bucket();
+	test_stats_percentile();
+	test_stats_reset();
+	test_stats_concurrent();
+	test_stats_disabled();
+	test_stats_phases();
+	return check::result();
+}
@@ -0,0 +1,104 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "extractor.h"
+
+namespace {
+	const size_t shard = 0x100000;
+
+	Region
+	region(const std::vector<char>& buffer)
+	{
+		Region res = { reinterpret_cast<uintptr_t>(buffer.data()), reinterpret_cast<uintptr_t>(buffer.data()), buffer.size(), memory::state_commit, memory::protect_readwrite, 0 };
+		return res;
+	}
+
+	void
+	fill(std::vector<char>& buffer, size_t offset, size_t length)
+	{
+		for (size_t i = 0; i < length; i++)
+			buffer[offset + i] = static_cast<char>('a' + i % 26);
+	}
+
+	void
+	widen(std::vector<char>& buffer, size_t offset, size_t length)
+	{
+		for (size_t i = 0; i < length; i++)
+			buffer[offset + 2 * i] = static_cast<char>('A' + i % 26);
+	}
+}
+
+/* a run that crosses several shards is reported once, by the shard it starts in, with its whole length */
+void
+test_strings_crossing()
+{
+	std::vector<char> buffer(4 * shard, 0);
+	const size_t start = shard - 100, length = 2 * shard + 300;
+	fill(buffer, start, length);
+	fill(buffer, 3 * shard + 0x1000, 8);
+
+	for (size_t threads = 1; threads <= 4; threads *= 2) {
+		auto found = strings::extract(std::vector<Region>(1, region(buffer)), 4, static_cast<size_t>(-1), threads);
+		CHECK(found.size() == 2);
+		if (found.size() != 2)
+			continue;
+
+		CHECK(found[0].address == reinterpret_cast<uintptr_t>(&buffer[start]));
+		CHECK(found[0].encoding == strings::ascii);
+		CHECK(found[0].length == length);
+		CHECK(found[0].text.size() == strings::maximum);
+		CHECK(found[0].text.compare(0, 26, "abcdefghijklmnopqrstuvwxyz") == 0);
+
+		CHECK(found[1].address == reinterpret_cast<uintptr_t>(&buffer[3 * shard + 0x1000]));
+		CHECK(found[1].length == 8);
+		CHECK(found[1].text == "abcdefgh");
+	}
+}
+
+/* the same for a UTF-16 run, whose length is in characters */
+void
+test_strings_crossing16()
+{
+	std::vector<char> buffer(3 * shard, 0);
+	const size_t start = shard - 0x1000, length = shard / 2 + 0x1000;
+	widen(buffer, start, length);
+
+	auto found = strings::extract(std::vector<Region>(1, region(buffer)), 4, static_cast<size_t>(-1), 2);
+	CHECK(found.size() == 1);
+	if (found.size() == 1) {
+		CHECK(found[0].address == reinterpret_cast<uintptr_t>(&buffer[start]));
+		CHECK(found[0].encoding == strings::utf16);
+		CHECK(found[0].length == length);
+		CHECK(found[0].text.compare(0, 4, "ABCD") == 0);
+	}
+}
+
+/* a run that ends at the end of its span is cut off there, and the short ones are left out */
+void
+test_strings_edges()
+{
+	std::vector<char> buffer(shard + 0x1000, 0);
+	fill(buffer, 0x10, 3);
+	fill(buffer, buffer.size() - 10, 10);
+
+	auto found = strings::extract(std::vector<Region>(1, region(buffer)), 4, static_cast<size_t>(-1), 1);
+	CHECK(found.size() == 1);
+	if (found.size() == 1) {
+		CHECK(found[0].length == 10);
+		CHECK(found[0].text == "abcdefghij");
+	}
+
+	auto limited = strings::extract(std::vector<Region>(1, region(buffer)), 2, 1, 1);
+	CHECK(limited.size() == 1 && limited[0].text == "abc");
+}
+
+int
+main()
+{
+	test_strings_crossing();
+	test_strings_crossing16();
+	test_strings_edges();
+	return check::result();
+}
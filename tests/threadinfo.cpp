@@ -0,0 +1,157 @@
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "threadinfo.h"
+
+namespace {
+	uint32_t
+	current()
+	{
+		return static_cast<uint32_t>(syscall(SYS_gettid));
+	}
+
+	/* a thread that reports its id and then waits until it's told to exit */
+	class Parked {
+	private:
+		std::mutex m_lock;
+		std::condition_variable m_changed;
+		uint32_t m_tid;
+		bool m_released;
+		std::thread m_thread;
+
+	public:
+		Parked() : m_tid(0), m_released(false) {
+			m_thread = std::thread([this]() {
+				std::unique_lock<std::mutex> lock(m_lock);
+				m_tid = current();
+				m_changed.notify_all();
+				m_changed.wait(lock, [this]() { return m_released; });
+			});
+		}
+		~Parked() { release(); }
+
+		uint32_t tid() {
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_changed.wait(lock, [this]() { return m_tid != 0; });
+			return m_tid;
+		}
+
+		void release() {
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				m_released = true;
+			}
+			m_changed.notify_all();
+			if (m_thread.joinable())
+				m_thread.join();
+		}
+	};
+
+	bool
+	listed(const std::vector<ThreadInfo>& threads, uint32_t tid)
+	{
+		return std::any_of(threads.begin(), threads.end(), [tid](const ThreadInfo& info) { return info.tid == tid; });
+	}
+}
+
+/* the calling thread is found along with the stack that it's running on */
+void
+test_threadinfo_self()
+{
+	auto tids = threadinfo::enumerate();
+	CHECK(std::find(tids.begin(), tids.end(), current()) != tids.end());
+
+	ThreadInfo info;
+	CHECK(threadinfo::locate(current(), info));
+	CHECK(info.tid == current());
+	CHECK(info.created != 0);
+	CHECK(info.teb != 0);
+
+	int local = 0;
+	CHECK(info.contains(reinterpret_cast<uintptr_t>(&local)));
+	CHECK(!info.contains(reinterpret_cast<uintptr_t>(&test_threadinfo_self)));
+	CHECK(threadinfo::inspect(info));
+
+	// a thread with the same id that started at another time is a different one
+	auto replaced = info;
+	replaced.created++;
+	CHECK(!threadinfo::inspect(replaced));
+	CHECK(!threadinfo::locate(0, info));
+}
+
+/* other threads are only listed by their id, and are dropped once they've exited */
+void
+test_threadtable_refresh()
+{
+	Parked parked;
+	auto tid = parked.tid();
+
+	ThreadTable table;
+	CHECK(table.generation() == 0);
+	CHECK(table.refresh() >= 2);
+	CHECK(table.generation() == 1);
+	CHECK(listed(table.snapshot(), current()));
+	CHECK(listed(table.snapshot(), tid));
+
+	ThreadInfo info;
+	CHECK(table.find(tid, info));
+	CHECK(info.tid == tid && info.created != 0);
+	CHECK(info.teb == 0 && info.stackbase == 0);
+
+	parked.release();
+	CHECK(!table.find(tid, info));
+	table.refresh();
+	CHECK(!listed(table.snapshot(), tid));
+	CHECK(listed(table.snapshot(), current()));
+	CHECK(table.generation() == 2);
+}
+
+/* a thread that isn't cached yet is located when it's looked up */
+void
+test_threadtable_find()
+{
+	ThreadTable table;
+	CHECK(table.size() == 0);
+
+	ThreadInfo info;
+	CHECK(table.find(current(), info));
+	CHECK(table.size() == 1);
+	int local = 0;
+	CHECK(info.contains(reinterpret_cast<uintptr_t>(&local)));
+
+	// an entry that's gone stale is located again rather than returned as it was
+	ThreadInfo stale = info;
+	stale.created++;
+	stale.stackbase = stale.stacklimit = 0;
+	table.assign(std::vector<ThreadInfo>(1, stale));
+	CHECK(table.find(current(), info));
+	CHECK(info.created == stale.created - 1);
+	CHECK(info.contains(reinterpret_cast<uintptr_t>(&local)));
+}
+
+void
+test_threadtable_format()
+{
+	ThreadInfo info = { 0x1a2c, 0x30f000, 0x190000, 0x18b000, 0 };
+	CHECK(ThreadTable::format(info) == "1a2c 000000000030f000 0000000000190000 000000000018b000");
+	CHECK(info.contains(0x18b000) && info.contains(0x18ffff));
+	CHECK(!info.contains(0x190000) && !info.contains(0x18afff));
+}
+
+int
+main()
+{
+	test_threadinfo_self();
+	test_threadtable_refresh();
+	test_threadtable_find();
+	test_threadtable_format();
+	return check::result();
+}
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "regions.h"
+#include "threading.h"
+
+namespace {
+	const size_t readers = 16;
+	const size_t iterations = 20000;
+	const size_t rounds = 2000;		// the lookups that each reader makes while the writer keeps replacing what it's reading
+
+	struct Slot {
+		std::thread::id owner;
+		size_t value;
+
+		Slot() : owner(std::this_thread::get_id()), value(0) {}
+	};
+
+	/* holds every thread until they've all arrived */
+	class Barrier {
+	private:
+		std::mutex m_lock;
+		std::condition_variable m_arrived;
+		size_t m_waiting;
+
+	public:
+		Barrier(size_t count) : m_waiting(count) {}
+
+		void wait() {
+			std::unique_lock<std::mutex> lock(m_lock);
+			if (--m_waiting == 0)
+				m_arrived.notify_all();
+			else
+				m_arrived.wait(lock, [this]() { return m_waiting == 0; });
+		}
+	};
+
+	/* two layouts that a writer flips between, where each region's type says which one it came from */
+	std::vector<Region>
+	layout(uint32_t type, size_t count, uintptr_t stride)
+	{
+		std::vector<Region> res;
+		for (size_t i = 0; i < count; i++) {
+			Region region = { 0x10000 + i * stride, 0x10000 + i * stride, stride / 2, memory::state_commit, memory::protect_readwrite, type };
+			res.push_back(region);
+		}
+		return res;
+	}
+
+	std::vector<Module>
+	modules(const char* path, size_t count, uintptr_t stride)
+	{
+		std::vector<Module> res;
+		for (size_t i = 0; i < count; i++) {
+			Module module = { 0x10000 + i * stride, stride / 2, path };
+			res.push_back(module);
+		}
+		return res;
+	}
+}
+
+/* every thread gets its own instance, which stays put for as long as the thread is running */
+void
+test_perthread_instances()
+{
+	std::atomic<size_t> created(0);
+	PerThread<Slot> slots([&created]() { created++; return new Slot(); });
+
+	Barrier started(readers), finished(readers);
+	std::mutex lock;
+	std::set<Slot*> seen;
+	std::atomic<size_t> wrong(0);
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < readers; i++) {
+		threads.emplace_back([&]() {
+			started.wait();
+			auto first = &slots.get();
+			for (size_t j = 0; j < iterations; j++) {
+				auto& slot = slots.get();
+				if (&slot != first || slot.owner != std::this_thread::get_id() || slot.value != j)
+					wrong++;
+				slot.value++;
+			}
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				seen.insert(first);
+			}
+			finished.wait();
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	CHECK(wrong == 0);
+	CHECK(seen.size() == readers);
+	CHECK(created == readers);
+
+	// every slot was released when its thread exited
+	CHECK(slots.size() == 0);
+}
+
+/* a thread that starts after another has exited never sees the state that the other one left behind */
+void
+test_perthread_reuse()
+{
+	PerThread<Slot> slots([]() { return new Slot(); });
+	std::atomic<size_t> stale(0);
+
+	for (size_t i = 0; i < 64; i++) {
+		std::thread thread([&]() {
+			auto& slot = slots.get();
+			if (slot.value != 0 || slot.owner != std::this_thread::get_id())
+				stale++;
+			slot.value = 1;
+		});
+		thread.join();
+	}
+	CHECK(stale == 0);
+	CHECK(slots.size() == 0);
+
+	// clearing hands the calling thread a new instance rather than the one it had cached
+	slots.get().value = 5;
+	CHECK(slots.size() == 1);
+	slots.clear();
+	CHECK(slots.size() == 0);
+	CHECK(slots.get().value == 0);
+	CHECK(slots.size() == 1);
+
+	// and so does a new set of slots, even though this thread has already cached one of each
+	for (size_t i = 0; i < 8; i++) {
+		PerThread<Slot> other([]() { return new Slot(); });
+		CHECK(other.get().value == 0);
+		other.get().value = i + 1;
+	}
+}
+
+/* instances that are used by threads which come and go while others keep using theirs */
+void
+test_perthread_churn()
+{
+	std::atomic<size_t> created(0);
+	PerThread<Slot> slots([&created]() { created++; return new Slot(); });
+	std::atomic<bool> done(false);
+	std::atomic<size_t> wrong(0);
+
+	std::vector<std::thread> steady;
+	for (size_t i = 0; i < 4; i++) {
+		steady.emplace_back([&]() {
+			auto first = &slots.get();
+			while (!done) {
+				if (&slots.get() != first)
+					wrong++;
+				std::this_thread::yield();
+			}
+		});
+	}
+
+	for (size_t round = 0; round < 32; round++) {
+		std::vector<std::thread> transient;
+		for (size_t i = 0; i < 8; i++)
+			transient.emplace_back([&]() {
+				for (size_t j = 0; j < 100; j++)
+					slots.get().value++;
+			});
+		for (auto& thread : transient)
+			thread.join();
+	}
+	CHECK(slots.size() == steady.size());
+
+	done = true;
+	for (auto& thread : steady)
+		thread.join();
+	CHECK(wrong == 0);
+	CHECK(created == 4 + 32 * 8);
+	CHECK(slots.size() == 0);
+}
+
+/* readers always see one whole layout or the other while a writer keeps swapping them */
+void
+test_regionmap_readers()
+{
+	const size_t count = 256;
+	const uintptr_t stride = 0x10000;
+	auto first = layout(1, count, stride), second = layout(2, count / 2, stride * 2);
+
+	RegionMap map;
+	CHECK(map.stale(std::chrono::hours(1)));
+	map.assign(first);
+	CHECK(!map.stale(std::chrono::hours(1)));
+	CHECK(map.stale(std::chrono::milliseconds(0)));
+
+	std::atomic<size_t> remaining(readers), wrong(0), found(0);
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < readers; i++) {
+		threads.emplace_back([&, i]() {
+			uintptr_t ea = 0x10000 + i * 0x1234;
+			for (size_t n = 0; n < rounds; n++) {
+				ea = 0x10000 + (ea * 2654435761u) % (count * stride);
+
+				Region region;
+				if (map.find(ea, region)) {
+					found++;
+					if (!region.contains(ea) || (region.type != 1 && region.type != 2))
+						wrong++;
+				}
+
+				auto selected = map.select(ea, ea + 4 * stride, nullptr);
+				for (auto& item : selected)
+					if (item.base < ea || item.end() > ea + 4 * stride)
+						wrong++;
+
+				auto regions = map.snapshot();
+				if (regions.size() != count && regions.size() != count / 2)
+					wrong++;
+				if (!std::is_sorted(regions.begin(), regions.end(), [](const Region& a, const Region& b) { return a.base < b.base; }))
+					wrong++;
+				for (auto& item : regions)
+					if (item.type != regions.front().type)
+						wrong++;
+
+				if (map.readable(ea, 16) > 16)
+					wrong++;
+			}
+			remaining--;
+		});
+	}
+
+	for (size_t i = 0; remaining; i++) {
+		map.assign((i & 1) ? first : second);
+		std::this_thread::yield();
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	CHECK(wrong == 0);
+	CHECK(found > 0);
+}
+
+/* the generation only moves when a refresh finds something different */
+void
+test_regionmap_generation()
+{
+	auto first = layout(1, 16, 0x10000), second = layout(1, 17, 0x10000);
+
+	RegionMap map;
+	CHECK(map.generation() == 0);
+	map.assign(first);
+	auto generation = map.generation();
+	CHECK(generation == 1);
+	map.assign(first);
+	CHECK(map.generation() == generation);
+	map.assign(second);
+	CHECK(map.generation() == generation + 1);
+
+	// even an empty layout counts as having been read
+	RegionMap empty;
+	empty.assign({});
+	CHECK(empty.generation() == 1);
+	CHECK(!empty.stale(std::chrono::hours(1)));
+}
+
+/* the real layout can be read while others are looking things up in it */
+void
+test_regionmap_refresh()
+{
+	RegionMap map;
+	ModuleTable table;
+	CHECK(map.refresh() > 0);
+	CHECK(table.refresh() > 0);
+
+	int local = 0;
+	auto stack = reinterpret_cast<uintptr_t>(&local);
+	auto code = reinterpret_cast<uintptr_t>(&test_regionmap_refresh);
+
+	std::atomic<size_t> remaining(readers), wrong(0);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < readers; i++) {
+		threads.emplace_back([&]() {
+			for (size_t n = 0; n < rounds; n++) {
+				Region region;
+				if (!map.find(stack, region) || !region.readable() || !region.writable())
+					wrong++;
+				if (!map.find(code, region) || !region.executable())
+					wrong++;
+
+				Module module;
+				if (!table.find(code, module) || module.path.find("test_threading") == std::string::npos)
+					wrong++;
+			}
+			remaining--;
+		});
+	}
+
+	while (remaining) {
+		map.refresh();
+		table.refresh();
+	}
+	for (auto& thread : threads)
+		thread.join();
+	CHECK(wrong == 0);
+}
+
+/* module lookups stay consistent while the table is being replaced */
+void
+test_moduletable_readers()
+{
+	const size_t count = 512;
+	const uintptr_t stride = 0x20000;
+	auto first = modules("/first", count, stride), second = modules("/second", count, stride);
+
+	ModuleTable table;
+	CHECK(table.stale(std::chrono::hours(1)));
+	table.assign(first);
+	auto generation = table.generation();
+	table.assign(first);
+	CHECK(table.generation() == generation);
+
+	std::atomic<size_t> remaining(readers), wrong(0), found(0);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < readers; i++) {
+		threads.emplace_back([&, i]() {
+			uintptr_t ea = 0x10000 + i * 0x777;
+			for (size_t n = 0; n < rounds; n++) {
+				ea = 0x10000 + (ea * 2654435761u) % (count * stride);
+
+				Module module;
+				if (table.find(ea, module)) {
+					found++;
+					if (!module.contains(ea) || (module.path != "/first" && module.path != "/second"))
+						wrong++;
+				}
+
+				auto loaded = table.snapshot();
+				if (loaded.size() != count)
+					wrong++;
+				for (auto& item : loaded)
+					if (item.path != loaded.front().path)
+						wrong++;
+			}
+			remaining--;
+		});
+	}
+
+	for (size_t i = 0; remaining; i++) {
+		table.assign((i & 1) ? first : second);
+		std::this_thread::yield();
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	CHECK(wrong == 0);
+	CHECK(found > 0);
+	CHECK(table.generation() > generation);
+}
+
+int
+main()
+{
+	test_perthread_instances();
+	test_perthread_reuse();
+	test_perthread_churn();
+	test_regionmap_readers();
+	test_regionmap_generation();
+	test_regionmap_refresh();
+	test_moduletable_readers();
+	return check::result();
+}
@@ -0,0 +1,156 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "check.h"
+#include "trace.h"
+#include "walker.h"
+
+namespace {
+	const uint64_t base = 0x10000000, size = 0x1000;
+	const uint64_t offset = 0x10;		// where the link is in each node
+	const size_t count = 5;
+
+	/* a circular list of `count` nodes 0x100 bytes apart, whose sentinel is at the base */
+	trace::MemoryBackend
+	list()
+	{
+		trace::MemoryBackend res;
+		res.map(base, size);
+
+		uint64_t previous = base;
+		for (size_t i = 1; i <= count; i++) {
+			uint64_t link = base + i * 0x100 + offset;
+			res.write(previous, &link, sizeof(link));
+			previous = link;
+		}
+		uint64_t head = base;
+		res.write(previous, &head, sizeof(head));
+		return res;
+	}
+
+	std::vector<uint8_t>
+	image(trace::Backend& backend)
+	{
+		std::vector<uint8_t> res(size);
+		backend.read(base, res.data(), res.size());
+		return res;
+	}
+
+	void
+	save(const char* path, const std::string& contents)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << contents;
+	}
+}
+
+/* an entry survives being encoded, including the largest values and the fault bit */
+void
+test_trace_encoding()
+{
+	trace::Entry entry = { trace::copy, true, 0x123456789ull, ~0ull, 0x80, 0x7f, 0 };
+	uint8_t buffer[trace::maximum];
+	auto length = trace::encode(entry, buffer);
+	CHECK(length <= trace::maximum);
+
+	trace::Entry decoded;
+	CHECK(trace::decode(buffer, length, decoded) == length);
+	CHECK(decoded.op == trace::copy && decoded.faulted);
+	CHECK(decoded.timestamp == entry.timestamp && decoded.address == entry.address);
+	CHECK(decoded.size == entry.size && decoded.value == entry.value && decoded.result == entry.result);
+
+	CHECK(trace::decode(buffer, length - 1, decoded) == 0);
+}
+
+/*
+	Walks through a recording backend are recorded, flushed, parsed back, and
+	replayed against the same memory without any differences. Replaying them
+	against memory where a link was changed diverges at the load of that link.
+	The trace and both images are left behind for the replay program's tests.
+*/
+void
+test_trace_roundtrip()
+{
+	auto memory = list();
+	auto original = image(memory);
+
+	trace::Recorder recorder(0x10000);
+	trace::RecordingBackend backend(memory, recorder);
+
+	// nothing is recorded until the recorder is started
+	walk::list(backend, base, offset, sizeof(uint64_t), 100);
+	std::vector<trace::Entry> drained;
+	CHECK(recorder.drain(drained) == 0);
+
+	recorder.start();
+	auto walked = walk::list(backend, base, offset, sizeof(uint64_t), 100);
+	CHECK(walked.status == walk::List::complete);
+	CHECK(walked.nodes.size() == count);
+	CHECK(!walked.nodes.empty() && walked.nodes[0] == base + 0x100);
+
+	walk::Path path("[[base]]+8");
+	uint64_t result, fault;
+	CHECK(path.evaluate(backend, base, sizeof(uint64_t), result, fault));
+	CHECK(result == base + 0x200 + offset + 8);
+
+	walk::Path faulting("[[base]+0x100000]");
+	CHECK(!faulting.evaluate(backend, base, sizeof(uint64_t), result, fault));
+	CHECK(fault == base + 0x100 + offset + 0x100000);
+
+	uint64_t value = 0x41414141;
+	CHECK(backend.write(base + 0x800, &value, sizeof(value)) == sizeof(value));
+	std::vector<uint8_t> bulk(0x20);
+	CHECK(backend.read(base + size - 0x10, bulk.data(), bulk.size()) == 0x10);
+	recorder.stop();
+
+	std::stringstream stream;
+	trace::header(stream);
+	CHECK(recorder.flush(stream) == (count + 1) + 2 + 2 + 1 + 1);
+	CHECK(recorder.dropped() == 0);
+
+	auto entries = trace::parse(stream);
+	CHECK(entries.size() == (count + 1) + 2 + 2 + 1 + 1);
+	if (entries.size() != (count + 1) + 2 + 2 + 1 + 1)
+		return;
+
+	for (size_t i = 0; i < count + 5; i++)
+		CHECK(entries[i].op == trace::load && entries[i].size == sizeof(uint64_t));
+	CHECK(entries[0].address == base && entries[0].result == base + 0x100 + offset && !entries[0].faulted);
+	CHECK(entries[count + 4].faulted && entries[count + 4].address == fault);
+	CHECK(entries[count + 5].op == trace::write && entries[count + 5].result == sizeof(value));
+	CHECK(entries[count + 6].op == trace::read && entries[count + 6].result == 0x10 && entries[count + 6].faulted);
+	for (size_t i = 1; i < entries.size(); i++)
+		CHECK(entries[i].timestamp >= entries[i - 1].timestamp);
+
+	// against the memory as it was when the trace started
+	trace::MemoryBackend same;
+	same.assign(base, original.data(), original.size());
+	auto summary = trace::replay(entries, same);
+	CHECK(summary.entries == entries.size());
+	CHECK(summary.mismatches == 0 && summary.diverged.empty());
+	CHECK(summary.skipped == 1);
+
+	// and after the second node's link has been pointed back at the sentinel
+	auto changed = original;
+	uint64_t head = base;
+	memcpy(&changed[0x200 + offset], &head, sizeof(head));
+	trace::MemoryBackend different;
+	different.assign(base, changed.data(), changed.size());
+	summary = trace::replay(entries, different);
+	CHECK(summary.mismatches > 0);
+	CHECK(!summary.diverged.empty() && summary.diverged[0] == 2);
+
+	save("walk.trace", stream.str());
+	save("walk.bin", std::string(original.begin(), original.end()));
+	save("walk-changed.bin", std::string(changed.begin(), changed.end()));
+}
+
+int
+main()
+{
+	test_trace_encoding();
+	test_trace_roundtrip();
+	return check::result();
+}
@@ -0,0 +1,129 @@
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "transfer.h"
+
+namespace {
+	const size_t pagesize = transfer::pagesize;
+
+	/* a few pages that start on a page boundary, numbered so that every byte is distinct from its neighbours */
+	class Pages {
+	private:
+		std::vector<uint8_t> m_buffer;
+		uint8_t* m_base;
+
+	public:
+		Pages(size_t count) : m_buffer((count + 1) * pagesize) {
+			auto ea = reinterpret_cast<uintptr_t>(m_buffer.data());
+			m_base = m_buffer.data() + (pagesize - ea % pagesize) % pagesize;
+			for (size_t i = 0; i < count * pagesize; i++)
+				m_base[i] = static_cast<uint8_t>(i % 251);
+		}
+
+		uint8_t* at(size_t offset) { return m_base + offset; }
+		uintptr_t address(size_t offset) { return reinterpret_cast<uintptr_t>(at(offset)); }
+	};
+}
+
+/* a write that straddles a page returns what was there before it */
+void
+test_transfer_write()
+{
+	Pages pages(3);
+	std::vector<uint8_t> data(pagesize + 0x20);
+	std::iota(data.begin(), data.end(), 0x40);
+
+	std::vector<uint8_t> original(pages.at(pagesize - 0x10), pages.at(pagesize - 0x10) + data.size());
+	std::vector<uint8_t> previous;
+	CHECK(transfer::write(pages.address(pagesize - 0x10), data.data(), data.size(), &previous) == data.size());
+	CHECK(previous == original);
+	CHECK(memcmp(pages.at(pagesize - 0x10), data.data(), data.size()) == 0);
+
+	// without asking for the previous contents
+	CHECK(transfer::write(pages.address(0), data.data(), 4, nullptr) == 4);
+	CHECK(memcmp(pages.at(0), data.data(), 4) == 0);
+	CHECK(transfer::write(pages.address(0), data.data(), 0, &previous) == 0 && previous.empty());
+}
+
+/* the pattern keeps its phase across page boundaries, and a partial copy of it is left at the end */
+void
+test_transfer_fill()
+{
+	Pages pages(4);
+	const std::vector<uint8_t> pattern = { 0xde, 0xad, 0xbe };
+	const size_t start = pagesize - 5, count = 2 * pagesize + 7;
+
+	std::vector<uint8_t> original(pages.at(start), pages.at(start) + count), previous;
+	CHECK(transfer::fill(pages.address(start), count, pattern, &previous) == count);
+	CHECK(previous == original);
+
+	size_t wrong = 0;
+	for (size_t i = 0; i < count; i++)
+		wrong += (*pages.at(start + i) == pattern[i % pattern.size()]) ? 0 : 1;
+	CHECK(wrong == 0);
+	CHECK(*pages.at(start + count) == (start + count) % 251);
+
+	// shorter than the pattern
+	CHECK(transfer::fill(pages.address(0), 2, pattern, nullptr) == 2);
+	CHECK(*pages.at(0) == 0xde && *pages.at(1) == 0xad && *pages.at(2) == 2);
+
+	bool thrown = false;
+	try {
+		transfer::fill(pages.address(0), 1, std::vector<uint8_t>(), nullptr);
+	}
+	catch (const std::invalid_argument&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+/* copies between separate ranges and overlapping ones in either direction behave like memmove */
+void
+test_transfer_copy()
+{
+	Pages pages(4);
+	const size_t count = pagesize + 0x30;
+
+	std::vector<uint8_t> expected(pages.at(0x10), pages.at(0x10) + count), previous;
+	std::vector<uint8_t> original(pages.at(2 * pagesize + 0x8), pages.at(2 * pagesize + 0x8) + count);
+	CHECK(transfer::copy(pages.address(2 * pagesize + 0x8), pages.address(0x10), count, &previous) == count);
+	CHECK(previous == original);
+	CHECK(memcmp(pages.at(2 * pagesize + 0x8), expected.data(), count) == 0);
+
+	// forwards over itself
+	expected.assign(pages.at(0), pages.at(0) + count);
+	original.assign(pages.at(0x100), pages.at(0x100) + count);
+	CHECK(transfer::copy(pages.address(0x100), pages.address(0), count, &previous) == count);
+	CHECK(memcmp(pages.at(0x100), expected.data(), count) == 0);
+	CHECK(previous == original);
+
+	// and backwards
+	expected.assign(pages.at(0x100), pages.at(0x100) + count);
+	CHECK(transfer::copy(pages.address(0x80), pages.address(0x100), count, nullptr) == count);
+	CHECK(memcmp(pages.at(0x80), expected.data(), count) == 0);
+}
+
+void
+test_transfer_read()
+{
+	Pages pages(2);
+	std::vector<uint8_t> result;
+	CHECK(transfer::read(pages.address(pagesize - 2), 4, result) == 4);
+	CHECK(transfer::format(result) == "4e4f5051");
+
+	CHECK(transfer::format(std::vector<uint8_t>{ 0x00, 0x0f, 0xf0, 0xff }) == "000ff0ff");
+	CHECK(transfer::format(std::vector<uint8_t>()).empty());
+}
+
+int
+main()
+{
+	test_transfer_write();
+	test_transfer_fill();
+	test_transfer_copy();
+	test_transfer_read();
+	return check::result();
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "check.h"
+#include "vtables.h"
+
+namespace {
+	const size_t shard = 0x100000;
+	const uint64_t module = 0x7ff800000000;
+
+	template<typename T> Region
+	region(const std::vector<T>& values)
+	{
+		Region res = { reinterpret_cast<uintptr_t>(values.data()), reinterpret_cast<uintptr_t>(values.data()), values.size() * sizeof(T), memory::state_commit, memory::protect_readonly, 0 };
+		return res;
+	}
+
+	/* a run of `count` entries that point into the code, starting at the `index` entry */
+	template<typename T> void
+	run(std::vector<T>& values, size_t index, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			values[index + i] = static_cast<T>(module + 0x1000 + 0x10 * (index + i) % 0x800);
+	}
+
+	template<typename T> uintptr_t
+	at(const std::vector<T>& values, size_t index)
+	{
+		return reinterpret_cast<uintptr_t>(&values[index]);
+	}
+}
+
+/* only the runs that are long enough are tables, even when they were split between shards */
+void
+test_vtables_search()
+{
+	const size_t per = shard / sizeof(uint64_t);
+	std::vector<uint64_t> values(3 * per, 0), other(0x100, 0);
+	run(values, 0, 5);
+	run(values, 16, 2);						// too short
+	run(values, 32, 3);
+	values[36] = module + 0x2000;			// outside of the code, so it ends the next run
+	run(values, 37, 4);
+	run(values, per - 2, 4);				// split between the first two shards
+	run(values, 2 * per - 1, 2);			// also split, but too short even once it's joined
+	run(values, 3 * per - 3, 3);			// at the very end
+	run(other, 0, 3);						// in another region, which doesn't join with the end of the first
+
+	pointers::Targets code({ { module + 0x1000, module + 0x1800 } });
+	// the regions are listed in address order, the way that a layout is
+	std::vector<Region> regions = { region(values), region(other) };
+	if (regions[1].base < regions[0].base)
+		std::swap(regions[0], regions[1]);
+
+	for (size_t threads : { 1, 4 }) {
+		auto tables = vtables::search(regions, sizeof(uint64_t), code, 3, threads);
+		std::vector<vtables::Table> expected = {
+			{ at(values, 0), 5 }, { at(values, 32), 3 }, { at(values, 37), 4 }, { at(values, per - 2), 4 }, { at(values, 3 * per - 3), 3 }, { at(other, 0), 3 },
+		};
+		std::sort(expected.begin(), expected.end());
+		CHECK(tables.size() == expected.size());
+		for (size_t i = 0; i < tables.size() && i < expected.size(); i++)
+			CHECK(tables[i].address == expected[i].address && tables[i].length == expected[i].length);
+	}
+
+	// a minimum of 1 finds every run
+	CHECK(vtables::search(regions, sizeof(uint64_t), code, 1, 2).size() == 8);
+}
+
+/* 32-bit tables are read with the narrower kernel, and any other width is rejected */
+void
+test_vtables_narrow()
+{
+	std::vector<uint32_t> values(0x400, 0);
+	run(values, 0x10, 6);
+	run(values, 0x80, 2);
+
+	pointers::Targets code({ { module + 0x1000, module + 0x1800 } });
+	CHECK(vtables::search({ region(values) }, sizeof(uint64_t), code, 3, 1).empty());
+
+	// the values are cut down to the low half of where the code would be
+	pointers::Targets narrow({ { 0x1000, 0x1800 } });
+	auto tables = vtables::search({ region(values) }, sizeof(uint32_t), narrow, 3, 1);
+	CHECK(tables.size() == 1 && tables[0].address == at(values, 0x10) && tables[0].length == 6);
+	CHECK(tables.size() == 1 && tables[0].end(sizeof(uint32_t)) == at(values, 0x16));
+
+	bool thrown = false;
+	try {
+		vtables::search({ region(values) }, 2, narrow, 3, 1);
+	}
+	catch (const std::invalid_argument&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+}
+
+void
+test_vtables_utilities()
+{
+	Region region = { 0x10000, 0x10000, 0x1000, memory::state_commit, memory::protect_readonly, 0 };
+	CHECK(vtables::readonly(region));
+	region.protect = memory::protect_readwrite;
+	CHECK(!vtables::readonly(region));
+	region.protect = memory::protect_execute_read;
+	CHECK(!vtables::readonly(region));
+
+	vtables::Table table = { 0x7ff812345678, 12 };
+	CHECK(vtables::format(table, "ntdll") == "00007ff812345678 12 ntdll");
+}
+
+/* the tables of a module are kept until it's unloaded, and only for the same search */
+void
+test_vtables_cache()
+{
+	Module first = { 0x10000, 0x8000, "/first.dll" }, second = { 0x20000, 0x8000, "/second.dll" };
+	std::vector<vtables::Table> tables = { { 0x11000, 4 } }, result;
+
+	vtables::Cache cache;
+	CHECK(!cache.find(first, 8, 3, result));
+	cache.assign(first, 8, 3, tables);
+	cache.assign(second, 8, 3, {});
+	CHECK(cache.size() == 2);
+
+	CHECK(cache.find(first, 8, 3, result) && result.size() == 1 && result[0].address == 0x11000);
+	CHECK(!cache.find(first, 4, 3, result));
+	CHECK(!cache.find(first, 8, 5, result));
+
+	// a different module that was loaded at the same place isn't the same one
+	Module replaced = { 0x10000, 0x8000, "/replaced.dll" };
+	CHECK(!cache.find(replaced, 8, 3, result));
+
+	CHECK(cache.retain({ replaced, second }) == 1);
+	CHECK(!cache.find(first, 8, 3, result));
+	CHECK(cache.find(second, 8, 3, result) && result.empty());
+}
+
+int
+main()
+{
+	test_vtables_search();
+	test_vtables_narrow();
+	test_vtables_utilities();
+	test_vtables_cache();
+	return check::result();
+}
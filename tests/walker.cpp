@@ -0,0 +1,174 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "trace.h"
+#include "walker.h"
+
+namespace {
+	const uint64_t base = 0x20000000, size = 0x2000;
+
+	/* memory holding pointers of `width` bytes */
+	class Memory {
+	public:
+		trace::MemoryBackend backend;
+		size_t width;
+
+		Memory(size_t width) : width(width) {
+			backend.map(base, size);
+		}
+
+		void set(uint64_t ea, uint64_t value) {
+			backend.write(ea, &value, width);
+		}
+
+		// link the nodes at each address in order, with the link at `offset` within each node
+		void chain(const std::vector<uint64_t>& nodes, uint64_t offset, uint64_t last) {
+			for (size_t i = 0; i < nodes.size(); i++)
+				set(nodes[i] + offset, (i + 1 < nodes.size()) ? nodes[i + 1] + offset : last);
+		}
+	};
+
+	bool
+	invalid(const std::string& expression)
+	{
+		try {
+			walk::Path path(expression);
+		}
+		catch (const std::invalid_argument&) {
+			return true;
+		}
+		return false;
+	}
+}
+
+/* arithmetic and dereferences are applied in the order they're written */
+void
+test_walker_path()
+{
+	Memory memory(sizeof(uint64_t));
+	memory.set(base + 0x18, base + 0x100);
+	memory.set(base + 0x110, base + 0x200);
+	memory.set(base + 0x208, 0x1234);
+
+	uint64_t result, fault;
+	walk::Path chain("[[base+0x18]+0x10]+8");
+	CHECK(chain.hops() == 2);
+	CHECK(chain.evaluate(memory.backend, base, sizeof(uint64_t), result, fault) && result == base + 0x208);
+
+	walk::Path deeper(" [ [ [base + 24] + 16 ] + 8 ] - 0x34 ");
+	CHECK(deeper.hops() == 3);
+	CHECK(deeper.evaluate(memory.backend, base, sizeof(uint64_t), result, fault) && result == 0x1200);
+
+	walk::Path constant("0x10+16-2");
+	CHECK(constant.hops() == 0);
+	CHECK(constant.evaluate(memory.backend, 0, sizeof(uint64_t), result, fault) && result == 30);
+
+	// a hop into memory that isn't there reports where it was, and so does one below the lowest address
+	walk::Path unmapped("[[base+0x18]+0x4000]");
+	CHECK(!unmapped.evaluate(memory.backend, base, sizeof(uint64_t), result, fault) && fault == base + 0x4100);
+	walk::Path null("[[base+0x20]]");
+	CHECK(!null.evaluate(memory.backend, base, sizeof(uint64_t), result, fault) && fault == 0);
+
+	// a pointer only reads its own width
+	Memory narrow(sizeof(uint32_t));
+	narrow.set(base + 4, base + 0x40);
+	narrow.set(base + 0x40, 0xffffffff);
+	walk::Path pointer("[[base+4]]");
+	CHECK(pointer.evaluate(narrow.backend, base, sizeof(uint32_t), result, fault) && result == 0xffffffff);
+}
+
+void
+test_walker_syntax()
+{
+	CHECK(invalid(""));
+	CHECK(invalid("[base"));
+	CHECK(invalid("base]"));
+	CHECK(invalid("base+"));
+	CHECK(invalid("base*2"));
+	CHECK(invalid("bas"));
+	CHECK(invalid(std::string(0x101, '[') + "base" + std::string(0x101, ']')));
+	CHECK(!invalid(std::string(0x100, '[') + "base" + std::string(0x100, ']')));
+}
+
+/* a list is walked until it comes back to its sentinel, and each node is the record that contains its link */
+void
+test_walker_complete()
+{
+	for (size_t width : { sizeof(uint32_t), sizeof(uint64_t) }) {
+		Memory memory(width);
+		const uint64_t head = base, offset = 0x20;
+		std::vector<uint64_t> nodes = { base + 0x300, base + 0x100, base + 0x1f00, base + 0x200 };
+
+		memory.set(head, nodes[0] + offset);
+		memory.chain(nodes, offset, head);
+
+		auto list = walk::list(memory.backend, head, offset, width, 100);
+		CHECK(list.status == walk::List::complete);
+		CHECK(list.nodes == nodes);
+		CHECK(walk::format(list) == "0000000020000300\n0000000020000100\n0000000020001f00\n0000000020000200\n");
+	}
+
+	// an empty list only has its sentinel
+	Memory memory(sizeof(uint64_t));
+	memory.set(base, base);
+	auto empty = walk::list(memory.backend, base, 0, sizeof(uint64_t), 100);
+	CHECK(empty.status == walk::List::complete && empty.nodes.empty());
+	CHECK(walk::format(empty).empty());
+}
+
+/* walks that stop early say why and where */
+void
+test_walker_stopped()
+{
+	Memory memory(sizeof(uint64_t));
+	std::vector<uint64_t> nodes;
+	for (uint64_t i = 1; i <= 8; i++)
+		nodes.push_back(base + i * 0x100);
+	memory.set(base, nodes[0]);
+
+	// the limit
+	memory.chain(nodes, 0, base);
+	auto limited = walk::list(memory.backend, base, 0, sizeof(uint64_t), 3);
+	CHECK(limited.status == walk::List::limit && limited.nodes.size() == 3);
+	CHECK(limited.where == nodes[3]);
+	CHECK(walk::format(limited).find("limit 0000000020000400\n") != std::string::npos);
+
+	// a cycle that never returns to the sentinel keeps each node once
+	memory.chain(nodes, 0, nodes[2]);
+	auto cycle = walk::list(memory.backend, base, 0, sizeof(uint64_t), 1000);
+	CHECK(cycle.status == walk::List::cycle);
+	CHECK(cycle.nodes == nodes);
+	CHECK(cycle.where == nodes[2]);
+
+	// a node that points to itself
+	memory.chain(std::vector<uint64_t>(1, nodes[0]), 0, nodes[0]);
+	auto self = walk::list(memory.backend, base, 0, sizeof(uint64_t), 1000);
+	CHECK(self.status == walk::List::cycle && self.nodes.size() == 1);
+
+	// a link into memory that isn't there
+	memory.chain(nodes, 0, base + 0x100000);
+	auto faulted = walk::list(memory.backend, base, 0, sizeof(uint64_t), 1000);
+	CHECK(faulted.status == walk::List::fault && faulted.nodes == nodes);
+	CHECK(faulted.where == base + 0x100000);
+
+	// and a null one, which isn't even read
+	memory.chain(nodes, 0, 0);
+	auto null = walk::list(memory.backend, base, 0, sizeof(uint64_t), 1000);
+	CHECK(null.status == walk::List::fault && null.where == 0);
+
+	// a sentinel that can't be read
+	auto missing = walk::list(memory.backend, base + 0x100000, 0, sizeof(uint64_t), 1000);
+	CHECK(missing.status == walk::List::fault && missing.nodes.empty() && missing.where == base + 0x100000);
+}
+
+int
+main()
+{
+	test_walker_path();
+	test_walker_syntax();
+	test_walker_complete();
+	test_walker_stopped();
+	return check::result();
+}
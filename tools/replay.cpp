@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "scanner.h"
+#include "trace.h"
+
+/*
+	Replay a trace that was written by trace_flush against memory images that
+	are loaded at the addresses they came from, or against this process. Each
+	entry whose result differs from the recorded one is listed, and the exit
+	code is non-zero if there were any.
+
+		replay [--map address:path]... [--process] trace
+*/
+namespace {
+	int
+	usage()
+	{
+		std::cerr << "usage: replay [--map address:path]... [--process] trace" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// load the image in "address:path" into the backend, where the address is in hex
+	void
+	map(trace::MemoryBackend& backend, const std::string& argument)
+	{
+		auto separator = argument.find(':');
+		if (separator == std::string::npos || separator == 0)
+			throw std::invalid_argument(argument);
+		auto address = std::stoull(argument.substr(0, separator), nullptr, 16);
+
+		std::ifstream file(argument.substr(separator + 1), std::ios::binary);
+		if (!file)
+			throw std::invalid_argument(argument);
+		std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (!contents.empty())
+			backend.assign(address, contents.data(), contents.size());
+	}
+}
+
+int
+main(int argc, char** argv)
+{
+	trace::MemoryBackend memory;
+	trace::ProcessBackend process;
+	trace::Backend* backend = &memory;
+	std::string path;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string option(argv[i]);
+			if (option == "--map" && i + 1 < argc)
+				map(memory, argv[++i]);
+			else if (option == "--process")
+				backend = &process;
+			else if (option.compare(0, 2, "--") != 0 && path.empty())
+				path = option;
+			else
+				return usage();
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << "unable to map " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (path.empty())
+		return usage();
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "unable to read " << path << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	auto entries = trace::parse(file);
+	auto summary = trace::replay(entries, *backend);
+
+	for (auto index : summary.diverged) {
+		auto& entry = entries[index];
+		std::cout << "diverged " << index << " " << trace::name(entry.op) << " " << scan::format(static_cast<uintptr_t>(entry.address)) << " " << std::hex << entry.size << std::dec << std::endl;
+	}
+	std::cout << "entries " << summary.entries << " bytes " << summary.bytes << " mismatches " << summary.mismatches << " skipped " << summary.skipped << " seconds " << summary.seconds << std::endl;
+	return summary.mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}